@@ -26,11 +26,60 @@
 *       - If enabled, the bot only initiates trades within "Start Time" and "Stop Time".
 *       - If enabled, at "Stop Time", any open position is flattened, and working
 *         orders are canceled.
-*   5.  Safety: If an active Stop or Take-Profit order (child of the filled
+*       - Alternatively, a session calendar file (multiple windows, holidays,
+*         early closes, blackouts) is compiled into a sorted interval array and
+*         checked against a cached next-boundary timestamp.
+*   5.  Daily Risk: A running realized P&L and trade counter, fed from detected
+*       fills, trips a kill switch (cancel, flatten, idle until the next day) on a
+*       daily loss limit, max consecutive losses, or max trades per day.
+*   6.  Order Rate Limiting (Optional): Submits, modifies, cancels and
+*       flattens go through per-second and per-minute token buckets. Deferred
+*       cancels are queued; a queued bracket cancel plus a new submission
+*       becomes a modify.
+*   7.  Order Templates: Brackets are submitted from persistent pre-filled
+*       orders; only prices and offsets are patched per submission.
+*   8.  Bracket Ladder (Optional): Extra OCO brackets at wider fractions of
+*       'R', tracked in a fixed array by order ID and reconciled against the
+*       position.
+*   9.  Partial Fills and Scale-Out: Partial entry fills are tracked through
+*       FilledQuantity: the opposite leg is cancelled, the remainder is
+*       cancelled or kept per policy, and the attached stop and target are
+*       resized to the open quantity. Optionally, up to four attached
+*       stop/target groups split the quantity, with a breakeven stop move
+*       after the first target.
+*   10. State Snapshot (Optional): Written on every transition and validated
+*       against the live orders at startup, so a restart resumes open trades.
+*   11. Parameter File (Optional): Checked for changes at most once per
+*       second; changes the fractions of 'R' and the trading window without a
+*       chart recalculation and requotes an armed bracket.
+*   12. Stale-Feed Guard (Optional): A smoothed trade time to receive time
+*       latency above a threshold pulls armed brackets until it recovers.
+*   13. Measurement:
+*       - Optional per-phase profiling: per-bar min/mean/max/p99 call timings
+*         as subgraphs.
+*       - Fill quality per round trip (slippage, arm-to-fill, time in trade,
+*         MAE/MFE) in subgraphs and optionally appended to a CSV.
+*       - Submit, cancel and flatten acknowledgement latency per action type,
+*         published as p50/p99/p99.9 subgraphs.
+*       - Optional Prometheus textfile export of counters, gauges and latency
+*         histograms, written by a background thread.
+*       - Optional order lifecycle trace: status spans of every submitted
+*         order, keyed by InternalOrderID, buffered in a fixed ring and
+*         appended as Chrome trace-event JSON by a background thread.
+*   14. External Strategy Process (Optional): Market data and order events are
+*       published on a shared-memory bus of two lock-free rings, and the order
+*       commands read back are executed through the rate limiter.
+*   15. Safety: If an active Stop or Take-Profit order (child of the filled
 *       entry) is detected as CANCELED or in ERROR state while a position is open,
 *       the bot will attempt to flatten the position to prevent it from becoming
 *       unprotected.
 *
+*   Study Variants:
+*       scsf_Scalping_Bot takes every choice from its inputs. The other exported
+*       studies fix the 'R' source (subgraph or built-in range EMA), the center
+*       price, the exit (static, trailing stop, time stop) and the time gating
+*       (window or calendar) at compile time through policy templates.
+*
 *   Core Parameters:
 *   - Number of Contracts
 *   - Volatility Subgraph (for 'R' value)
@@ -39,6 +88,9 @@
 *   - Start Time, Stop Time (if window is used)
 *   - Master Trading Enable switch
 *   - Log Detail Level (dropdown: NONE, ERROR, WARN, INFO, DEBUG, VERBOSE)
+*   - Bracket Center Price (dropdown: LAST TRADE, MID, MICROPRICE) and
+*     the number of market depth levels used for the microprice
+*   - Optional order book imbalance gate (threshold, skip or one-sided arming)
 *
 *   Important: Thorough simulation is crucial before live trading.
 *   See README.md for simulation recommendations and risk disclaimers.
@@ -48,6 +100,26 @@
 
 #include "sierrachart.h"
 
+#include <algorithm>     // std::sort, std::upper_bound for the session calendar.
+#include <atomic>        // Lock-free counters shared with the metrics writer thread.
+#include <chrono>        // steady_clock for the order rate limiter and latency timing.
+#include <cctype>        // isalnum for the per-chart state snapshot file name.
+#include <cstdarg>       // va_list for the fixed-size log message buffer.
+#include <cstddef>       // offsetof for the state snapshot checksum.
+#include <cstdio>        // fopen/fgets for the session calendar file.
+#include <cstdlib>       // strtof for the parameter file values.
+#include <thread>        // Background writer of the metrics file.
+#include <sys/stat.h>    // Modification time and size of the parameter and calendar files.
+
+#include "scalping_bot_bus.h" // Shared-memory rings to an external strategy process.
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>   // SSE2 intrinsics for the market depth reduction.
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>      // _BitScanReverse64 for the latency histogram bucket index.
+#endif
+
 SCDLLName("Scalping Bot")
 
 // Enum for logging levels to control the verbosity of messages.
@@ -71,7 +143,8 @@ enum TradeSide {
 // Enum to represent the status of the OCO bracket order.
 enum BracketStatus {
     BRACKET_NOT_ARMED = 0,
-    BRACKET_ARMED_AND_WORKING = 1
+    BRACKET_ARMED_AND_WORKING = 1,
+    BRACKET_CANCEL_PENDING = 2      // Cancel requested; the leg IDs are kept until neither leg can fill.
 };
 
 // Symbolic constants for persistent variable keys.
@@ -88,15 +161,984 @@ enum BracketStatus {
 #define PID_LAST_LOGGED_INVALID_R_BAR 102
 #define PID_LAST_LOGGED_AFTER_WINDOW_BAR 103
 #define PID_LAST_LOGGED_OFFSETS_BAR 104
+#define PID_LAST_LOGGED_NO_DEPTH_BAR 105
+#define PID_LAST_LOGGED_CALENDAR_ERROR_BAR 106
+
+// Persistent pointer key for the heap-allocated runtime state (see BotRuntimeState).
+#define PID_RUNTIME_STATE_POINTER 1
+
+// Enum for the price the OCO bracket is centered on.
+// The order here MUST match the "Bracket Center Price" input strings.
+enum BracketCenterMode {
+    CENTER_LAST_TRADE = 0,
+    CENTER_MID = 1,
+    CENTER_MICROPRICE = 2
+};
+
+// Enum for what the order book imbalance gate does when the threshold is exceeded.
+// The order here MUST match the "Imbalance Gate Action" input strings.
+enum ImbalanceGateAction {
+    IMBALANCE_GATE_SKIP_ARMING = 0,
+    IMBALANCE_GATE_ARM_ONE_SIDE = 1
+};
+
+// What happens to the unfilled remainder of a partially filled entry leg. The opposite leg is
+// always cancelled on the first fill.
+enum PartialFillPolicy {
+    PARTIAL_FILL_CANCEL_REMAINDER = 0,
+    PARTIAL_FILL_KEEP_REMAINDER = 1
+};
+
+// Which legs of the bracket STATE 1 submits.
+enum BracketSides {
+    ARM_BOTH_SIDES = 0,
+    ARM_BUY_SIDE_ONLY = 1,
+    ARM_SELL_SIDE_ONLY = 2
+};
+
+// Where the bracket decisions are made.
+// The order here MUST match the "Strategy Host" input strings.
+enum StrategyHost {
+    HOST_THIS_STUDY = 0,
+    HOST_BUS_PROCESS = 1            // External process over the shared-memory bus; the study only executes.
+};
+
+// Maximum number of market depth levels read per side. Must be a multiple of 4 (SSE width),
+// since quantities are reduced over the full fixed-size arrays.
+#define MAX_DEPTH_LEVELS 16
+
+// Top-of-book snapshot. Only the configured number of levels is refreshed in place
+// on each call, so reading the book costs O(levels) and never allocates.
+// Quantity arrays are kept zero-padded past the populated levels so that totals can be
+// computed with a fixed-size, branch-free reduction.
+struct MarketDepthSnapshot {
+    float BidPrice[MAX_DEPTH_LEVELS];
+    alignas(16) float BidQuantity[MAX_DEPTH_LEVELS];
+    float AskPrice[MAX_DEPTH_LEVELS];
+    alignas(16) float AskQuantity[MAX_DEPTH_LEVELS];
+    int NumBidLevels;                       // Levels actually populated on the bid side.
+    int NumAskLevels;                       // Levels actually populated on the ask side.
+    float TotalBidQuantity;                 // Sum of BidQuantity[0..NumBidLevels).
+    float TotalAskQuantity;                 // Sum of AskQuantity[0..NumAskLevels).
+};
+
+// Result of the time gating check for the current update.
+enum SessionGate {
+    SESSION_OPEN = 0,           // Trading allowed.
+    SESSION_BEFORE_START = 1,   // Before the trading window: cancel any armed bracket, do not flatten.
+    SESSION_CLOSED = 2          // After the window, holiday, or blackout: cancel orders and flatten.
+};
+
+// Session calendar limits. The calendar is compiled for CALENDAR_HORIZON_DAYS days starting the
+// day before it is loaded, and recompiled every day.
+#define MAX_CALENDAR_INTERVALS 4096
+#define MAX_CALENDAR_RULES 256
+#define CALENDAR_HORIZON_DAYS 120
+#define CALENDAR_PATH_LENGTH 512
+
+// One tradable interval [Start, End), in seconds since the Sierra Chart base date
+// (Date * SECONDS_PER_DAY + TimeInSeconds), in the chart time zone.
+struct SessionInterval {
+    long long Start;
+    long long End;
+};
+
+// Session calendar compiled from a local file into a sorted, non-overlapping interval array.
+// The gate for the current time is cached along with the boundaries around it, so the per-tick
+// check is one comparison until a boundary is crossed.
+struct SessionCalendar {
+    SessionInterval Intervals[MAX_CALENDAR_INTERVALS];
+    int NumIntervals;
+    long long HorizonStart;         // Start of the compiled range.
+    long long HorizonEnd;           // End of the compiled range.
+    char LoadedPath[CALENDAR_PATH_LENGTH];
+    bool Loaded;                    // A load was attempted for LoadedPath.
+    bool LoadFailed;                // The last load failed; trading is blocked.
+    char LoadError[128];            // Why the load failed.
+
+    // Cached lookup result, valid while CachedFrom <= now < CachedUntil.
+    long long CachedFrom;
+    long long CachedUntil;
+    bool CachedInWindow;
+};
+
+// The calendar file is read and compiled by a loader thread, never by the study: on start, when the
+// chart date changes, and when its modification time or size changes (checked once per second). A compiled
+// calendar is published into the spare buffer and swapped in by the study with one atomic load.
+struct SessionCalendarLoader {
+    SessionCalendar Buffers[2];
+    int Active;                     // Buffer the study reads. Study thread only.
+    std::atomic<int> Published;     // Buffer compiled and not yet taken by the study, -1 if none.
+    std::atomic<int> LoadDate;      // Chart date the horizon is compiled from; set by the study.
+
+    // Loader thread. The path is fixed while it runs; a change restarts it.
+    std::thread Worker;
+    std::atomic<bool> StopRequested;
+    bool Running;
+    char Path[CALENDAR_PATH_LENGTH];
+};
+
+// Reason the daily risk kill switch was tripped.
+enum KillSwitchReason {
+    KILL_NONE = 0,
+    KILL_DAILY_LOSS = 1,
+    KILL_CONSECUTIVE_LOSSES = 2,
+    KILL_MAX_TRADES = 3
+};
+
+// How a round trip ended, for the fill quality log.
+enum RoundTripExit {
+    EXIT_STOP = 0,
+    EXIT_TARGET = 1,
+    EXIT_SAFETY_FLATTEN = 2,    // Lost protection or inconsistent state.
+    EXIT_SESSION_FLATTEN = 3,   // Trading window or session calendar close.
+    EXIT_KILL_SWITCH = 4,
+    EXIT_TIME_STOP = 5
+};
+
+// Running daily P&L and trade counters, updated incrementally from the entry and exit fills
+// already detected by the state machine (never by re-walking fills or trade statistics).
+// All values are reset when the trading day (sc.GetTradingDayDate of the last bar) changes.
+struct DailyRiskState {
+    int TradingDate;            // Trading day (sc.GetTradingDayDate) the counters belong to.
+    double RealizedPnL;         // Closed trade P&L for the day, in currency (points if CurrencyValuePerTick is 0).
+    int TradesToday;            // Completed round trips.
+    int ConsecutiveLosses;      // Losing round trips in a row.
+    KillSwitchReason KillReason; // KILL_NONE while trading is allowed.
+
+    // Open trade, set on the entry fill.
+    int OpenSide;               // TradeSide of the open trade, SIDE_FLAT if none.
+    float OpenEntryPrice;
+    float OpenQuantity;
+    // Price at which realized + open P&L reaches the daily loss limit, so the in-trade check is
+    // one comparison per tick. 0 if the loss limit is disabled.
+    float LossTriggerPrice;
+};
+
+// Order action rate limiting. Each bucket holds up to its per-period limit in tokens and refills
+// continuously; an action is sent only if both buckets have enough tokens.
+#define MAX_PENDING_ORDER_ACTIONS 16
+
+// Latency histogram: 8 linear sub-buckets per power of two of nanoseconds (about 12% resolution).
+#define LATENCY_HISTOGRAM_SUB_BUCKETS 8
+#define LATENCY_HISTOGRAM_BUCKETS 488
+
+// Prometheus metrics export.
+#define METRICS_PATH_LENGTH 512
+#define METRICS_LABELS_LENGTH 160
+#define METRICS_LATENCY_BUCKETS 13  // Finite histogram buckets; the +Inf bucket is the total count.
+
+// Histogram bucket upper bounds for the metrics latency histograms, in nanoseconds (1 us .. 10 ms).
+static const long long MetricsLatencyBucketBoundsNs[METRICS_LATENCY_BUCKETS] = {
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+// Bracket ladder.
+#define MAX_LADDER_LEVELS 8
+#define LADDER_MISMATCH_SECONDS 5   // Tracked vs actual position disagreement tolerated before flattening.
+
+// Attached orders of an open trade that are not listed yet are looked up again for this long before
+// the position is treated as unprotected.
+#define ATTACHED_ORDER_LOOKUP_SECONDS 5
+
+// Hot-reloadable parameter file.
+#define PARAMETER_FILE_PATH_LENGTH 512
+#define PARAMETER_FILE_CHECK_SECONDS 1.0   // The file's stamp is checked at most this often.
+
+// Stale-feed guard.
+#define FEED_LATENCY_HISTORY_DAYS 1.0  // A trade older than this is history (reload, replay start), not a latency sample.
+
+// Scale-out: attached OCO groups (stop + target) per entry leg.
+#define MAX_SCALE_OUT_TARGETS 4
+
+// Order lifecycle trace (Chrome trace-event JSON).
+#define ORDER_TRACE_CAPACITY 16384  // Events buffered for the writer thread. Power of two.
+#define MAX_TRACED_ORDERS 128       // Orders whose status is followed at the same time.
+#define ORDER_TRACE_PATH_LENGTH 512
+
+// Shared-memory bus to an external strategy process (scalping_bot_bus.h).
+#define BUS_PATH_LENGTH 512
+#define MAX_BUS_ORDERS 64           // Orders submitted for the bus whose status is followed at the same time.
+#define MAX_BUS_COMMANDS_PER_CALL 16
+#define BUS_PUBLISH_WINDOW 4096     // Publish times kept to match command trigger sequences. Power of two.
+#define BUS_REOPEN_SECONDS 5.0      // Delay before mapping the segment again after a failure.
+
+// State of one extra ladder bracket.
+enum LadderLevelState {
+    LADDER_IDLE = 0,
+    LADDER_ARMED = 1,
+    LADDER_IN_TRADE = 2
+};
+
+// State snapshot file.
+#define STATE_SNAPSHOT_MAGIC 0x53425353u   // "SSBS"
+#define STATE_SNAPSHOT_VERSION 5
+#define STATE_SNAPSHOT_SYMBOL_LENGTH 64
+#define STATE_SNAPSHOT_PATH_LENGTH 512
+
+// Phases of a study call timed by the profiler.
+// The order here MUST match the "Profiled Phase" input strings.
+enum ProfilePhase {
+    PHASE_TOTAL = 0,            // Whole call on the last bar.
+    PHASE_INPUT_READ = 1,       // Input, subgraph and persistent variable setup up to the last-bar check.
+    PHASE_LIMITER_AND_RISK = 2, // Rate limiter drain, enable/TickSize checks, daily risk kill switch.
+    PHASE_TIME_GATING = 3,
+    PHASE_R_FETCH = 4,
+    PHASE_OFFSETS = 5,          // Offsets, center price, market depth, execution quality counters.
+    PHASE_STATE_1 = 6,
+    PHASE_STATE_2 = 7,
+    PHASE_STATE_3 = 8,
+    PHASE_LOGGING = 9,          // Messages actually written to the log.
+    NUM_PROFILE_PHASES = 10
+};
+
+// Number of order messages each action costs against the rate limits.
+#define ORDER_COST_OCO_SUBMIT 2     // Two parent orders.
+#define ORDER_COST_SINGLE 1         // Single submit, modify, cancel, or flatten.
+
+struct TokenBucket {
+    double Tokens;
+    double Capacity;                // Max burst, equal to the per-period limit.
+    double RefillPerSecond;
+};
+
+// Results of RequoteBracketByModify.
+#define REQUOTE_NOT_POSSIBLE -1     // A leg is no longer working; submit a fresh bracket.
+#define REQUOTE_DEFERRED 0          // Legs working, but no tokens for the modifies yet.
+#define REQUOTE_DONE 1              // Legs moved to the new prices.
+
+// Types of deferred order actions. Submits are never queued: STATE 1 simply re-evaluates
+// on the next update with fresh prices, which coalesces any number of deferred submits.
+enum PendingOrderActionType {
+    PENDING_NONE = 0,
+    PENDING_CANCEL_ORDER = 1,       // Cancel OrderID.
+    PENDING_CANCEL_BRACKET = 2      // Cancel both legs of a bracket (BuyOrderID, SellOrderID).
+};
+
+struct PendingOrderAction {
+    PendingOrderActionType Type;
+    int BuyOrderID;                 // OrderID for PENDING_CANCEL_ORDER.
+    int SellOrderID;
+    float StopOffset;               // Attached offsets of the bracket, to decide if it can be requoted by modify.
+    float TargetOffsets[MAX_SCALE_OUT_TARGETS];
+    int NumTargets;
+    float Quantity;
+};
+
+// Order actions whose acknowledgement latency is measured.
+// The order here MUST match the "Acknowledgement Latency Action" input strings.
+enum AckAction {
+    ACK_SUBMIT = 0,                 // Entry leg sent until OPEN (or filled, cancelled, rejected).
+    ACK_CANCEL = 1,                 // Cancel sent until CANCELED (or filled, rejected).
+    ACK_FLATTEN = 2,                // Flatten sent until the position is flat.
+    NUM_ACK_ACTIONS = 3
+};
+
+#define MAX_PENDING_ACKS 16
+#define ACK_TIMEOUT_SECONDS 30      // An action still unacknowledged after this long is dropped, not sampled.
+
+// Send time of an order action awaiting its acknowledgement.
+struct PendingAck {
+    int OrderID;                    // 0 for a flatten.
+    AckAction Action;
+    long long SentNs;               // SteadyClockNanoseconds() just before the ACSIL call.
+};
+
+// Central order rate limiter. Every submit, modify, cancel and flatten goes through it.
+struct OrderRateLimiter {
+    TokenBucket PerSecond;
+    TokenBucket PerMinute;
+    double LastRefillTime;          // steady_clock seconds of the last refill.
+    PendingOrderAction Pending[MAX_PENDING_ORDER_ACTIONS];
+    int NumPending;
+
+    // Counters published as subgraphs.
+    int ActionsSent;                // Order messages sent.
+    int ActionsDeferred;            // Actions that had to wait for tokens.
+    int ActionsCoalesced;           // Deferred actions merged with or replaced by a later action.
+
+    // Actions sent and not yet seen acknowledged, polled by PollAcknowledgements.
+    PendingAck Acks[MAX_PENDING_ACKS];
+    int NumAcks;
+};
+
+// Persistent, pre-filled order structures for bracket submission. Built once per quantity change;
+// STATE 1 only patches prices and offsets before submitting.
+struct OrderTemplateState {
+    s_SCNewOrder OCOTemplate;       // OCO buy limit / sell limit with attached stops and targets.
+    s_SCNewOrder SingleTemplate;    // Single limit leg with attached stops and targets (imbalance gate).
+    s_SCNewOrder LadderTemplate;    // OCO with a single attached stop and target, for ladder levels.
+    s_SCNewOrder ScratchOrder;      // Rebuilt from scratch on each submission when templates are off.
+    int BuiltForQuantity;           // NumContracts the templates were built for, 0 if never built.
+    int BuiltForTargets;            // Scale-out targets the templates were built for.
+};
+
+// Tick-to-submit latency: time from the start of the study call to the order submission call.
+struct SubmitLatencyStats {
+    long long LastNs;
+    long long MaxNs;
+    double SumNs;
+    int Count;
+    bool UsedOrderTemplate;         // Mode the statistics were collected in.
+};
+
+// Fill quality of the open round trip plus running sums over all completed ones. MAE/MFE come from
+// a running low/high of the last price while in the trade, so no price history is re-read.
+struct RoundTripAnalytics {
+    // Open round trip, set on the entry fill.
+    bool Open;
+    int Side;                       // TradeSide value.
+    float Quantity;
+    float RequestedEntryPrice;      // Limit price of the filled leg.
+    float EntryFillPrice;
+    double ArmToFillSeconds;
+    SCDateTime EntryTime;
+    float HighSinceEntry;
+    float LowSinceEntry;
+
+    // Completed round trips.
+    int Count;
+    double EntrySlippageTicksSum;   // Positive = filled worse than requested.
+    double ExitSlippageTicksSum;
+    double ArmToFillSecondsSum;
+    double TimeInTradeSecondsSum;
+    double MAETicksSum;             // Maximum adverse excursion.
+    double MFETicksSum;             // Maximum favorable excursion.
+};
+
+// Log-linear latency histogram, fixed size, for percentiles without storing samples.
+struct LatencyHistogram {
+    unsigned int Counts[LATENCY_HISTOGRAM_BUCKETS];
+    long long TotalCount;
+};
+
+// Per-bar timing of one profiled phase.
+struct PhaseTimingStats {
+    long long MinNs;
+    long long MaxNs;
+    double SumNs;
+    LatencyHistogram Histogram;
+};
+
+// Per-phase profiler. Accumulators cover the current bar and are reset when a new bar starts.
+struct PhaseProfiler {
+    bool Enabled;                   // Mirrors the "Enable Phase Profiling" input, for LogSCSMessage.
+    int BarIndex;                   // Bar the accumulators belong to.
+    PhaseTimingStats Phases[NUM_PROFILE_PHASES];
+};
+
+// Submit-to-acknowledge latency per action type, since the study was loaded. Percentiles are
+// recomputed only when an action receives a new sample.
+struct AckLatencyStats {
+    LatencyHistogram Histograms[NUM_ACK_ACTIONS];
+    long long MaxNs[NUM_ACK_ACTIONS];
+    double SumNs[NUM_ACK_ACTIONS];
+    long long PercentilesNs[NUM_ACK_ACTIONS][3];   // p50, p99, p99.9.
+    int Timeouts[NUM_ACK_ACTIONS];  // Actions dropped unacknowledged (timed out, or order not found).
+};
+
+// Latency histogram in Prometheus form. Written by the study thread, read by the writer thread.
+struct MetricsLatencyHistogram {
+    std::atomic<long long> Buckets[METRICS_LATENCY_BUCKETS + 1]; // Per-bucket counts; last is above every bound.
+    std::atomic<long long> SumNs;
+    std::atomic<long long> Count;
+};
+
+// Counters and gauges exported to a Prometheus textfile. The study thread only does relaxed atomic
+// updates; a background thread formats and writes the file every few seconds.
+struct MetricsExporter {
+    std::atomic<long long> BracketsSubmitted;
+    std::atomic<long long> EntryFillsBuy;
+    std::atomic<long long> EntryFillsSell;
+    std::atomic<long long> StopExits;
+    std::atomic<long long> TargetExits;
+    std::atomic<long long> SafetyFlattens;
+    std::atomic<long long> Requotes;
+    std::atomic<double> RangeR;
+    std::atomic<double> DailyRealizedPnL;
+    std::atomic<int> PositionSide;          // TradeSide value.
+    MetricsLatencyHistogram TickLatency;    // Whole study call on the last bar.
+    MetricsLatencyHistogram TickToSubmit;   // Start of the call to the bracket submission.
+    std::atomic<double> AckLatencySeconds[NUM_ACK_ACTIONS][3]; // p50, p99, p99.9 from AckLatencyStats.
+    std::atomic<double> AckLatencySumSeconds[NUM_ACK_ACTIONS];
+    std::atomic<long long> AckLatencyCount[NUM_ACK_ACTIONS];
+
+    // Writer thread. Path, labels and interval are fixed while it runs; a change restarts it.
+    std::thread Writer;
+    std::atomic<bool> StopRequested;
+    bool Running;
+    char Path[METRICS_PATH_LENGTH];
+    char Labels[METRICS_LABELS_LENGTH];
+    int IntervalSeconds;
+};
+
+// Span and instant names of the order lifecycle trace. A span covers the time an order spent in one
+// status, from the poll that first saw it to the poll that saw the next one.
+enum OrderTraceName {
+    TRACE_SUBMITTED = 0,    // Handed to Sierra Chart, no status polled yet.
+    TRACE_SENT,
+    TRACE_PENDING_OPEN,
+    TRACE_OPEN,             // Acknowledged and working.
+    TRACE_PENDING,          // Any other non-terminal status (attached orders waiting for their parent).
+    TRACE_PENDING_CANCEL,
+    TRACE_PARTIAL_FILL,     // Instant: FilledQuantity increased while still working.
+    TRACE_FILLED,           // Terminal instants from here on.
+    TRACE_CANCELED,
+    TRACE_ERROR,
+    TRACE_NOT_FOUND,
+    TRACE_REQUOTED,         // Instant: price moved by a coalesced requote.
+    NUM_TRACE_NAMES
+};
+
+// What an order is to the bot. Written as the trace event category.
+enum OrderTraceRole {
+    TRACE_ROLE_BUY_ENTRY = 0,
+    TRACE_ROLE_SELL_ENTRY,
+    TRACE_ROLE_STOP,
+    TRACE_ROLE_TARGET,
+    TRACE_ROLE_LADDER_ENTRY,
+    TRACE_ROLE_LADDER_STOP,
+    TRACE_ROLE_LADDER_TARGET,
+    NUM_TRACE_ROLES
+};
+
+// One trace event as recorded by the study thread; formatted as JSON by the writer thread.
+struct OrderTraceEvent {
+    long long TimestampNs;          // SteadyClockNanoseconds().
+    int OrderID;                    // InternalOrderID, the async span id.
+    float FilledQuantity;           // For instants.
+    unsigned char Phase;            // 'b' begin, 'e' end, 'n' instant.
+    unsigned char Name;             // OrderTraceName.
+    unsigned char Role;             // OrderTraceRole.
+};
+
+// Order followed by the tracer and the span it currently has open.
+struct TracedOrder {
+    int OrderID;
+    unsigned char Role;
+    unsigned char OpenSpan;         // OrderTraceName.
+    float FilledQuantity;
+};
+
+// Order lifecycle tracer. The study thread polls the traced orders once per call and pushes events
+// into a single-producer, single-consumer ring; a background thread appends them to the trace file.
+// A full ring drops events rather than block the study.
+struct OrderTracer {
+    OrderTraceEvent Events[ORDER_TRACE_CAPACITY];
+    std::atomic<unsigned int> Head;     // Next slot written by the study thread.
+    std::atomic<unsigned int> Tail;     // Next slot read by the writer thread.
+    std::atomic<long long> Dropped;     // Events lost to a full ring or a full order table.
+    TracedOrder Orders[MAX_TRACED_ORDERS];
+    int NumOrders;
+
+    // Writer thread. Path is fixed while it runs; a change restarts it.
+    std::thread Writer;
+    std::atomic<bool> StopRequested;
+    bool Running;
+    char Path[ORDER_TRACE_PATH_LENGTH];
+    int ProcessID;                      // Chart number, the trace "pid".
+};
+
+// Prices and attached offsets of the bracket currently armed, recorded at submission.
+struct ArmedBracketInfo {
+    float BuyPrice;
+    float SellPrice;
+    float StopOffset;
+    float TargetOffsets[MAX_SCALE_OUT_TARGETS]; // One per scale-out target; unused entries are 0.
+    float Quantity;
+    // Attached order IDs per OCO group returned by the submission, so the trade's stops and targets
+    // are looked up by ID instead of by walking the order list. 0 if unknown (bracket inferred by the bootstrap).
+    int NumTargets;
+    int BuyStopIDs[MAX_SCALE_OUT_TARGETS];
+    int BuyTargetIDs[MAX_SCALE_OUT_TARGETS];
+    int SellStopIDs[MAX_SCALE_OUT_TARGETS];
+    int SellTargetIDs[MAX_SCALE_OUT_TARGETS];
+};
+
+// Fills of the open trade, updated incrementally from the FilledQuantity of the entry order and of
+// its attached stops and targets. Each scale-out group is an OCO pair of one stop and one target.
+struct TradeFillTracker {
+    int EntryOrderID;               // Filled parent being tracked; set on the first STATE 3 update of a trade.
+    bool EntryWorking;              // The parent can still fill more (partially filled, not yet final).
+    float EntryFilledQuantity;
+    int NumGroups;
+    int StopOrderIDs[MAX_SCALE_OUT_TARGETS];
+    int TargetOrderIDs[MAX_SCALE_OUT_TARGETS];
+    float StopFilledQuantity[MAX_SCALE_OUT_TARGETS];
+    float TargetFilledQuantity[MAX_SCALE_OUT_TARGETS];
+    double ExitNotional[MAX_SCALE_OUT_TARGETS];          // AvgFillPrice * FilledQuantity of the closed group.
+    double RequestedExitNotional[MAX_SCALE_OUT_TARGETS]; // Order price * FilledQuantity of the closed group.
+    bool GroupClosed[MAX_SCALE_OUT_TARGETS];             // Closed groups are no longer looked up.
+    int GroupsClosed;
+    bool BreakevenPending;          // A target filled; the remaining stops still have to reach breakeven.
+    SCDateTime LookupSince;         // First update with no attached orders found (NumGroups 0); unset otherwise.
+};
+
+// Counters used to judge whether a bracket center mode helps:
+// how often an armed bracket gets filled, and how often the fill is followed by an adverse move.
+struct ExecutionQualityCounters {
+    int BracketsArmed;          // Successful OCO submissions.
+    int EntryFills;             // OCO legs filled.
+    int MarkoutsMeasured;       // Fills whose markout horizon has elapsed.
+    int AdverseFills;           // Fills where the center price moved against the position by the horizon.
+    double MarkoutTicksSum;     // Sum of signed markouts in ticks (positive = favorable).
+    double ArmedSeconds;        // Total time a bracket has been resting in the book (queue time).
+    SCDateTime ArmedSince;      // sc.CurrentSystemDateTimeMS when the current bracket was armed, unset if not armed.
+    int ImbalanceSkips;         // Arming attempts skipped by the imbalance gate.
+    int ImbalanceOneSided;      // Brackets armed on one side only by the imbalance gate.
+
+    // Pending markout of the most recent fill.
+    int PendingMarkoutSide;     // TradeSide of the pending fill, SIDE_FLAT if none.
+    float PendingMarkoutFillPrice;
+    SCDateTime PendingMarkoutDueTime;    // sc.CurrentSystemDateTimeMS, like the other timing.
+};
+
+// One extra OCO bracket of the ladder. The attached stop and target IDs are captured at submission,
+// so every check is a GetOrderByOrderID lookup, never a walk of the order list.
+struct LadderLevel {
+    int State;                      // LadderLevelState value.
+    int BuyOrderID;
+    int SellOrderID;
+    int BuyStopID;
+    int BuyTargetID;
+    int SellStopID;
+    int SellTargetID;
+    int Side;                       // TradeSide while in a trade.
+    float EntryPrice;
+    float Quantity;
+};
+
+// Extra brackets armed alongside the main one, each wider by one step. Level i is armed at
+// Bracket Width Fraction + (i + 1) * Ladder Step Fraction of R.
+struct LadderState {
+    LadderLevel Levels[MAX_LADDER_LEVELS];
+    int StateVersion;               // Incremented on every level transition, for the state snapshot.
+    SCDateTime MismatchSince;       // Unset while the tracked and actual positions agree.
+};
+
+// Strategy parameters that can be overridden by the parameter file. A value not set in the file
+// keeps following its study input.
+struct StrategyParameterSet {
+    float BracketFraction;
+    float StopFraction;
+    float TakeProfitFraction;
+    int StartTime;                  // Seconds since midnight.
+    int StopTime;
+    bool HasBracketFraction;
+    bool HasStopFraction;
+    bool HasTakeProfitFraction;
+    bool HasWindow;                 // START_TIME and STOP_TIME are only applied together.
+};
+
+// Identity of a watched file's contents: its modification time at the file system's full resolution
+// and its size, so two saves within the same second are still told apart.
+struct FileStamp {
+    long long ModificationTime;     // Nanoseconds since the epoch (100 ns units since 1601 on Windows), -1 if missing.
+    long long Size;                 // Bytes, -1 if missing.
+};
+
+// Parameter file watched for changes. A new version is parsed and validated in full before it
+// replaces the applied set, so the study never runs with half of a change.
+struct ParameterFileState {
+    char Path[PARAMETER_FILE_PATH_LENGTH];
+    FileStamp Stamp;                // Of the last file read.
+    double NextCheckTime;           // SteadyClockSeconds() at which the file stamp is checked again.
+    StrategyParameterSet Applied;
+    int Version;                    // Incremented on every applied change.
+};
+
+// Data feed latency: local receive time minus the exchange time of the latest trade, smoothed per
+// trade. While the estimate is above the threshold the feed is stale and no bracket rests in the book.
+struct FeedLatencyState {
+    SCDateTime LastTradeTime;       // sc.LatestDateTimeForLastBar last sampled.
+    int LastTradeBar;
+    bool HasEstimate;
+    double EstimateMs;              // Exponential moving average over trades.
+    double LastSampleMs;
+    bool Stale;
+    SCDateTime HealthySince;        // While stale: since when the estimate has been below the threshold.
+    int StaleEpisodes;
+};
+
+// Order submitted for the bus and the status last published for it.
+struct BusWatchedOrder {
+    int OrderID;
+    int Status;                     // BusOrderStatus, -1 before the first event.
+    double FilledQuantity;
+};
+
+// Study side of the shared-memory bus: the mapping, the market state last published (only changes
+// are published), the orders followed for status events, and the event-to-command round trip.
+struct BusBridgeState {
+    BusMapping Mapping;
+    char Path[BUS_PATH_LENGTH];
+    double NextOpenTime;            // steady_clock seconds before which a failed mapping is not retried.
+    uint64_t NextSequence;
+    long long PublishedNs[BUS_PUBLISH_WINDOW]; // Steady clock publish time, indexed by sequence.
+    BusTick LastTick;
+    BusDepth LastDepth;
+    BusPosition LastPosition;
+    BusWatchedOrder Orders[MAX_BUS_ORDERS];
+    int NumOrders;
+    LatencyHistogram RoundTrip;     // Event published until the command triggered by it is read.
+    long long RoundTripMaxNs;
+    long long RoundTripP50Ns;
+    long long RoundTripP99Ns;
+    int CommandsExecuted;
+    int CommandsRejected;
+};
+
+// Built-in 'R' estimator: exponential moving average of the closed bars' high-low range.
+struct RangeEstimatorState {
+    double Value;
+    int LastBar;                    // Last closed bar folded into Value, -1 if none.
+    int Length;                     // EMA length the value was computed with.
+};
+
+// On-disk copy of the state machine and daily risk state, written with write-then-rename whenever
+// the state changes, so a restart can resume instead of re-inferring the state from the order list.
+struct BotStateSnapshot {
+    unsigned int Magic;
+    unsigned int Version;
+    char Symbol[STATE_SNAPSHOT_SYMBOL_LENGTH];
+    int ChartNumber;
+    int ParentBuyLimitOrderID;
+    int ParentSellLimitOrderID;
+    int TradeSide;
+    int BracketStatus;
+    int ActiveFilledParentOrderID;
+    ArmedBracketInfo ArmedBracket;
+    DailyRiskState Risk;
+    LadderLevel Ladder[MAX_LADDER_LEVELS];
+    unsigned int Checksum;          // FNV-1a of every byte before this field.
+};
 
+// Values the last written snapshot was taken from, to detect a state change with a few compares.
+struct StateSnapshotTracker {
+    char Path[STATE_SNAPSHOT_PATH_LENGTH]; // Resolved by the bootstrap; see ResolveStateSnapshotPath.
+    bool Written;
+    int ParentBuyLimitOrderID;
+    int ParentSellLimitOrderID;
+    int TradeSide;
+    int BracketStatus;
+    int ActiveFilledParentOrderID;
+    int TradingDate;
+    int TradesToday;
+    int KillReason;
+    int LadderVersion;
+    bool WriteFailed;               // Logged once until a write succeeds again.
+};
+
+// State that does not fit in persistent ints. Allocated once per study instance,
+// retained across calls (and across full recalculations) and freed on the last call.
+struct BotRuntimeState {
+    MarketDepthSnapshot Depth;
+    ExecutionQualityCounters Quality;
+    SessionCalendarLoader Calendar;
+    DailyRiskState Risk;
+    OrderRateLimiter RateLimiter;
+    ArmedBracketInfo ArmedBracket;
+    OrderTemplateState OrderTemplates;
+    SubmitLatencyStats SubmitLatency;
+    PhaseProfiler Profiler;
+    MetricsExporter Metrics;
+    RoundTripAnalytics RoundTrips;
+    StateSnapshotTracker Snapshot;
+    RangeEstimatorState RangeEstimator;
+    LadderState Ladder;
+    TradeFillTracker Fills;
+    ParameterFileState Parameters;
+    OrderTracer Trace;
+    AckLatencyStats AckLatency;
+    FeedLatencyState Feed;
+    BusBridgeState Bus;
+    SCDateTime TradeEntryTime;      // Entry fill of the open trade, for time-stop exit policies (sc.CurrentSystemDateTimeMS).
+};
+
+
+// Fixed-size log message. Formatting into it never allocates, so messages can be built on the
+// per-tick path; longer messages are truncated.
+#define LOG_MESSAGE_LENGTH 512
+struct LogBuffer {
+    char Text[LOG_MESSAGE_LENGTH];
+
+    LogBuffer() { Text[0] = '\0'; }
+    void Format(const char* format, ...) {
+        va_list arguments;
+        va_start(arguments, format);
+        vsnprintf(Text, sizeof(Text), format, arguments);
+        va_end(arguments);
+    }
+    const char* GetChars() const { return Text; }
+    operator const char*() const { return Text; }
+};
 
 // Forward declaration of helper function for logging.
 void LogSCSMessage(SCStudyInterfaceRef& sc, int currentLogLevelSetting, LoggingLevel messageLevel, const SCString& message, bool showInTradeServiceLog = false);
 void LogSCSMessage(SCStudyInterfaceRef& sc, int currentLogLevelSetting, LoggingLevel messageLevel, const char* message, bool showInTradeServiceLog = false);
 
+// Forward declarations of market depth helpers.
+bool ReadMarketDepth(SCStudyInterfaceRef& sc, int levels, MarketDepthSnapshot& depth);
+float ComputeBracketCenterPrice(BracketCenterMode mode, const MarketDepthSnapshot& depth, float lastTradePrice, bool& usedDepth);
+void ReduceDepthQuantities(MarketDepthSnapshot& depth);
+float ComputeDepthImbalance(const MarketDepthSnapshot& depth);
 
-SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
+// Forward declarations of daily risk helpers.
+void OpenRiskTrade(DailyRiskState& risk, TradeSide side, float entryPrice, float quantity, float dailyLossLimit, float currencyPerPoint);
+double CloseRiskTrade(DailyRiskState& risk, float exitPrice, float currencyPerPoint);
+KillSwitchReason EvaluateRiskLimits(const DailyRiskState& risk, float dailyLossLimit, int maxConsecutiveLosses, int maxTradesPerDay);
+const char* KillSwitchReasonText(KillSwitchReason reason);
+
+// Forward declarations of fill quality helpers.
+void OpenRoundTrip(RoundTripAnalytics& trips, TradeSide side, float requestedPrice, float fillPrice, float quantity, double armToFillSeconds, const SCDateTime& entryTime);
+void CompleteRoundTrip(SCStudyInterfaceRef& sc, RoundTripAnalytics& trips, const char* logPath, RoundTripExit exitReason,
+    float requestedExitPrice, float exitPrice, double pnl);
+
+// Forward declarations of order template helpers.
+void BuildBracketOrderTemplates(OrderTemplateState& templates, int quantity, int stopOrderType, int numTargets);
+void ApplyScaleOutGroups(s_SCNewOrder& order, int quantity, int stopOrderType, int numTargets);
+void PatchBracketOrder(s_SCNewOrder& order, float price1, float price2, float stopOffset, const float* targetOffsets, int numTargets);
+void StoreAttachedOrderIDs(const s_SCNewOrder& order, ArmedBracketInfo& bracket, int numTargets, BracketSides sides);
+
+// Forward declarations of order rate limiter helpers.
+double SteadyClockSeconds();
+long long SteadyClockNanoseconds();
+void ConfigureOrderRateLimiter(OrderRateLimiter& limiter, int maxPerSecond, int maxPerMinute);
+bool AcquireOrderTokens(OrderRateLimiter& limiter, int cost);
+void ForceOrderTokens(OrderRateLimiter& limiter, int cost);
+void LimitedCancelOrder(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, int orderID);
+void LimitedCancelBracket(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, int buyOrderID, int sellOrderID, const ArmedBracketInfo& bracket);
+void LimitedFlatten(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, bool cancelOwnOrders);
+int FindPendingBracketCancel(const OrderRateLimiter& limiter);
+int RequoteBracketByModify(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, int pendingIndex, float buyPrice, float sellPrice);
+int DrainPendingOrderActions(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter);
+void ExpectAcknowledgement(OrderRateLimiter& limiter, AckAction action, int orderID, long long sentNs);
+unsigned int PollAcknowledgements(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, AckLatencyStats& stats);
+
+// Forward declarations of profiling helpers.
+void RecordLatencySample(LatencyHistogram& histogram, long long nanoseconds);
+long long LatencyHistogramPercentile(const LatencyHistogram& histogram, double percentile);
+void RecordProfilePhase(PhaseProfiler& profiler, ProfilePhase phase, long long nanoseconds);
+void ResetPhaseProfiler(PhaseProfiler& profiler, int barIndex);
+void PublishProfilePhase(const PhaseProfiler& profiler, ProfilePhase phase, int barIndex,
+    SCSubgraphRef minSubgraph, SCSubgraphRef meanSubgraph, SCSubgraphRef maxSubgraph, SCSubgraphRef p99Subgraph);
+
+// Forward declarations of metrics export helpers.
+void ObserveMetricsLatency(MetricsLatencyHistogram& histogram, long long nanoseconds);
+void StartMetricsExporter(MetricsExporter& metrics, const char* path, const char* labels, int intervalSeconds);
+void StopMetricsExporter(MetricsExporter& metrics);
+
+// Forward declarations of order lifecycle trace helpers.
+void StartOrderTracer(OrderTracer& tracer, const char* path, int processID);
+void StopOrderTracer(OrderTracer& tracer);
+void TraceOrderSubmitted(OrderTracer* tracer, int orderID, OrderTraceRole role);
+void TraceBracketSubmitted(OrderTracer* tracer, int buyOrderID, int sellOrderID, const ArmedBracketInfo& bracket);
+void TraceOrderRequoted(OrderTracer* tracer, int orderID);
+void PollTracedOrders(SCStudyInterfaceRef& sc, OrderTracer& tracer);
+
+// Forward declarations of partial fill tracking helpers.
+int GetOrderStatusByID(SCStudyInterfaceRef& sc, int orderID, s_SCTradeOrder& order);
+bool IsWorkingOrderStatus(int status);
+void BeginFillTracking(SCStudyInterfaceRef& sc, TradeFillTracker& fills, int parentOrderID, TradeSide side, const ArmedBracketInfo& bracket, float filledQuantity);
+void FindAttachedOrders(SCStudyInterfaceRef& sc, TradeFillTracker& fills);
+bool LimitedResizeOrder(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, const s_SCTradeOrder& order, float openQuantity);
+bool LimitedMoveStopOrder(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, const s_SCTradeOrder& order, float price);
+
+// Forward declarations of bracket ladder helpers.
+bool ManageLadder(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, int numLevels, bool allowArming, float centerPrice,
+    float rValue, float bracketFraction, float stepFraction, float stopOffset, float targetOffset, int quantity, int stopOrderType,
+    float currencyPerPoint, int logLevel);
+void CancelLadderBrackets(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, LadderState& ladder);
+void CloseLadderTrades(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, LadderState& ladder, DailyRiskState& risk,
+    float exitPrice, float currencyPerPoint, bool cancelAttachedOrders);
+float LadderNetPosition(const LadderState& ladder);
+bool IsLadderParentOrder(const LadderState& ladder, int orderID);
+
+// Forward declarations of parameter file helpers.
+bool ReadFileStamp(const char* path, FileStamp& stamp);
+bool SameFileStamp(const FileStamp& a, const FileStamp& b);
+bool LoadParameterFile(const char* path, StrategyParameterSet& parameters, SCString& errorMessage);
+bool SameParameterSet(const StrategyParameterSet& a, const StrategyParameterSet& b);
+
+// Forward declarations of stale feed helpers.
+bool UpdateFeedLatency(FeedLatencyState& feed, const SCDateTime& tradeTime, int tradeBar, const SCDateTime& now,
+    int smoothingTrades, float thresholdMs, int recoverySeconds);
+
+// Forward declarations of shared-memory bus helpers.
+bool OpenBusBridge(BusBridgeState& bus, const char* path);
+void CloseBusBridge(BusBridgeState& bus);
+void RunBusBridge(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, float rValue, int depthLevels, int stopOrderType,
+    int bracketBlockReason, int logLevel);
+void CancelBusEntryOrders(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState);
+
+// Forward declarations of the built-in 'R' estimator.
+double UpdateRangeEstimator(SCStudyInterfaceRef& sc, RangeEstimatorState& estimator, int lengthBars, int barIndex);
+
+// Forward declarations of state snapshot helpers.
+bool ReplaceFileAtomically(const char* tempPath, const char* path);
+void ResolveStateSnapshotPath(SCStudyInterfaceRef& sc, const char* configuredPath, char* path, size_t pathSize);
+void SaveStateSnapshotIfChanged(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, int logLevel);
+bool LoadStateSnapshot(const char* path, BotStateSnapshot& snapshot);
+bool RestoreStateSnapshot(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, const BotStateSnapshot& snapshot, float dailyLossLimit, LogBuffer& result);
+
+// Forward declarations of session calendar helpers.
+bool LoadSessionCalendar(const char* path, int loadDate, SessionCalendar& calendar, SCString& errorMessage);
+void LookupSessionCalendar(SessionCalendar& calendar, long long now);
+void StartSessionCalendarLoader(SessionCalendarLoader& loader, const char* path, int loadDate);
+void StopSessionCalendarLoader(SessionCalendarLoader& loader);
+
+// Extends the running high/low of the open round trip with the latest price. Two compares per update.
+inline void UpdateRoundTripExcursion(RoundTripAnalytics& trips, float lastPrice) {
+    if (lastPrice > trips.HighSinceEntry) trips.HighSinceEntry = lastPrice;
+    if (lastPrice < trips.LowSinceEntry) trips.LowSinceEntry = lastPrice;
+}
+
+// Closes the current queue-time interval of an armed bracket, if one is open.
+inline void EndArmedInterval(ExecutionQualityCounters& quality, const SCDateTime& now) {
+    if (quality.ArmedSince.IsUnset())
+        return;
+    quality.ArmedSeconds += (now - quality.ArmedSince).GetAsDouble() * SECONDS_PER_DAY;
+    quality.ArmedSince = SCDateTime();
+}
+
+// Relaxed increment of a metrics counter. Ordering against other counters does not matter.
+inline void IncrementMetric(std::atomic<long long>& counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Observes the duration of the study call into the metrics tick latency histogram when it goes out
+// of scope. With a NULL exporter (export disabled) it reads no clock.
+struct ScopedTickLatency {
+    MetricsExporter* Metrics;
+    long long StartNs;
+
+    ScopedTickLatency(MetricsExporter* metrics, long long startNs) : Metrics(metrics), StartNs(startNs) {}
+    ~ScopedTickLatency() {
+        if (Metrics != NULL)
+            ObserveMetricsLatency(Metrics->TickLatency, SteadyClockNanoseconds() - StartNs);
+    }
+};
+
+// Polls the status of the traced orders when the call ends, so transitions caused by this call's
+// submissions and cancels are seen on every return path. With a NULL tracer it does nothing.
+struct ScopedOrderTrace {
+    SCStudyInterfaceRef& StudyInterface;
+    OrderTracer* Tracer;
+
+    ScopedOrderTrace(SCStudyInterfaceRef& sc, OrderTracer* tracer) : StudyInterface(sc), Tracer(tracer) {}
+    ~ScopedOrderTrace() {
+        if (Tracer != NULL)
+            PollTracedOrders(StudyInterface, *Tracer);
+    }
+};
+
+// Saves the state snapshot when the call ends, on whichever path it returns. With a NULL runtime
+// state (snapshots disabled) it does nothing.
+struct ScopedStateSnapshot {
+    SCStudyInterfaceRef& StudyInterface;
+    BotRuntimeState* RuntimeState;
+    int LogLevel;
+
+    ScopedStateSnapshot(SCStudyInterfaceRef& sc, BotRuntimeState* runtimeState, int logLevel)
+        : StudyInterface(sc), RuntimeState(runtimeState), LogLevel(logLevel) {}
+    ~ScopedStateSnapshot() {
+        if (RuntimeState != NULL)
+            SaveStateSnapshotIfChanged(StudyInterface, *RuntimeState, LogLevel);
+    }
+};
+
+// Times one phase from construction to Stop() or the end of the scope, whichever comes first.
+// With a NULL profiler (profiling disabled) it reads no clock and records nothing.
+struct ScopedPhaseTimer {
+    PhaseProfiler* Profiler;
+    ProfilePhase Phase;
+    long long StartNs;
+
+    ScopedPhaseTimer(PhaseProfiler* profiler, ProfilePhase phase)
+        : Profiler(profiler), Phase(phase), StartNs(profiler != NULL ? SteadyClockNanoseconds() : 0) {}
+    ScopedPhaseTimer(PhaseProfiler* profiler, ProfilePhase phase, long long startNs)
+        : Profiler(profiler), Phase(phase), StartNs(startNs) {}
+    ~ScopedPhaseTimer() { Stop(); }
+
+    void Stop() {
+        if (Profiler == NULL)
+            return;
+        RecordProfilePhase(*Profiler, Phase, SteadyClockNanoseconds() - StartNs);
+        Profiler = NULL;
+    }
+};
+
+//── Compile-Time Strategy Policies ───────────────────────────────────────
+// Each exported study below instantiates ScalpingBotStudy with one policy per axis. A fixed policy
+// returns a constant, so the compiler removes the branches of the other choices from that study.
+// The "FromInput" policies keep the choice on the study inputs (the original scsf_Scalping_Bot).
+// Inputs that belong to a fixed choice are simply ignored by that study.
+
+// 'R' source: the user-selected study subgraph.
+struct SubgraphRangeR {
+    static const char* Name() { return "Subgraph R"; }
+    static float Fetch(SCStudyInterfaceRef& sc, RangeEstimatorState&, SCInputRef volSubgraph, int, int barIndex) {
+        SCFloatArray volatilityArray;
+        // sc.GetStudyArrayUsingID gets the data. Parameters: (StudyID, SubgraphIndex, OutputArray)
+        sc.GetStudyArrayUsingID(volSubgraph.GetStudyID(), volSubgraph.GetSubgraphIndex(), volatilityArray);
+        if (volatilityArray.GetArraySize() == 0 || barIndex >= volatilityArray.GetArraySize())
+            return 0.0f;
+        return volatilityArray[barIndex];
+    }
+};
+
+// 'R' source: built-in EMA of the closed bars' high-low range, updated only for bars not yet folded in.
+struct BuiltInRangeR {
+    static const char* Name() { return "Built-in R"; }
+    static float Fetch(SCStudyInterfaceRef& sc, RangeEstimatorState& estimator, SCInputRef, int lengthBars, int barIndex) {
+        return static_cast<float>(UpdateRangeEstimator(sc, estimator, lengthBars, barIndex));
+    }
+};
+
+// Entry centering policies.
+template <BracketCenterMode Mode>
+struct FixedCenter {
+    static BracketCenterMode Center(SCInputRef) { return Mode; }
+};
+struct CenterFromInput {
+    static BracketCenterMode Center(SCInputRef centerModeInput) { return static_cast<BracketCenterMode>(centerModeInput.GetIndex()); }
+};
+
+// Exit policies: attached stop type, and whether an open trade is flattened after a fixed time.
+struct StaticExit {
+    static int StopOrderType() { return SCT_ORDERTYPE_STOP; }
+    static bool UsesTimeStop() { return false; }
+};
+struct TrailingStopExit {
+    static int StopOrderType() { return SCT_ORDERTYPE_TRAILING_STOP; } // Trails by the stop offset.
+    static bool UsesTimeStop() { return false; }
+};
+struct TimeStopExit {
+    static int StopOrderType() { return SCT_ORDERTYPE_STOP; }
+    static bool UsesTimeStop() { return true; }
+};
+
+// Time gating policies: session calendar file, single Start/Stop window, or chosen by the inputs.
+struct WindowGating {
+    static bool UseCalendar(SCInputRef) { return false; }
+    static bool UseWindow(SCInputRef) { return true; }
+};
+struct CalendarGating {
+    static bool UseCalendar(SCInputRef) { return true; }
+    static bool UseWindow(SCInputRef) { return false; }
+};
+struct GatingFromInput {
+    static bool UseCalendar(SCInputRef useCalendarInput) { return useCalendarInput.GetYesNo() != 0; }
+    static bool UseWindow(SCInputRef useWindowInput) { return useWindowInput.GetYesNo() != 0; }
+};
+
+
+template <class RangePolicy, class EntryPolicy, class ExitPolicy, class GatingPolicy>
+void ScalpingBotStudy(SCStudyInterfaceRef sc, const char* graphName)
 {
+    // Start of this call, for the tick-to-submit latency and the phase profiler.
+    long long callStartTime = SteadyClockNanoseconds();
+
     //── Study Inputs ──────────────────────────────────────────────────────
     SCInputRef NumContracts = sc.Input[0];      // How many contracts/shares to trade.
     SCInputRef VolSubgraph = sc.Input[1];       // Source for the dynamic range 'R' value.
@@ -108,6 +1150,84 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
     SCInputRef StopTimeInput = sc.Input[7];     // Bot's operational stop time (also triggers flattening).
     SCInputRef EnableInput = sc.Input[8];       // Master switch to enable/disable trading.
     SCInputRef LogLevelInput = sc.Input[9];     // Controls logging verbosity.
+    SCInputRef CenterModeInput = sc.Input[10];  // Price the OCO bracket is centered on (last trade, mid, microprice).
+    SCInputRef DepthLevelsInput = sc.Input[11]; // Number of market depth levels used for the microprice and imbalance.
+    SCInputRef MarkoutSecondsInput = sc.Input[12]; // Horizon after an entry fill at which adverse selection is measured.
+    SCInputRef UseImbalanceGateInput = sc.Input[13]; // Gate bracket arming on top-of-book imbalance.
+    SCInputRef ImbalanceThresholdInput = sc.Input[14]; // |imbalance| above which the gate acts.
+    SCInputRef ImbalanceActionInput = sc.Input[15];    // Skip arming, or arm only the with-flow side.
+    SCInputRef UseSessionCalendarInput = sc.Input[16]; // Gate on a session calendar file instead of Start/Stop Time.
+    SCInputRef SessionCalendarFileInput = sc.Input[17]; // Path of the session calendar file.
+    SCInputRef DailyLossLimitInput = sc.Input[18];     // Daily loss (currency) that trips the kill switch. 0 = off.
+    SCInputRef MaxConsecutiveLossesInput = sc.Input[19]; // Losing trades in a row that trip the kill switch. 0 = off.
+    SCInputRef MaxTradesPerDayInput = sc.Input[20];    // Completed trades per day that trip the kill switch. 0 = off.
+    SCInputRef MaxActionsPerSecondInput = sc.Input[21]; // Order messages (submit/modify/cancel/flatten) per second. 0 = off.
+    SCInputRef MaxActionsPerMinuteInput = sc.Input[22]; // Order messages per minute. 0 = off.
+    SCInputRef UseOrderTemplateInput = sc.Input[23];   // Submit from a pre-filled persistent s_SCNewOrder.
+    SCInputRef EnableProfilingInput = sc.Input[24];    // Time each phase of the study call.
+    SCInputRef ProfiledPhaseInput = sc.Input[25];      // Phase published to the profiling subgraphs.
+    SCInputRef ExportMetricsInput = sc.Input[26];      // Write a Prometheus textfile from a background thread.
+    SCInputRef MetricsFileInput = sc.Input[27];        // Path of the Prometheus textfile.
+    SCInputRef MetricsIntervalInput = sc.Input[28];    // Seconds between metrics file writes.
+    SCInputRef LogRoundTripsInput = sc.Input[29];      // Append each completed round trip to a file.
+    SCInputRef RoundTripLogFileInput = sc.Input[30];   // Path of the round trip log (CSV).
+    SCInputRef PersistStateInput = sc.Input[31];       // Write a state snapshot on every transition and resume from it.
+    SCInputRef StateSnapshotFileInput = sc.Input[32];  // Path of the state snapshot. Empty: one file per symbol and chart.
+    SCInputRef BuiltInRLengthInput = sc.Input[33];     // EMA length of the built-in 'R' estimator (built-in R studies).
+    SCInputRef TimeStopSecondsInput = sc.Input[34];    // Seconds in trade before a time-stop flatten (time-stop studies).
+    SCInputRef LadderLevelsInput = sc.Input[35];       // Extra OCO brackets armed beyond the main one. 0 = off.
+    SCInputRef LadderStepInput = sc.Input[36];         // Fraction of R added to the bracket width per ladder level.
+    SCInputRef PartialFillPolicyInput = sc.Input[37];  // Cancel or keep the unfilled remainder of a partially filled entry.
+    SCInputRef ScaleOutTargetsInput = sc.Input[38];    // Attached targets per entry leg (1-4); the quantity is split between them.
+    SCInputRef Target2FracInput = sc.Input[39];        // Fraction of R: distance of target 2 from the entry price.
+    SCInputRef Target3FracInput = sc.Input[40];        // Fraction of R: distance of target 3 from the entry price.
+    SCInputRef Target4FracInput = sc.Input[41];        // Fraction of R: distance of target 4 from the entry price.
+    SCInputRef BreakevenAfterTargetInput = sc.Input[42]; // Move the remaining stops to the entry price after the first target fill.
+    SCInputRef UseParameterFileInput = sc.Input[43];   // Override the strategy parameters from a watched file.
+    SCInputRef ParameterFileInput = sc.Input[44];      // Path of the parameter file.
+    SCInputRef TraceOrdersInput = sc.Input[45];        // Write order lifecycle spans as Chrome trace-event JSON.
+    SCInputRef OrderTraceFileInput = sc.Input[46];     // Path of the trace file. Appended to.
+    SCInputRef AckLatencyActionInput = sc.Input[47];   // Action whose acknowledgement latency percentiles are published.
+    SCInputRef StaleFeedThresholdInput = sc.Input[48]; // Smoothed feed latency (ms) above which the bracket is pulled. 0 = off.
+    SCInputRef FeedLatencySmoothingInput = sc.Input[49]; // Trades in the feed latency moving average.
+    SCInputRef StaleFeedRecoveryInput = sc.Input[50];  // Seconds below the threshold before re-arming.
+    SCInputRef StrategyHostInput = sc.Input[51];       // This study, or an external process over the shared-memory bus.
+    SCInputRef BusFileInput = sc.Input[52];            // Path of the shared-memory bus segment file.
+
+    //── Study Subgraphs (execution quality counters) ─────────────────────
+    SCSubgraphRef CenterPriceSubgraph = sc.Subgraph[0];   // Price the bracket is centered on.
+    SCSubgraphRef FillRateSubgraph = sc.Subgraph[1];      // Entry fills / brackets armed, in percent.
+    SCSubgraphRef AdverseRateSubgraph = sc.Subgraph[2];   // Adverse fills / measured markouts, in percent.
+    SCSubgraphRef AvgMarkoutSubgraph = sc.Subgraph[3];    // Average signed markout in ticks.
+    SCSubgraphRef ImbalanceSubgraph = sc.Subgraph[4];     // Top-of-book imbalance, -1 (ask heavy) .. +1 (bid heavy).
+    SCSubgraphRef AdversePerHourSubgraph = sc.Subgraph[5]; // Adverse fills per hour of bracket queue time.
+    SCSubgraphRef DailyPnLSubgraph = sc.Subgraph[6];      // Realized P&L for the day.
+    SCSubgraphRef TradesTodaySubgraph = sc.Subgraph[7];   // Completed round trips for the day.
+    SCSubgraphRef ActionsSentSubgraph = sc.Subgraph[8];   // Order messages sent through the rate limiter.
+    SCSubgraphRef ActionsDeferredSubgraph = sc.Subgraph[9]; // Order actions deferred for lack of tokens.
+    SCSubgraphRef ActionsCoalescedSubgraph = sc.Subgraph[10]; // Deferred actions merged into later ones.
+    SCSubgraphRef PendingActionsSubgraph = sc.Subgraph[11]; // Order actions currently queued.
+    SCSubgraphRef SubmitLatencySubgraph = sc.Subgraph[12]; // Tick-to-submit latency of the last submission, microseconds.
+    SCSubgraphRef SubmitLatencyMeanSubgraph = sc.Subgraph[13]; // Mean tick-to-submit latency, microseconds.
+    SCSubgraphRef PhaseMinSubgraph = sc.Subgraph[14];     // Profiled phase, minimum per bar, microseconds.
+    SCSubgraphRef PhaseMeanSubgraph = sc.Subgraph[15];    // Profiled phase, mean per bar, microseconds.
+    SCSubgraphRef PhaseMaxSubgraph = sc.Subgraph[16];     // Profiled phase, maximum per bar, microseconds.
+    SCSubgraphRef PhaseP99Subgraph = sc.Subgraph[17];     // Profiled phase, 99th percentile per bar, microseconds.
+    SCSubgraphRef AvgEntrySlippageSubgraph = sc.Subgraph[18]; // Average entry slippage per round trip, ticks.
+    SCSubgraphRef AvgExitSlippageSubgraph = sc.Subgraph[19];  // Average exit slippage per round trip, ticks.
+    SCSubgraphRef AvgArmToFillSubgraph = sc.Subgraph[20];     // Average bracket arm to entry fill, seconds.
+    SCSubgraphRef AvgTimeInTradeSubgraph = sc.Subgraph[21];   // Average entry fill to exit, seconds.
+    SCSubgraphRef AvgMAESubgraph = sc.Subgraph[22];           // Average maximum adverse excursion, ticks.
+    SCSubgraphRef AvgMFESubgraph = sc.Subgraph[23];           // Average maximum favorable excursion, ticks.
+    SCSubgraphRef LadderPositionSubgraph = sc.Subgraph[24];   // Net position held by the ladder levels.
+    SCSubgraphRef ParameterVersionSubgraph = sc.Subgraph[25]; // Version of the applied parameter file, 0 if none.
+    SCSubgraphRef AckLatencyP50Subgraph = sc.Subgraph[26];    // Selected action, acknowledgement latency p50, microseconds.
+    SCSubgraphRef AckLatencyP99Subgraph = sc.Subgraph[27];    // Selected action, acknowledgement latency p99, microseconds.
+    SCSubgraphRef AckLatencyP999Subgraph = sc.Subgraph[28];   // Selected action, acknowledgement latency p99.9, microseconds.
+    SCSubgraphRef FeedLatencySubgraph = sc.Subgraph[29];      // Smoothed feed latency, milliseconds.
+    SCSubgraphRef FeedStaleSubgraph = sc.Subgraph[30];        // 1 while the feed is considered stale.
+    SCSubgraphRef BusRoundTripP50Subgraph = sc.Subgraph[31];  // Bus event to command round trip p50, microseconds.
+    SCSubgraphRef BusRoundTripP99Subgraph = sc.Subgraph[32];  // Bus event to command round trip p99, microseconds.
 
     //── Persistent State Variables ───────────────────────────────────────
     // These variables retain their values across calls to this study function.
@@ -125,15 +1245,32 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
     // IDs of the active filled Parent order
     int& ActiveFilledParentOrderID_Persist = sc.GetPersistentInt(PID_ACTIVE_FILLED_PARENT_ORDER_ID);
 
+    // Heap-allocated runtime state (market depth snapshot, execution quality counters).
+    void*& RuntimeStatePointer = sc.GetPersistentPointer(PID_RUNTIME_STATE_POINTER);
+
+    // Free the runtime state when the study is removed or the chart is closed.
+    if (sc.LastCallToFunction)
+    {
+        if (RuntimeStatePointer != NULL) {
+            StopMetricsExporter(static_cast<BotRuntimeState*>(RuntimeStatePointer)->Metrics); // Joins the writer thread.
+            StopSessionCalendarLoader(static_cast<BotRuntimeState*>(RuntimeStatePointer)->Calendar);
+            StopOrderTracer(static_cast<BotRuntimeState*>(RuntimeStatePointer)->Trace);
+            CloseBusBridge(static_cast<BotRuntimeState*>(RuntimeStatePointer)->Bus);
+            delete static_cast<BotRuntimeState*>(RuntimeStatePointer);
+            RuntimeStatePointer = NULL;
+        }
+        return;
+    }
+
     //── Default Settings Block (sc.SetDefaults) ───────────────────────────
     // This block is executed only once when the study is first added to a chart,
     // or when its settings are reset to default.
     if (sc.SetDefaults)
     {
-        sc.GraphName = "Scalping Bot"; // Name displayed in the chart's "Studies" list and on the chart.
-        sc.AutoLoop = 1;  // Setting to 1 enables "automatic looping".
-                          // This means Sierra Chart will call this study function for each bar
-                          // during a full recalculation, and then for each new tick/update.
+        sc.GraphName = graphName; // Name displayed in the chart's "Studies" list and on the chart.
+        sc.AutoLoop = 0;  // Manual looping: one call per chart update, covering bars
+                          // sc.UpdateStartIndex .. sc.ArraySize - 1. A full recalculation is a
+                          // single call instead of one call per bar.
         sc.UpdateAlways = 1; // Setting to 1 ensures this study function is called on every chart update.
         sc.MaintainTradeStatisticsAndTradesData = true; // Allows access to trade position data (sc.GetTradePosition)
                                                         // and order history (sc.GetOrderByOrderID, sc.GetOrderByIndex).
@@ -182,145 +1319,645 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
         // Set the default selection to "INFO" (which is index 3, matching LOG_LEVEL_INFO)
         LogLevelInput.SetCustomInputIndex(LOG_LEVEL_INFO); // Use the enum value directly for clarity
 
-        // Critical Unmanaged Auto-trading Settings (User should be aware these are set by the study)
-        // These settings control how Sierra Chart's global trading system interacts with this study's orders.
-        // It's good practice to set these explicitly to ensure predictable behavior.
-        sc.MaximumPositionAllowed = 100000; // Set high to practically not limit this bot's small positions.
-        sc.AllowMultipleEntriesInSameDirection = true; // Not strictly used by this bot's flat-before-new-entry logic.
-        sc.AllowOppositeEntryWithOpposingPositionOrOrders = true; // Not strictly used.
-        sc.CancelAllOrdersOnEntriesAndReversals = false; // Bot manages its own OCO cancellations.
-        sc.CancelAllOrdersOnReversals = false;
-        sc.CancelAllOrdersOnEntries = false;
-        sc.AllowEntryWithWorkingOrders = true; // Bot uses OCO, so this allows entry while the other OCO leg is working.
-        sc.CancelAllWorkingOrdersOnExit = false; // Bot handles its own order cleanup on exit or EOD flatten.
-        sc.SupportAttachedOrdersForTrading = true; // ESSENTIAL for OCO with attached stops/targets to function.
+        CenterModeInput.Name = "Bracket Center Price";
+        // The order here MUST match the BracketCenterMode enum values.
+        CenterModeInput.SetCustomInputStrings("LAST TRADE;MID;MICROPRICE");
+        CenterModeInput.SetCustomInputIndex(CENTER_LAST_TRADE); // Default keeps the original last-trade centering.
 
-        // sc.SendOrdersToTradeService = 1; // THIS IS THE MASTER SWITCH FOR LIVE TRADING.
-                                          // Default is 0 (simulated).
-                                          // UNCOMMENT THIS LINE CAREFULLY TO ENABLE LIVE TRADING ORDERS.
-                                          // Also requires "Automated Trading Enabled - Global"
-                                          // and "Automated Trading Enabled - For Chart" in Sierra Chart menus.
+        DepthLevelsInput.Name = "Market Depth Levels (Microprice/Imbalance)";
+        DepthLevelsInput.SetInt(3);
+        DepthLevelsInput.SetIntLimits(1, MAX_DEPTH_LEVELS);
 
-        return; // Exit after setting defaults. No further processing in this call.
-    }
+        MarkoutSecondsInput.Name = "Adverse Selection Markout (Seconds)";
+        MarkoutSecondsInput.SetInt(5); // Center price is compared to the fill price this long after each entry fill.
+        MarkoutSecondsInput.SetIntLimits(1, 3600);
 
-    //── Bootstrap Logic (Full Recalculation, First Bar) ──────────────────
-    // This section runs ONCE when the study is first applied or fully recalculated (e.g., chart reload, study settings change).
-    // Its purpose is to try and re-synchronize the bot's internal state with the actual market state
-    // (current position, existing orders) if the study was previously running or if orders were placed manually.
-    // sc.IsFullRecalculation is true during a full recalculation.
-    // sc.Index == 0 means this is the first bar being processed in that full recalculation sequence.
-    if (sc.IsFullRecalculation && sc.Index == 0)
-    {
-        SCString bootstrapMsg; // Reusable string for log messages
-        // Get the user-set log level for conditional logging
-        int currentLogLevelSetting = LogLevelInput.GetInt();
-        LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_DEBUG, "BOOTSTRAP: Performing full recalculation.");
+        UseImbalanceGateInput.Name = "Use Order Book Imbalance Gate";
+        UseImbalanceGateInput.SetYesNo(false);
 
-        // 1. Reset all persisted order IDs to ensure a clean state before trying to re-identify.
-        ParentBuyLimitOrderID_Persist = 0;
-        ParentSellLimitOrderID_Persist = 0;
-        ActiveFilledParentOrderID_Persist = 0;
-        IsBracketArmed_Persist = BRACKET_NOT_ARMED; // Assuming not armed until proven otherwise
+        ImbalanceThresholdInput.Name = "Imbalance Gate Threshold (0-1)";
+        // Imbalance = (BidSize - AskSize) / (BidSize + AskSize) over the configured depth levels.
+        ImbalanceThresholdInput.SetFloat(0.6f);
+        ImbalanceThresholdInput.SetFloatLimits(0.05f, 1.0f);
 
-        // 2. Infer current position from Sierra Chart's trade data.
-        s_SCPositionData pos; // Structure to hold position data.
-        sc.GetTradePosition(pos); // ACSIL function to get current trade position for the chart's symbol/account.
+        ImbalanceActionInput.Name = "Imbalance Gate Action";
+        // The order here MUST match the ImbalanceGateAction enum values.
+        ImbalanceActionInput.SetCustomInputStrings("SKIP ARMING;ARM WITH-FLOW SIDE ONLY");
+        ImbalanceActionInput.SetCustomInputIndex(IMBALANCE_GATE_SKIP_ARMING);
 
-        if (pos.PositionQuantity > 0) CurrentTradeSide_Persist = SIDE_LONG;
-        else if (pos.PositionQuantity < 0) CurrentTradeSide_Persist = SIDE_SHORT;
-        else CurrentTradeSide_Persist = SIDE_FLAT;
+        UseSessionCalendarInput.Name = "Use Session Calendar File";
+        // When enabled, overrides "Use Trading Window" / Start Time / Stop Time.
+        UseSessionCalendarInput.SetYesNo(false);
 
-        bootstrapMsg.Format("BOOTSTRAP: Current Position Qty: %.0f, Inferred TradeSide: %d", pos.PositionQuantity, CurrentTradeSide_Persist);
-        LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_DEBUG, bootstrapMsg);
+        SessionCalendarFileInput.Name = "Session Calendar File";
+        SessionCalendarFileInput.SetPathAndFileName(""); // See README.md for the file format.
 
-        // 3. If currently flat, attempt to re-identify working OCO bracket orders.
-        // Iterate through all known orders for the current chart to find potential OCO parents.
-        if (static_cast<TradeSide>(CurrentTradeSide_Persist) == SIDE_FLAT)
-        {
-            int orderIndex = 0;
-            s_SCTradeOrder currentOrder;
-            std::vector<int> validParentLimitOrderIDs;
+        DailyLossLimitInput.Name = "Daily Loss Limit (Currency, 0 = Off)";
+        DailyLossLimitInput.SetFloat(0.0f);
+        DailyLossLimitInput.SetFloatLimits(0.0f, 1000000.0f);
 
-            while (sc.GetOrderByIndex(orderIndex++, currentOrder) != SCTRADING_ORDER_ERROR)
-            {
-                if (currentOrder.OrderStatusCode == SCT_OSC_OPEN &&
-                    currentOrder.ParentInternalOrderID == 0 &&
-                    currentOrder.OrderTypeAsInt == SCT_ORDERTYPE_LIMIT)
-                {
-                    int childIndex = 0;
-                    int childOrderCount = 0;
-                    s_SCTradeOrder childOrder;
-                    while (sc.GetOrderByIndex(childIndex++, childOrder) != SCTRADING_ORDER_ERROR)
-                    {
-                        if (childOrder.ParentInternalOrderID == currentOrder.InternalOrderID)
-                        {
-                            childOrderCount++;
-                        }
-                    }
-                    if (childOrderCount == 2)
-                    {
-                        validParentLimitOrderIDs.push_back(currentOrder.InternalOrderID);
-                    }
-                }
-            }
+        MaxConsecutiveLossesInput.Name = "Max Consecutive Losses (0 = Off)";
+        MaxConsecutiveLossesInput.SetInt(0);
+        MaxConsecutiveLossesInput.SetIntLimits(0, 1000);
 
-            // If we found exactly two such parent limit orders, assume they form an OCO pair.
-            if (validParentLimitOrderIDs.size() == 2)
-            {
-                s_SCTradeOrder orderA, orderB;
-                sc.GetOrderByOrderID(validParentLimitOrderIDs[0], orderA);
-                sc.GetOrderByOrderID(validParentLimitOrderIDs[1], orderB);
+        MaxTradesPerDayInput.Name = "Max Trades Per Day (0 = Off)";
+        MaxTradesPerDayInput.SetInt(0);
+        MaxTradesPerDayInput.SetIntLimits(0, 100000);
 
-                if (orderA.Price1 < orderB.Price1) {
-                    ParentBuyLimitOrderID_Persist = orderA.InternalOrderID;
-                    ParentSellLimitOrderID_Persist = orderB.InternalOrderID;
-                } else {
-                    ParentBuyLimitOrderID_Persist = orderB.InternalOrderID;
-                    ParentSellLimitOrderID_Persist = orderA.InternalOrderID;
-                }
-                IsBracketArmed_Persist = BRACKET_ARMED_AND_WORKING;
-                bootstrapMsg.Format("BOOTSTRAP: Found and re-armed OCO bracket. BuyLimitID: %d, SellLimitID: %d", ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist);
-                LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_INFO, bootstrapMsg);
-            }
-            else
-            {
-                if (!validParentLimitOrderIDs.empty()) {
-                    bootstrapMsg.Format("BOOTSTRAP: Found %d potential parent orders with 2 children, but not exactly 2. Not arming OCO.", (int)validParentLimitOrderIDs.size());
-                    LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_DEBUG, bootstrapMsg);
-                } else {
-                     LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_DEBUG, "BOOTSTRAP: No active OCO bracket found while flat.");
-                }
+        MaxActionsPerSecondInput.Name = "Max Order Actions Per Second (0 = Off)";
+        MaxActionsPerSecondInput.SetInt(0); // Off by default: the trade service and broker apply their own limits.
+        MaxActionsPerSecondInput.SetIntLimits(0, 1000);
+
+        MaxActionsPerMinuteInput.Name = "Max Order Actions Per Minute (0 = Off)";
+        MaxActionsPerMinuteInput.SetInt(0);
+        MaxActionsPerMinuteInput.SetIntLimits(0, 60000);
+
+        UseOrderTemplateInput.Name = "Use Order Template";
+        UseOrderTemplateInput.SetYesNo(true); // Set to No to measure the original fresh-order path.
+
+        EnableProfilingInput.Name = "Enable Phase Profiling";
+        EnableProfilingInput.SetYesNo(false); // No clock reads at all when disabled.
+
+        ProfiledPhaseInput.Name = "Profiled Phase";
+        ProfiledPhaseInput.SetCustomInputStrings("TOTAL;INPUT READ;RATE LIMITER AND RISK;TIME GATING;R FETCH;OFFSETS AND CENTER;STATE 1 ARM;STATE 2 ENTRY;STATE 3 EXIT;LOGGING");
+        ProfiledPhaseInput.SetCustomInputIndex(PHASE_TOTAL);
+
+        ExportMetricsInput.Name = "Export Prometheus Metrics";
+        ExportMetricsInput.SetYesNo(false);
+
+        MetricsFileInput.Name = "Prometheus Metrics File";
+        MetricsFileInput.SetPathAndFileName("scalping_bot.prom");
+
+        MetricsIntervalInput.Name = "Metrics Write Interval (Seconds)";
+        MetricsIntervalInput.SetInt(5);
+        MetricsIntervalInput.SetIntLimits(1, 3600);
+
+        LogRoundTripsInput.Name = "Log Round Trips to File";
+        LogRoundTripsInput.SetYesNo(false);
+
+        RoundTripLogFileInput.Name = "Round Trip Log File";
+        RoundTripLogFileInput.SetPathAndFileName("scalping_bot_round_trips.csv");
+
+        PersistStateInput.Name = "Persist State Snapshot";
+        PersistStateInput.SetYesNo(false);
+
+        StateSnapshotFileInput.Name = "State Snapshot File (Empty = Per Chart)";
+        StateSnapshotFileInput.SetPathAndFileName("");
+
+        BuiltInRLengthInput.Name = "Built-in R Length (Bars, Built-in R Studies)";
+        BuiltInRLengthInput.SetInt(20);
+        BuiltInRLengthInput.SetIntLimits(1, 10000);
+
+        TimeStopSecondsInput.Name = "Time Stop (Seconds, Time-Stop Studies)";
+        TimeStopSecondsInput.SetInt(60);
+        TimeStopSecondsInput.SetIntLimits(1, 86400);
+
+        LadderLevelsInput.Name = "Ladder Levels (Extra Brackets, 0 = Off)";
+        LadderLevelsInput.SetInt(0);
+        LadderLevelsInput.SetIntLimits(0, MAX_LADDER_LEVELS);
+
+        LadderStepInput.Name = "Ladder Step Fraction of R";
+        LadderStepInput.SetFloat(0.5f);
+        LadderStepInput.SetFloatLimits(0.05f, 10.0f);
+
+        PartialFillPolicyInput.Name = "Partial Entry Fill Policy";
+        // The order here MUST match the PartialFillPolicy enum values.
+        PartialFillPolicyInput.SetCustomInputStrings("CANCEL REMAINDER;KEEP REMAINDER WORKING");
+        PartialFillPolicyInput.SetCustomInputIndex(PARTIAL_FILL_CANCEL_REMAINDER);
+
+        ScaleOutTargetsInput.Name = "Scale-Out Targets (1 = Single Target)";
+        ScaleOutTargetsInput.SetInt(1);
+        ScaleOutTargetsInput.SetIntLimits(1, MAX_SCALE_OUT_TARGETS);
+
+        Target2FracInput.Name = "Target 2 Offset Fraction of R";
+        Target2FracInput.SetFloat(1.5f);
+        Target2FracInput.SetFloatLimits(0.001f, 20.0f);
+
+        Target3FracInput.Name = "Target 3 Offset Fraction of R";
+        Target3FracInput.SetFloat(2.0f);
+        Target3FracInput.SetFloatLimits(0.001f, 20.0f);
+
+        Target4FracInput.Name = "Target 4 Offset Fraction of R";
+        Target4FracInput.SetFloat(3.0f);
+        Target4FracInput.SetFloatLimits(0.001f, 20.0f);
+
+        BreakevenAfterTargetInput.Name = "Move Stop to Breakeven After First Target";
+        BreakevenAfterTargetInput.SetYesNo(0);
+
+        UseParameterFileInput.Name = "Use Parameter File (Hot Reload)";
+        UseParameterFileInput.SetYesNo(0);
+
+        ParameterFileInput.Name = "Parameter File";
+        ParameterFileInput.SetPathAndFileName("scalping_bot_params.txt");
+
+        TraceOrdersInput.Name = "Trace Order Lifecycle (Chrome Trace JSON)";
+        TraceOrdersInput.SetYesNo(0); // No order polling beyond the state machine's own when disabled.
+
+        OrderTraceFileInput.Name = "Order Trace File";
+        OrderTraceFileInput.SetPathAndFileName("scalping_bot_trace.json");
+
+        AckLatencyActionInput.Name = "Acknowledgement Latency Action";
+        // The order here MUST match the AckAction enum values.
+        AckLatencyActionInput.SetCustomInputStrings("SUBMIT;CANCEL;FLATTEN");
+        AckLatencyActionInput.SetCustomInputIndex(ACK_SUBMIT);
+
+        StaleFeedThresholdInput.Name = "Stale Feed Threshold (ms, 0 = Off)";
+        StaleFeedThresholdInput.SetFloat(0.0f); // Depends on the feed and on the PC clock being synchronized.
+        StaleFeedThresholdInput.SetFloatLimits(0.0f, 600000.0f);
+
+        FeedLatencySmoothingInput.Name = "Feed Latency Smoothing (Trades)";
+        FeedLatencySmoothingInput.SetInt(20);
+        FeedLatencySmoothingInput.SetIntLimits(1, 10000);
+
+        StaleFeedRecoveryInput.Name = "Stale Feed Recovery (Seconds)";
+        StaleFeedRecoveryInput.SetInt(5);
+        StaleFeedRecoveryInput.SetIntLimits(0, 3600);
+
+        StrategyHostInput.Name = "Strategy Host";
+        // The order here MUST match the StrategyHost enum values.
+        StrategyHostInput.SetCustomInputStrings("THIS STUDY;EXTERNAL PROCESS (SHARED MEMORY BUS)");
+        StrategyHostInput.SetCustomInputIndex(HOST_THIS_STUDY);
+
+        BusFileInput.Name = "Shared Memory Bus File";
+        // Under Wine, Z:\dev\shm is /dev/shm, where a native Linux strategy process maps the same file.
+        BusFileInput.SetPathAndFileName("Z:\\dev\\shm\\scalping_bot_bus");
+
+        // Execution quality subgraphs. Set to DRAWSTYLE_IGNORE so they do not disturb the price scale;
+        // change the Draw Style in the study settings to chart them.
+        CenterPriceSubgraph.Name = "Bracket Center Price";
+        CenterPriceSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        CenterPriceSubgraph.PrimaryColor = RGB(255, 255, 0);
+
+        FillRateSubgraph.Name = "Entry Fill Rate %";
+        FillRateSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        FillRateSubgraph.PrimaryColor = RGB(0, 255, 0);
+
+        AdverseRateSubgraph.Name = "Adverse Fill Rate %";
+        AdverseRateSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AdverseRateSubgraph.PrimaryColor = RGB(255, 0, 0);
+
+        AvgMarkoutSubgraph.Name = "Average Markout (Ticks)";
+        AvgMarkoutSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AvgMarkoutSubgraph.PrimaryColor = RGB(0, 128, 255);
+
+        ImbalanceSubgraph.Name = "Order Book Imbalance";
+        ImbalanceSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        ImbalanceSubgraph.PrimaryColor = RGB(255, 128, 0);
+
+        AdversePerHourSubgraph.Name = "Adverse Fills per Queue Hour";
+        AdversePerHourSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AdversePerHourSubgraph.PrimaryColor = RGB(255, 0, 255);
+
+        DailyPnLSubgraph.Name = "Daily Realized P&L";
+        DailyPnLSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        DailyPnLSubgraph.PrimaryColor = RGB(0, 255, 255);
+
+        TradesTodaySubgraph.Name = "Trades Today";
+        TradesTodaySubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        TradesTodaySubgraph.PrimaryColor = RGB(192, 192, 192);
+
+        ActionsSentSubgraph.Name = "Order Actions Sent";
+        ActionsSentSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        ActionsSentSubgraph.PrimaryColor = RGB(128, 255, 128);
+
+        ActionsDeferredSubgraph.Name = "Order Actions Deferred";
+        ActionsDeferredSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        ActionsDeferredSubgraph.PrimaryColor = RGB(255, 128, 128);
+
+        ActionsCoalescedSubgraph.Name = "Order Actions Coalesced";
+        ActionsCoalescedSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        ActionsCoalescedSubgraph.PrimaryColor = RGB(128, 128, 255);
+
+        PendingActionsSubgraph.Name = "Pending Order Actions";
+        PendingActionsSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        PendingActionsSubgraph.PrimaryColor = RGB(255, 255, 128);
+
+        SubmitLatencySubgraph.Name = "Tick-to-Submit Latency (us)";
+        SubmitLatencySubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        SubmitLatencySubgraph.PrimaryColor = RGB(255, 192, 0);
+
+        SubmitLatencyMeanSubgraph.Name = "Mean Tick-to-Submit Latency (us)";
+        SubmitLatencyMeanSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        SubmitLatencyMeanSubgraph.PrimaryColor = RGB(192, 128, 0);
+
+        PhaseMinSubgraph.Name = "Phase Min (us)";
+        PhaseMinSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        PhaseMinSubgraph.PrimaryColor = RGB(128, 192, 255);
+
+        PhaseMeanSubgraph.Name = "Phase Mean (us)";
+        PhaseMeanSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        PhaseMeanSubgraph.PrimaryColor = RGB(64, 160, 255);
+
+        PhaseMaxSubgraph.Name = "Phase Max (us)";
+        PhaseMaxSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        PhaseMaxSubgraph.PrimaryColor = RGB(0, 96, 255);
+
+        PhaseP99Subgraph.Name = "Phase P99 (us)";
+        PhaseP99Subgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        PhaseP99Subgraph.PrimaryColor = RGB(255, 64, 255);
+
+        AvgEntrySlippageSubgraph.Name = "Avg Entry Slippage (Ticks)";
+        AvgEntrySlippageSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AvgEntrySlippageSubgraph.PrimaryColor = RGB(255, 160, 160);
+
+        AvgExitSlippageSubgraph.Name = "Avg Exit Slippage (Ticks)";
+        AvgExitSlippageSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AvgExitSlippageSubgraph.PrimaryColor = RGB(255, 96, 96);
+
+        AvgArmToFillSubgraph.Name = "Avg Arm to Fill (Seconds)";
+        AvgArmToFillSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AvgArmToFillSubgraph.PrimaryColor = RGB(160, 255, 160);
+
+        AvgTimeInTradeSubgraph.Name = "Avg Time in Trade (Seconds)";
+        AvgTimeInTradeSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AvgTimeInTradeSubgraph.PrimaryColor = RGB(96, 224, 96);
+
+        AvgMAESubgraph.Name = "Avg MAE (Ticks)";
+        AvgMAESubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AvgMAESubgraph.PrimaryColor = RGB(255, 0, 0);
+
+        AvgMFESubgraph.Name = "Avg MFE (Ticks)";
+        AvgMFESubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AvgMFESubgraph.PrimaryColor = RGB(0, 255, 0);
+
+        LadderPositionSubgraph.Name = "Ladder Net Position";
+        LadderPositionSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        LadderPositionSubgraph.PrimaryColor = RGB(255, 128, 0);
+
+        ParameterVersionSubgraph.Name = "Parameter File Version";
+        ParameterVersionSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        ParameterVersionSubgraph.PrimaryColor = RGB(128, 128, 255);
+
+        AckLatencyP50Subgraph.Name = "Ack Latency P50 (us)";
+        AckLatencyP50Subgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AckLatencyP50Subgraph.PrimaryColor = RGB(160, 224, 255);
+
+        AckLatencyP99Subgraph.Name = "Ack Latency P99 (us)";
+        AckLatencyP99Subgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AckLatencyP99Subgraph.PrimaryColor = RGB(96, 160, 255);
+
+        AckLatencyP999Subgraph.Name = "Ack Latency P99.9 (us)";
+        AckLatencyP999Subgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        AckLatencyP999Subgraph.PrimaryColor = RGB(32, 96, 255);
+
+        FeedLatencySubgraph.Name = "Feed Latency (ms)";
+        FeedLatencySubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        FeedLatencySubgraph.PrimaryColor = RGB(255, 224, 128);
+
+        FeedStaleSubgraph.Name = "Feed Stale";
+        FeedStaleSubgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        FeedStaleSubgraph.PrimaryColor = RGB(255, 64, 64);
+
+        BusRoundTripP50Subgraph.Name = "Bus Round Trip P50 (us)";
+        BusRoundTripP50Subgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        BusRoundTripP50Subgraph.PrimaryColor = RGB(192, 255, 192);
+
+        BusRoundTripP99Subgraph.Name = "Bus Round Trip P99 (us)";
+        BusRoundTripP99Subgraph.DrawStyle = DRAWSTYLE_IGNORE;
+        BusRoundTripP99Subgraph.PrimaryColor = RGB(96, 224, 96);
+
+        // Critical Unmanaged Auto-trading Settings (User should be aware these are set by the study)
+        // These settings control how Sierra Chart's global trading system interacts with this study's orders.
+        // It's good practice to set these explicitly to ensure predictable behavior.
+        sc.MaximumPositionAllowed = 100000; // Set high to practically not limit this bot's small positions.
+        sc.AllowMultipleEntriesInSameDirection = true; // Not strictly used by this bot's flat-before-new-entry logic.
+        sc.AllowOppositeEntryWithOpposingPositionOrOrders = true; // Not strictly used.
+        sc.CancelAllOrdersOnEntriesAndReversals = false; // Bot manages its own OCO cancellations.
+        sc.CancelAllOrdersOnReversals = false;
+        sc.CancelAllOrdersOnEntries = false;
+        sc.AllowEntryWithWorkingOrders = true; // Bot uses OCO, so this allows entry while the other OCO leg is working.
+        sc.CancelAllWorkingOrdersOnExit = false; // Bot handles its own order cleanup on exit or EOD flatten.
+        sc.SupportAttachedOrdersForTrading = true; // ESSENTIAL for OCO with attached stops/targets to function.
+
+        // sc.SendOrdersToTradeService = 1; // THIS IS THE MASTER SWITCH FOR LIVE TRADING.
+                                          // Default is 0 (simulated).
+                                          // UNCOMMENT THIS LINE CAREFULLY TO ENABLE LIVE TRADING ORDERS.
+                                          // Also requires "Automated Trading Enabled - Global"
+                                          // and "Automated Trading Enabled - For Chart" in Sierra Chart menus.
+
+        return; // Exit after setting defaults. No further processing in this call.
+    }
+
+    // Allocate the runtime state on the first call after defaults. Value-initialization zeroes every counter.
+    if (RuntimeStatePointer == NULL) {
+        RuntimeStatePointer = new BotRuntimeState();
+    }
+    BotRuntimeState& runtimeState = *static_cast<BotRuntimeState*>(RuntimeStatePointer);
+
+    // Market depth (sc.GetBidMarketDepthEntryAt / sc.GetAskMarketDepthEntryAt) is only subscribed to while
+    // an input reads it: a MID or MICROPRICE center, the imbalance gate, or the bus host, which publishes it.
+    sc.UsesMarketDepthData = (EntryPolicy::Center(CenterModeInput) != CENTER_LAST_TRADE || UseImbalanceGateInput.GetYesNo() ||
+        StrategyHostInput.GetIndex() == HOST_BUS_PROCESS) ? 1 : 0;
+
+    // With manual looping there is no sc.Index. Trading and subgraph updates only ever concern the last
+    // bar; the earlier bars of a full recalculation (sc.UpdateStartIndex onward) need no per-bar work.
+    if (sc.ArraySize == 0)
+        return;
+    const int lastBarIndex = sc.ArraySize - 1;
+
+    //── Bootstrap Logic (Full Recalculation, First Bar) ──────────────────
+    // This section runs ONCE when the study is first applied or fully recalculated (e.g., chart reload, study settings change).
+    // Its purpose is to try and re-synchronize the bot's internal state with the actual market state
+    // (current position, existing orders) if the study was previously running or if orders were placed manually.
+    // sc.IsFullRecalculation is true during a full recalculation.
+    // sc.UpdateStartIndex == 0 means this call covers the chart from its first bar.
+    if (sc.IsFullRecalculation && sc.UpdateStartIndex == 0)
+    {
+        LogBuffer bootstrapMsg; // Reusable string for log messages
+        // Get the user-set log level for conditional logging
+        int currentLogLevelSetting = LogLevelInput.GetInt();
+        LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_DEBUG, "BOOTSTRAP: Performing full recalculation.");
+
+        // 1. Reset all persisted order IDs to ensure a clean state before trying to re-identify. The legs of a
+        // bracket being cancelled are remembered: the order scan would otherwise adopt them as a working bracket.
+        int cancelPendingBuyID = 0, cancelPendingSellID = 0;
+        if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_CANCEL_PENDING) {
+            cancelPendingBuyID = ParentBuyLimitOrderID_Persist;
+            cancelPendingSellID = ParentSellLimitOrderID_Persist;
+        }
+        ParentBuyLimitOrderID_Persist = 0;
+        ParentSellLimitOrderID_Persist = 0;
+        ActiveFilledParentOrderID_Persist = 0;
+        IsBracketArmed_Persist = BRACKET_NOT_ARMED; // Assuming not armed until proven otherwise
+        StopSessionCalendarLoader(runtimeState.Calendar); // Restarted on next use, re-reading the file after a settings change.
+        runtimeState.RangeEstimator.LastBar = -1;   // Rebuild the built-in 'R' from the first bar.
+
+        // 2. Resume from the state snapshot if it matches the live orders and position. Unlike the order scan
+        // below, it keeps the filled parent ID of an open trade, so the trade is managed instead of being
+        // flattened as an inconsistent state, and it needs one order lookup per ID instead of a list scan.
+        bool snapshotRestored = false;
+        if (PersistStateInput.GetYesNo()) {
+            ResolveStateSnapshotPath(sc, StateSnapshotFileInput.GetPathAndFileName(), runtimeState.Snapshot.Path, sizeof(runtimeState.Snapshot.Path));
+            BotStateSnapshot snapshot;
+            const char* snapshotPath = runtimeState.Snapshot.Path;
+            if (LoadStateSnapshot(snapshotPath, snapshot)) {
+                snapshotRestored = RestoreStateSnapshot(sc, runtimeState, snapshot, DailyLossLimitInput.GetFloat(), bootstrapMsg);
+                LogSCSMessage(sc, currentLogLevelSetting, snapshotRestored ? LOG_LEVEL_INFO : LOG_LEVEL_WARN, bootstrapMsg, true);
+            } else {
+                bootstrapMsg.Format("BOOTSTRAP: No valid state snapshot at '%s'. Inferring the state from orders.", snapshotPath);
+                LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_DEBUG, bootstrapMsg);
             }
-        } else {
-             if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_ARMED_AND_WORKING) {
-                 LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_WARN, "BOOTSTRAP: InTrade, but IsBracketArmed was true. Resetting IsBracketArmed.");
-                 IsBracketArmed_Persist = BRACKET_NOT_ARMED;
-             }
         }
+
+        // 3. Without a snapshot, infer the state from the position and the order list.
+        if (!snapshotRestored) {
+            // Infer current position from Sierra Chart's trade data. The ladder's trades are not the main bracket's.
+            s_SCPositionData pos; // Structure to hold position data.
+            sc.GetTradePosition(pos); // ACSIL function to get current trade position for the chart's symbol/account.
+            pos.PositionQuantity -= LadderNetPosition(runtimeState.Ladder);
+
+            if (pos.PositionQuantity > 0) CurrentTradeSide_Persist = SIDE_LONG;
+            else if (pos.PositionQuantity < 0) CurrentTradeSide_Persist = SIDE_SHORT;
+            else CurrentTradeSide_Persist = SIDE_FLAT;
+
+            bootstrapMsg.Format("BOOTSTRAP: Current Position Qty: %.0f, Inferred TradeSide: %d", pos.PositionQuantity, CurrentTradeSide_Persist);
+            LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_DEBUG, bootstrapMsg);
+
+            // If currently flat, attempt to re-identify working OCO bracket orders.
+            // Iterate through all known orders for the current chart to find potential OCO parents.
+            if (static_cast<TradeSide>(CurrentTradeSide_Persist) == SIDE_FLAT)
+            {
+                int orderIndex = 0;
+                s_SCTradeOrder currentOrder;
+                int validParentLimitOrderIDs[2] = { 0, 0 }; // The first two found; more than two is not an OCO pair.
+                int numValidParentLimitOrders = 0;
+
+                while (sc.GetOrderByIndex(orderIndex++, currentOrder) != SCTRADING_ORDER_ERROR)
+                {
+                    if (currentOrder.OrderStatusCode == SCT_OSC_OPEN &&
+                        currentOrder.ParentInternalOrderID == 0 &&
+                        currentOrder.OrderTypeAsInt == SCT_ORDERTYPE_LIMIT &&
+                        !IsLadderParentOrder(runtimeState.Ladder, currentOrder.InternalOrderID)) // Ladder levels track their own orders.
+                    {
+                        int childIndex = 0;
+                        int childOrderCount = 0;
+                        s_SCTradeOrder childOrder;
+                        while (sc.GetOrderByIndex(childIndex++, childOrder) != SCTRADING_ORDER_ERROR)
+                        {
+                            if (childOrder.ParentInternalOrderID == currentOrder.InternalOrderID)
+                            {
+                                childOrderCount++;
+                            }
+                        }
+                        if (childOrderCount == 2)
+                        {
+                            if (numValidParentLimitOrders < 2)
+                                validParentLimitOrderIDs[numValidParentLimitOrders] = currentOrder.InternalOrderID;
+                            numValidParentLimitOrders++;
+                        }
+                    }
+                }
+
+                // A single parent limit order is a one-sided bracket (the imbalance gate's with-flow action), whose
+                // side comes from the order. Two are assumed to form an OCO pair.
+                if (numValidParentLimitOrders == 1)
+                {
+                    s_SCTradeOrder order;
+                    sc.GetOrderByOrderID(validParentLimitOrderIDs[0], order);
+                    if (order.BuySell == BSE_BUY)
+                        ParentBuyLimitOrderID_Persist = order.InternalOrderID;
+                    else
+                        ParentSellLimitOrderID_Persist = order.InternalOrderID;
+                    IsBracketArmed_Persist = BRACKET_ARMED_AND_WORKING;
+                    bootstrapMsg.Format("BOOTSTRAP: Found and re-armed one-sided bracket. BuyLimitID: %d, SellLimitID: %d", ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist);
+                    LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_INFO, bootstrapMsg);
+                }
+                else if (numValidParentLimitOrders == 2)
+                {
+                    s_SCTradeOrder orderA, orderB;
+                    sc.GetOrderByOrderID(validParentLimitOrderIDs[0], orderA);
+                    sc.GetOrderByOrderID(validParentLimitOrderIDs[1], orderB);
+
+                    if (orderA.Price1 < orderB.Price1) {
+                        ParentBuyLimitOrderID_Persist = orderA.InternalOrderID;
+                        ParentSellLimitOrderID_Persist = orderB.InternalOrderID;
+                    } else {
+                        ParentBuyLimitOrderID_Persist = orderB.InternalOrderID;
+                        ParentSellLimitOrderID_Persist = orderA.InternalOrderID;
+                    }
+                    IsBracketArmed_Persist = BRACKET_ARMED_AND_WORKING;
+                    bootstrapMsg.Format("BOOTSTRAP: Found and re-armed OCO bracket. BuyLimitID: %d, SellLimitID: %d", ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist);
+                    LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_INFO, bootstrapMsg);
+                }
+                else
+                {
+                    if (numValidParentLimitOrders > 0) {
+                        bootstrapMsg.Format("BOOTSTRAP: Found %d potential parent orders with 2 children, but not 1 or 2. Not arming OCO.", numValidParentLimitOrders);
+                        LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_DEBUG, bootstrapMsg);
+                    } else {
+                         LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_DEBUG, "BOOTSTRAP: No active OCO bracket found while flat.");
+                    }
+                }
+            } else {
+                 if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_ARMED_AND_WORKING) {
+                     LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_WARN, "BOOTSTRAP: InTrade, but IsBracketArmed was true. Resetting IsBracketArmed.");
+                     IsBracketArmed_Persist = BRACKET_NOT_ARMED;
+                 }
+            }
+            if ((cancelPendingBuyID != 0 || cancelPendingSellID != 0) && static_cast<TradeSide>(CurrentTradeSide_Persist) == SIDE_FLAT) {
+                ParentBuyLimitOrderID_Persist = cancelPendingBuyID;
+                ParentSellLimitOrderID_Persist = cancelPendingSellID;
+                IsBracketArmed_Persist = BRACKET_CANCEL_PENDING;
+                bootstrapMsg.Format("BOOTSTRAP: Bracket cancel still pending. BuyLimitID: %d, SellLimitID: %d", cancelPendingBuyID, cancelPendingSellID);
+                LogSCSMessage(sc, currentLogLevelSetting, LOG_LEVEL_INFO, bootstrapMsg);
+            }
+        }
+
+        // 4. A cancel that was pending may have been lost with the previous session: send it again. A cancel
+        // still queued for tokens coalesces with it, and one for legs already gone is ignored by the trade service.
+        if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_CANCEL_PENDING)
+            LimitedCancelBracket(sc, runtimeState.RateLimiter, ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist, runtimeState.ArmedBracket);
+    }
+
+    //── Main Trading Logic (runs on the last bar of the chart on every update, as sc.UpdateAlways = 1) ─────
+    // lastBarIndex is the very latest bar; all trading logic works on it.
+
+    //── Phase Profiling ───────────────────────────────────────────────────
+    // Accumulators cover one bar. The finished bar keeps its final values; the current bar shows the
+    // calls so far. When disabled, 'profiler' is NULL and every ScopedPhaseTimer is a no-op.
+    PhaseProfiler* profiler = NULL;
+    runtimeState.Profiler.Enabled = EnableProfilingInput.GetYesNo() != 0;
+    if (runtimeState.Profiler.Enabled) {
+        profiler = &runtimeState.Profiler;
+        long long inputReadNs = SteadyClockNanoseconds() - callStartTime;
+        int profiledPhase = ProfiledPhaseInput.GetIndex();
+        if (profiledPhase < 0 || profiledPhase >= NUM_PROFILE_PHASES)
+            profiledPhase = PHASE_TOTAL;
+        if (profiler->BarIndex != lastBarIndex) {
+            if (profiler->BarIndex >= 0 && profiler->BarIndex < lastBarIndex)
+                PublishProfilePhase(*profiler, static_cast<ProfilePhase>(profiledPhase), profiler->BarIndex,
+                    PhaseMinSubgraph, PhaseMeanSubgraph, PhaseMaxSubgraph, PhaseP99Subgraph);
+            ResetPhaseProfiler(*profiler, lastBarIndex);
+        }
+        RecordProfilePhase(*profiler, PHASE_INPUT_READ, inputReadNs);
+        PublishProfilePhase(*profiler, static_cast<ProfilePhase>(profiledPhase), lastBarIndex,
+            PhaseMinSubgraph, PhaseMeanSubgraph, PhaseMaxSubgraph, PhaseP99Subgraph);
+    }
+    ScopedPhaseTimer totalTimer(profiler, PHASE_TOTAL, callStartTime);
+
+    //── Prometheus Metrics Export ─────────────────────────────────────────
+    // Counters are always maintained with relaxed atomics. The writer thread is started, restarted
+    // on a path or interval change, or stopped here; it never touches the study's other state.
+    MetricsExporter& metrics = runtimeState.Metrics;
+    if (ExportMetricsInput.GetYesNo()) {
+        const char* metricsPath = MetricsFileInput.GetPathAndFileName();
+        if (!metrics.Running || strcmp(metrics.Path, metricsPath) != 0 || metrics.IntervalSeconds != MetricsIntervalInput.GetInt()) {
+            SCString metricsLabels;
+            metricsLabels.Format("symbol=\"%s\",chart=\"%d\"", sc.Symbol.GetChars(), sc.ChartNumber);
+            StopMetricsExporter(metrics);
+            StartMetricsExporter(metrics, metricsPath, metricsLabels.GetChars(), MetricsIntervalInput.GetInt());
+        }
+    } else if (metrics.Running) {
+        StopMetricsExporter(metrics);
+    }
+    ScopedTickLatency tickLatency(metrics.Running ? &metrics : NULL, callStartTime);
+
+    //── Order Lifecycle Trace ─────────────────────────────────────────────
+    // Submitted orders are registered with the tracer; their status is polled when the call returns.
+    // 'orderTracer' is NULL when tracing is disabled.
+    if (TraceOrdersInput.GetYesNo()) {
+        const char* tracePath = OrderTraceFileInput.GetPathAndFileName();
+        if (!runtimeState.Trace.Running || strcmp(runtimeState.Trace.Path, tracePath) != 0) {
+            StopOrderTracer(runtimeState.Trace);
+            StartOrderTracer(runtimeState.Trace, tracePath, sc.ChartNumber);
+        }
+    } else if (runtimeState.Trace.Running) {
+        StopOrderTracer(runtimeState.Trace);
     }
+    OrderTracer* orderTracer = runtimeState.Trace.Running ? &runtimeState.Trace : NULL;
+    ScopedOrderTrace orderTrace(sc, orderTracer);
 
-    //── Main Trading Logic (runs only on the last bar of the chart if sc.UpdateAlways = 1) ─────
-    // sc.Index is the current bar index being processed by Sierra Chart.
-    // sc.ArraySize is the total number of bars in the chart.
-    // We only want to execute our trading logic on the very latest bar data.
-    if (sc.Index != sc.ArraySize - 1)
-        return; // Not the last bar, so do nothing in this call.
+    // Every state transition in this call is saved to the snapshot file when the call returns.
+    ScopedStateSnapshot stateSnapshot(sc, PersistStateInput.GetYesNo() ? &runtimeState : NULL, LogLevelInput.GetInt());
+    ScopedPhaseTimer limiterAndRiskTimer(profiler, PHASE_LIMITER_AND_RISK);
 
-    SCString logMsg;
+    LogBuffer logMsg; // Formatting never allocates; see LogBuffer.
     int currentLogLevel = LogLevelInput.GetInt();
 
+    //── Order Rate Limiter ────────────────────────────────────────────────
+    // Refill the buckets and send queued actions before anything else, so deferred cancels go out
+    // as soon as tokens are available even while trading is disabled or outside the window.
+    OrderRateLimiter& rateLimiter = runtimeState.RateLimiter;
+    ConfigureOrderRateLimiter(rateLimiter, MaxActionsPerSecondInput.GetInt(), MaxActionsPerMinuteInput.GetInt());
+    if (rateLimiter.NumPending > 0) {
+        int filledLegID = DrainPendingOrderActions(sc, rateLimiter);
+        bool pendingBracketLeg = static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_CANCEL_PENDING &&
+            (filledLegID == ParentBuyLimitOrderID_Persist || filledLegID == ParentSellLimitOrderID_Persist);
+        if (filledLegID != 0 && !pendingBracketLeg) { // A bracket leg is still tracked and handled just below.
+            // A leg filled while its cancel was waiting for tokens. The bot no longer tracks it, so flatten.
+            logMsg.Format("CRITICAL SAFETY: Order %d filled while its cancel was rate limited. Flattening untracked position.", filledLegID);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+            LimitedFlatten(sc, runtimeState, true);
+            IncrementMetric(metrics.SafetyFlattens);
+        }
+    }
+    //── Bracket Cancel ────────────────────────────────────────────────────
+    // A cancelled bracket keeps its leg IDs (BRACKET_CANCEL_PENDING) until neither leg can fill any more,
+    // whether its cancel went out or is still queued for tokens, so no leg is ever left working untracked.
+    // STATE 1 arms a new bracket only after that, except by moving the legs while their cancel is queued.
+    if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_CANCEL_PENDING) {
+        int legIDs[2] = { ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist };
+        int filledLegID = 0;
+        bool legWorking = false;
+        for (int i = 0; i < 2; ++i) {
+            s_SCTradeOrder leg;
+            int status = GetOrderStatusByID(sc, legIDs[i], leg);
+            if (leg.FilledQuantity > 0)
+                filledLegID = legIDs[i];
+            else if (IsWorkingOrderStatus(status))
+                legWorking = true;
+        }
+        if (filledLegID != 0) {
+            // The entry filled before the cancel took effect. The bracket was being pulled, so flatten.
+            logMsg.Format("CRITICAL SAFETY: Order %d filled before its bracket cancel took effect. Flattening.", filledLegID);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+            LimitedFlatten(sc, runtimeState, true); // Also cancels the other leg and the attached orders.
+            IncrementMetric(metrics.SafetyFlattens);
+        }
+        if (filledLegID != 0 || !legWorking) {
+            ParentBuyLimitOrderID_Persist = 0;
+            ParentSellLimitOrderID_Persist = 0;
+            IsBracketArmed_Persist = BRACKET_NOT_ARMED;
+        }
+    }
+    //── Acknowledgement Latency ───────────────────────────────────────────
+    // Actions sent in earlier calls are looked up by ID (one lookup each, nothing when none is
+    // pending), so cancels and flattens that end STATE 2 or STATE 3 are still seen acknowledged.
+    AckLatencyStats& ackLatency = runtimeState.AckLatency;
+    if (rateLimiter.NumAcks > 0) {
+        unsigned int sampledActions = PollAcknowledgements(sc, rateLimiter, ackLatency);
+        for (int action = 0; action < NUM_ACK_ACTIONS; action++) {
+            if ((sampledActions & (1u << action)) == 0)
+                continue;
+            for (int quantile = 0; quantile < 3; quantile++)
+                metrics.AckLatencySeconds[action][quantile].store(ackLatency.PercentilesNs[action][quantile] / 1e9, std::memory_order_relaxed);
+            metrics.AckLatencySumSeconds[action].store(ackLatency.SumNs[action] / 1e9, std::memory_order_relaxed);
+            metrics.AckLatencyCount[action].store(ackLatency.Histograms[action].TotalCount, std::memory_order_relaxed);
+        }
+    }
+    int ackLatencyAction = AckLatencyActionInput.GetIndex();
+    if (ackLatencyAction >= 0 && ackLatencyAction < NUM_ACK_ACTIONS && ackLatency.Histograms[ackLatencyAction].TotalCount > 0) {
+        AckLatencyP50Subgraph[lastBarIndex] = static_cast<float>(ackLatency.PercentilesNs[ackLatencyAction][0] / 1000.0);
+        AckLatencyP99Subgraph[lastBarIndex] = static_cast<float>(ackLatency.PercentilesNs[ackLatencyAction][1] / 1000.0);
+        AckLatencyP999Subgraph[lastBarIndex] = static_cast<float>(ackLatency.PercentilesNs[ackLatencyAction][2] / 1000.0);
+    }
+
+    ActionsSentSubgraph[lastBarIndex] = static_cast<float>(rateLimiter.ActionsSent);
+    ActionsDeferredSubgraph[lastBarIndex] = static_cast<float>(rateLimiter.ActionsDeferred);
+    ActionsCoalescedSubgraph[lastBarIndex] = static_cast<float>(rateLimiter.ActionsCoalesced);
+    PendingActionsSubgraph[lastBarIndex] = static_cast<float>(rateLimiter.NumPending);
+
     //── Trading Enabled Check ─────────────────────────────────────────────
     // Check the "Enable Trading" input. If not 'Yes', stop all bot activity.
     if (!EnableInput.GetYesNo())
     {
         // Log this disabled state, but not on every tick to avoid spam.
         int& lastLoggedDisabledBar = sc.GetPersistentInt(PID_LAST_LOGGED_DISABLED_BAR);
-        // sc.GetBarHasClosedStatus() tells if the current bar (sc.Index) has closed.
+        // sc.GetBarHasClosedStatus(lastBarIndex) tells if the current bar (lastBarIndex) has closed.
         // We log once per closed bar, or if the bar index changes (meaning a new bar formed).
-        if (sc.GetBarHasClosedStatus() == BHCS_BAR_HAS_CLOSED || lastLoggedDisabledBar != sc.CurrentIndex) {
+        if (sc.GetBarHasClosedStatus(lastBarIndex) == BHCS_BAR_HAS_CLOSED || lastLoggedDisabledBar != lastBarIndex) {
             LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, "Trading is disabled via 'Enable Trading' input.");
-            lastLoggedDisabledBar = sc.CurrentIndex; // Update the last bar index we logged this for.
+            lastLoggedDisabledBar = lastBarIndex; // Update the last bar index we logged this for.
         }
         return; // Exit if trading is disabled.
     }
@@ -332,103 +1969,417 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
         return; // Cannot operate without a valid TickSize.
     }
 
-    //── Optional Time Gating Logic ────────────────────────────────────────
-    bool proceedToTradeLogic = true;
+    //── Daily Risk Kill Switch ────────────────────────────────────────────
+    // Counters are maintained incrementally from the fills seen by STATE 2 and STATE 3. Per update
+    // this costs a date comparison, the tripped check, and one price comparison while in a trade.
+    DailyRiskState& risk = runtimeState.Risk;
+    // P&L per point of price movement per contract. Falls back to points if the symbol has no currency value.
+    float currencyPerPoint = sc.CurrencyValuePerTick > 0.0f ? sc.CurrencyValuePerTick / sc.TickSize : 1.0f;
+    // Keyed on the trading day, not the calendar date, so a session that opens in the evening resets
+    // its counters at the session start rather than at midnight in the middle of the session.
+    int barDate = sc.GetTradingDayDate(sc.BaseDateTimeIn[lastBarIndex]);
+    if (barDate != risk.TradingDate) {
+        if (risk.TradingDate != 0) {
+            logMsg.Format("New trading day. Previous day: Realized P&L %.2f over %d trades. Daily risk counters reset.", risk.RealizedPnL, risk.TradesToday);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg);
+        }
+        risk.TradingDate = barDate;
+        risk.RealizedPnL = 0.0;
+        risk.TradesToday = 0;
+        risk.ConsecutiveLosses = 0;
+        risk.KillReason = KILL_NONE;
+        // Re-arm the loss trigger of a trade carried over the date change against the fresh limit.
+        if (risk.OpenSide != SIDE_FLAT)
+            OpenRiskTrade(risk, static_cast<TradeSide>(risk.OpenSide), risk.OpenEntryPrice, risk.OpenQuantity, DailyLossLimitInput.GetFloat(), currencyPerPoint);
+    }
 
-    if (UseTradingWindowInput.GetYesNo()) {
-        int currentTime = sc.BaseDateTimeIn[sc.Index].GetTime();
-        int tradingStartTime = StartTimeInput.GetTime();
-        int tradingStopTime = StopTimeInput.GetTime();
+    // The daily loss limit counts open P&L too: trip as soon as price reaches the precomputed trigger.
+    if (risk.KillReason == KILL_NONE && risk.OpenSide != SIDE_FLAT && risk.LossTriggerPrice > 0.0f) {
+        float lastPrice = sc.Close[lastBarIndex];
+        if (risk.OpenSide == SIDE_LONG ? lastPrice <= risk.LossTriggerPrice : lastPrice >= risk.LossTriggerPrice) {
+            risk.KillReason = KILL_DAILY_LOSS;
+            logMsg.Format("KILL SWITCH: Price %.5f reached the daily loss trigger %.5f (Realized P&L %.2f, Limit %.2f).",
+                lastPrice, risk.LossTriggerPrice, risk.RealizedPnL, DailyLossLimitInput.GetFloat());
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+        }
+    }
 
-        if (currentTime < tradingStartTime) {
-            int& lastLoggedBeforeWindowBar = sc.GetPersistentInt(PID_LAST_LOGGED_BEFORE_WINDOW_BAR);
-            if (sc.GetBarHasClosedStatus() == BHCS_BAR_HAS_CLOSED || lastLoggedBeforeWindowBar != sc.CurrentIndex) {
-                logMsg.Format("Waiting for trading window to start. CurrentTime: %06d, StartTime: %06d", currentTime, tradingStartTime);
-                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
-                lastLoggedBeforeWindowBar = sc.CurrentIndex;
-            }
-            if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_ARMED_AND_WORKING) {
-                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, "Outside trading window: Cancelling armed OCO bracket.", true);
-                if (ParentBuyLimitOrderID_Persist != 0) sc.CancelOrder(ParentBuyLimitOrderID_Persist);
-                if (ParentSellLimitOrderID_Persist != 0) sc.CancelOrder(ParentSellLimitOrderID_Persist);
+    // Fill quality: extend MAE/MFE of the open round trip and publish the averages.
+    RoundTripAnalytics& roundTrips = runtimeState.RoundTrips;
+    const char* roundTripLogPath = LogRoundTripsInput.GetYesNo() ? RoundTripLogFileInput.GetPathAndFileName() : NULL;
+    if (roundTrips.Open)
+        UpdateRoundTripExcursion(roundTrips, sc.Close[lastBarIndex]);
+    if (roundTrips.Count > 0) {
+        AvgEntrySlippageSubgraph[lastBarIndex] = static_cast<float>(roundTrips.EntrySlippageTicksSum / roundTrips.Count);
+        AvgExitSlippageSubgraph[lastBarIndex] = static_cast<float>(roundTrips.ExitSlippageTicksSum / roundTrips.Count);
+        AvgArmToFillSubgraph[lastBarIndex] = static_cast<float>(roundTrips.ArmToFillSecondsSum / roundTrips.Count);
+        AvgTimeInTradeSubgraph[lastBarIndex] = static_cast<float>(roundTrips.TimeInTradeSecondsSum / roundTrips.Count);
+        AvgMAESubgraph[lastBarIndex] = static_cast<float>(roundTrips.MAETicksSum / roundTrips.Count);
+        AvgMFESubgraph[lastBarIndex] = static_cast<float>(roundTrips.MFETicksSum / roundTrips.Count);
+    }
+
+    DailyPnLSubgraph[lastBarIndex] = static_cast<float>(risk.RealizedPnL);
+    TradesTodaySubgraph[lastBarIndex] = static_cast<float>(risk.TradesToday);
+    metrics.DailyRealizedPnL.store(risk.RealizedPnL, std::memory_order_relaxed);
+    metrics.PositionSide.store(CurrentTradeSide_Persist, std::memory_order_relaxed);
+
+    if (risk.KillReason != KILL_NONE)
+    {
+        // Tripped: cancel the bracket and flatten once, then stay idle until the next trading day.
+        bool killSwitchReset = false;
+        if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_ARMED_AND_WORKING) {
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, "Kill switch active: Cancelling armed OCO bracket.", true);
+            LimitedCancelBracket(sc, rateLimiter, ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist, runtimeState.ArmedBracket);
+            IsBracketArmed_Persist = BRACKET_CANCEL_PENDING;
+            EndArmedInterval(runtimeState.Quality, sc.CurrentSystemDateTimeMS);
+            killSwitchReset = true;
+        }
+        if (static_cast<TradeSide>(CurrentTradeSide_Persist) != SIDE_FLAT) {
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, "Kill switch active: Flattening position and cancelling its attached orders.", true);
+            // The attached SL/TP would otherwise stay working after the flatten.
+            LimitedFlatten(sc, runtimeState, true);
+            killSwitchReset = true;
+            double pnl = CloseRiskTrade(risk, sc.Close[lastBarIndex], currencyPerPoint); // Estimated at the last price.
+            CompleteRoundTrip(sc, roundTrips, roundTripLogPath, EXIT_KILL_SWITCH, sc.Close[lastBarIndex], sc.Close[lastBarIndex], pnl);
+            logMsg.Format("Kill switch flatten: estimated trade P&L %.2f. Daily Realized P&L %.2f.", pnl, risk.RealizedPnL);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+        }
+        if (LadderNetPosition(runtimeState.Ladder) != 0.0f && static_cast<TradeSide>(CurrentTradeSide_Persist) == SIDE_FLAT)
+            LimitedFlatten(sc, runtimeState, true); // Only ladder levels are in a trade.
+        CancelLadderBrackets(sc, rateLimiter, runtimeState.Ladder);
+        CloseLadderTrades(sc, rateLimiter, runtimeState.Ladder, risk, sc.Close[lastBarIndex], currencyPerPoint, false);
+        bool busHost = StrategyHostInput.GetIndex() == HOST_BUS_PROCESS;
+        if (busHost && risk.OpenSide != SIDE_FLAT) {
+            // The external process's trade: its brackets and attached orders are cancelled with the flatten.
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, "Kill switch active: Flattening the external strategy's position.", true);
+            LimitedFlatten(sc, runtimeState, true);
+            killSwitchReset = true;
+            double pnl = CloseRiskTrade(risk, sc.Close[lastBarIndex], currencyPerPoint);
+            logMsg.Format("Kill switch flatten: estimated trade P&L %.2f. Daily Realized P&L %.2f.", pnl, risk.RealizedPnL);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+        }
+        risk.KillReason = EvaluateRiskLimits(risk, DailyLossLimitInput.GetFloat(), MaxConsecutiveLossesInput.GetInt(), MaxTradesPerDayInput.GetInt());
+        if (killSwitchReset) {
+            if (static_cast<BracketStatus>(IsBracketArmed_Persist) != BRACKET_CANCEL_PENDING) {
                 ParentBuyLimitOrderID_Persist = 0;
                 ParentSellLimitOrderID_Persist = 0;
-                IsBracketArmed_Persist = BRACKET_NOT_ARMED;
-                ActiveFilledParentOrderID_Persist = 0;
             }
-            proceedToTradeLogic = false;
-        } else if (currentTime >= tradingStopTime) {
-            int& lastLoggedAfterWindowBar = sc.GetPersistentInt(PID_LAST_LOGGED_AFTER_WINDOW_BAR);
-            bool logThisBar = (sc.GetBarHasClosedStatus() == BHCS_BAR_HAS_CLOSED || lastLoggedAfterWindowBar != sc.CurrentIndex);
+            ActiveFilledParentOrderID_Persist = 0;
+            CurrentTradeSide_Persist = SIDE_FLAT;
+            logMsg.Format("Kill switch tripped (%s). Trading halted until the next trading day.", KillSwitchReasonText(risk.KillReason));
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, logMsg, true);
+        }
+        if (!busHost)
+            return;
+        // The bus keeps running, so the process sees the flatten; its bracket commands are rejected below.
+    }
 
-            if (logThisBar) {
-                logMsg.Format("Trading window ended (CurrentTime: %06d, StopTime: %06d). Flattening position and cancelling orders.", currentTime, tradingStopTime);
-                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
-            }
+    limiterAndRiskTimer.Stop();
 
-            if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_ARMED_AND_WORKING) {
-                if (ParentBuyLimitOrderID_Persist != 0) {
-                    logMsg.Format("End of Day: Cancelling ParentBuyLimitOrderID: %d", ParentBuyLimitOrderID_Persist);
-                    LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
-                    sc.CancelOrder(ParentBuyLimitOrderID_Persist);
-                }
-                if (ParentSellLimitOrderID_Persist != 0) {
-                    logMsg.Format("End of Day: Cancelling ParentSellLimitOrderID: %d", ParentSellLimitOrderID_Persist);
+    //── Hot-Reloadable Parameters ─────────────────────────────────────────
+    // Changing a study input makes Sierra Chart recalculate the chart, which reruns the bootstrap. The
+    // parameter file changes the same parameters without a recalculation: its modification time and size
+    // are checked at most once per second, and a changed file is applied only if it parses completely.
+    ParameterFileState& parameterFile = runtimeState.Parameters;
+    StrategyParameterSet* fileParameters = NULL;
+    if (UseParameterFileInput.GetYesNo()) {
+        const char* parameterPath = ParameterFileInput.GetPathAndFileName();
+        double nowSeconds = SteadyClockSeconds();
+        bool pathChanged = strcmp(parameterFile.Path, parameterPath) != 0;
+        if (pathChanged || nowSeconds >= parameterFile.NextCheckTime) {
+            parameterFile.NextCheckTime = nowSeconds + PARAMETER_FILE_CHECK_SECONDS;
+            FileStamp stamp;
+            bool fileFound = ReadFileStamp(parameterPath, stamp);
+            if (pathChanged || !SameFileStamp(stamp, parameterFile.Stamp)) {
+                strncpy(parameterFile.Path, parameterPath, PARAMETER_FILE_PATH_LENGTH - 1);
+                parameterFile.Path[PARAMETER_FILE_PATH_LENGTH - 1] = '\0';
+                parameterFile.Stamp = stamp;
+                StrategyParameterSet loaded = StrategyParameterSet();
+                SCString parameterError;
+                if (!fileFound || !LoadParameterFile(parameterPath, loaded, parameterError)) {
+                    logMsg.Format("Parameter file '%s' not applied: %s. Keeping the previous parameters.", parameterPath,
+                        !fileFound ? "file not found or not readable" : parameterError.GetChars());
+                    LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+                } else if (parameterFile.Version > 0 && SameParameterSet(loaded, parameterFile.Applied)) {
+                    // Saved again without a change (or only comments changed): nothing to apply or requote.
+                    logMsg.Format("Parameter file '%s' unchanged (version %d).", parameterPath, parameterFile.Version);
                     LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
-                    sc.CancelOrder(ParentSellLimitOrderID_Persist);
+                } else {
+                    // Until the first version is applied the study runs on its inputs, so that version is
+                    // compared with them: a file restating the inputs does not requote a restored bracket.
+                    StrategyParameterSet previous = parameterFile.Applied;
+                    if (parameterFile.Version == 0) {
+                        previous = loaded;
+                        previous.BracketFraction = BracketFrac.GetFloat();
+                        previous.StopFraction = StopFrac.GetFloat();
+                        previous.TakeProfitFraction = TPFrac.GetFloat();
+                        previous.StartTime = StartTimeInput.GetTime();
+                        previous.StopTime = StopTimeInput.GetTime();
+                    }
+                    bool parametersChanged = !SameParameterSet(loaded, previous);
+                    parameterFile.Applied = loaded;
+                    parameterFile.Version++;
+                    logMsg.Format("Parameter file '%s' applied (version %d).", parameterPath, parameterFile.Version);
+                    LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+
+                    // Requote a working bracket under the new parameters: cancel it and let STATE 1 arm it
+                    // again once the legs are cancelled (or move the legs if the cancel has to wait for tokens).
+                    if (parametersChanged && static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_ARMED_AND_WORKING &&
+                        static_cast<TradeSide>(CurrentTradeSide_Persist) == SIDE_FLAT) {
+                        LimitedCancelBracket(sc, rateLimiter, ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist, runtimeState.ArmedBracket);
+                        IsBracketArmed_Persist = BRACKET_CANCEL_PENDING;
+                        EndArmedInterval(runtimeState.Quality, sc.CurrentSystemDateTimeMS);
+                        LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, "Requoting the armed bracket under the new parameters.");
+                    }
                 }
             }
+        }
+        fileParameters = &parameterFile.Applied;
+    }
+    ParameterVersionSubgraph[lastBarIndex] = static_cast<float>(fileParameters != NULL ? parameterFile.Version : 0);
+    float bracketFraction = (fileParameters != NULL && fileParameters->HasBracketFraction) ? fileParameters->BracketFraction : BracketFrac.GetFloat();
+    float stopFraction = (fileParameters != NULL && fileParameters->HasStopFraction) ? fileParameters->StopFraction : StopFrac.GetFloat();
+    float takeProfitFraction = (fileParameters != NULL && fileParameters->HasTakeProfitFraction) ? fileParameters->TakeProfitFraction : TPFrac.GetFloat();
 
-            s_SCPositionData positionData;
-            sc.GetTradePosition(positionData);
-            if (positionData.PositionQuantity != 0) {
-                logMsg.Format("End of Day: Flattening open position of %.0f contracts.", positionData.PositionQuantity);
-                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
-                sc.FlattenPosition();
+    //── Stale Feed Guard ──────────────────────────────────────────────────
+    // A resting limit priced off delayed data is picked off. Each new trade gives a latency sample
+    // (local receive time minus its exchange time); above the threshold the armed brackets are pulled,
+    // and none is armed again until the estimate has stayed below it for the recovery period.
+    // Open trades keep their attached orders, which rest at the trade service.
+    FeedLatencyState& feed = runtimeState.Feed;
+    float staleFeedThresholdMs = StaleFeedThresholdInput.GetFloat();
+    if (staleFeedThresholdMs > 0.0f) {
+        bool feedChanged = UpdateFeedLatency(feed, sc.LatestDateTimeForLastBar, lastBarIndex, sc.CurrentSystemDateTimeMS,
+            FeedLatencySmoothingInput.GetInt(), staleFeedThresholdMs, StaleFeedRecoveryInput.GetInt());
+        if (feedChanged && feed.Stale) {
+            logMsg.Format("STALE FEED: Feed latency %.0f ms (last trade %.0f ms) above %.0f ms. Pulling armed brackets.",
+                feed.EstimateMs, feed.LastSampleMs, staleFeedThresholdMs);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, logMsg, true);
+            if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_ARMED_AND_WORKING &&
+                static_cast<TradeSide>(CurrentTradeSide_Persist) == SIDE_FLAT) {
+                LimitedCancelBracket(sc, rateLimiter, ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist, runtimeState.ArmedBracket);
+                IsBracketArmed_Persist = BRACKET_CANCEL_PENDING;
+                EndArmedInterval(runtimeState.Quality, sc.CurrentSystemDateTimeMS);
+            }
+            CancelLadderBrackets(sc, rateLimiter, runtimeState.Ladder);
+            CancelBusEntryOrders(sc, runtimeState);
+        } else if (feedChanged) {
+            logMsg.Format("Feed latency %.0f ms below %.0f ms for %d seconds. Re-arming allowed.",
+                feed.EstimateMs, staleFeedThresholdMs, StaleFeedRecoveryInput.GetInt());
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+        }
+    } else {
+        feed.Stale = false;
+    }
+    FeedLatencySubgraph[lastBarIndex] = static_cast<float>(feed.EstimateMs);
+    FeedStaleSubgraph[lastBarIndex] = feed.Stale ? 1.0f : 0.0f;
+
+    //── External Strategy Host ────────────────────────────────────────────
+    // With the strategy in an external process, this study publishes market data and order events on
+    // the shared-memory bus and executes the commands read back, through the same rate limiter and
+    // order templates. Time gating and the bracket state machine belong to the external process; the
+    // kill switch and the stale-feed guard above still apply: while either holds, bracket commands are
+    // rejected. The process's position is booked into the daily risk counters like the study's trades.
+    BusBridgeState& bus = runtimeState.Bus;
+    if (StrategyHostInput.GetIndex() == HOST_BUS_PROCESS) {
+        const char* busPath = BusFileInput.GetPathAndFileName();
+        if (bus.Mapping.Segment == NULL || strcmp(bus.Path, busPath) != 0) {
+            CloseBusBridge(bus);
+            if (SteadyClockSeconds() < bus.NextOpenTime && strcmp(bus.Path, busPath) == 0)
+                return;
+            if (!OpenBusBridge(bus, busPath)) {
+                logMsg.Format("Shared memory bus '%s' could not be mapped. Retrying in %.0f seconds.", busPath, BUS_REOPEN_SECONDS);
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+                return;
+            }
+            logMsg.Format("Shared memory bus '%s' mapped. Waiting for the strategy process.", busPath);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+        }
+        float busRValue = RangePolicy::Fetch(sc, runtimeState.RangeEstimator, VolSubgraph, BuiltInRLengthInput.GetInt(), lastBarIndex);
+        int bracketBlockReason = risk.KillReason != KILL_NONE ? BUS_REJECT_KILL_SWITCH : (feed.Stale ? BUS_REJECT_STALE_FEED : 0);
+        BusPosition positionBefore = bus.LastPosition;
+        RunBusBridge(sc, runtimeState, busRValue > 0.0f ? busRValue : 0.0f, DepthLevelsInput.GetInt(), ExitPolicy::StopOrderType(),
+            bracketBlockReason, currentLogLevel);
+        if (bus.LastPosition.Quantity != positionBefore.Quantity || bus.LastPosition.AveragePrice != positionBefore.AveragePrice) {
+            // A trade that is closed or reversed is booked at the last price; a resized one re-arms its loss trigger.
+            TradeSide busSide = bus.LastPosition.Quantity > 0.0 ? SIDE_LONG : (bus.LastPosition.Quantity < 0.0 ? SIDE_SHORT : SIDE_FLAT);
+            if (risk.OpenSide != SIDE_FLAT && busSide != static_cast<TradeSide>(risk.OpenSide)) {
+                double pnl = CloseRiskTrade(risk, sc.Close[lastBarIndex], currencyPerPoint);
+                risk.KillReason = EvaluateRiskLimits(risk, DailyLossLimitInput.GetFloat(), MaxConsecutiveLossesInput.GetInt(), MaxTradesPerDayInput.GetInt());
+                logMsg.Format("External strategy trade closed: estimated P&L %.2f. Daily Realized P&L %.2f.", pnl, risk.RealizedPnL);
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg);
+            }
+            if (busSide != SIDE_FLAT) { // Opened while the kill switch holds, it is flattened on the next update.
+                float busQuantity = static_cast<float>(bus.LastPosition.Quantity > 0.0 ? bus.LastPosition.Quantity : -bus.LastPosition.Quantity);
+                OpenRiskTrade(risk, busSide, static_cast<float>(bus.LastPosition.AveragePrice), busQuantity, DailyLossLimitInput.GetFloat(), currencyPerPoint);
+            }
+        }
+        if (bus.RoundTrip.TotalCount > 0) {
+            BusRoundTripP50Subgraph[lastBarIndex] = static_cast<float>(bus.RoundTripP50Ns / 1000.0);
+            BusRoundTripP99Subgraph[lastBarIndex] = static_cast<float>(bus.RoundTripP99Ns / 1000.0);
+        }
+        return;
+    } else if (bus.Mapping.Segment != NULL) {
+        CloseBusBridge(bus);
+    }
+
+    //── Optional Time Gating Logic ────────────────────────────────────────
+    // Either a session calendar file (multiple windows, holidays, early closes, blackouts)
+    // or the single Start/Stop Time window decides whether the bot may trade now.
+    ScopedPhaseTimer timeGatingTimer(profiler, PHASE_TIME_GATING);
+    bool proceedToTradeLogic = true;
+    SessionGate sessionGate = SESSION_OPEN;
+    int currentTime = sc.BaseDateTimeIn[lastBarIndex].GetTime();
+    int tradingStartTime = (fileParameters != NULL && fileParameters->HasWindow) ? fileParameters->StartTime : StartTimeInput.GetTime();
+    int tradingStopTime = (fileParameters != NULL && fileParameters->HasWindow) ? fileParameters->StopTime : StopTimeInput.GetTime();
+
+    SessionCalendarLoader& calendarLoader = runtimeState.Calendar;
+    if (GatingPolicy::UseCalendar(UseSessionCalendarInput)) {
+        int currentDate = sc.BaseDateTimeIn[lastBarIndex].GetDate();
+        long long now = static_cast<long long>(currentDate) * SECONDS_PER_DAY + currentTime;
+
+        // The loader thread reads the file; here a path change restarts it and a date change is passed on.
+        const char* calendarPath = SessionCalendarFileInput.GetPathAndFileName();
+        if (!calendarLoader.Running || strcmp(calendarLoader.Path, calendarPath) != 0) {
+            StopSessionCalendarLoader(calendarLoader);
+            StartSessionCalendarLoader(calendarLoader, calendarPath, currentDate);
+        } else if (calendarLoader.LoadDate.load(std::memory_order_relaxed) != currentDate) {
+            calendarLoader.LoadDate.store(currentDate, std::memory_order_release);
+        }
+        int publishedCalendar = calendarLoader.Published.load(std::memory_order_acquire);
+        if (publishedCalendar >= 0) {
+            calendarLoader.Active = publishedCalendar;
+            calendarLoader.Published.store(-1, std::memory_order_release);
+            const SessionCalendar& loaded = calendarLoader.Buffers[publishedCalendar];
+            if (!loaded.LoadFailed) {
+                logMsg.Format("Session calendar loaded from '%s': %d intervals.", loaded.LoadedPath, loaded.NumIntervals);
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg);
+            } else {
+                logMsg.Format("Session calendar '%s' could not be loaded: %s. Trading is blocked.", loaded.LoadedPath, loaded.LoadError);
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+            }
+        }
+
+        SessionCalendar& calendar = calendarLoader.Buffers[calendarLoader.Active];
+        if (!calendar.Loaded)
+            return; // First compile still running on the loader thread: keep the current orders and position.
+        if (calendar.LoadFailed) {
+            int& lastLoggedCalendarErrorBar = sc.GetPersistentInt(PID_LAST_LOGGED_CALENDAR_ERROR_BAR);
+            if (sc.GetBarHasClosedStatus(lastBarIndex) == BHCS_BAR_HAS_CLOSED || lastLoggedCalendarErrorBar != lastBarIndex) {
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, "Session calendar unavailable. Treating the session as closed.");
+                lastLoggedCalendarErrorBar = lastBarIndex;
             }
+            sessionGate = SESSION_CLOSED;
+        } else {
+            // One comparison per update; the interval search only runs when a boundary is crossed.
+            if (now >= calendar.CachedUntil || now < calendar.CachedFrom)
+                LookupSessionCalendar(calendar, now);
+            sessionGate = calendar.CachedInWindow ? SESSION_OPEN : SESSION_CLOSED;
+        }
+    } else if (GatingPolicy::UseWindow(UseTradingWindowInput)) {
+        if (currentTime < tradingStartTime)
+            sessionGate = SESSION_BEFORE_START;
+        else if (currentTime >= tradingStopTime)
+            sessionGate = SESSION_CLOSED;
+    }
+    if (!GatingPolicy::UseCalendar(UseSessionCalendarInput) && calendarLoader.Running)
+        StopSessionCalendarLoader(calendarLoader); // Calendar gating was switched off.
+
+    if (sessionGate == SESSION_BEFORE_START) {
+        int& lastLoggedBeforeWindowBar = sc.GetPersistentInt(PID_LAST_LOGGED_BEFORE_WINDOW_BAR);
+        if (sc.GetBarHasClosedStatus(lastBarIndex) == BHCS_BAR_HAS_CLOSED || lastLoggedBeforeWindowBar != lastBarIndex) {
+            logMsg.Format("Waiting for trading window to start. CurrentTime: %06d, StartTime: %06d", currentTime, tradingStartTime);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
+            lastLoggedBeforeWindowBar = lastBarIndex;
+        }
+        if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_ARMED_AND_WORKING) {
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, "Outside trading window: Cancelling armed OCO bracket.", true);
+            LimitedCancelBracket(sc, rateLimiter, ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist, runtimeState.ArmedBracket);
+            IsBracketArmed_Persist = BRACKET_CANCEL_PENDING;
+            ActiveFilledParentOrderID_Persist = 0;
+            EndArmedInterval(runtimeState.Quality, sc.CurrentSystemDateTimeMS);
+        }
+        CancelLadderBrackets(sc, rateLimiter, runtimeState.Ladder);
+        proceedToTradeLogic = false;
+    } else if (sessionGate == SESSION_CLOSED) {
+        int& lastLoggedAfterWindowBar = sc.GetPersistentInt(PID_LAST_LOGGED_AFTER_WINDOW_BAR);
+        bool logThisBar = (sc.GetBarHasClosedStatus(lastBarIndex) == BHCS_BAR_HAS_CLOSED || lastLoggedAfterWindowBar != lastBarIndex);
+
+        if (logThisBar) {
+            if (GatingPolicy::UseCalendar(UseSessionCalendarInput))
+                logMsg.Format("Outside session calendar windows (CurrentTime: %06d). Flattening position and cancelling orders.", currentTime);
+            else
+                logMsg.Format("Trading window ended (CurrentTime: %06d, StopTime: %06d). Flattening position and cancelling orders.", currentTime, tradingStopTime);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+        }
 
+        if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_ARMED_AND_WORKING) {
+            logMsg.Format("End of Day: Cancelling ParentBuyLimitOrderID: %d, ParentSellLimitOrderID: %d", ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
+            LimitedCancelBracket(sc, rateLimiter, ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist, runtimeState.ArmedBracket);
+            IsBracketArmed_Persist = BRACKET_CANCEL_PENDING;
+            EndArmedInterval(runtimeState.Quality, sc.CurrentSystemDateTimeMS);
+        }
+
+        s_SCPositionData positionData;
+        sc.GetTradePosition(positionData);
+        if (positionData.PositionQuantity != 0) {
+            logMsg.Format("End of Day: Flattening open position of %.0f contracts.", positionData.PositionQuantity);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+            LimitedFlatten(sc, runtimeState, false);
+        }
+        if (risk.OpenSide != SIDE_FLAT) {
+            double pnl = CloseRiskTrade(risk, sc.Close[lastBarIndex], currencyPerPoint); // Estimated at the last price.
+            CompleteRoundTrip(sc, roundTrips, roundTripLogPath, EXIT_SESSION_FLATTEN, sc.Close[lastBarIndex], sc.Close[lastBarIndex], pnl);
+        }
+        CancelLadderBrackets(sc, rateLimiter, runtimeState.Ladder);
+        CloseLadderTrades(sc, rateLimiter, runtimeState.Ladder, risk, sc.Close[lastBarIndex], currencyPerPoint, true);
+        risk.KillReason = EvaluateRiskLimits(risk, DailyLossLimitInput.GetFloat(), MaxConsecutiveLossesInput.GetInt(), MaxTradesPerDayInput.GetInt());
+
+        if (static_cast<BracketStatus>(IsBracketArmed_Persist) != BRACKET_CANCEL_PENDING) { // Kept until the cancel takes effect.
             ParentBuyLimitOrderID_Persist = 0;
             ParentSellLimitOrderID_Persist = 0;
-            ActiveFilledParentOrderID_Persist = 0;
-            CurrentTradeSide_Persist = SIDE_FLAT;
-            IsBracketArmed_Persist = BRACKET_NOT_ARMED;
+        }
+        ActiveFilledParentOrderID_Persist = 0;
+        CurrentTradeSide_Persist = SIDE_FLAT;
 
-            if (logThisBar) {
-                 LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, "End of Day: All states reset. Bot is flat and idle.");
-                 lastLoggedAfterWindowBar = sc.CurrentIndex;
-            }
-            return;
+        if (logThisBar) {
+             LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, "End of Day: All states reset. Bot is flat and idle.");
+             lastLoggedAfterWindowBar = lastBarIndex;
         }
+        return;
     }
 
     if (!proceedToTradeLogic) {
         return;
     }
+    timeGatingTimer.Stop();
 
     //── Calculate Dynamic Offsets based on 'R' ──────────────────────────
-    // Get the 'R' value from the external study subgraph specified by the user.
-    SCFloatArray volatilityArray; // This will hold the data from the specified subgraph.
-    // sc.GetStudyArrayUsingID gets the data. Parameters: (StudyID, SubgraphIndex, OutputArray)
-    // StudyID and SubgraphIndex are obtained from the VolSubgraph input.
-    sc.GetStudyArrayUsingID(VolSubgraph.GetStudyID(), VolSubgraph.GetSubgraphIndex(), volatilityArray);
+    // Get the 'R' value from the study's 'R' source: the external study subgraph specified by the
+    // user, or the built-in range estimator.
+    ScopedPhaseTimer rFetchTimer(profiler, PHASE_R_FETCH);
+    float R_value = RangePolicy::Fetch(sc, runtimeState.RangeEstimator, VolSubgraph, BuiltInRLengthInput.GetInt(), lastBarIndex); // The dynamic range 'R'.
 
     // Validate the 'R' value.
-    if (volatilityArray.GetArraySize() == 0 || sc.Index >= volatilityArray.GetArraySize() || volatilityArray[sc.Index] <= 0.0f)
+    if (R_value <= 0.0f)
     {
         int& lastLoggedInvalidRBar = sc.GetPersistentInt(PID_LAST_LOGGED_INVALID_R_BAR);
-         if (sc.GetBarHasClosedStatus() == BHCS_BAR_HAS_CLOSED || lastLoggedInvalidRBar != sc.CurrentIndex) {
-            logMsg.Format("Invalid or zero 'R' (volatility) value from subgraph at Index %d. Value: %f. Cannot calculate offsets.", sc.Index, (volatilityArray.GetArraySize() == 0 || sc.Index >= volatilityArray.GetArraySize()) ? 0.0f : volatilityArray[sc.Index]);
+         if (sc.GetBarHasClosedStatus(lastBarIndex) == BHCS_BAR_HAS_CLOSED || lastLoggedInvalidRBar != lastBarIndex) {
+            logMsg.Format("Invalid or zero 'R' (volatility) value from %s at Index %d. Value: %f. Cannot calculate offsets.", RangePolicy::Name(), lastBarIndex, R_value);
             LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, logMsg);
-            lastLoggedInvalidRBar = sc.CurrentIndex;
+            lastLoggedInvalidRBar = lastBarIndex;
         }
         return; // Cannot proceed without a valid 'R' value.
     }
-    float R_value = volatilityArray[sc.Index]; // The dynamic range 'R'.
+    metrics.RangeR.store(R_value, std::memory_order_relaxed);
+    rFetchTimer.Stop();
+    ScopedPhaseTimer offsetsTimer(profiler, PHASE_OFFSETS);
 
     // Calculate raw offsets based on 'R' and user-defined fractions.
-    float rawEntryOffset = R_value * BracketFrac.GetFloat();
-    float rawStopOffset = R_value * StopFrac.GetFloat();
-    float rawTakeProfitOffset = R_value * TPFrac.GetFloat();
+    float rawEntryOffset = R_value * bracketFraction;
+    float rawStopOffset = R_value * stopFraction;
+    float rawTakeProfitOffset = R_value * takeProfitFraction;
 
     // Round these raw offsets to the nearest tick size of the instrument.
     // sc.TickSize is the minimum price increment for the current symbol.
@@ -437,16 +2388,85 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
     float calculatedStopOffset = sc.RoundToIncrement(rawStopOffset, sc.TickSize);
     float calculatedTakeProfitOffset = sc.RoundToIncrement(rawTakeProfitOffset, sc.TickSize);
 
-    // Debug logging for calculated offsets if enabled.
-    int& lastLoggedOffsetsBar = sc.GetPersistentInt(PID_LAST_LOGGED_OFFSETS_BAR);
+    //── Bracket Center Price and Execution Quality ───────────────────────
+    // The bracket is centered on the last trade, the mid, or a size-weighted microprice over the
+    // top levels of the book. Depth is only read when a depth-based mode or the imbalance gate is selected.
+    BracketCenterMode centerMode = EntryPolicy::Center(CenterModeInput);
+    bool useImbalanceGate = UseImbalanceGateInput.GetYesNo() != 0;
+    bool depthAvailable = false;
+    float bracketCenterPrice = sc.Close[lastBarIndex];
+    if (centerMode != CENTER_LAST_TRADE || useImbalanceGate)
+    {
+        depthAvailable = ReadMarketDepth(sc, DepthLevelsInput.GetInt(), runtimeState.Depth);
+
+        bool usedDepth = false;
+        if (depthAvailable)
+            bracketCenterPrice = ComputeBracketCenterPrice(centerMode, runtimeState.Depth, sc.Close[lastBarIndex], usedDepth);
+
+        // The center falls back to the last trade; the gate fails closed and blocks arming until depth returns.
+        bool centerFellBack = centerMode != CENTER_LAST_TRADE && !usedDepth;
+        bool gateBlocked = useImbalanceGate && !depthAvailable;
+        if (centerFellBack || gateBlocked) {
+            int& lastLoggedNoDepthBar = sc.GetPersistentInt(PID_LAST_LOGGED_NO_DEPTH_BAR);
+            if (sc.GetBarHasClosedStatus(lastBarIndex) == BHCS_BAR_HAS_CLOSED || lastLoggedNoDepthBar != lastBarIndex) {
+                if (!gateBlocked)
+                    LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, "Market depth unavailable or crossed. Centering bracket on last trade price.");
+                else if (!centerFellBack)
+                    LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, "Market depth unavailable. Imbalance gate blocks bracket arming.");
+                else
+                    LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, "Market depth unavailable. Centering bracket on last trade price; imbalance gate blocks bracket arming.");
+                lastLoggedNoDepthBar = lastBarIndex;
+            }
+        }
+    }
+
+    // Resolve the pending adverse-selection markout once its horizon has elapsed.
+    ExecutionQualityCounters& quality = runtimeState.Quality;
+    if (quality.PendingMarkoutSide != SIDE_FLAT && sc.CurrentSystemDateTimeMS >= quality.PendingMarkoutDueTime)
+    {
+        float markoutTicks = (bracketCenterPrice - quality.PendingMarkoutFillPrice) / sc.TickSize;
+        if (quality.PendingMarkoutSide == SIDE_SHORT)
+            markoutTicks = -markoutTicks;
+
+        quality.MarkoutsMeasured++;
+        quality.MarkoutTicksSum += markoutTicks;
+        if (markoutTicks < 0.0f)
+            quality.AdverseFills++;
+        quality.PendingMarkoutSide = SIDE_FLAT;
+
+        logMsg.Format("Markout after %ds: %.1f ticks (%s). Adverse fills: %d of %d measured.",
+            MarkoutSecondsInput.GetInt(), markoutTicks, markoutTicks < 0.0f ? "ADVERSE" : "favorable",
+            quality.AdverseFills, quality.MarkoutsMeasured);
+        LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
+    }
+
+    CenterPriceSubgraph[lastBarIndex] = bracketCenterPrice;
+    if (quality.BracketsArmed > 0)
+        FillRateSubgraph[lastBarIndex] = 100.0f * quality.EntryFills / quality.BracketsArmed;
+    if (quality.MarkoutsMeasured > 0) {
+        AdverseRateSubgraph[lastBarIndex] = 100.0f * quality.AdverseFills / quality.MarkoutsMeasured;
+        AvgMarkoutSubgraph[lastBarIndex] = static_cast<float>(quality.MarkoutTicksSum / quality.MarkoutsMeasured);
+    }
+    if (quality.ArmedSeconds > 0.0)
+        AdversePerHourSubgraph[lastBarIndex] = static_cast<float>(quality.AdverseFills * 3600.0 / quality.ArmedSeconds);
+
+    // Top-of-book imbalance from the totals already reduced by ReadMarketDepth. O(1) here.
+    float depthImbalance = 0.0f;
+    if (useImbalanceGate && depthAvailable) {
+        depthImbalance = ComputeDepthImbalance(runtimeState.Depth);
+        ImbalanceSubgraph[lastBarIndex] = depthImbalance;
+    }
+
+    // Debug logging for calculated offsets if enabled.
+    int& lastLoggedOffsetsBar = sc.GetPersistentInt(PID_LAST_LOGGED_OFFSETS_BAR);
     if (currentLogLevel >= LOG_LEVEL_VERBOSE) { // Changed from DEBUG to VERBOSE to match enum
-        if (sc.GetBarHasClosedStatus() == BHCS_BAR_HAS_CLOSED || lastLoggedOffsetsBar != sc.CurrentIndex) {
+        if (sc.GetBarHasClosedStatus(lastBarIndex) == BHCS_BAR_HAS_CLOSED || lastLoggedOffsetsBar != lastBarIndex) {
             logMsg.Format("VERBOSE: R_Value: %.5f, RawEntryOff: %.5f, RawStopOff: %.5f, RawTPOff: %.5f", R_value, rawEntryOffset, rawStopOffset, rawTakeProfitOffset);
             LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_VERBOSE, logMsg);
             logMsg.Format("VERBOSE: CalcEntryOff: %.5f, CalcStopOff: %.5f, CalcTPOff: %.5f, TickSize: %.5f",
                 calculatedEntryOffset, calculatedStopOffset, calculatedTakeProfitOffset, sc.TickSize);
             LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_VERBOSE, logMsg);
-            lastLoggedOffsetsBar = sc.CurrentIndex;
+            lastLoggedOffsetsBar = lastBarIndex;
         }
     }
 
@@ -471,7 +2491,7 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
 
     // Log adjustments if DEBUG level is met and an adjustment occurred
     if (currentLogLevel >= LOG_LEVEL_DEBUG && (entryOffsetAdjusted || stopOffsetAdjusted || tpOffsetAdjusted)) {
-         if (sc.GetBarHasClosedStatus() == BHCS_BAR_HAS_CLOSED || lastLoggedOffsetsBar != sc.CurrentIndex) {
+         if (sc.GetBarHasClosedStatus(lastBarIndex) == BHCS_BAR_HAS_CLOSED || lastLoggedOffsetsBar != lastBarIndex) {
             if (entryOffsetAdjusted) {
                 logMsg.Format("DEBUG: Entry offset was less than TickSize (%.5f), adjusted to TickSize.", sc.TickSize);
                 LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
@@ -485,24 +2505,91 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
                 LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
             }
             // Update lastLoggedOffsetsBar if we logged anything here (or above if VERBOSE was on)
-            if (currentLogLevel < LOG_LEVEL_VERBOSE) lastLoggedOffsetsBar = sc.CurrentIndex;
+            if (currentLogLevel < LOG_LEVEL_VERBOSE) lastLoggedOffsetsBar = lastBarIndex;
          }
     }
 
 
+    offsetsTimer.Stop();
+
+    //── Bracket Ladder ────────────────────────────────────────────────────
+    // Extra brackets at wider fractions of R, each tracked by its own order IDs in O(levels) lookups.
+    // The imbalance gate applies to them as a whole: they are not armed while it would act, or while
+    // it has no depth to act on. Like the main bracket, they are only armed while its trade is flat.
+    int ladderLevels = LadderLevelsInput.GetInt();
+    if (ladderLevels > 0 || LadderNetPosition(runtimeState.Ladder) != 0.0f)
+    {
+        bool ladderArmingAllowed = static_cast<TradeSide>(CurrentTradeSide_Persist) == SIDE_FLAT &&
+            !feed.Stale && !(useImbalanceGate && (!depthAvailable ||
+            (depthImbalance < 0.0f ? -depthImbalance : depthImbalance) > ImbalanceThresholdInput.GetFloat()));
+        bool ladderFlattenAll = ManageLadder(sc, runtimeState, ladderLevels, ladderArmingAllowed, bracketCenterPrice, R_value,
+            bracketFraction, LadderStepInput.GetFloat(), calculatedStopOffset, calculatedTakeProfitOffset,
+            NumContracts.GetInt(), ExitPolicy::StopOrderType(), currencyPerPoint, currentLogLevel);
+        float ladderPosition = LadderNetPosition(runtimeState.Ladder);
+        LadderPositionSubgraph[lastBarIndex] = ladderPosition;
+
+        // Reconcile: the main bracket's trade plus the ladder's must match the account position. Fills and
+        // position updates can arrive in different updates, so only a lasting mismatch is acted on.
+        if (!ladderFlattenAll) {
+            s_SCPositionData ladderCheckPosition;
+            sc.GetTradePosition(ladderCheckPosition);
+            float mainPosition = (risk.OpenSide == SIDE_LONG) ? risk.OpenQuantity : (risk.OpenSide == SIDE_SHORT ? -risk.OpenQuantity : 0.0f);
+            if (static_cast<float>(ladderCheckPosition.PositionQuantity) == mainPosition + ladderPosition) {
+                runtimeState.Ladder.MismatchSince = SCDateTime();
+            } else if (runtimeState.Ladder.MismatchSince.IsUnset()) {
+                runtimeState.Ladder.MismatchSince = sc.CurrentSystemDateTime;
+            } else if ((sc.CurrentSystemDateTime - runtimeState.Ladder.MismatchSince).GetAsDouble() * SECONDS_PER_DAY >= LADDER_MISMATCH_SECONDS) {
+                logMsg.Format("CRITICAL SAFETY: Position %.0f does not match the tracked main %.0f + ladder %.0f for %d seconds. Flattening.",
+                    ladderCheckPosition.PositionQuantity, mainPosition, ladderPosition, LADDER_MISMATCH_SECONDS);
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+                ladderFlattenAll = true;
+            }
+        }
+
+        if (ladderFlattenAll) {
+            // Same response as a lost stop or target on the main trade: flatten everything and start over.
+            // The flatten cancels the bracket legs too; they stay tracked until the cancels take effect.
+            if (static_cast<BracketStatus>(IsBracketArmed_Persist) == BRACKET_ARMED_AND_WORKING) {
+                IsBracketArmed_Persist = BRACKET_CANCEL_PENDING;
+                EndArmedInterval(runtimeState.Quality, sc.CurrentSystemDateTimeMS);
+            }
+            LimitedFlatten(sc, runtimeState, true);
+            IncrementMetric(metrics.SafetyFlattens);
+            CancelLadderBrackets(sc, rateLimiter, runtimeState.Ladder);
+            CloseLadderTrades(sc, rateLimiter, runtimeState.Ladder, risk, sc.Close[lastBarIndex], currencyPerPoint, false);
+            if (risk.OpenSide != SIDE_FLAT) {
+                double pnl = CloseRiskTrade(risk, sc.Close[lastBarIndex], currencyPerPoint);
+                CompleteRoundTrip(sc, roundTrips, roundTripLogPath, EXIT_SAFETY_FLATTEN, sc.Close[lastBarIndex], sc.Close[lastBarIndex], pnl);
+            }
+            if (static_cast<BracketStatus>(IsBracketArmed_Persist) != BRACKET_CANCEL_PENDING) {
+                ParentBuyLimitOrderID_Persist = 0;
+                ParentSellLimitOrderID_Persist = 0;
+            }
+            ActiveFilledParentOrderID_Persist = 0;
+            CurrentTradeSide_Persist = SIDE_FLAT;
+            runtimeState.Ladder.MismatchSince = SCDateTime();
+            risk.KillReason = EvaluateRiskLimits(risk, DailyLossLimitInput.GetFloat(), MaxConsecutiveLossesInput.GetInt(), MaxTradesPerDayInput.GetInt());
+            return;
+        }
+        risk.KillReason = EvaluateRiskLimits(risk, DailyLossLimitInput.GetFloat(), MaxConsecutiveLossesInput.GetInt(), MaxTradesPerDayInput.GetInt());
+    }
+
     //── State Machine Logic ───────────────────────────────────────────────
     TradeSide currentTradeSide = static_cast<TradeSide>(CurrentTradeSide_Persist);
     BracketStatus currentBracketStatus = static_cast<BracketStatus>(IsBracketArmed_Persist);
 
     // STATE 1: FLAT and OCO BRACKET NOT ARMED --> Try to place OCO bracket
-    // Bot is flat, no orders are out, conditions are met to try and enter.
-    if (currentTradeSide == SIDE_FLAT && currentBracketStatus == BRACKET_NOT_ARMED)
+    // Bot is flat, no orders are out, conditions are met to try and enter. While the previous bracket's
+    // cancel is pending, only the coalesced requote below can arm; otherwise wait for the cancel.
+    if (currentTradeSide == SIDE_FLAT && (currentBracketStatus == BRACKET_NOT_ARMED || currentBracketStatus == BRACKET_CANCEL_PENDING))
     {
-        // sc.Close is an array of closing prices for each bar. sc.Close[sc.Index] is the latest close.
-        float currentClosePrice = sc.Close[sc.Index];
-        // Calculate entry limit prices. sc.RoundToTickSize ensures valid order prices.
-        float buyLimitPrice = sc.RoundToTickSize(currentClosePrice - calculatedEntryOffset, sc.TickSize);
-        float sellLimitPrice = sc.RoundToTickSize(currentClosePrice + calculatedEntryOffset, sc.TickSize);
+        ScopedPhaseTimer stateTimer(profiler, PHASE_STATE_1);
+        if (feed.Stale)
+            return; // Stale feed: no bracket until it has recovered.
+
+        // Calculate entry limit prices around the selected center price. sc.RoundToTickSize ensures valid order prices.
+        float buyLimitPrice = sc.RoundToTickSize(bracketCenterPrice - calculatedEntryOffset, sc.TickSize);
+        float sellLimitPrice = sc.RoundToTickSize(bracketCenterPrice + calculatedEntryOffset, sc.TickSize);
 
         // Sanity check: buy limit must be below sell limit.
         if (buyLimitPrice >= sellLimitPrice) {
@@ -516,41 +2603,217 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
             }
         }
 
-        logMsg.Format("Attempting to place OCO bracket. R=%.5f. Close=%.5f. BuyLimit@%.5f, SellLimit@%.5f, StopOffset=%.5f, TPOffset=%.5f",
-            R_value, currentClosePrice, buyLimitPrice, sellLimitPrice, calculatedStopOffset, calculatedTakeProfitOffset);
+        //── Order Book Imbalance Gate ────────────────────────────────────
+        // A strongly one-sided book predicts the next move; the leg resting against that move is the
+        // one most likely to be filled by informed flow. Either skip arming, or arm only the with-flow leg
+        // (the buy limit below the market when bids dominate, the sell limit above when asks dominate).
+        BracketSides armSides = ARM_BOTH_SIDES;
+        if (useImbalanceGate && !depthAvailable)
+            return; // Fail closed: without depth the gate cannot tell which leg is safe. Logged above.
+        if (useImbalanceGate) {
+            float absImbalance = depthImbalance < 0.0f ? -depthImbalance : depthImbalance;
+            if (absImbalance > ImbalanceThresholdInput.GetFloat()) {
+                if (ImbalanceActionInput.GetIndex() == IMBALANCE_GATE_SKIP_ARMING) {
+                    quality.ImbalanceSkips++;
+                    if (currentLogLevel >= LOG_LEVEL_VERBOSE) {
+                        logMsg.Format("VERBOSE: Imbalance gate: |%.3f| > %.3f. Skipping bracket arming.", depthImbalance, ImbalanceThresholdInput.GetFloat());
+                        LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_VERBOSE, logMsg);
+                    }
+                    return; // Re-evaluated on the next tick.
+                }
+                armSides = depthImbalance > 0.0f ? ARM_BUY_SIDE_ONLY : ARM_SELL_SIDE_ONLY;
+            }
+        }
+
+        // Scale-out: target 1 uses "Take Profit Offset Fraction of R", further targets their own fractions.
+        // There cannot be more targets than contracts.
+        int numTargets = ScaleOutTargetsInput.GetInt();
+        if (numTargets > NumContracts.GetInt()) numTargets = NumContracts.GetInt();
+        if (numTargets < 1) numTargets = 1;
+        float targetOffsets[MAX_SCALE_OUT_TARGETS] = { calculatedTakeProfitOffset, 0.0f, 0.0f, 0.0f };
+        const float extraTargetFractions[MAX_SCALE_OUT_TARGETS] = { 0.0f, Target2FracInput.GetFloat(), Target3FracInput.GetFloat(), Target4FracInput.GetFloat() };
+        for (int target = 1; target < numTargets; target++) {
+            targetOffsets[target] = sc.RoundToIncrement(R_value * extraTargetFractions[target], sc.TickSize);
+            if (targetOffsets[target] < sc.TickSize) targetOffsets[target] = sc.TickSize;
+        }
+
+        //── Coalesced Requote ────────────────────────────────────────────
+        // If the previous bracket's cancel is still waiting for tokens and its legs are working with the
+        // same attached offsets (every scale-out target) and quantity, move those legs to the new prices instead:
+        // two modifies replace two cancels plus a new OCO submission.
+        int pendingBracketCancel = FindPendingBracketCancel(rateLimiter);
+        if (currentBracketStatus == BRACKET_CANCEL_PENDING && pendingBracketCancel >= 0 && armSides == ARM_BOTH_SIDES) {
+            const PendingOrderAction& pendingCancel = rateLimiter.Pending[pendingBracketCancel];
+            bool sameTargets = pendingCancel.NumTargets == numTargets;
+            for (int target = 0; sameTargets && target < numTargets; target++)
+                sameTargets = pendingCancel.TargetOffsets[target] == targetOffsets[target];
+            if (pendingCancel.BuyOrderID == ParentBuyLimitOrderID_Persist && pendingCancel.SellOrderID == ParentSellLimitOrderID_Persist &&
+                pendingCancel.StopOffset == calculatedStopOffset && sameTargets &&
+                pendingCancel.Quantity == static_cast<float>(NumContracts.GetInt()))
+            {
+                int requoteBuyID = pendingCancel.BuyOrderID;
+                int requoteSellID = pendingCancel.SellOrderID;
+                int requoteResult = RequoteBracketByModify(sc, rateLimiter, pendingBracketCancel, buyLimitPrice, sellLimitPrice);
+                if (requoteResult == REQUOTE_DONE) {
+                    IncrementMetric(metrics.Requotes);
+                    TraceOrderRequoted(orderTracer, requoteBuyID);
+                    TraceOrderRequoted(orderTracer, requoteSellID);
+                    ParentBuyLimitOrderID_Persist = requoteBuyID;
+                    ParentSellLimitOrderID_Persist = requoteSellID;
+                    IsBracketArmed_Persist = BRACKET_ARMED_AND_WORKING;
+                    runtimeState.ArmedBracket.BuyPrice = buyLimitPrice;
+                    runtimeState.ArmedBracket.SellPrice = sellLimitPrice;
+                    quality.BracketsArmed++;
+                    quality.ArmedSince = sc.CurrentSystemDateTimeMS;
+                    logMsg.Format("Pending bracket cancel coalesced into a requote. BuyLimitID: %d @%.5f, SellLimitID: %d @%.5f",
+                        requoteBuyID, buyLimitPrice, requoteSellID, sellLimitPrice);
+                    LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+                    return;
+                }
+                if (requoteResult == REQUOTE_DEFERRED)
+                    return; // Retry on the next update.
+            }
+        }
+        if (currentBracketStatus == BRACKET_CANCEL_PENDING)
+            return; // The previous bracket's legs can still fill; arm once its cancel has taken effect.
+
+        // Both buckets must have tokens for the whole submission; otherwise skip this update.
+        // The next update recomputes the prices, which coalesces any number of deferred submits.
+        if (!AcquireOrderTokens(rateLimiter, armSides == ARM_BOTH_SIDES ? ORDER_COST_OCO_SUBMIT : ORDER_COST_SINGLE)) {
+            if (currentLogLevel >= LOG_LEVEL_VERBOSE) {
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_VERBOSE, "VERBOSE: Order rate limit reached. Bracket submission deferred.");
+            }
+            return;
+        }
+
+        logMsg.Format("Attempting to place OCO bracket. R=%.5f. Close=%.5f, Center=%.5f. BuyLimit@%.5f, SellLimit@%.5f, StopOffset=%.5f, TPOffset=%.5f",
+            R_value, sc.Close[lastBarIndex], bracketCenterPrice, buyLimitPrice, sellLimitPrice, calculatedStopOffset, calculatedTakeProfitOffset);
         LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg);
 
         // s_SCNewOrder is the ACSIL structure used to define parameters for a new order.
-        s_SCNewOrder ocoOrder;
-        ocoOrder.OrderQuantity = NumContracts.GetInt(); // Get quantity from user input.
-        ocoOrder.OrderType = SCT_ORDERTYPE_OCO_BUY_LIMIT_SELL_LIMIT; // Specify OCO order type.
-
-        // Define the BUY leg of the OCO
-        ocoOrder.Price1 = buyLimitPrice; // Price for the buy limit order.
-        ocoOrder.Stop1Offset = calculatedStopOffset;      // Stop-loss offset for the buy leg.
-        ocoOrder.Target1Offset = calculatedTakeProfitOffset;  // Take-profit offset for the buy leg.
-        ocoOrder.AttachedOrderTarget1Type = SCT_ORDERTYPE_LIMIT; // Target is a Limit order.
-        ocoOrder.AttachedOrderStop1Type = SCT_ORDERTYPE_STOP;    // Stop is a Stop Market order.
-
-        // Define the SELL leg of the OCO
-        ocoOrder.Price2 = sellLimitPrice; // Price for the sell limit order.
-        ocoOrder.Stop1Offset_2 = calculatedStopOffset;     // Stop-loss offset for the sell leg.
-        ocoOrder.Target1Offset_2 = calculatedTakeProfitOffset; // Take-profit offset for the sell leg.
-        ocoOrder.AttachedOrderTarget2Type = SCT_ORDERTYPE_LIMIT; // Target is a Limit order.
-        ocoOrder.AttachedOrderStop2Type = SCT_ORDERTYPE_STOP;    // Stop is a Stop Market order.
-
-        // Submit the OCO order to Sierra Chart's trading system.
-        // This function returns an integer. >0 means success, and it's the InternalOrderID of the first OCO leg.
-        int submissionResult = sc.SubmitOCOOrder(ocoOrder);
+        // With "Use Order Template", the invariant fields (type, quantity, attached order types) are
+        // set once per quantity change in persistent templates and only prices and offsets are patched here.
+        OrderTemplateState& orderTemplates = runtimeState.OrderTemplates;
+        bool useOrderTemplate = UseOrderTemplateInput.GetYesNo() != 0;
+        s_SCNewOrder* orderToSubmit;
+        if (useOrderTemplate) {
+            if (orderTemplates.BuiltForQuantity != NumContracts.GetInt() || orderTemplates.BuiltForTargets != numTargets)
+                BuildBracketOrderTemplates(orderTemplates, NumContracts.GetInt(), ExitPolicy::StopOrderType(), numTargets);
+            orderToSubmit = (armSides == ARM_BOTH_SIDES) ? &orderTemplates.OCOTemplate : &orderTemplates.SingleTemplate;
+            if (armSides == ARM_SELL_SIDE_ONLY)
+                PatchBracketOrder(*orderToSubmit, sellLimitPrice, 0.0f, calculatedStopOffset, targetOffsets, numTargets);
+            else
+                PatchBracketOrder(*orderToSubmit, buyLimitPrice, sellLimitPrice, calculatedStopOffset, targetOffsets, numTargets);
+        } else {
+            // Original path: a freshly constructed order with every field set on each submission.
+            orderToSubmit = &orderTemplates.ScratchOrder;
+            *orderToSubmit = s_SCNewOrder();
+            s_SCNewOrder& freshOrder = *orderToSubmit;
+            freshOrder.OrderQuantity = NumContracts.GetInt(); // Get quantity from user input.
+            freshOrder.OrderType = SCT_ORDERTYPE_OCO_BUY_LIMIT_SELL_LIMIT; // Specify OCO order type.
+
+            // Define the BUY leg of the OCO
+            freshOrder.Price1 = buyLimitPrice; // Price for the buy limit order.
+            freshOrder.Stop1Offset = calculatedStopOffset;      // Stop-loss offset for the buy leg.
+            freshOrder.Target1Offset = calculatedTakeProfitOffset;  // Take-profit offset for the buy leg.
+            freshOrder.AttachedOrderTarget1Type = SCT_ORDERTYPE_LIMIT; // Target is a Limit order.
+            freshOrder.AttachedOrderStop1Type = ExitPolicy::StopOrderType(); // Stop is a Stop Market order (or trailing).
+
+            // Define the SELL leg of the OCO
+            freshOrder.Price2 = sellLimitPrice; // Price for the sell limit order.
+            freshOrder.Stop1Offset_2 = calculatedStopOffset;     // Stop-loss offset for the sell leg.
+            freshOrder.Target1Offset_2 = calculatedTakeProfitOffset; // Take-profit offset for the sell leg.
+            freshOrder.AttachedOrderTarget2Type = SCT_ORDERTYPE_LIMIT; // Target is a Limit order.
+            freshOrder.AttachedOrderStop2Type = ExitPolicy::StopOrderType(); // Stop is a Stop Market order (or trailing).
+
+            if (armSides != ARM_BOTH_SIDES) {
+                // Imbalance gate: only the with-flow leg, as a plain limit order with the same attached SL/TP.
+                freshOrder.OrderType = SCT_ORDERTYPE_LIMIT;
+                if (armSides == ARM_SELL_SIDE_ONLY)
+                    freshOrder.Price1 = sellLimitPrice;
+            }
+
+            if (numTargets > 1) {
+                // Scale-out: one OCO group (stop and target) per target, with the quantity split between them.
+                ApplyScaleOutGroups(freshOrder, NumContracts.GetInt(), ExitPolicy::StopOrderType(), numTargets);
+                PatchBracketOrder(freshOrder, static_cast<float>(freshOrder.Price1), static_cast<float>(freshOrder.Price2),
+                    calculatedStopOffset, targetOffsets, numTargets);
+            }
+        }
+        s_SCNewOrder& ocoOrder = *orderToSubmit;
+
+        int submissionResult = 0;
+        long long submitStartTime = SteadyClockNanoseconds();
+        if (armSides == ARM_BOTH_SIDES)
+        {
+            // Submit the OCO order to Sierra Chart's trading system.
+            // This function returns an integer. >0 means success, and it's the InternalOrderID of the first OCO leg.
+            submissionResult = sc.SubmitOCOOrder(ocoOrder);
+        }
+        else
+        {
+            // STATE 2 handles a bracket with one leg ID of 0 the same way as a half-cancelled OCO.
+            submissionResult = (armSides == ARM_SELL_SIDE_ONLY) ? sc.SellOrder(ocoOrder) : sc.BuyOrder(ocoOrder);
+        }
+
+        // Tick-to-submit latency: from the start of this study call to the order being handed to Sierra Chart.
+        // Reset when the template mode is switched, so the two modes can be compared.
+        SubmitLatencyStats& submitLatency = runtimeState.SubmitLatency;
+        if (submitLatency.Count == 0 || submitLatency.UsedOrderTemplate != useOrderTemplate) {
+            submitLatency = SubmitLatencyStats();
+            submitLatency.UsedOrderTemplate = useOrderTemplate;
+        }
+        long long tickToSubmitNs = submitStartTime - callStartTime;
+        submitLatency.LastNs = tickToSubmitNs;
+        submitLatency.SumNs += static_cast<double>(tickToSubmitNs);
+        submitLatency.Count++;
+        if (tickToSubmitNs > submitLatency.MaxNs)
+            submitLatency.MaxNs = tickToSubmitNs;
+        SubmitLatencySubgraph[lastBarIndex] = static_cast<float>(tickToSubmitNs / 1000.0);
+        SubmitLatencyMeanSubgraph[lastBarIndex] = static_cast<float>(submitLatency.SumNs / submitLatency.Count / 1000.0);
+        ObserveMetricsLatency(metrics.TickToSubmit, tickToSubmitNs);
+
+        if (armSides != ARM_BOTH_SIDES) {
+            quality.ImbalanceOneSided++;
+            logMsg.Format("Imbalance gate: imbalance %.3f exceeds %.3f. Arming %s leg only.",
+                depthImbalance, ImbalanceThresholdInput.GetFloat(), armSides == ARM_BUY_SIDE_ONLY ? "BUY" : "SELL");
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg);
+        }
+        if (currentLogLevel >= LOG_LEVEL_DEBUG) {
+            logMsg.Format("DEBUG: Tick-to-submit %.1f us (mean %.1f us, max %.1f us over %d submissions, order template %s). Submit call %.1f us.",
+                tickToSubmitNs / 1000.0, submitLatency.SumNs / submitLatency.Count / 1000.0, submitLatency.MaxNs / 1000.0,
+                submitLatency.Count, useOrderTemplate ? "on" : "off", (SteadyClockNanoseconds() - submitStartTime) / 1000.0);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
+        }
 
         if (submissionResult > 0) // OCO submission was successful
         {
             // Store the InternalOrderIDs of the parent OCO limit orders and their potential attached orders.
             // These IDs are returned in the ocoOrder structure after sc.SubmitOCOOrder.
-            ParentBuyLimitOrderID_Persist = ocoOrder.InternalOrderID;   // ID of the Buy Limit leg
-            ParentSellLimitOrderID_Persist = ocoOrder.InternalOrderID2; // ID of the Sell Limit leg
+            if (armSides == ARM_BOTH_SIDES) {
+                ParentBuyLimitOrderID_Persist = ocoOrder.InternalOrderID;   // ID of the Buy Limit leg
+                ParentSellLimitOrderID_Persist = ocoOrder.InternalOrderID2; // ID of the Sell Limit leg
+            } else {
+                ParentBuyLimitOrderID_Persist = (armSides == ARM_BUY_SIDE_ONLY) ? ocoOrder.InternalOrderID : 0;
+                ParentSellLimitOrderID_Persist = (armSides == ARM_SELL_SIDE_ONLY) ? ocoOrder.InternalOrderID : 0;
+            }
 
             IsBracketArmed_Persist = BRACKET_ARMED_AND_WORKING; // Update bot state.
+            quality.BracketsArmed++;
+            IncrementMetric(metrics.BracketsSubmitted);
+            quality.ArmedSince = sc.CurrentSystemDateTimeMS;
+
+            ArmedBracketInfo& armedBracket = runtimeState.ArmedBracket;
+            armedBracket.BuyPrice = buyLimitPrice;
+            armedBracket.SellPrice = sellLimitPrice;
+            armedBracket.StopOffset = calculatedStopOffset;
+            for (int target = 0; target < MAX_SCALE_OUT_TARGETS; target++)
+                armedBracket.TargetOffsets[target] = target < numTargets ? targetOffsets[target] : 0.0f;
+            armedBracket.Quantity = static_cast<float>(NumContracts.GetInt());
+            StoreAttachedOrderIDs(ocoOrder, armedBracket, numTargets, armSides);
+            ExpectAcknowledgement(rateLimiter, ACK_SUBMIT, ParentBuyLimitOrderID_Persist, submitStartTime);
+            ExpectAcknowledgement(rateLimiter, ACK_SUBMIT, ParentSellLimitOrderID_Persist, submitStartTime);
+            TraceBracketSubmitted(orderTracer, ParentBuyLimitOrderID_Persist, ParentSellLimitOrderID_Persist, armedBracket);
 
             logMsg.Format("OCO Bracket submitted. BuyLimitID: %d (S:%d, T:%d), SellLimitID: %d (S:%d, T:%d)",
                 ParentBuyLimitOrderID_Persist, ocoOrder.Stop1InternalOrderID, ocoOrder.Target1InternalOrderID,
@@ -573,21 +2836,23 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
     // OCO entry orders are working, waiting for one of them to be filled.
     if (currentTradeSide == SIDE_FLAT && currentBracketStatus == BRACKET_ARMED_AND_WORKING)
     {
+        ScopedPhaseTimer stateTimer(profiler, PHASE_STATE_2);
         s_SCTradeOrder filledOrderDetails; // Structure to hold details of a filled order.
         bool entryFilled = false;          // Flag to track if an entry occurred.
         TradeSide sideEntered = SIDE_FLAT; // To store which side got filled.
         int filledParentID = 0;
 
         // Check status of the BUY LIMIT parent order.
+        // Any filled quantity is an entry, including a partial fill of a leg that is still working.
         if (ParentBuyLimitOrderID_Persist != 0 && sc.GetOrderByOrderID(ParentBuyLimitOrderID_Persist, filledOrderDetails) != SCTRADING_ORDER_ERROR)
         {
-            if (filledOrderDetails.OrderStatusCode == SCT_OSC_FILLED) // Order filled
+            if (filledOrderDetails.FilledQuantity > 0) // Order filled, fully or partially
             {
                 sideEntered = SIDE_LONG;
                 filledParentID = ParentBuyLimitOrderID_Persist;
                 entryFilled = true;
-                logMsg.Format("Entry filled: BUY LIMIT (ParentOrderID: %d) filled. Quantity: %.0f, AvgFillPrice: %.5f",
-                    ParentBuyLimitOrderID_Persist, filledOrderDetails.FilledQuantity, filledOrderDetails.AvgFillPrice);
+                logMsg.Format("Entry filled: BUY LIMIT (ParentOrderID: %d) filled. Quantity: %.0f of %.0f, AvgFillPrice: %.5f",
+                    ParentBuyLimitOrderID_Persist, filledOrderDetails.FilledQuantity, filledOrderDetails.OrderQuantity, filledOrderDetails.AvgFillPrice);
                 LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
             }
             else if (filledOrderDetails.OrderStatusCode == SCT_OSC_CANCELED || filledOrderDetails.OrderStatusCode == SCT_OSC_ERROR) {
@@ -600,13 +2865,13 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
         // If BUY leg wasn't filled, check status of the SELL LIMIT parent order.
         if (!entryFilled && ParentSellLimitOrderID_Persist != 0 && sc.GetOrderByOrderID(ParentSellLimitOrderID_Persist, filledOrderDetails) != SCTRADING_ORDER_ERROR)
         {
-            if (filledOrderDetails.OrderStatusCode == SCT_OSC_FILLED) // Order filled
+            if (filledOrderDetails.FilledQuantity > 0) // Order filled, fully or partially
             {
                 sideEntered = SIDE_SHORT;
                 filledParentID = ParentSellLimitOrderID_Persist;
                 entryFilled = true;
-                logMsg.Format("Entry filled: SELL LIMIT (ParentOrderID: %d) filled. Quantity: %.0f, AvgFillPrice: %.5f",
-                    ParentSellLimitOrderID_Persist, filledOrderDetails.FilledQuantity, filledOrderDetails.AvgFillPrice);
+                logMsg.Format("Entry filled: SELL LIMIT (ParentOrderID: %d) filled. Quantity: %.0f of %.0f, AvgFillPrice: %.5f",
+                    ParentSellLimitOrderID_Persist, filledOrderDetails.FilledQuantity, filledOrderDetails.OrderQuantity, filledOrderDetails.AvgFillPrice);
                 LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
             }
             else if (filledOrderDetails.OrderStatusCode == SCT_OSC_CANCELED || filledOrderDetails.OrderStatusCode == SCT_OSC_ERROR) {
@@ -619,10 +2884,47 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
         // If an entry was filled:
         if (entryFilled)
         {
+            runtimeState.TradeEntryTime = sc.CurrentSystemDateTimeMS;
+
+            // Record the entry side of the round trip before the armed interval is closed.
+            double armToFillSeconds = quality.ArmedSince.IsUnset() ? 0.0 : (sc.CurrentSystemDateTimeMS - quality.ArmedSince).GetAsDouble() * SECONDS_PER_DAY;
+            OpenRoundTrip(runtimeState.RoundTrips, sideEntered,
+                sideEntered == SIDE_LONG ? runtimeState.ArmedBracket.BuyPrice : runtimeState.ArmedBracket.SellPrice,
+                static_cast<float>(filledOrderDetails.AvgFillPrice), static_cast<float>(filledOrderDetails.FilledQuantity),
+                armToFillSeconds, sc.CurrentSystemDateTimeMS);
+
+            // Schedule the adverse-selection markout for this fill.
+            EndArmedInterval(quality, sc.CurrentSystemDateTimeMS);
+            quality.EntryFills++;
+            IncrementMetric(sideEntered == SIDE_LONG ? metrics.EntryFillsBuy : metrics.EntryFillsSell);
+            quality.PendingMarkoutSide = sideEntered;
+            quality.PendingMarkoutFillPrice = static_cast<float>(filledOrderDetails.AvgFillPrice);
+            quality.PendingMarkoutDueTime = sc.CurrentSystemDateTimeMS + SCDateTime::SECONDS(MarkoutSecondsInput.GetInt());
+
+            // Start the daily risk tracking for this trade.
+            OpenRiskTrade(risk, sideEntered, static_cast<float>(filledOrderDetails.AvgFillPrice),
+                static_cast<float>(filledOrderDetails.FilledQuantity), DailyLossLimitInput.GetFloat(), currencyPerPoint);
+
             CurrentTradeSide_Persist = sideEntered; // Update trade side.
             ActiveFilledParentOrderID_Persist = filledParentID;
             IsBracketArmed_Persist = BRACKET_NOT_ARMED; // OCO bracket is no longer considered "armed".
 
+            // A partial fill does not trigger the OCO cancel: cancel the opposite leg here, and the
+            // remainder of the filled leg unless the policy keeps it working. STATE 3 tracks further
+            // fills of the remainder and sizes the attached orders to the filled quantity.
+            int oppositeLegID = (sideEntered == SIDE_LONG) ? ParentSellLimitOrderID_Persist : ParentBuyLimitOrderID_Persist;
+            if (filledOrderDetails.OrderStatusCode != SCT_OSC_FILLED) {
+                LimitedCancelOrder(sc, rateLimiter, oppositeLegID);
+                bool keepRemainder = PartialFillPolicyInput.GetIndex() == PARTIAL_FILL_KEEP_REMAINDER;
+                if (!keepRemainder && filledOrderDetails.OrderStatusCode != SCT_OSC_CANCELED && filledOrderDetails.OrderStatusCode != SCT_OSC_ERROR)
+                    LimitedCancelOrder(sc, rateLimiter, filledParentID);
+                logMsg.Format("Partial entry fill: %.0f of %.0f. Opposite leg %d cancelled, remainder %s.",
+                    filledOrderDetails.FilledQuantity, filledOrderDetails.OrderQuantity, oppositeLegID, keepRemainder ? "kept working" : "cancelled");
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+            }
+            BeginFillTracking(sc, runtimeState.Fills, filledParentID, sideEntered, runtimeState.ArmedBracket,
+                static_cast<float>(filledOrderDetails.FilledQuantity));
+
             // Set the Active Stop and Target Order IDs based on which leg was filled.
             if (sideEntered == SIDE_LONG) {
                 ParentSellLimitOrderID_Persist = 0;
@@ -637,6 +2939,7 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
                 LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_WARN, "Both OCO parent legs seem inactive without a fill. Resetting bracket state.");
                 IsBracketArmed_Persist = BRACKET_NOT_ARMED;
                 ActiveFilledParentOrderID_Persist = 0;
+                EndArmedInterval(quality, sc.CurrentSystemDateTimeMS);
             } else if (currentLogLevel >= LOG_LEVEL_VERBOSE) {
                  LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_VERBOSE, "VERBOSE: OCO Armed, no entry fill detected yet.");
             }
@@ -648,60 +2951,226 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
     // Bot has an open position (long or short) and is monitoring its active stop-loss and take-profit.
     if (currentTradeSide != SIDE_FLAT)
     {
+        ScopedPhaseTimer stateTimer(profiler, PHASE_STATE_3);
         bool exitDetected = false;
-        s_SCTradeOrder childOrderDetails;
-        int orderIndex = 0;
-
+        float exitPrice = sc.Close[lastBarIndex]; // Estimate for safety flattens; replaced by the fill price on SL/TP fills.
+        float requestedExitPrice = exitPrice;
+        RoundTripExit exitReason = EXIT_SAFETY_FLATTEN;
         if (ActiveFilledParentOrderID_Persist == 0) {
             LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, "In trade, but ActiveFilledParentOrderID is 0. Cannot monitor SL/TP. This is an inconsistent state.", true);
             s_SCPositionData posCheck; sc.GetTradePosition(posCheck);
-            if(posCheck.PositionQuantity != 0) sc.FlattenPosition();
+            if(posCheck.PositionQuantity != 0) { LimitedFlatten(sc, runtimeState, false); IncrementMetric(metrics.SafetyFlattens); }
+            if (risk.OpenSide != SIDE_FLAT) {
+                double pnl = CloseRiskTrade(risk, sc.Close[lastBarIndex], currencyPerPoint);
+                CompleteRoundTrip(sc, roundTrips, roundTripLogPath, EXIT_SAFETY_FLATTEN, sc.Close[lastBarIndex], sc.Close[lastBarIndex], pnl);
+                risk.KillReason = EvaluateRiskLimits(risk, DailyLossLimitInput.GetFloat(), MaxConsecutiveLossesInput.GetInt(), MaxTradesPerDayInput.GetInt());
+            }
             CurrentTradeSide_Persist = SIDE_FLAT;
             return;
         }
 
-        while (sc.GetOrderByIndex(orderIndex++, childOrderDetails) != SCTRADING_ORDER_ERROR)
+        // Time stop (time-stop studies only): flatten once the trade has been open long enough. The
+        // flatten also cancels the attached stop and target.
+        if (ExitPolicy::UsesTimeStop() && !runtimeState.TradeEntryTime.IsUnset() &&
+            (sc.CurrentSystemDateTimeMS - runtimeState.TradeEntryTime).GetAsDouble() * SECONDS_PER_DAY >= TimeStopSecondsInput.GetInt())
         {
-            if (childOrderDetails.ParentInternalOrderID == ActiveFilledParentOrderID_Persist)
-            {
+            logMsg.Format("Time stop: trade open for %d seconds. Flattening position and cancelling its attached orders.", TimeStopSecondsInput.GetInt());
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+            LimitedFlatten(sc, runtimeState, true);
+            runtimeState.TradeEntryTime = SCDateTime();
+            exitReason = EXIT_TIME_STOP;
+            exitDetected = true;
+        }
+
+        // Fills are tracked by order ID: the entry while its remainder can still fill, and its attached
+        // stop and target. A trade resumed by the bootstrap resolves its attached order IDs once.
+        TradeFillTracker& fills = runtimeState.Fills;
+        if (!exitDetected && fills.EntryOrderID != ActiveFilledParentOrderID_Persist)
+            BeginFillTracking(sc, fills, ActiveFilledParentOrderID_Persist, currentTradeSide, runtimeState.ArmedBracket, risk.OpenQuantity);
+
+        // The trade service may list the attached orders an update or two after the fill. Until they are
+        // found nothing can detect an exit or a lost stop, so they are looked up again on every update,
+        // and a trade still without them after ATTACHED_ORDER_LOOKUP_SECONDS is flattened as unprotected.
+        if (!exitDetected && fills.NumGroups == 0) {
+            if (fills.LookupSince.IsUnset())
+                fills.LookupSince = sc.CurrentSystemDateTimeMS;
+            else
+                FindAttachedOrders(sc, fills);
+            if (fills.NumGroups > 0) {
+                fills.LookupSince = SCDateTime();
+            } else if ((sc.CurrentSystemDateTimeMS - fills.LookupSince).GetAsDouble() * SECONDS_PER_DAY >= ATTACHED_ORDER_LOOKUP_SECONDS) {
+                logMsg.Format("CRITICAL SAFETY: No attached stop or target found for ActiveFilledParentID %d after %d seconds. Position may be unprotected. Flattening.",
+                    ActiveFilledParentOrderID_Persist, ATTACHED_ORDER_LOOKUP_SECONDS);
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+                LimitedFlatten(sc, runtimeState, true); // Also cancels a working entry remainder and late children.
+                IncrementMetric(metrics.SafetyFlattens);
+                exitDetected = true;
+            }
+        }
+
+        if (!exitDetected && fills.EntryWorking) {
+            s_SCTradeOrder entryOrder;
+            int entryStatus = GetOrderStatusByID(sc, fills.EntryOrderID, entryOrder);
+            if (entryOrder.FilledQuantity > fills.EntryFilledQuantity) {
+                // The remainder filled further: re-base the risk tracking on the new average fill.
+                fills.EntryFilledQuantity = static_cast<float>(entryOrder.FilledQuantity);
+                OpenRiskTrade(risk, currentTradeSide, static_cast<float>(entryOrder.AvgFillPrice), fills.EntryFilledQuantity,
+                    DailyLossLimitInput.GetFloat(), currencyPerPoint);
+                roundTrips.Quantity = fills.EntryFilledQuantity;
+                roundTrips.EntryFillPrice = static_cast<float>(entryOrder.AvgFillPrice);
+                logMsg.Format("Entry fill update: %.0f of %.0f filled, AvgFillPrice: %.5f.", entryOrder.FilledQuantity, entryOrder.OrderQuantity, entryOrder.AvgFillPrice);
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+            }
+            if (entryStatus == SCT_OSC_FILLED || entryStatus == SCT_OSC_CANCELED || entryStatus == SCT_OSC_ERROR || entryStatus == SCT_OSC_UNSPECIFIED)
+                fills.EntryWorking = false;
+        }
+
+        if (!exitDetected) {
+            // Each scale-out group (one stop and one target) is looked up by ID until it closes; a group
+            // closes when either order fills, which cancels the other through its OCO link.
+            s_SCTradeOrder stopOrder, targetOrder;
+            float exitFilledQuantity = 0.0f;
+            bool lostProtection = false;
+            for (int group = 0; group < fills.NumGroups; group++) {
+                if (fills.GroupClosed[group]) {
+                    exitFilledQuantity += fills.StopFilledQuantity[group] + fills.TargetFilledQuantity[group];
+                    continue;
+                }
+                int stopStatus = GetOrderStatusByID(sc, fills.StopOrderIDs[group], stopOrder);
+                int targetStatus = GetOrderStatusByID(sc, fills.TargetOrderIDs[group], targetOrder);
                 if (currentLogLevel >= LOG_LEVEL_VERBOSE) {
-                    logMsg.Format("VERBOSE: Checking child order ID %d of ActiveFilledParentID %d. Status: %d, Type: %d",
-                        childOrderDetails.InternalOrderID, ActiveFilledParentOrderID_Persist, childOrderDetails.OrderStatusCode, childOrderDetails.OrderTypeAsInt);
+                    logMsg.Format("VERBOSE: ActiveFilledParentID %d group %d: stop %d status %d (%.0f filled), target %d status %d (%.0f filled).",
+                        ActiveFilledParentOrderID_Persist, group + 1, fills.StopOrderIDs[group], stopStatus, stopOrder.FilledQuantity,
+                        fills.TargetOrderIDs[group], targetStatus, targetOrder.FilledQuantity);
                     LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_VERBOSE, logMsg);
                 }
+                if (stopOrder.FilledQuantity + targetOrder.FilledQuantity > fills.StopFilledQuantity[group] + fills.TargetFilledQuantity[group] &&
+                    stopStatus != SCT_OSC_FILLED && targetStatus != SCT_OSC_FILLED) {
+                    logMsg.Format("Partial exit fill in group %d: stop %.0f, target %.0f filled.", group + 1, stopOrder.FilledQuantity, targetOrder.FilledQuantity);
+                    LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+                }
+                fills.StopFilledQuantity[group] = static_cast<float>(stopOrder.FilledQuantity);
+                fills.TargetFilledQuantity[group] = static_cast<float>(targetOrder.FilledQuantity);
+                exitFilledQuantity += fills.StopFilledQuantity[group] + fills.TargetFilledQuantity[group];
 
-                if (childOrderDetails.OrderStatusCode == SCT_OSC_FILLED)
+                if (stopStatus == SCT_OSC_FILLED || targetStatus == SCT_OSC_FILLED)
                 {
-                    logMsg.Format("Exit detected: Attached Order (ID: %d, ParentID: %d, Type: %s) FILLED. Qty: %.0f, Price: %.5f",
-                        childOrderDetails.InternalOrderID,
-                        ActiveFilledParentOrderID_Persist,
-                        (childOrderDetails.OrderTypeAsInt == SCT_ORDERTYPE_STOP || childOrderDetails.OrderTypeAsInt == SCT_ORDERTYPE_STOP_LIMIT) ? "STOP" : "TARGET",
-                        childOrderDetails.FilledQuantity,
-                        childOrderDetails.AvgFillPrice);
+                    const s_SCTradeOrder& exitOrder = (stopStatus == SCT_OSC_FILLED) ? stopOrder : targetOrder;
+                    logMsg.Format("Exit detected: Attached Order (ID: %d, ParentID: %d, Type: %s, Group: %d of %d) FILLED. Qty: %.0f, Price: %.5f",
+                        exitOrder.InternalOrderID, ActiveFilledParentOrderID_Persist,
+                        (stopStatus == SCT_OSC_FILLED) ? "STOP" : "TARGET", group + 1, fills.NumGroups, exitOrder.FilledQuantity, exitOrder.AvgFillPrice);
                     LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
 
-                    // IMPORTANT: Clear the active parent ID immediately upon confirmed fill of a child
-                    ActiveFilledParentOrderID_Persist = 0;
-                    exitDetected = true;
-                    break;
+                    if (stopStatus == SCT_OSC_FILLED) {
+                        IncrementMetric(metrics.StopExits);
+                        exitReason = EXIT_STOP;
+                    } else {
+                        IncrementMetric(metrics.TargetExits);
+                        exitReason = EXIT_TARGET;
+                        if (BreakevenAfterTargetInput.GetYesNo() && fills.GroupsClosed == 0)
+                            fills.BreakevenPending = true;
+                    }
+                    fills.ExitNotional[group] = stopOrder.AvgFillPrice * stopOrder.FilledQuantity + targetOrder.AvgFillPrice * targetOrder.FilledQuantity;
+                    fills.RequestedExitNotional[group] = stopOrder.Price1 * stopOrder.FilledQuantity + targetOrder.Price1 * targetOrder.FilledQuantity;
+                    fills.GroupClosed[group] = true;
+                    fills.GroupsClosed++;
                 }
-                else if (childOrderDetails.OrderStatusCode == SCT_OSC_CANCELED ||
-                         childOrderDetails.OrderStatusCode == SCT_OSC_ERROR)
+                else if (stopStatus == SCT_OSC_CANCELED || stopStatus == SCT_OSC_ERROR ||
+                         targetStatus == SCT_OSC_CANCELED || targetStatus == SCT_OSC_ERROR)
                 {
+                    bool stopLost = (stopStatus == SCT_OSC_CANCELED || stopStatus == SCT_OSC_ERROR);
                     logMsg.Format("CRITICAL SAFETY: Active SL/TP child order (ID: %d, ParentID: %d, Type: %s) is now status %d! Position may be unprotected.",
-                        childOrderDetails.InternalOrderID, ActiveFilledParentOrderID_Persist,
-                        (childOrderDetails.OrderTypeAsInt == SCT_ORDERTYPE_STOP || childOrderDetails.OrderTypeAsInt == SCT_ORDERTYPE_STOP_LIMIT) ? "STOP" : "TARGET",
-                        childOrderDetails.OrderStatusCode);
+                        stopLost ? fills.StopOrderIDs[group] : fills.TargetOrderIDs[group], ActiveFilledParentOrderID_Persist,
+                        stopLost ? "STOP" : "TARGET", stopLost ? stopStatus : targetStatus);
+                    LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+                    lostProtection = true;
+                    break;
+                }
+            }
+
+            if (lostProtection)
+            {
+                s_SCPositionData currentPos;
+                sc.GetTradePosition(currentPos);
+                if (currentPos.PositionQuantity != 0) {
+                    LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, "Attempting to flatten position due to unexpected issue with active SL/TP order.", true);
+                    LimitedFlatten(sc, runtimeState, fills.EntryWorking); // Also cancels a working entry remainder.
+                    IncrementMetric(metrics.SafetyFlattens);
+                }
+                for (int group = 0; group < fills.NumGroups; group++) { // The other groups would act on a flat position.
+                    if (fills.GroupClosed[group]) continue;
+                    LimitedCancelOrder(sc, rateLimiter, fills.StopOrderIDs[group]);
+                    LimitedCancelOrder(sc, rateLimiter, fills.TargetOrderIDs[group]);
+                }
+                exitDetected = true;
+            }
+            else if (fills.NumGroups > 0 && fills.GroupsClosed == fills.NumGroups)
+            {
+                // Every group has closed. Average over every exit fill; quantity the attached orders did not
+                // cover (the entry remainder filled after they were last sized) is flattened at the last price.
+                double exitNotional = 0.0, requestedNotional = 0.0;
+                for (int group = 0; group < fills.NumGroups; group++) {
+                    exitNotional += fills.ExitNotional[group];
+                    requestedNotional += fills.RequestedExitNotional[group];
+                }
+                if (fills.EntryWorking) {
+                    LimitedCancelOrder(sc, rateLimiter, fills.EntryOrderID);
+                    fills.EntryWorking = false;
+                }
+                float residualQuantity = fills.EntryFilledQuantity - exitFilledQuantity;
+                if (residualQuantity > 0.0f) {
+                    logMsg.Format("CRITICAL SAFETY: %.0f contracts of the entry were not covered by the attached orders. Flattening.", residualQuantity);
                     LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+                    LimitedFlatten(sc, runtimeState, false);
+                    IncrementMetric(metrics.SafetyFlattens);
+                    exitNotional += residualQuantity * sc.Close[lastBarIndex];
+                    requestedNotional += residualQuantity * sc.Close[lastBarIndex];
+                    exitFilledQuantity += residualQuantity;
+                }
+
+                // IMPORTANT: Clear the active parent ID immediately upon confirmed fill of a child
+                ActiveFilledParentOrderID_Persist = 0;
+                if (exitFilledQuantity > 0.0f) {
+                    exitPrice = static_cast<float>(exitNotional / exitFilledQuantity);
+                    requestedExitPrice = static_cast<float>(requestedNotional / exitFilledQuantity);
+                }
+                exitDetected = true;
+            }
+            else
+            {
+                // Breakeven: after the first target fill, move the stops of the open groups to the average
+                // entry price. A stop already there costs nothing; one without tokens is retried next update.
+                if (fills.BreakevenPending) {
+                    float breakevenPrice = sc.RoundToTickSize(risk.OpenEntryPrice, sc.TickSize);
+                    bool allMoved = true;
+                    for (int group = 0; group < fills.NumGroups; group++) {
+                        if (fills.GroupClosed[group]) continue;
+                        if (GetOrderStatusByID(sc, fills.StopOrderIDs[group], stopOrder) != SCT_OSC_OPEN) continue;
+                        if (static_cast<float>(stopOrder.Price1) == breakevenPrice) continue;
+                        if (LimitedMoveStopOrder(sc, rateLimiter, stopOrder, breakevenPrice)) {
+                            logMsg.Format("Stop %d of group %d moved to breakeven @%.5f.", fills.StopOrderIDs[group], group + 1, breakevenPrice);
+                            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+                        } else {
+                            allMoved = false;
+                        }
+                    }
+                    if (allMoved)
+                        fills.BreakevenPending = false;
+                }
 
-                    s_SCPositionData currentPos;
-                    sc.GetTradePosition(currentPos);
-                    if (currentPos.PositionQuantity != 0) {
-                        LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, "Attempting to flatten position due to unexpected issue with active SL/TP order.", true);
-                        sc.FlattenPosition();
+                // Keep a single target's attached orders sized to the open quantity as the entry remainder
+                // fills. With scale-out, Sierra Chart distributes later fills between the groups itself.
+                // The orders are still those of the lookup above, as the only group is open.
+                float openQuantity = fills.EntryFilledQuantity - exitFilledQuantity;
+                if (fills.NumGroups == 1 && openQuantity > 0.0f) {
+                    if (stopOrder.OrderStatusCode == SCT_OSC_OPEN && LimitedResizeOrder(sc, rateLimiter, stopOrder, openQuantity)) {
+                        logMsg.Format("Stop %d resized to %.0f open contracts.", fills.StopOrderIDs[0], openQuantity);
+                        LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
+                    }
+                    if (targetOrder.OrderStatusCode == SCT_OSC_OPEN && LimitedResizeOrder(sc, rateLimiter, targetOrder, openQuantity)) {
+                        logMsg.Format("Target %d resized to %.0f open contracts.", fills.TargetOrderIDs[0], openQuantity);
+                        LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_DEBUG, logMsg);
                     }
-                    exitDetected = true;
-                    break;
                 }
             }
         }
@@ -714,7 +3183,21 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
             ParentSellLimitOrderID_Persist = 0;      // Remnants of OCO entry
             ActiveFilledParentOrderID_Persist = 0;   // Ensure it's cleared if not already
             CurrentTradeSide_Persist = SIDE_FLAT;
+            runtimeState.Fills = TradeFillTracker();
             IsBracketArmed_Persist = BRACKET_NOT_ARMED;
+
+            // Update the daily risk counters with this round trip and check the limits.
+            double tradePnL = CloseRiskTrade(risk, exitPrice, currencyPerPoint);
+            CompleteRoundTrip(sc, roundTrips, roundTripLogPath, exitReason, requestedExitPrice, exitPrice, tradePnL);
+            risk.KillReason = EvaluateRiskLimits(risk, DailyLossLimitInput.GetFloat(), MaxConsecutiveLossesInput.GetInt(), MaxTradesPerDayInput.GetInt());
+            logMsg.Format("Trade P&L: %.2f. Daily Realized P&L: %.2f, Trades: %d, Consecutive Losses: %d.",
+                tradePnL, risk.RealizedPnL, risk.TradesToday, risk.ConsecutiveLosses);
+            LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, logMsg, true);
+            if (risk.KillReason != KILL_NONE) {
+                logMsg.Format("KILL SWITCH: %s limit reached. No new brackets until the next trading day.", KillSwitchReasonText(risk.KillReason));
+                LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_ERROR, logMsg, true);
+            }
+
             LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_INFO, "Trade exited/flattened. All states reset. Ready for new OCO bracket.");
         } else if (currentLogLevel >= LOG_LEVEL_VERBOSE) {
              LogSCSMessage(sc, currentLogLevel, LOG_LEVEL_VERBOSE, "VERBOSE: In trade, no SL/TP fill or critical order issue detected yet.");
@@ -723,12 +3206,50 @@ SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
     }
 }
 
-// Helper function for logging messages to the Sierra Chart Message Log.
-void LogSCSMessage(SCStudyInterfaceRef& sc, int currentLogLevelSetting, LoggingLevel messageLevel, const SCString& message, bool showInTradeServiceLog) {
+//── Exported Studies ─────────────────────────────────────────────────────
+// The original study: every choice is made through its inputs.
+SCSFExport scsf_Scalping_Bot(SCStudyInterfaceRef sc)
+{
+    ScalpingBotStudy<SubgraphRangeR, CenterFromInput, StaticExit, GatingFromInput>(sc, "Scalping Bot");
+}
+
+// Fixed-policy variants. Add a line here for any other combination.
+SCSFExport scsf_Scalping_Bot_Close_Static_Window(SCStudyInterfaceRef sc)
+{
+    ScalpingBotStudy<SubgraphRangeR, FixedCenter<CENTER_LAST_TRADE>, StaticExit, WindowGating>(sc, "Scalping Bot (Close, Static Exit, Window)");
+}
+
+SCSFExport scsf_Scalping_Bot_Microprice_Static_Calendar(SCStudyInterfaceRef sc)
+{
+    ScalpingBotStudy<SubgraphRangeR, FixedCenter<CENTER_MICROPRICE>, StaticExit, CalendarGating>(sc, "Scalping Bot (Microprice, Static Exit, Calendar)");
+}
+
+SCSFExport scsf_Scalping_Bot_Mid_Trailing_Window(SCStudyInterfaceRef sc)
+{
+    ScalpingBotStudy<SubgraphRangeR, FixedCenter<CENTER_MID>, TrailingStopExit, WindowGating>(sc, "Scalping Bot (Mid, Trailing Stop, Window)");
+}
+
+SCSFExport scsf_Scalping_Bot_BuiltInR_Close_TimeStop_Window(SCStudyInterfaceRef sc)
+{
+    ScalpingBotStudy<BuiltInRangeR, FixedCenter<CENTER_LAST_TRADE>, TimeStopExit, WindowGating>(sc, "Scalping Bot (Built-in R, Close, Time Stop, Window)");
+}
+
+SCSFExport scsf_Scalping_Bot_BuiltInR_Microprice_TimeStop_Calendar(SCStudyInterfaceRef sc)
+{
+    ScalpingBotStudy<BuiltInRangeR, FixedCenter<CENTER_MICROPRICE>, TimeStopExit, CalendarGating>(sc, "Scalping Bot (Built-in R, Microprice, Time Stop, Calendar)");
+}
+
+// Helper function for logging messages to the Sierra Chart Message Log. The level check comes first
+// and the line is formatted into a stack buffer, so a filtered message costs one comparison and a
+// written one no heap allocation in the study.
+void LogSCSMessage(SCStudyInterfaceRef& sc, int currentLogLevelSetting, LoggingLevel messageLevel, const char* message, bool showInTradeServiceLog) {
     if (currentLogLevelSetting < static_cast<int>(messageLevel)) {
         return;
     }
-    SCString logLevelStr;
+    // Only messages that are written are timed; the runtime state is looked up only for those.
+    BotRuntimeState* runtimeState = static_cast<BotRuntimeState*>(sc.GetPersistentPointer(PID_RUNTIME_STATE_POINTER));
+    ScopedPhaseTimer loggingTimer(runtimeState != NULL && runtimeState->Profiler.Enabled ? &runtimeState->Profiler : NULL, PHASE_LOGGING);
+    const char* logLevelStr;
     switch (messageLevel) {
         case LOG_LEVEL_ERROR:   logLevelStr = "ERROR";   break;
         case LOG_LEVEL_WARN:    logLevelStr = "WARN";    break;
@@ -737,17 +3258,2277 @@ void LogSCSMessage(SCStudyInterfaceRef& sc, int currentLogLevelSetting, LoggingL
         case LOG_LEVEL_VERBOSE: logLevelStr = "VERBOSE"; break;
         default:                logLevelStr = "LOG";     break;
     }
-    SCString finalMessage;
-    finalMessage.Format("%s [%s Bar:%d]: %s",
-        sc.FormatDateTime(sc.CurrentSystemDateTime).GetChars(),
-        logLevelStr.GetChars(),
-        sc.CurrentIndex,
-        message.GetChars()
+    const SCDateTime& now = sc.CurrentSystemDateTime;
+    LogBuffer finalMessage;
+    finalMessage.Format("%04d-%02d-%02d %02d:%02d:%02d [%s Bar:%d]: %s",
+        now.GetYear(), now.GetMonth(), now.GetDay(), now.GetHour(), now.GetMinute(), now.GetSecond(),
+        logLevelStr,
+        sc.ArraySize - 1,
+        message
     );
-    sc.AddMessageToLog(finalMessage, showInTradeServiceLog);
+    sc.AddMessageToLog(finalMessage.GetChars(), showInTradeServiceLog);
 }
 
-void LogSCSMessage(SCStudyInterfaceRef& sc, int currentLogLevelSetting, LoggingLevel messageLevel, const char* message, bool showInTradeServiceLog) {
-    SCString scsMessage(message);
-    LogSCSMessage(sc, currentLogLevelSetting, messageLevel, scsMessage, showInTradeServiceLog);
-}
\ No newline at end of file
+void LogSCSMessage(SCStudyInterfaceRef& sc, int currentLogLevelSetting, LoggingLevel messageLevel, const SCString& message, bool showInTradeServiceLog) {
+    LogSCSMessage(sc, currentLogLevelSetting, messageLevel, message.GetChars(), showInTradeServiceLog);
+}
+
+// Reads the top 'levels' of market depth on each side into 'depth', refreshing only those
+// levels in place. Returns false if either side of the book is empty.
+bool ReadMarketDepth(SCStudyInterfaceRef& sc, int levels, MarketDepthSnapshot& depth) {
+    if (levels > MAX_DEPTH_LEVELS) levels = MAX_DEPTH_LEVELS;
+
+    s_MarketDepthEntry entry;
+    int previousBidLevels = depth.NumBidLevels;
+    depth.NumBidLevels = 0;
+    for (int level = 0; level < levels && sc.GetBidMarketDepthEntryAt(entry, level); ++level) {
+        if (entry.Quantity == 0) break;
+        depth.BidPrice[level] = entry.Price;
+        depth.BidQuantity[level] = static_cast<float>(entry.Quantity);
+        depth.NumBidLevels = level + 1;
+    }
+    // Clear only the levels that were populated last time but not this time, keeping the padding zero.
+    for (int level = depth.NumBidLevels; level < previousBidLevels; ++level)
+        depth.BidQuantity[level] = 0.0f;
+
+    int previousAskLevels = depth.NumAskLevels;
+    depth.NumAskLevels = 0;
+    for (int level = 0; level < levels && sc.GetAskMarketDepthEntryAt(entry, level); ++level) {
+        if (entry.Quantity == 0) break;
+        depth.AskPrice[level] = entry.Price;
+        depth.AskQuantity[level] = static_cast<float>(entry.Quantity);
+        depth.NumAskLevels = level + 1;
+    }
+    for (int level = depth.NumAskLevels; level < previousAskLevels; ++level)
+        depth.AskQuantity[level] = 0.0f;
+
+    ReduceDepthQuantities(depth);
+    return depth.NumBidLevels > 0 && depth.NumAskLevels > 0;
+}
+
+// Sums bid and ask quantities over the full zero-padded arrays. The trip count is a compile-time
+// constant and there are no branches, so this is four SSE adds per side plus a horizontal sum.
+void ReduceDepthQuantities(MarketDepthSnapshot& depth) {
+#if defined(_M_X64) || defined(__SSE2__)
+    __m128 bidSum = _mm_setzero_ps();
+    __m128 askSum = _mm_setzero_ps();
+    for (int level = 0; level < MAX_DEPTH_LEVELS; level += 4) {
+        bidSum = _mm_add_ps(bidSum, _mm_load_ps(&depth.BidQuantity[level]));
+        askSum = _mm_add_ps(askSum, _mm_load_ps(&depth.AskQuantity[level]));
+    }
+    // Horizontal sums: lanes (0+2, 1+3), then (0+1).
+    bidSum = _mm_add_ps(bidSum, _mm_movehl_ps(bidSum, bidSum));
+    askSum = _mm_add_ps(askSum, _mm_movehl_ps(askSum, askSum));
+    bidSum = _mm_add_ss(bidSum, _mm_shuffle_ps(bidSum, bidSum, 1));
+    askSum = _mm_add_ss(askSum, _mm_shuffle_ps(askSum, askSum, 1));
+    depth.TotalBidQuantity = _mm_cvtss_f32(bidSum);
+    depth.TotalAskQuantity = _mm_cvtss_f32(askSum);
+#else
+    float bidLanes[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float askLanes[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int level = 0; level < MAX_DEPTH_LEVELS; level += 4) {
+        for (int lane = 0; lane < 4; ++lane) {
+            bidLanes[lane] += depth.BidQuantity[level + lane];
+            askLanes[lane] += depth.AskQuantity[level + lane];
+        }
+    }
+    depth.TotalBidQuantity = (bidLanes[0] + bidLanes[2]) + (bidLanes[1] + bidLanes[3]);
+    depth.TotalAskQuantity = (askLanes[0] + askLanes[2]) + (askLanes[1] + askLanes[3]);
+#endif
+}
+
+// Returns (BidQuantity - AskQuantity) / (BidQuantity + AskQuantity) over the read levels,
+// in the range -1 (all size on the ask) to +1 (all size on the bid).
+float ComputeDepthImbalance(const MarketDepthSnapshot& depth) {
+    float totalQuantity = depth.TotalBidQuantity + depth.TotalAskQuantity;
+    if (totalQuantity <= 0.0f)
+        return 0.0f;
+    return (depth.TotalBidQuantity - depth.TotalAskQuantity) / totalQuantity;
+}
+
+// Returns the bracket center for 'mode'. The microprice weights the best bid and ask by the
+// opposite side's aggregated size over the read levels, so it leans toward the side that is
+// more likely to trade next. Falls back to 'lastTradePrice' (usedDepth = false) on a crossed book.
+float ComputeBracketCenterPrice(BracketCenterMode mode, const MarketDepthSnapshot& depth, float lastTradePrice, bool& usedDepth) {
+    usedDepth = false;
+    if (mode == CENTER_LAST_TRADE)
+        return lastTradePrice;
+
+    float bestBid = depth.BidPrice[0];
+    float bestAsk = depth.AskPrice[0];
+    if (bestBid <= 0.0f || bestAsk <= bestBid)
+        return lastTradePrice;
+
+    usedDepth = true;
+    if (mode == CENTER_MICROPRICE) {
+        float totalQuantity = depth.TotalBidQuantity + depth.TotalAskQuantity;
+        if (totalQuantity > 0.0f)
+            return (bestBid * depth.TotalAskQuantity + bestAsk * depth.TotalBidQuantity) / totalQuantity;
+    }
+    return 0.5f * (bestBid + bestAsk);
+}
+
+// Converts a civil date to a Sierra Chart date value (days since 1899-12-30).
+static int SierraDateFromCivil(int year, int month, int day) {
+    // Days from 1970-01-01 (H. Hinnant's days_from_civil), then shifted to the 1899-12-30 base.
+    year -= month <= 2 ? 1 : 0;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468 + 25569;
+}
+
+// Day of week of a Sierra Chart date value, 0 = Sunday. The base date 1899-12-30 was a Saturday.
+static int DayOfWeekFromSierraDate(int date) {
+    return (date + 6) % 7;
+}
+
+// Parses "HH:MM:SS", "HH:MM" or "HHMMSS" into seconds of the day. Returns -1 on error.
+static int ParseCalendarTime(const char* text) {
+    int hour = 0, minute = 0, second = 0;
+    if (sscanf(text, "%d:%d:%d", &hour, &minute, &second) >= 2) {
+        // HH:MM or HH:MM:SS
+    } else if (strlen(text) == 6 && sscanf(text, "%2d%2d%2d", &hour, &minute, &second) == 3) {
+        // HHMMSS
+    } else {
+        return -1;
+    }
+    if (hour < 0 || hour > 24 || minute < 0 || minute > 59 || second < 0 || second > 59)
+        return -1;
+    if (hour == 24 && (minute != 0 || second != 0))
+        return -1; // 24:00:00 is the end of the day; nothing later exists.
+    return hour * 3600 + minute * 60 + second;
+}
+
+// Parses "YYYY-MM-DD" into a Sierra Chart date value. Returns -1 on error.
+static int ParseCalendarDate(const char* text) {
+    int year = 0, month = 0, day = 0;
+    if (sscanf(text, "%d-%d-%d", &year, &month, &day) != 3 || month < 1 || month > 12 || day < 1 || day > 31)
+        return -1;
+    return SierraDateFromCivil(year, month, day);
+}
+
+// Parses a day specification ("MON", "MON-FRI", "DAILY") into a bit mask, bit 0 = Sunday. Returns 0 on error.
+static int ParseCalendarDays(const char* text) {
+    static const char* const dayNames[7] = { "SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT" };
+    if (strcmp(text, "DAILY") == 0)
+        return 0x7F;
+
+    int first = -1, last = -1;
+    for (int day = 0; day < 7; ++day) {
+        if (strncmp(text, dayNames[day], 3) == 0) first = day;
+        if (strlen(text) == 7 && text[3] == '-' && strncmp(text + 4, dayNames[day], 3) == 0) last = day;
+    }
+    if (first < 0) return 0;
+    if (strlen(text) == 3) return 1 << first;
+    if (last < 0) return 0;
+
+    int mask = 0;
+    for (int day = first; ; day = (day + 1) % 7) { // Ranges may wrap, e.g. SUN-THU or FRI-MON.
+        mask |= 1 << day;
+        if (day == last) break;
+    }
+    return mask;
+}
+
+static bool SessionIntervalStartsBefore(const SessionInterval& a, const SessionInterval& b) {
+    return a.Start < b.Start;
+}
+
+// Reads the session calendar file at 'path' and compiles it into calendar.Intervals for
+// CALENDAR_HORIZON_DAYS days starting the day before 'loadDate'. File format, one rule per line,
+// times in the chart time zone, '#' starts a comment:
+//   WINDOW     <days> <start> <end>      e.g. WINDOW MON-FRI 08:30:00 15:00:00
+//   HOLIDAY    <date>                    e.g. HOLIDAY 2026-12-25
+//   EARLYCLOSE <date> <time>             e.g. EARLYCLOSE 2026-11-27 12:00:00
+//   BLACKOUT   <date> <start> <end>      e.g. BLACKOUT 2026-11-06 08:25:00 08:40:00
+// A window whose end is at or before its start is overnight: it opens on the evening before each of
+// its days and belongs to the day it closes on, as an exchange trading day does, so that day's
+// holiday removes it and its early close cuts it short. An overnight blackout ends the next day.
+// Runs on the calendar loader thread only.
+bool LoadSessionCalendar(const char* path, int loadDate, SessionCalendar& calendar, SCString& errorMessage) {
+    struct WindowRule { int DayMask; int Start; int End; };
+    struct DateRule { int Date; int Start; int End; };
+    WindowRule windows[MAX_CALENDAR_RULES];
+    DateRule holidays[MAX_CALENDAR_RULES];
+    DateRule earlyCloses[MAX_CALENDAR_RULES];
+    DateRule blackouts[MAX_CALENDAR_RULES];
+    int numWindows = 0, numHolidays = 0, numEarlyCloses = 0, numBlackouts = 0;
+
+    calendar.Loaded = true;
+    calendar.LoadFailed = true;
+    calendar.NumIntervals = 0;
+    calendar.CachedFrom = calendar.CachedUntil = 0;
+    calendar.CachedInWindow = false;
+    strncpy(calendar.LoadedPath, path, CALENDAR_PATH_LENGTH - 1);
+    calendar.LoadedPath[CALENDAR_PATH_LENGTH - 1] = '\0';
+
+    FILE* file = (path != NULL && path[0] != '\0') ? fopen(path, "r") : NULL;
+    if (file == NULL) {
+        errorMessage = "file not found or not readable";
+        return false;
+    }
+
+    char line[256];
+    int lineNumber = 0;
+    bool parseError = false;
+    bool tooManyRules = false;
+    while (!parseError && fgets(line, sizeof(line), file) != NULL) {
+        ++lineNumber;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+
+        char keyword[16] = "", field1[32] = "", field2[32] = "", field3[32] = "";
+        int numFields = sscanf(line, "%15s %31s %31s %31s", keyword, field1, field2, field3);
+        if (numFields <= 0)
+            continue; // Blank or comment-only line.
+
+        int* ruleCount = strcmp(keyword, "WINDOW") == 0 ? &numWindows : strcmp(keyword, "HOLIDAY") == 0 ? &numHolidays :
+            strcmp(keyword, "EARLYCLOSE") == 0 ? &numEarlyCloses : strcmp(keyword, "BLACKOUT") == 0 ? &numBlackouts : NULL;
+        if (ruleCount != NULL && *ruleCount >= MAX_CALENDAR_RULES) {
+            tooManyRules = true;
+            break;
+        }
+
+        if (strcmp(keyword, "WINDOW") == 0 && numFields == 4) {
+            WindowRule& rule = windows[numWindows++];
+            rule.DayMask = ParseCalendarDays(field1);
+            rule.Start = ParseCalendarTime(field2);
+            rule.End = ParseCalendarTime(field3);
+            parseError = rule.DayMask == 0 || rule.Start < 0 || rule.Start >= SECONDS_PER_DAY || rule.End < 0 || rule.End == rule.Start;
+        } else if (strcmp(keyword, "HOLIDAY") == 0 && numFields == 2) {
+            DateRule& rule = holidays[numHolidays++];
+            rule.Date = ParseCalendarDate(field1);
+            rule.Start = rule.End = 0;
+            parseError = rule.Date < 0;
+        } else if (strcmp(keyword, "EARLYCLOSE") == 0 && numFields == 3) {
+            DateRule& rule = earlyCloses[numEarlyCloses++];
+            rule.Date = ParseCalendarDate(field1);
+            rule.Start = 0;
+            rule.End = ParseCalendarTime(field2);
+            parseError = rule.Date < 0 || rule.End < 0;
+        } else if (strcmp(keyword, "BLACKOUT") == 0 && numFields == 4) {
+            DateRule& rule = blackouts[numBlackouts++];
+            rule.Date = ParseCalendarDate(field1);
+            rule.Start = ParseCalendarTime(field2);
+            rule.End = ParseCalendarTime(field3);
+            parseError = rule.Date < 0 || rule.Start < 0 || rule.Start >= SECONDS_PER_DAY || rule.End < 0 || rule.End == rule.Start;
+        } else {
+            parseError = true;
+        }
+    }
+    fclose(file);
+
+    if (tooManyRules) {
+        errorMessage.Format("more than %d rules of one kind (line %d)", MAX_CALENDAR_RULES, lineNumber);
+        return false;
+    }
+    if (parseError) {
+        errorMessage.Format("invalid or unsupported rule on line %d", lineNumber);
+        return false;
+    }
+    if (numWindows == 0) {
+        errorMessage = "no WINDOW rules";
+        return false;
+    }
+
+    // Blackouts are applied in time order so a window can be split around several of them.
+    for (int i = 1; i < numBlackouts; ++i) {
+        DateRule rule = blackouts[i];
+        int j = i - 1;
+        for (; j >= 0 && (blackouts[j].Date > rule.Date || (blackouts[j].Date == rule.Date && blackouts[j].Start > rule.Start)); --j)
+            blackouts[j + 1] = blackouts[j];
+        blackouts[j + 1] = rule;
+    }
+
+    // Expand the weekly windows day by day, applying holidays, early closes and blackouts.
+    int firstDate = loadDate - 1;
+    for (int date = firstDate; date < firstDate + CALENDAR_HORIZON_DAYS; ++date) {
+        bool isHoliday = false;
+        for (int i = 0; i < numHolidays; ++i)
+            isHoliday = isHoliday || holidays[i].Date == date;
+        if (isHoliday)
+            continue;
+
+        int closeTime = SECONDS_PER_DAY;
+        for (int i = 0; i < numEarlyCloses; ++i)
+            if (earlyCloses[i].Date == date && earlyCloses[i].End < closeTime)
+                closeTime = earlyCloses[i].End;
+
+        int dayBit = 1 << DayOfWeekFromSierraDate(date);
+        long long dayStart = static_cast<long long>(date) * SECONDS_PER_DAY;
+        for (int w = 0; w < numWindows; ++w) {
+            if ((windows[w].DayMask & dayBit) == 0)
+                continue;
+            bool overnight = windows[w].End <= windows[w].Start;
+            long long start = (overnight ? dayStart - SECONDS_PER_DAY : dayStart) + windows[w].Start;
+            long long end = dayStart + (windows[w].End < closeTime ? windows[w].End : closeTime);
+            if (end <= start)
+                continue;
+
+            // Split the window around each blackout that overlaps it.
+            for (int b = 0; b <= numBlackouts && start < end; ++b) {
+                long long pieceEnd = end;
+                long long nextStart = end;
+                if (b < numBlackouts) {
+                    const DateRule& blackout = blackouts[b];
+                    long long blackoutStart = static_cast<long long>(blackout.Date) * SECONDS_PER_DAY + blackout.Start;
+                    long long blackoutEnd = static_cast<long long>(blackout.Date) * SECONDS_PER_DAY + blackout.End +
+                        (blackout.End <= blackout.Start ? SECONDS_PER_DAY : 0);
+                    if (blackoutEnd <= start || blackoutStart >= end)
+                        continue;
+                    pieceEnd = blackoutStart;
+                    nextStart = blackoutEnd;
+                }
+                if (pieceEnd > start) {
+                    if (calendar.NumIntervals >= MAX_CALENDAR_INTERVALS) {
+                        errorMessage = "too many intervals for the calendar horizon";
+                        return false;
+                    }
+                    SessionInterval& interval = calendar.Intervals[calendar.NumIntervals++];
+                    interval.Start = start;
+                    interval.End = pieceEnd;
+                }
+                start = nextStart;
+            }
+        }
+    }
+
+    // Sort and merge overlapping or adjacent intervals, so a lookup finds at most one match.
+    std::sort(calendar.Intervals, calendar.Intervals + calendar.NumIntervals, SessionIntervalStartsBefore);
+    int merged = 0;
+    for (int i = 0; i < calendar.NumIntervals; ++i) {
+        if (merged > 0 && calendar.Intervals[i].Start <= calendar.Intervals[merged - 1].End) {
+            if (calendar.Intervals[i].End > calendar.Intervals[merged - 1].End)
+                calendar.Intervals[merged - 1].End = calendar.Intervals[i].End;
+        } else {
+            calendar.Intervals[merged++] = calendar.Intervals[i];
+        }
+    }
+    calendar.NumIntervals = merged;
+
+    calendar.HorizonStart = static_cast<long long>(firstDate) * SECONDS_PER_DAY;
+    calendar.HorizonEnd = static_cast<long long>(firstDate + CALENDAR_HORIZON_DAYS) * SECONDS_PER_DAY;
+    calendar.LoadFailed = false;
+    return true;
+}
+
+// Finds the interval state at 'now' and caches it with the boundaries [CachedFrom, CachedUntil)
+// over which it stays valid. O(log n); only called when a cached boundary is crossed.
+void LookupSessionCalendar(SessionCalendar& calendar, long long now) {
+    SessionInterval key = { now, now };
+    // First interval starting after 'now'; the one before it is the only candidate containing 'now'.
+    const SessionInterval* first = calendar.Intervals;
+    const SessionInterval* last = calendar.Intervals + calendar.NumIntervals;
+    const SessionInterval* next = std::upper_bound(first, last, key, SessionIntervalStartsBefore);
+
+    if (next != first && now < (next - 1)->End) {
+        calendar.CachedInWindow = true;
+        calendar.CachedFrom = (next - 1)->Start;
+        calendar.CachedUntil = (next - 1)->End;
+    } else {
+        calendar.CachedInWindow = false;
+        calendar.CachedFrom = (next != first) ? (next - 1)->End : calendar.HorizonStart;
+        calendar.CachedUntil = (next != last) ? next->Start : calendar.HorizonEnd;
+    }
+}
+
+// Loader thread body: compiles the calendar into the spare buffer when the chart date or the file's
+// modification time or size changes, once the study has taken the previously published buffer. A file that
+// fails to load is published too, so the study blocks trading and logs why, and is retried once it changes.
+static void RunSessionCalendarLoader(SessionCalendarLoader* loader) {
+    int spare = 1 - loader->Active;
+    int compiledDate = 0;
+    FileStamp compiledStamp = { -2, -2 }; // Never returned by ReadFileStamp.
+    while (!loader->StopRequested.load(std::memory_order_acquire)) {
+        int loadDate = loader->LoadDate.load(std::memory_order_acquire);
+        FileStamp stamp;
+        ReadFileStamp(loader->Path, stamp);
+        if ((loadDate != compiledDate || !SameFileStamp(stamp, compiledStamp)) &&
+            loader->Published.load(std::memory_order_acquire) < 0) {
+            SessionCalendar& calendar = loader->Buffers[spare];
+            SCString calendarError;
+            if (!LoadSessionCalendar(loader->Path, loadDate, calendar, calendarError))
+                snprintf(calendar.LoadError, sizeof(calendar.LoadError), "%s", calendarError.GetChars());
+            compiledDate = loadDate;
+            compiledStamp = stamp;
+            loader->Published.store(spare, std::memory_order_release);
+            spare = 1 - spare;
+        }
+        for (int waited = 0; waited < 10 && !loader->StopRequested.load(std::memory_order_acquire); waited++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+void StartSessionCalendarLoader(SessionCalendarLoader& loader, const char* path, int loadDate) {
+    snprintf(loader.Path, sizeof(loader.Path), "%s", path);
+    loader.Buffers[loader.Active].Loaded = false; // Nothing is gated until this path has been compiled.
+    loader.Published.store(-1, std::memory_order_release);
+    loader.LoadDate.store(loadDate, std::memory_order_release);
+    loader.StopRequested.store(false, std::memory_order_release);
+    loader.Worker = std::thread(RunSessionCalendarLoader, &loader);
+    loader.Running = true;
+}
+
+void StopSessionCalendarLoader(SessionCalendarLoader& loader) {
+    if (!loader.Running)
+        return;
+    loader.StopRequested.store(true, std::memory_order_release);
+    if (loader.Worker.joinable())
+        loader.Worker.join();
+    loader.Running = false;
+}
+
+// Starts tracking an open trade and precomputes the price at which realized plus open P&L
+// would reach -dailyLossLimit. A limit already used up by realized losses trips immediately.
+void OpenRiskTrade(DailyRiskState& risk, TradeSide side, float entryPrice, float quantity, float dailyLossLimit, float currencyPerPoint) {
+    risk.OpenSide = side;
+    risk.OpenEntryPrice = entryPrice;
+    risk.OpenQuantity = quantity > 0.0f ? quantity : 1.0f;
+    risk.LossTriggerPrice = 0.0f;
+
+    if (dailyLossLimit <= 0.0f)
+        return;
+
+    double remainingLoss = dailyLossLimit + risk.RealizedPnL; // RealizedPnL is negative after losses.
+    if (remainingLoss <= 0.0) {
+        risk.KillReason = KILL_DAILY_LOSS;
+        return;
+    }
+    float triggerDistance = static_cast<float>(remainingLoss / (risk.OpenQuantity * currencyPerPoint));
+    risk.LossTriggerPrice = (side == SIDE_LONG) ? entryPrice - triggerDistance : entryPrice + triggerDistance;
+    if (risk.LossTriggerPrice <= 0.0f) // A long trigger below zero can never be reached.
+        risk.LossTriggerPrice = 0.0f;
+}
+
+// Closes the open trade at 'exitPrice', updates the running counters and returns the trade P&L.
+double CloseRiskTrade(DailyRiskState& risk, float exitPrice, float currencyPerPoint) {
+    if (risk.OpenSide == SIDE_FLAT)
+        return 0.0;
+
+    double pointsPerContract = (risk.OpenSide == SIDE_LONG) ? exitPrice - risk.OpenEntryPrice : risk.OpenEntryPrice - exitPrice;
+    double tradePnL = pointsPerContract * risk.OpenQuantity * currencyPerPoint;
+
+    risk.RealizedPnL += tradePnL;
+    risk.TradesToday++;
+    risk.ConsecutiveLosses = (tradePnL < 0.0) ? risk.ConsecutiveLosses + 1 : 0;
+
+    risk.OpenSide = SIDE_FLAT;
+    risk.LossTriggerPrice = 0.0f;
+    return tradePnL;
+}
+
+// Returns the first daily limit crossed by the running counters, or KILL_NONE. Limits of 0 are disabled.
+KillSwitchReason EvaluateRiskLimits(const DailyRiskState& risk, float dailyLossLimit, int maxConsecutiveLosses, int maxTradesPerDay) {
+    if (risk.KillReason != KILL_NONE) return risk.KillReason;
+    if (dailyLossLimit > 0.0f && risk.RealizedPnL <= -dailyLossLimit) return KILL_DAILY_LOSS;
+    if (maxConsecutiveLosses > 0 && risk.ConsecutiveLosses >= maxConsecutiveLosses) return KILL_CONSECUTIVE_LOSSES;
+    if (maxTradesPerDay > 0 && risk.TradesToday >= maxTradesPerDay) return KILL_MAX_TRADES;
+    return KILL_NONE;
+}
+
+const char* KillSwitchReasonText(KillSwitchReason reason) {
+    switch (reason) {
+        case KILL_DAILY_LOSS:         return "Daily Loss";
+        case KILL_CONSECUTIVE_LOSSES: return "Max Consecutive Losses";
+        case KILL_MAX_TRADES:         return "Max Trades Per Day";
+        default:                      return "None";
+    }
+}
+
+// Monotonic wall-clock seconds for the rate limiter (unaffected by chart replay or time zone).
+double SteadyClockSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Monotonic nanoseconds for latency measurements.
+long long SteadyClockNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Applies the configured limits and refills both buckets for the time elapsed since the last call.
+// A limit of 0 disables that bucket (it always has tokens).
+void ConfigureOrderRateLimiter(OrderRateLimiter& limiter, int maxPerSecond, int maxPerMinute) {
+    double now = SteadyClockSeconds();
+    double elapsed = (limiter.LastRefillTime > 0.0) ? now - limiter.LastRefillTime : 0.0;
+    limiter.LastRefillTime = now;
+
+    TokenBucket* buckets[2] = { &limiter.PerSecond, &limiter.PerMinute };
+    double capacities[2] = { static_cast<double>(maxPerSecond), static_cast<double>(maxPerMinute) };
+    double periods[2] = { 1.0, 60.0 };
+    for (int i = 0; i < 2; ++i) {
+        TokenBucket& bucket = *buckets[i];
+        if (capacities[i] <= 0.0) {
+            bucket.Capacity = 0.0; // Disabled.
+            continue;
+        }
+        if (bucket.Capacity != capacities[i]) { // First use or limit changed: start full.
+            bucket.Capacity = capacities[i];
+            bucket.Tokens = capacities[i];
+        }
+        bucket.RefillPerSecond = capacities[i] / periods[i];
+        bucket.Tokens += elapsed * bucket.RefillPerSecond;
+        if (bucket.Tokens > bucket.Capacity)
+            bucket.Tokens = bucket.Capacity;
+    }
+}
+
+// Takes 'cost' tokens from both buckets if both have them. Counts the action as sent or deferred.
+bool AcquireOrderTokens(OrderRateLimiter& limiter, int cost) {
+    bool perSecondOK = limiter.PerSecond.Capacity <= 0.0 || limiter.PerSecond.Tokens >= cost;
+    bool perMinuteOK = limiter.PerMinute.Capacity <= 0.0 || limiter.PerMinute.Tokens >= cost;
+    if (!perSecondOK || !perMinuteOK) {
+        limiter.ActionsDeferred++;
+        return false;
+    }
+    ForceOrderTokens(limiter, cost);
+    return true;
+}
+
+// Takes 'cost' tokens even if that drives the buckets negative. Used for flattens, which are never
+// delayed; the debt throttles the actions that follow.
+void ForceOrderTokens(OrderRateLimiter& limiter, int cost) {
+    if (limiter.PerSecond.Capacity > 0.0) limiter.PerSecond.Tokens -= cost;
+    if (limiter.PerMinute.Capacity > 0.0) limiter.PerMinute.Tokens -= cost;
+    limiter.ActionsSent += cost;
+}
+
+// Appends a pending action, or returns false if the queue is full.
+static bool EnqueuePendingOrderAction(OrderRateLimiter& limiter, const PendingOrderAction& action) {
+    if (limiter.NumPending >= MAX_PENDING_ORDER_ACTIONS)
+        return false;
+    limiter.Pending[limiter.NumPending++] = action;
+    return true;
+}
+
+static void RemovePendingOrderAction(OrderRateLimiter& limiter, int index) {
+    for (int i = index + 1; i < limiter.NumPending; ++i)
+        limiter.Pending[i - 1] = limiter.Pending[i];
+    limiter.NumPending--;
+}
+
+// Sends a cancel and records its send time for the acknowledgement latency.
+static void SendCancel(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, int orderID) {
+    long long sentNs = SteadyClockNanoseconds();
+    sc.CancelOrder(orderID);
+    ExpectAcknowledgement(limiter, ACK_CANCEL, orderID, sentNs);
+}
+
+// Cancels 'orderID' now, or queues the cancel until tokens are available. Duplicate cancels coalesce.
+void LimitedCancelOrder(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, int orderID) {
+    if (orderID == 0)
+        return;
+    for (int i = 0; i < limiter.NumPending; ++i) {
+        const PendingOrderAction& pending = limiter.Pending[i];
+        if ((pending.Type == PENDING_CANCEL_ORDER && pending.BuyOrderID == orderID) ||
+            (pending.Type == PENDING_CANCEL_BRACKET && (pending.BuyOrderID == orderID || pending.SellOrderID == orderID))) {
+            limiter.ActionsCoalesced++;
+            return;
+        }
+    }
+    if (AcquireOrderTokens(limiter, ORDER_COST_SINGLE)) {
+        SendCancel(sc, limiter, orderID);
+        return;
+    }
+    PendingOrderAction action = { PENDING_CANCEL_ORDER, orderID, 0, 0.0f, { 0.0f }, 0, 0.0f };
+    if (!EnqueuePendingOrderAction(limiter, action)) { // Queue full: a cancel is never dropped.
+        ForceOrderTokens(limiter, ORDER_COST_SINGLE);
+        SendCancel(sc, limiter, orderID);
+    }
+}
+
+// Cancels both legs of a bracket now, or queues the cancel as one bracket action so that a later
+// submission can turn it into a requote by modify.
+void LimitedCancelBracket(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, int buyOrderID, int sellOrderID, const ArmedBracketInfo& bracket) {
+    if (buyOrderID == 0 || sellOrderID == 0) { // One-sided bracket: plain cancels.
+        LimitedCancelOrder(sc, limiter, buyOrderID);
+        LimitedCancelOrder(sc, limiter, sellOrderID);
+        return;
+    }
+    if (AcquireOrderTokens(limiter, 2 * ORDER_COST_SINGLE)) {
+        SendCancel(sc, limiter, buyOrderID);
+        SendCancel(sc, limiter, sellOrderID);
+        return;
+    }
+    PendingOrderAction action = { PENDING_CANCEL_BRACKET, buyOrderID, sellOrderID, bracket.StopOffset, { 0.0f }, bracket.NumTargets, bracket.Quantity };
+    for (int target = 0; target < MAX_SCALE_OUT_TARGETS; target++)
+        action.TargetOffsets[target] = bracket.TargetOffsets[target];
+    if (!EnqueuePendingOrderAction(limiter, action)) {
+        ForceOrderTokens(limiter, 2 * ORDER_COST_SINGLE);
+        SendCancel(sc, limiter, buyOrderID);
+        SendCancel(sc, limiter, sellOrderID);
+    }
+}
+
+// Collects the parent orders this study instance owns: the main bracket legs, the filled entry and
+// the ladder legs. Their attached stops and targets are found through ParentInternalOrderID.
+static int CollectOwnedParentOrders(SCStudyInterfaceRef& sc, const BotRuntimeState& runtimeState, int* orderIDs) {
+    int count = 0;
+    orderIDs[count++] = sc.GetPersistentInt(PID_PARENT_BUY_LIMIT_ORDER_ID);
+    orderIDs[count++] = sc.GetPersistentInt(PID_PARENT_SELL_LIMIT_ORDER_ID);
+    orderIDs[count++] = sc.GetPersistentInt(PID_ACTIVE_FILLED_PARENT_ORDER_ID);
+    orderIDs[count++] = runtimeState.Fills.EntryOrderID;
+    for (int i = 0; i < MAX_LADDER_LEVELS; i++) {
+        orderIDs[count++] = runtimeState.Ladder.Levels[i].BuyOrderID;
+        orderIDs[count++] = runtimeState.Ladder.Levels[i].SellOrderID;
+    }
+    return count;
+}
+
+// Flattens the position immediately. Flattens are never deferred; they consume tokens even into debt.
+// With cancelOwnOrders, the working orders of this study instance (bracket and ladder legs with their
+// attached orders, orders submitted for the external process, and any order with a queued cancel) are
+// cancelled first in the same way, in one pass over the order list. Orders of other studies and manual orders on the symbol are left alone.
+void LimitedFlatten(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, bool cancelOwnOrders) {
+    OrderRateLimiter& limiter = runtimeState.RateLimiter;
+    if (cancelOwnOrders) {
+        int ownedIDs[4 + 2 * MAX_LADDER_LEVELS];
+        int numOwned = CollectOwnedParentOrders(sc, runtimeState, ownedIDs);
+        s_SCTradeOrder order;
+        for (int index = 0; sc.GetOrderByIndex(index, order) != SCTRADING_ORDER_ERROR; ++index) {
+            if (!IsWorkingOrderStatus(order.OrderStatusCode))
+                continue;
+            bool owned = false;
+            for (int i = 0; i < numOwned && !owned; ++i)
+                owned = ownedIDs[i] != 0 && (order.InternalOrderID == ownedIDs[i] || order.ParentInternalOrderID == ownedIDs[i]);
+            for (int i = 0; i < limiter.NumPending && !owned; ++i)
+                owned = limiter.Pending[i].BuyOrderID == order.InternalOrderID ||
+                    (limiter.Pending[i].Type == PENDING_CANCEL_BRACKET && limiter.Pending[i].SellOrderID == order.InternalOrderID);
+            for (int i = 0; i < runtimeState.Bus.NumOrders && !owned; ++i)
+                owned = runtimeState.Bus.Orders[i].OrderID == order.InternalOrderID;
+            if (!owned)
+                continue;
+            ForceOrderTokens(limiter, ORDER_COST_SINGLE);
+            SendCancel(sc, limiter, order.InternalOrderID);
+        }
+        limiter.ActionsCoalesced += limiter.NumPending; // Sent above, or their orders are already final.
+        limiter.NumPending = 0;
+    }
+    ForceOrderTokens(limiter, ORDER_COST_SINGLE);
+    s_SCPositionData position;
+    sc.GetTradePosition(position);
+    if (position.PositionQuantity != 0) // Flattening a flat position measures nothing.
+        ExpectAcknowledgement(limiter, ACK_FLATTEN, 0, SteadyClockNanoseconds());
+    sc.FlattenPosition();
+}
+
+// Returns the index of a queued bracket cancel, or -1.
+int FindPendingBracketCancel(const OrderRateLimiter& limiter) {
+    for (int i = 0; i < limiter.NumPending; ++i)
+        if (limiter.Pending[i].Type == PENDING_CANCEL_BRACKET)
+            return i;
+    return -1;
+}
+
+// Turns the queued bracket cancel at 'pendingIndex' plus a new submission into modifies of the
+// still-working legs. If a leg is no longer working, the queued cancel is left in place and
+// REQUOTE_NOT_POSSIBLE is returned so the caller submits a fresh bracket.
+int RequoteBracketByModify(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, int pendingIndex, float buyPrice, float sellPrice) {
+    const PendingOrderAction& pending = limiter.Pending[pendingIndex];
+    s_SCTradeOrder buyLeg, sellLeg;
+    if (sc.GetOrderByOrderID(pending.BuyOrderID, buyLeg) == SCTRADING_ORDER_ERROR || buyLeg.OrderStatusCode != SCT_OSC_OPEN ||
+        sc.GetOrderByOrderID(pending.SellOrderID, sellLeg) == SCTRADING_ORDER_ERROR || sellLeg.OrderStatusCode != SCT_OSC_OPEN)
+        return REQUOTE_NOT_POSSIBLE;
+
+    if (!AcquireOrderTokens(limiter, 2 * ORDER_COST_SINGLE))
+        return REQUOTE_DEFERRED;
+
+    s_SCNewOrder modifyOrder;
+    modifyOrder.InternalOrderID = pending.BuyOrderID;
+    modifyOrder.Price1 = buyPrice;
+    sc.ModifyOrder(modifyOrder);
+
+    s_SCNewOrder modifyOrder2;
+    modifyOrder2.InternalOrderID = pending.SellOrderID;
+    modifyOrder2.Price1 = sellPrice;
+    sc.ModifyOrder(modifyOrder2);
+
+    RemovePendingOrderAction(limiter, pendingIndex);
+    limiter.ActionsCoalesced++;
+    return REQUOTE_DONE;
+}
+
+// Sends queued actions in order while tokens are available. Returns the ID of a bracket leg found
+// FILLED while its cancel was queued (the caller must deal with the untracked position), else 0.
+int DrainPendingOrderActions(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter) {
+    int filledLegID = 0;
+    while (limiter.NumPending > 0) {
+        const PendingOrderAction& pending = limiter.Pending[0];
+        int cost = (pending.Type == PENDING_CANCEL_BRACKET) ? 2 * ORDER_COST_SINGLE : ORDER_COST_SINGLE;
+        bool perSecondOK = limiter.PerSecond.Capacity <= 0.0 || limiter.PerSecond.Tokens >= cost;
+        bool perMinuteOK = limiter.PerMinute.Capacity <= 0.0 || limiter.PerMinute.Tokens >= cost;
+        if (!perSecondOK || !perMinuteOK)
+            break; // Still throttled; already counted as deferred when queued.
+
+        ForceOrderTokens(limiter, cost);
+        int orderIDs[2] = { pending.BuyOrderID, pending.Type == PENDING_CANCEL_BRACKET ? pending.SellOrderID : 0 };
+        for (int i = 0; i < 2; ++i) {
+            if (orderIDs[i] == 0)
+                continue;
+            s_SCTradeOrder order;
+            if (sc.GetOrderByOrderID(orderIDs[i], order) != SCTRADING_ORDER_ERROR && order.OrderStatusCode == SCT_OSC_FILLED)
+                filledLegID = orderIDs[i];
+            SendCancel(sc, limiter, orderIDs[i]);
+        }
+        RemovePendingOrderAction(limiter, 0);
+    }
+    return filledLegID;
+}
+
+// Records an order action to be timed until its acknowledgement. A second action of the same type
+// on the same order keeps the first send time.
+void ExpectAcknowledgement(OrderRateLimiter& limiter, AckAction action, int orderID, long long sentNs) {
+    if (orderID < 0 || (orderID == 0 && action != ACK_FLATTEN))
+        return;
+    for (int i = 0; i < limiter.NumAcks; ++i)
+        if (limiter.Acks[i].OrderID == orderID && limiter.Acks[i].Action == action)
+            return;
+    int slot = limiter.NumAcks;
+    if (slot >= MAX_PENDING_ACKS) {
+        // The oldest entry makes room; it is the one most likely to never be acknowledged. Entries are
+        // not in send order (acknowledged ones are swapped out), so it is found by its send time.
+        slot = 0;
+        for (int i = 1; i < limiter.NumAcks; ++i)
+            if (limiter.Acks[i].SentNs < limiter.Acks[slot].SentNs)
+                slot = i;
+    } else {
+        limiter.NumAcks++;
+    }
+    PendingAck& ack = limiter.Acks[slot];
+    ack.OrderID = orderID;
+    ack.Action = action;
+    ack.SentNs = sentNs;
+}
+
+// Whether 'status' answers 'action': a submit is acknowledged once it leaves the sent and pending
+// states, a cancel once the order reaches a final state.
+static bool IsAcknowledgedStatus(AckAction action, int status) {
+    if (action == ACK_SUBMIT)
+        return status == SCT_OSC_OPEN || status == SCT_OSC_FILLED || status == SCT_OSC_CANCELED || status == SCT_OSC_ERROR;
+    return status == SCT_OSC_FILLED || status == SCT_OSC_CANCELED || status == SCT_OSC_ERROR;
+}
+
+// Looks up each action awaiting acknowledgement: one order lookup per submit or cancel, one position
+// read for a flatten. Acknowledged actions are sampled into their histogram; actions whose order is
+// gone or that exceed ACK_TIMEOUT_SECONDS are dropped. Returns a bit per AckAction that got a sample.
+unsigned int PollAcknowledgements(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, AckLatencyStats& stats) {
+    long long nowNs = SteadyClockNanoseconds();
+    unsigned int sampledActions = 0;
+    s_SCTradeOrder order;
+    for (int i = 0; i < limiter.NumAcks; ) {
+        const PendingAck& ack = limiter.Acks[i];
+        bool acknowledged;
+        bool lost = false;
+        if (ack.Action == ACK_FLATTEN) {
+            s_SCPositionData position;
+            sc.GetTradePosition(position);
+            acknowledged = position.PositionQuantity == 0;
+        } else {
+            int status = GetOrderStatusByID(sc, ack.OrderID, order);
+            acknowledged = IsAcknowledgedStatus(ack.Action, status);
+            lost = status == SCT_OSC_UNSPECIFIED;
+        }
+        if (acknowledged) {
+            long long latencyNs = nowNs - ack.SentNs;
+            RecordLatencySample(stats.Histograms[ack.Action], latencyNs);
+            if (latencyNs > stats.MaxNs[ack.Action])
+                stats.MaxNs[ack.Action] = latencyNs;
+            stats.SumNs[ack.Action] += static_cast<double>(latencyNs);
+            sampledActions |= 1u << ack.Action;
+        } else if (!lost && nowNs - ack.SentNs < ACK_TIMEOUT_SECONDS * 1000000000LL) {
+            i++;
+            continue;
+        } else {
+            stats.Timeouts[ack.Action]++;
+        }
+        limiter.Acks[i] = limiter.Acks[--limiter.NumAcks];
+    }
+
+    static const double Percentiles[3] = { 50.0, 99.0, 99.9 };
+    for (int action = 0; action < NUM_ACK_ACTIONS; action++) {
+        if ((sampledActions & (1u << action)) == 0)
+            continue;
+        for (int quantile = 0; quantile < 3; quantile++) {
+            long long value = LatencyHistogramPercentile(stats.Histograms[action], Percentiles[quantile]);
+            stats.PercentilesNs[action][quantile] = value < stats.MaxNs[action] ? value : stats.MaxNs[action];
+        }
+    }
+    return sampledActions;
+}
+
+// Builds the invariant part of the bracket orders: type, quantity and attached order types.
+void BuildBracketOrderTemplates(OrderTemplateState& templates, int quantity, int stopOrderType, int numTargets) {
+    s_SCNewOrder& oco = templates.OCOTemplate;
+    oco = s_SCNewOrder();
+    oco.OrderQuantity = quantity;
+    oco.OrderType = SCT_ORDERTYPE_OCO_BUY_LIMIT_SELL_LIMIT;
+    oco.AttachedOrderTarget1Type = SCT_ORDERTYPE_LIMIT; // Target is a Limit order.
+    oco.AttachedOrderStop1Type = stopOrderType;         // Stop Market, or Trailing Stop for trailing exits.
+    oco.AttachedOrderTarget2Type = SCT_ORDERTYPE_LIMIT;
+    oco.AttachedOrderStop2Type = stopOrderType;
+    templates.LadderTemplate = oco;
+    if (numTargets > 1)
+        ApplyScaleOutGroups(oco, quantity, stopOrderType, numTargets);
+
+    s_SCNewOrder& single = templates.SingleTemplate;
+    single = oco;
+    single.OrderType = SCT_ORDERTYPE_LIMIT;
+
+    templates.BuiltForQuantity = quantity;
+    templates.BuiltForTargets = numTargets;
+}
+
+// Attached order fields of each OCO group, indexed by group. The second set is for the sell leg of an OCO.
+static double s_SCNewOrder::* const StopOffsetFields[MAX_SCALE_OUT_TARGETS] =
+    { &s_SCNewOrder::Stop1Offset, &s_SCNewOrder::Stop2Offset, &s_SCNewOrder::Stop3Offset, &s_SCNewOrder::Stop4Offset };
+static double s_SCNewOrder::* const TargetOffsetFields[MAX_SCALE_OUT_TARGETS] =
+    { &s_SCNewOrder::Target1Offset, &s_SCNewOrder::Target2Offset, &s_SCNewOrder::Target3Offset, &s_SCNewOrder::Target4Offset };
+static double s_SCNewOrder::* const StopOffsetFields2[MAX_SCALE_OUT_TARGETS] =
+    { &s_SCNewOrder::Stop1Offset_2, &s_SCNewOrder::Stop2Offset_2, &s_SCNewOrder::Stop3Offset_2, &s_SCNewOrder::Stop4Offset_2 };
+static double s_SCNewOrder::* const TargetOffsetFields2[MAX_SCALE_OUT_TARGETS] =
+    { &s_SCNewOrder::Target1Offset_2, &s_SCNewOrder::Target2Offset_2, &s_SCNewOrder::Target3Offset_2, &s_SCNewOrder::Target4Offset_2 };
+static int s_SCNewOrder::* const StopIDFields[MAX_SCALE_OUT_TARGETS] =
+    { &s_SCNewOrder::Stop1InternalOrderID, &s_SCNewOrder::Stop2InternalOrderID, &s_SCNewOrder::Stop3InternalOrderID, &s_SCNewOrder::Stop4InternalOrderID };
+static int s_SCNewOrder::* const TargetIDFields[MAX_SCALE_OUT_TARGETS] =
+    { &s_SCNewOrder::Target1InternalOrderID, &s_SCNewOrder::Target2InternalOrderID, &s_SCNewOrder::Target3InternalOrderID, &s_SCNewOrder::Target4InternalOrderID };
+static int s_SCNewOrder::* const StopIDFields2[MAX_SCALE_OUT_TARGETS] =
+    { &s_SCNewOrder::Stop1InternalOrderID_2, &s_SCNewOrder::Stop2InternalOrderID_2, &s_SCNewOrder::Stop3InternalOrderID_2, &s_SCNewOrder::Stop4InternalOrderID_2 };
+static int s_SCNewOrder::* const TargetIDFields2[MAX_SCALE_OUT_TARGETS] =
+    { &s_SCNewOrder::Target1InternalOrderID_2, &s_SCNewOrder::Target2InternalOrderID_2, &s_SCNewOrder::Target3InternalOrderID_2, &s_SCNewOrder::Target4InternalOrderID_2 };
+
+// Sets up 'numTargets' attached OCO groups, each a stop and a target, and splits 'quantity' between
+// them as evenly as possible (the first groups take the extra contracts).
+void ApplyScaleOutGroups(s_SCNewOrder& order, int quantity, int stopOrderType, int numTargets) {
+    int* const targetTypes[MAX_SCALE_OUT_TARGETS] = { &order.AttachedOrderTarget1Type, &order.AttachedOrderTarget2Type, &order.AttachedOrderTarget3Type, &order.AttachedOrderTarget4Type };
+    int* const stopTypes[MAX_SCALE_OUT_TARGETS] = { &order.AttachedOrderStop1Type, &order.AttachedOrderStop2Type, &order.AttachedOrderStop3Type, &order.AttachedOrderStop4Type };
+    double* const groupQuantities[MAX_SCALE_OUT_TARGETS] = { &order.OCOGroup1Quantity, &order.OCOGroup2Quantity, &order.OCOGroup3Quantity, &order.OCOGroup4Quantity };
+    for (int group = 0; group < MAX_SCALE_OUT_TARGETS; group++) {
+        bool used = group < numTargets;
+        *targetTypes[group] = used ? SCT_ORDERTYPE_LIMIT : 0;
+        *stopTypes[group] = used ? stopOrderType : 0;
+        *groupQuantities[group] = used ? quantity / numTargets + (group < quantity % numTargets ? 1 : 0) : 0;
+    }
+}
+
+// Patches the per-submission fields of a template: prices, attached offsets of each group for both
+// legs, and the order IDs written back by the previous submission. Every group shares the stop offset.
+void PatchBracketOrder(s_SCNewOrder& order, float price1, float price2, float stopOffset, const float* targetOffsets, int numTargets) {
+    order.Price1 = price1;
+    order.Price2 = price2;
+    for (int group = 0; group < numTargets; group++) {
+        order.*StopOffsetFields[group] = stopOffset;
+        order.*TargetOffsetFields[group] = targetOffsets[group];
+        order.*StopOffsetFields2[group] = stopOffset;
+        order.*TargetOffsetFields2[group] = targetOffsets[group];
+    }
+
+    order.InternalOrderID = 0;
+    order.InternalOrderID2 = 0;
+    for (int group = 0; group < MAX_SCALE_OUT_TARGETS; group++) {
+        order.*StopIDFields[group] = 0;
+        order.*TargetIDFields[group] = 0;
+        order.*StopIDFields2[group] = 0;
+        order.*TargetIDFields2[group] = 0;
+    }
+}
+
+// Copies the attached order IDs written back by a submission into 'bracket'. A single sell order
+// reports its attached orders in the first leg fields.
+void StoreAttachedOrderIDs(const s_SCNewOrder& order, ArmedBracketInfo& bracket, int numTargets, BracketSides sides) {
+    bracket.NumTargets = numTargets;
+    for (int group = 0; group < MAX_SCALE_OUT_TARGETS; group++) {
+        bool used = group < numTargets;
+        bracket.BuyStopIDs[group] = (used && sides != ARM_SELL_SIDE_ONLY) ? order.*StopIDFields[group] : 0;
+        bracket.BuyTargetIDs[group] = (used && sides != ARM_SELL_SIDE_ONLY) ? order.*TargetIDFields[group] : 0;
+        if (sides == ARM_SELL_SIDE_ONLY) {
+            bracket.SellStopIDs[group] = used ? order.*StopIDFields[group] : 0;
+            bracket.SellTargetIDs[group] = used ? order.*TargetIDFields[group] : 0;
+        } else {
+            bracket.SellStopIDs[group] = (used && sides == ARM_BOTH_SIDES) ? order.*StopIDFields2[group] : 0;
+            bracket.SellTargetIDs[group] = (used && sides == ARM_BOTH_SIDES) ? order.*TargetIDFields2[group] : 0;
+        }
+    }
+}
+
+// Bucket of a latency sample: exact below 16 ns, then 8 sub-buckets per power of two.
+static int LatencyBucketIndex(unsigned long long nanoseconds) {
+    if (nanoseconds < 2 * LATENCY_HISTOGRAM_SUB_BUCKETS)
+        return static_cast<int>(nanoseconds);
+#if defined(_MSC_VER)
+    unsigned long highestBit;
+    _BitScanReverse64(&highestBit, nanoseconds);
+#else
+    int highestBit = 63 - __builtin_clzll(nanoseconds);
+#endif
+    int shift = static_cast<int>(highestBit) - 3;
+    return shift * LATENCY_HISTOGRAM_SUB_BUCKETS + static_cast<int>(nanoseconds >> shift);
+}
+
+// Highest value that falls in 'index', so percentiles are never under-reported.
+static long long LatencyBucketUpperBound(int index) {
+    if (index < LATENCY_HISTOGRAM_SUB_BUCKETS)
+        return index;
+    int shift = index / LATENCY_HISTOGRAM_SUB_BUCKETS - 1;
+    long long mantissa = index % LATENCY_HISTOGRAM_SUB_BUCKETS + LATENCY_HISTOGRAM_SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void RecordLatencySample(LatencyHistogram& histogram, long long nanoseconds) {
+    if (nanoseconds < 0)
+        nanoseconds = 0;
+    histogram.Counts[LatencyBucketIndex(static_cast<unsigned long long>(nanoseconds))]++;
+    histogram.TotalCount++;
+}
+
+// Value at 'percentile' (0-100), as the upper bound of the bucket holding it. 0 if empty.
+long long LatencyHistogramPercentile(const LatencyHistogram& histogram, double percentile) {
+    if (histogram.TotalCount == 0)
+        return 0;
+    long long rank = static_cast<long long>(percentile / 100.0 * histogram.TotalCount + 0.5);
+    if (rank < 1) rank = 1;
+    long long seen = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram.Counts[i];
+        if (seen >= rank)
+            return LatencyBucketUpperBound(i);
+    }
+    return LatencyBucketUpperBound(LATENCY_HISTOGRAM_BUCKETS - 1);
+}
+
+void RecordProfilePhase(PhaseProfiler& profiler, ProfilePhase phase, long long nanoseconds) {
+    PhaseTimingStats& stats = profiler.Phases[phase];
+    if (stats.Histogram.TotalCount == 0 || nanoseconds < stats.MinNs)
+        stats.MinNs = nanoseconds;
+    if (nanoseconds > stats.MaxNs)
+        stats.MaxNs = nanoseconds;
+    stats.SumNs += static_cast<double>(nanoseconds);
+    RecordLatencySample(stats.Histogram, nanoseconds);
+}
+
+void ResetPhaseProfiler(PhaseProfiler& profiler, int barIndex) {
+    bool enabled = profiler.Enabled;
+    profiler = PhaseProfiler();
+    profiler.Enabled = enabled;
+    profiler.BarIndex = barIndex;
+}
+
+// Writes min/mean/max/p99 of one phase, in microseconds, at 'barIndex'. Nothing if the phase has no samples.
+void PublishProfilePhase(const PhaseProfiler& profiler, ProfilePhase phase, int barIndex,
+    SCSubgraphRef minSubgraph, SCSubgraphRef meanSubgraph, SCSubgraphRef maxSubgraph, SCSubgraphRef p99Subgraph) {
+    const PhaseTimingStats& stats = profiler.Phases[phase];
+    if (stats.Histogram.TotalCount == 0)
+        return;
+    long long p99 = LatencyHistogramPercentile(stats.Histogram, 99.0);
+    if (p99 > stats.MaxNs)
+        p99 = stats.MaxNs;
+    minSubgraph[barIndex] = static_cast<float>(stats.MinNs / 1000.0);
+    meanSubgraph[barIndex] = static_cast<float>(stats.SumNs / stats.Histogram.TotalCount / 1000.0);
+    maxSubgraph[barIndex] = static_cast<float>(stats.MaxNs / 1000.0);
+    p99Subgraph[barIndex] = static_cast<float>(p99 / 1000.0);
+}
+
+void ObserveMetricsLatency(MetricsLatencyHistogram& histogram, long long nanoseconds) {
+    int bucket = 0;
+    while (bucket < METRICS_LATENCY_BUCKETS && nanoseconds > MetricsLatencyBucketBoundsNs[bucket])
+        bucket++;
+    histogram.Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram.SumNs.fetch_add(nanoseconds, std::memory_order_relaxed);
+    histogram.Count.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void WriteMetricsCounter(FILE* file, const char* name, const char* help, const char* labels, long long value) {
+    fprintf(file, "# HELP %s %s\n# TYPE %s counter\n%s{%s} %lld\n", name, help, name, name, labels, value);
+}
+
+static void WriteMetricsGauge(FILE* file, const char* name, const char* help, const char* labels, double value) {
+    fprintf(file, "# HELP %s %s\n# TYPE %s gauge\n%s{%s} %.10g\n", name, help, name, name, labels, value);
+}
+
+// Prometheus histograms are cumulative: each bucket counts every observation at or below its bound.
+static void WriteMetricsHistogram(FILE* file, const char* name, const char* help, const char* labels, const MetricsLatencyHistogram& histogram) {
+    fprintf(file, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    long long cumulative = 0;
+    for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++) {
+        cumulative += histogram.Buckets[i].load(std::memory_order_relaxed);
+        fprintf(file, "%s_bucket{%s,le=\"%g\"} %lld\n", name, labels, MetricsLatencyBucketBoundsNs[i] / 1e9, cumulative);
+    }
+    cumulative += histogram.Buckets[METRICS_LATENCY_BUCKETS].load(std::memory_order_relaxed);
+    fprintf(file, "%s_bucket{%s,le=\"+Inf\"} %lld\n", name, labels, cumulative);
+    fprintf(file, "%s_sum{%s} %.9f\n", name, labels, histogram.SumNs.load(std::memory_order_relaxed) / 1e9);
+    fprintf(file, "%s_count{%s} %lld\n", name, labels, cumulative);
+}
+
+// Acknowledgement latency as a Prometheus summary per action type.
+static void WriteMetricsAckLatency(FILE* file, const char* labels, const MetricsExporter& metrics) {
+    static const char* const ActionNames[NUM_ACK_ACTIONS] = { "submit", "cancel", "flatten" };
+    static const char* const QuantileNames[3] = { "0.5", "0.99", "0.999" };
+    fprintf(file, "# HELP scalping_bot_ack_latency_seconds Order action sent to acknowledged (working, cancelled or flat).\n# TYPE scalping_bot_ack_latency_seconds summary\n");
+    for (int action = 0; action < NUM_ACK_ACTIONS; action++) {
+        for (int quantile = 0; quantile < 3; quantile++)
+            fprintf(file, "scalping_bot_ack_latency_seconds{%s,action=\"%s\",quantile=\"%s\"} %.9f\n", labels, ActionNames[action],
+                QuantileNames[quantile], metrics.AckLatencySeconds[action][quantile].load(std::memory_order_relaxed));
+        fprintf(file, "scalping_bot_ack_latency_seconds_sum{%s,action=\"%s\"} %.9f\n", labels, ActionNames[action],
+            metrics.AckLatencySumSeconds[action].load(std::memory_order_relaxed));
+        fprintf(file, "scalping_bot_ack_latency_seconds_count{%s,action=\"%s\"} %lld\n", labels, ActionNames[action],
+            metrics.AckLatencyCount[action].load(std::memory_order_relaxed));
+    }
+}
+
+// Writes the metrics to a temporary file and renames it over the target, so a scraper never reads
+// a partial file.
+static bool WriteMetricsFile(const MetricsExporter& metrics) {
+    char tempPath[METRICS_PATH_LENGTH + 8];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", metrics.Path);
+    FILE* file = fopen(tempPath, "w");
+    if (file == NULL)
+        return false;
+
+    const char* labels = metrics.Labels;
+    WriteMetricsCounter(file, "scalping_bot_brackets_submitted_total", "Entry brackets submitted.", labels, metrics.BracketsSubmitted.load(std::memory_order_relaxed));
+    fprintf(file, "# HELP scalping_bot_entry_fills_total Entry fills by side.\n# TYPE scalping_bot_entry_fills_total counter\n");
+    fprintf(file, "scalping_bot_entry_fills_total{%s,side=\"buy\"} %lld\n", labels, metrics.EntryFillsBuy.load(std::memory_order_relaxed));
+    fprintf(file, "scalping_bot_entry_fills_total{%s,side=\"sell\"} %lld\n", labels, metrics.EntryFillsSell.load(std::memory_order_relaxed));
+    fprintf(file, "# HELP scalping_bot_exits_total Trade exits by attached order type.\n# TYPE scalping_bot_exits_total counter\n");
+    fprintf(file, "scalping_bot_exits_total{%s,exit=\"stop\"} %lld\n", labels, metrics.StopExits.load(std::memory_order_relaxed));
+    fprintf(file, "scalping_bot_exits_total{%s,exit=\"target\"} %lld\n", labels, metrics.TargetExits.load(std::memory_order_relaxed));
+    WriteMetricsCounter(file, "scalping_bot_safety_flattens_total", "Positions flattened because protection was lost or untracked.", labels, metrics.SafetyFlattens.load(std::memory_order_relaxed));
+    WriteMetricsCounter(file, "scalping_bot_requotes_total", "Brackets moved by modify instead of cancel and resubmit.", labels, metrics.Requotes.load(std::memory_order_relaxed));
+    WriteMetricsGauge(file, "scalping_bot_range_r", "Current dynamic range R.", labels, metrics.RangeR.load(std::memory_order_relaxed));
+    WriteMetricsGauge(file, "scalping_bot_daily_realized_pnl", "Realized P&L for the current trading day.", labels, metrics.DailyRealizedPnL.load(std::memory_order_relaxed));
+    WriteMetricsGauge(file, "scalping_bot_position_side", "0 flat, 1 long, 2 short.", labels, metrics.PositionSide.load(std::memory_order_relaxed));
+    WriteMetricsHistogram(file, "scalping_bot_tick_latency_seconds", "Duration of the study call on the last bar.", labels, metrics.TickLatency);
+    WriteMetricsHistogram(file, "scalping_bot_tick_to_submit_seconds", "Start of the study call to bracket submission.", labels, metrics.TickToSubmit);
+    WriteMetricsAckLatency(file, labels, metrics);
+
+    bool written = (ferror(file) == 0);
+    if (fclose(file) != 0)
+        written = false;
+    if (!written) {
+        remove(tempPath);
+        return false;
+    }
+    return ReplaceFileAtomically(tempPath, metrics.Path);
+}
+
+// Writer thread body: write, then sleep in short steps so a stop request is honored quickly.
+static void RunMetricsWriter(MetricsExporter* metrics) {
+    while (!metrics->StopRequested.load(std::memory_order_acquire)) {
+        WriteMetricsFile(*metrics);
+        for (int waited = 0; waited < metrics->IntervalSeconds * 10 && !metrics->StopRequested.load(std::memory_order_acquire); waited++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    WriteMetricsFile(*metrics); // Final values on shutdown.
+}
+
+void StartMetricsExporter(MetricsExporter& metrics, const char* path, const char* labels, int intervalSeconds) {
+    snprintf(metrics.Path, sizeof(metrics.Path), "%s", path);
+    snprintf(metrics.Labels, sizeof(metrics.Labels), "%s", labels);
+    metrics.IntervalSeconds = intervalSeconds > 0 ? intervalSeconds : 1;
+    metrics.StopRequested.store(false, std::memory_order_release);
+    metrics.Writer = std::thread(RunMetricsWriter, &metrics);
+    metrics.Running = true;
+}
+
+void StopMetricsExporter(MetricsExporter& metrics) {
+    if (!metrics.Running)
+        return;
+    metrics.StopRequested.store(true, std::memory_order_release);
+    if (metrics.Writer.joinable())
+        metrics.Writer.join();
+    metrics.Running = false;
+}
+
+//── Order Lifecycle Trace ─────────────────────────────────────────────
+
+static const char* const OrderTraceNameText[NUM_TRACE_NAMES] = {
+    "SUBMITTED", "SENT", "PENDING OPEN", "OPEN", "PENDING", "PENDING CANCEL",
+    "PARTIAL FILL", "FILLED", "CANCELED", "ERROR", "NOT FOUND", "REQUOTED"
+};
+
+static const char* const OrderTraceRoleText[NUM_TRACE_ROLES] = {
+    "buy_entry", "sell_entry", "stop", "target", "ladder_entry", "ladder_stop", "ladder_target"
+};
+
+static OrderTraceName OrderTraceNameForStatus(int status) {
+    switch (status) {
+        case SCT_OSC_ORDERSENT: return TRACE_SENT;
+        case SCT_OSC_PENDINGOPEN: return TRACE_PENDING_OPEN;
+        case SCT_OSC_OPEN: return TRACE_OPEN;
+        case SCT_OSC_PENDINGCANCEL: return TRACE_PENDING_CANCEL;
+        case SCT_OSC_FILLED: return TRACE_FILLED;
+        case SCT_OSC_CANCELED: return TRACE_CANCELED;
+        case SCT_OSC_ERROR: return TRACE_ERROR;
+        case SCT_OSC_UNSPECIFIED: return TRACE_NOT_FOUND;
+        default: return TRACE_PENDING;
+    }
+}
+
+// Appends one event to the ring. Study thread only.
+static void PushOrderTraceEvent(OrderTracer& tracer, long long nowNs, const TracedOrder& order, char phase, OrderTraceName name) {
+    unsigned int head = tracer.Head.load(std::memory_order_relaxed);
+    if (head - tracer.Tail.load(std::memory_order_acquire) >= ORDER_TRACE_CAPACITY) {
+        tracer.Dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    OrderTraceEvent& event = tracer.Events[head & (ORDER_TRACE_CAPACITY - 1)];
+    event.TimestampNs = nowNs;
+    event.OrderID = order.OrderID;
+    event.FilledQuantity = order.FilledQuantity;
+    event.Phase = static_cast<unsigned char>(phase);
+    event.Name = static_cast<unsigned char>(name);
+    event.Role = order.Role;
+    tracer.Head.store(head + 1, std::memory_order_release);
+}
+
+// Appends the buffered events to the trace file in the JSON array format, whose closing bracket is
+// optional, so the file stays loadable while it grows and across restarts. Writer thread only.
+static void WriteOrderTraceEvents(OrderTracer& tracer, long long& writtenDropped) {
+    unsigned int tail = tracer.Tail.load(std::memory_order_relaxed);
+    unsigned int head = tracer.Head.load(std::memory_order_acquire);
+    long long dropped = tracer.Dropped.load(std::memory_order_relaxed);
+    if (tail == head && dropped == writtenDropped)
+        return;
+    FILE* file = fopen(tracer.Path, "a");
+    if (file == NULL)
+        return; // Retried on the next pass; the ring drops events if it stays unwritable.
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0)
+        fputs("[\n", file);
+    for (; tail != head; tail++) {
+        const OrderTraceEvent& event = tracer.Events[tail & (ORDER_TRACE_CAPACITY - 1)];
+        fprintf(file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"id\":%d,\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+            OrderTraceNameText[event.Name], OrderTraceRoleText[event.Role], event.Phase, event.OrderID,
+            event.TimestampNs / 1000.0, tracer.ProcessID, event.OrderID);
+        if (event.Phase == 'n')
+            fprintf(file, ",\"args\":{\"filled_quantity\":%g}", event.FilledQuantity);
+        fputs("},\n", file);
+    }
+    if (dropped != writtenDropped) {
+        fprintf(file, "{\"name\":\"dropped trace events\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%d,\"args\":{\"dropped\":%lld}},\n",
+            SteadyClockNanoseconds() / 1000.0, tracer.ProcessID, dropped);
+        writtenDropped = dropped;
+    }
+    fclose(file);
+    tracer.Tail.store(tail, std::memory_order_release);
+}
+
+static void RunOrderTraceWriter(OrderTracer* tracer) {
+    long long writtenDropped = tracer->Dropped.load(std::memory_order_relaxed);
+    while (!tracer->StopRequested.load(std::memory_order_acquire)) {
+        WriteOrderTraceEvents(*tracer, writtenDropped);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    WriteOrderTraceEvents(*tracer, writtenDropped); // Events recorded up to the stop.
+}
+
+void StartOrderTracer(OrderTracer& tracer, const char* path, int processID) {
+    snprintf(tracer.Path, sizeof(tracer.Path), "%s", path);
+    tracer.ProcessID = processID;
+    tracer.NumOrders = 0;
+    tracer.StopRequested.store(false, std::memory_order_release);
+    tracer.Writer = std::thread(RunOrderTraceWriter, &tracer);
+    tracer.Running = true;
+}
+
+// Closes the open span of every traced order, so the file has no unterminated spans, and joins the writer.
+void StopOrderTracer(OrderTracer& tracer) {
+    if (!tracer.Running)
+        return;
+    long long nowNs = SteadyClockNanoseconds();
+    for (int i = 0; i < tracer.NumOrders; i++)
+        PushOrderTraceEvent(tracer, nowNs, tracer.Orders[i], 'e', static_cast<OrderTraceName>(tracer.Orders[i].OpenSpan));
+    tracer.NumOrders = 0;
+    tracer.StopRequested.store(true, std::memory_order_release);
+    if (tracer.Writer.joinable())
+        tracer.Writer.join();
+    tracer.Running = false;
+}
+
+// Starts following 'orderID' with a SUBMITTED span. IDs of 0 (legs or groups not submitted) are ignored.
+void TraceOrderSubmitted(OrderTracer* tracer, int orderID, OrderTraceRole role) {
+    if (tracer == NULL || orderID <= 0)
+        return;
+    if (tracer->NumOrders >= MAX_TRACED_ORDERS) {
+        tracer->Dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TracedOrder& order = tracer->Orders[tracer->NumOrders++];
+    order.OrderID = orderID;
+    order.Role = static_cast<unsigned char>(role);
+    order.OpenSpan = TRACE_SUBMITTED;
+    order.FilledQuantity = 0.0f;
+    PushOrderTraceEvent(*tracer, SteadyClockNanoseconds(), order, 'b', TRACE_SUBMITTED);
+}
+
+// Registers both entry legs of a bracket and every attached stop and target recorded at submission.
+void TraceBracketSubmitted(OrderTracer* tracer, int buyOrderID, int sellOrderID, const ArmedBracketInfo& bracket) {
+    if (tracer == NULL)
+        return;
+    TraceOrderSubmitted(tracer, buyOrderID, TRACE_ROLE_BUY_ENTRY);
+    TraceOrderSubmitted(tracer, sellOrderID, TRACE_ROLE_SELL_ENTRY);
+    for (int group = 0; group < bracket.NumTargets && group < MAX_SCALE_OUT_TARGETS; group++) {
+        TraceOrderSubmitted(tracer, bracket.BuyStopIDs[group], TRACE_ROLE_STOP);
+        TraceOrderSubmitted(tracer, bracket.BuyTargetIDs[group], TRACE_ROLE_TARGET);
+        TraceOrderSubmitted(tracer, bracket.SellStopIDs[group], TRACE_ROLE_STOP);
+        TraceOrderSubmitted(tracer, bracket.SellTargetIDs[group], TRACE_ROLE_TARGET);
+    }
+}
+
+// Marks a price change of a traced order by a coalesced requote.
+void TraceOrderRequoted(OrderTracer* tracer, int orderID) {
+    if (tracer == NULL)
+        return;
+    for (int i = 0; i < tracer->NumOrders; i++) {
+        if (tracer->Orders[i].OrderID == orderID) {
+            PushOrderTraceEvent(*tracer, SteadyClockNanoseconds(), tracer->Orders[i], 'n', TRACE_REQUOTED);
+            return;
+        }
+    }
+}
+
+// One lookup per traced order. A status change ends the open span and begins the next one; a
+// terminal status ends it with an instant and stops following the order.
+void PollTracedOrders(SCStudyInterfaceRef& sc, OrderTracer& tracer) {
+    if (tracer.NumOrders == 0)
+        return;
+    long long nowNs = SteadyClockNanoseconds();
+    s_SCTradeOrder order;
+    for (int i = 0; i < tracer.NumOrders; ) {
+        TracedOrder& traced = tracer.Orders[i];
+        OrderTraceName name = OrderTraceNameForStatus(GetOrderStatusByID(sc, traced.OrderID, order));
+        float filledQuantity = static_cast<float>(order.FilledQuantity);
+        if (filledQuantity > traced.FilledQuantity) {
+            traced.FilledQuantity = filledQuantity;
+            if (name != TRACE_FILLED)
+                PushOrderTraceEvent(tracer, nowNs, traced, 'n', TRACE_PARTIAL_FILL);
+        }
+        if (name == traced.OpenSpan) {
+            i++;
+            continue;
+        }
+        PushOrderTraceEvent(tracer, nowNs, traced, 'e', static_cast<OrderTraceName>(traced.OpenSpan));
+        if (name >= TRACE_FILLED) {
+            PushOrderTraceEvent(tracer, nowNs, traced, 'n', name);
+            traced = tracer.Orders[--tracer.NumOrders]; // Re-examines the moved entry at the same index.
+            continue;
+        }
+        PushOrderTraceEvent(tracer, nowNs, traced, 'b', name);
+        traced.OpenSpan = static_cast<unsigned char>(name);
+        i++;
+    }
+}
+
+void OpenRoundTrip(RoundTripAnalytics& trips, TradeSide side, float requestedPrice, float fillPrice, float quantity, double armToFillSeconds, const SCDateTime& entryTime) {
+    trips.Open = true;
+    trips.Side = side;
+    trips.Quantity = quantity;
+    trips.RequestedEntryPrice = requestedPrice;
+    trips.EntryFillPrice = fillPrice;
+    trips.ArmToFillSeconds = armToFillSeconds;
+    trips.EntryTime = entryTime;
+    trips.HighSinceEntry = fillPrice;
+    trips.LowSinceEntry = fillPrice;
+}
+
+static const char* RoundTripExitText(RoundTripExit exitReason) {
+    switch (exitReason) {
+        case EXIT_STOP:            return "STOP";
+        case EXIT_TARGET:          return "TARGET";
+        case EXIT_SAFETY_FLATTEN:  return "SAFETY FLATTEN";
+        case EXIT_SESSION_FLATTEN: return "SESSION FLATTEN";
+        case EXIT_KILL_SWITCH:     return "KILL SWITCH";
+        case EXIT_TIME_STOP:       return "TIME STOP";
+        default:                   return "UNKNOWN";
+    }
+}
+
+// Closes the open round trip: adds it to the running sums and, if 'logPath' is set, appends one CSV
+// line to the log (with a header when the file is new). Slippage and excursions are in ticks, with
+// positive slippage meaning a worse price than requested.
+void CompleteRoundTrip(SCStudyInterfaceRef& sc, RoundTripAnalytics& trips, const char* logPath, RoundTripExit exitReason,
+    float requestedExitPrice, float exitPrice, double pnl) {
+    if (!trips.Open)
+        return;
+    trips.Open = false;
+    UpdateRoundTripExcursion(trips, exitPrice);
+
+    float direction = (trips.Side == SIDE_LONG) ? 1.0f : -1.0f;
+    float tickSize = sc.TickSize > 0.0f ? sc.TickSize : 1.0f;
+    double entrySlippage = direction * (trips.EntryFillPrice - trips.RequestedEntryPrice) / tickSize;
+    double exitSlippage = direction * (requestedExitPrice - exitPrice) / tickSize;
+    double mae = ((trips.Side == SIDE_LONG) ? trips.EntryFillPrice - trips.LowSinceEntry : trips.HighSinceEntry - trips.EntryFillPrice) / tickSize;
+    double mfe = ((trips.Side == SIDE_LONG) ? trips.HighSinceEntry - trips.EntryFillPrice : trips.EntryFillPrice - trips.LowSinceEntry) / tickSize;
+    double timeInTrade = (sc.CurrentSystemDateTimeMS - trips.EntryTime).GetAsDouble() * SECONDS_PER_DAY;
+
+    trips.Count++;
+    trips.EntrySlippageTicksSum += entrySlippage;
+    trips.ExitSlippageTicksSum += exitSlippage;
+    trips.ArmToFillSecondsSum += trips.ArmToFillSeconds;
+    trips.TimeInTradeSecondsSum += timeInTrade;
+    trips.MAETicksSum += mae;
+    trips.MFETicksSum += mfe;
+
+    if (logPath == NULL || logPath[0] == '\0')
+        return;
+    FILE* file = fopen(logPath, "a");
+    if (file == NULL)
+        return;
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0)
+        fprintf(file, "ExitTime,Symbol,Side,Quantity,RequestedEntry,EntryFill,EntrySlippageTicks,ArmToFillSeconds,"
+            "ExitReason,RequestedExit,ExitFill,ExitSlippageTicks,TimeInTradeSeconds,MAETicks,MFETicks,PnL\n");
+    fprintf(file, "%s,%s,%s,%.0f,%.5f,%.5f,%.2f,%.3f,%s,%.5f,%.5f,%.2f,%.3f,%.2f,%.2f,%.2f\n",
+        sc.FormatDateTime(sc.CurrentSystemDateTimeMS).GetChars(), sc.Symbol.GetChars(),
+        trips.Side == SIDE_LONG ? "LONG" : "SHORT", trips.Quantity,
+        trips.RequestedEntryPrice, trips.EntryFillPrice, entrySlippage, trips.ArmToFillSeconds,
+        RoundTripExitText(exitReason), requestedExitPrice, exitPrice, exitSlippage, timeInTrade, mae, mfe, pnl);
+    fclose(file);
+}
+
+// Renames 'tempPath' over 'path', replacing it in one step so readers see the old or the new file.
+bool ReplaceFileAtomically(const char* tempPath, const char* path) {
+#if defined(_WIN32)
+    return MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(tempPath, path) == 0;
+#endif
+}
+
+static unsigned int StateSnapshotChecksum(const BotStateSnapshot& snapshot) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&snapshot);
+    size_t length = offsetof(BotStateSnapshot, Checksum);
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Writes the snapshot path to 'path': the configured one, or, if that is empty, a file named after the
+// symbol and chart number in the Sierra Chart folder, so charts never share a snapshot by default.
+void ResolveStateSnapshotPath(SCStudyInterfaceRef& sc, const char* configuredPath, char* path, size_t pathSize) {
+    if (configuredPath != NULL && configuredPath[0] != '\0') {
+        snprintf(path, pathSize, "%s", configuredPath);
+        return;
+    }
+    char symbol[STATE_SNAPSHOT_SYMBOL_LENGTH];
+    snprintf(symbol, sizeof(symbol), "%s", sc.Symbol.GetChars());
+    for (char* c = symbol; *c != '\0'; c++) {
+        if (!isalnum(static_cast<unsigned char>(*c)) && *c != '-' && *c != '.')
+            *c = '_';
+    }
+    snprintf(path, pathSize, "scalping_bot_state_%s_%d.bin", symbol, sc.ChartNumber);
+}
+
+// Compares the state with the last snapshot written and, only if it changed, writes a new one.
+void SaveStateSnapshotIfChanged(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, int logLevel) {
+    StateSnapshotTracker& tracker = runtimeState.Snapshot;
+    const char* path = tracker.Path;
+    if (path[0] == '\0')
+        return; // Resolved by the bootstrap.
+    int parentBuyID = sc.GetPersistentInt(PID_PARENT_BUY_LIMIT_ORDER_ID);
+    int parentSellID = sc.GetPersistentInt(PID_PARENT_SELL_LIMIT_ORDER_ID);
+    int tradeSide = sc.GetPersistentInt(PID_CURRENT_TRADE_SIDE);
+    int bracketStatus = sc.GetPersistentInt(PID_IS_BRACKET_ARMED);
+    int activeParentID = sc.GetPersistentInt(PID_ACTIVE_FILLED_PARENT_ORDER_ID);
+    const DailyRiskState& risk = runtimeState.Risk;
+
+    if (tracker.Written && parentBuyID == tracker.ParentBuyLimitOrderID && parentSellID == tracker.ParentSellLimitOrderID &&
+        tradeSide == tracker.TradeSide && bracketStatus == tracker.BracketStatus && activeParentID == tracker.ActiveFilledParentOrderID &&
+        risk.TradingDate == tracker.TradingDate && risk.TradesToday == tracker.TradesToday && risk.KillReason == tracker.KillReason &&
+        runtimeState.Ladder.StateVersion == tracker.LadderVersion)
+        return;
+
+    BotStateSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot)); // Padding bytes are part of the checksum.
+    snapshot.Magic = STATE_SNAPSHOT_MAGIC;
+    snapshot.Version = STATE_SNAPSHOT_VERSION;
+    snprintf(snapshot.Symbol, sizeof(snapshot.Symbol), "%s", sc.Symbol.GetChars());
+    snapshot.ChartNumber = sc.ChartNumber;
+    snapshot.ParentBuyLimitOrderID = parentBuyID;
+    snapshot.ParentSellLimitOrderID = parentSellID;
+    snapshot.TradeSide = tradeSide;
+    snapshot.BracketStatus = bracketStatus;
+    snapshot.ActiveFilledParentOrderID = activeParentID;
+    snapshot.ArmedBracket = runtimeState.ArmedBracket;
+    snapshot.Risk = risk;
+    memcpy(snapshot.Ladder, runtimeState.Ladder.Levels, sizeof(snapshot.Ladder));
+    snapshot.Checksum = StateSnapshotChecksum(snapshot);
+
+    char tempPath[STATE_SNAPSHOT_PATH_LENGTH + 8];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE* file = fopen(tempPath, "wb");
+    bool written = false;
+    if (file != NULL) {
+        written = fwrite(&snapshot, sizeof(snapshot), 1, file) == 1;
+        if (fclose(file) != 0)
+            written = false;
+        written = written && ReplaceFileAtomically(tempPath, path);
+    }
+    if (!written) {
+        if (!tracker.WriteFailed) {
+            SCString message;
+            message.Format("State snapshot could not be written to '%s'. A restart will infer the state from orders.", path);
+            LogSCSMessage(sc, logLevel, LOG_LEVEL_WARN, message);
+        }
+        tracker.WriteFailed = true;
+        return; // Retried on the next call, since the tracker still holds the old values.
+    }
+
+    tracker.Written = true;
+    tracker.WriteFailed = false;
+    tracker.ParentBuyLimitOrderID = parentBuyID;
+    tracker.ParentSellLimitOrderID = parentSellID;
+    tracker.TradeSide = tradeSide;
+    tracker.BracketStatus = bracketStatus;
+    tracker.ActiveFilledParentOrderID = activeParentID;
+    tracker.TradingDate = risk.TradingDate;
+    tracker.TradesToday = risk.TradesToday;
+    tracker.KillReason = risk.KillReason;
+    tracker.LadderVersion = runtimeState.Ladder.StateVersion;
+}
+
+// Reads a snapshot and checks its magic, version and checksum.
+bool LoadStateSnapshot(const char* path, BotStateSnapshot& snapshot) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    bool read = fread(&snapshot, sizeof(snapshot), 1, file) == 1;
+    fclose(file);
+    return read && snapshot.Magic == STATE_SNAPSHOT_MAGIC && snapshot.Version == STATE_SNAPSHOT_VERSION &&
+        snapshot.Checksum == StateSnapshotChecksum(snapshot);
+}
+
+// True if the order exists and has the given status. One targeted lookup, no order list scan.
+static bool OrderHasStatus(SCStudyInterfaceRef& sc, int orderID, SCOrderStatusCodeEnum status) {
+    s_SCTradeOrder order;
+    return orderID != 0 && sc.GetOrderByOrderID(orderID, order) != SCTRADING_ORDER_ERROR && order.OrderStatusCode == status;
+}
+
+// True if 'orderID' exists and has filled at least partially.
+static bool OrderHasFill(SCStudyInterfaceRef& sc, int orderID) {
+    s_SCTradeOrder order;
+    return orderID != 0 && sc.GetOrderByOrderID(orderID, order) != SCTRADING_ORDER_ERROR && order.FilledQuantity > 0;
+}
+
+// Validates a snapshot against the live position and the orders it names, and applies it if they
+// agree. A leg that filled while the study was not running is resumed as the open trade. Daily risk
+// counters are kept either way; the open trade part only if the position matches.
+bool RestoreStateSnapshot(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, const BotStateSnapshot& snapshot, float dailyLossLimit, LogBuffer& result) {
+    if (strcmp(snapshot.Symbol, sc.Symbol.GetChars()) != 0 || snapshot.ChartNumber != sc.ChartNumber) {
+        result.Format("BOOTSTRAP: State snapshot belongs to %s chart %d. Ignored.", snapshot.Symbol, snapshot.ChartNumber);
+        return false;
+    }
+
+    // Ladder levels first: each is kept only if the orders it names are still in the state it expects.
+    // The position left after the kept levels belongs to the main bracket.
+    LadderState& ladder = runtimeState.Ladder;
+    int droppedLevels = 0;
+    for (int i = 0; i < MAX_LADDER_LEVELS; i++) {
+        const LadderLevel& saved = snapshot.Ladder[i];
+        bool keep = false;
+        if (saved.State == LADDER_ARMED)
+            keep = OrderHasStatus(sc, saved.BuyOrderID, SCT_OSC_OPEN) && OrderHasStatus(sc, saved.SellOrderID, SCT_OSC_OPEN);
+        else if (saved.State == LADDER_IN_TRADE)
+            keep = saved.Side == SIDE_LONG
+                ? OrderHasStatus(sc, saved.BuyStopID, SCT_OSC_OPEN) && OrderHasStatus(sc, saved.BuyTargetID, SCT_OSC_OPEN)
+                : OrderHasStatus(sc, saved.SellStopID, SCT_OSC_OPEN) && OrderHasStatus(sc, saved.SellTargetID, SCT_OSC_OPEN);
+        if (keep) {
+            ladder.Levels[i] = saved;
+        } else {
+            if (saved.State != LADDER_IDLE) droppedLevels++;
+            ladder.Levels[i] = LadderLevel();
+        }
+    }
+    ladder.StateVersion++;
+
+    s_SCPositionData position;
+    sc.GetTradePosition(position);
+    position.PositionQuantity -= LadderNetPosition(ladder);
+    int liveSide = position.PositionQuantity > 0 ? SIDE_LONG : (position.PositionQuantity < 0 ? SIDE_SHORT : SIDE_FLAT);
+
+    int tradeSide = SIDE_FLAT;
+    int bracketStatus = BRACKET_NOT_ARMED;
+    int parentBuyID = 0, parentSellID = 0, activeParentID = 0;
+    bool consistent = false;
+
+    if (snapshot.TradeSide != SIDE_FLAT) {
+        // In a trade: the parent must still be (at least partially) filled and the position on the same side.
+        if (liveSide == snapshot.TradeSide && OrderHasFill(sc, snapshot.ActiveFilledParentOrderID)) {
+            tradeSide = snapshot.TradeSide;
+            activeParentID = snapshot.ActiveFilledParentOrderID;
+            consistent = true;
+        }
+    } else if (snapshot.BracketStatus == BRACKET_ARMED_AND_WORKING || snapshot.BracketStatus == BRACKET_CANCEL_PENDING) {
+        int buyID = snapshot.ParentBuyLimitOrderID;
+        int sellID = snapshot.ParentSellLimitOrderID;
+        if (liveSide == SIDE_FLAT) {
+            // Still armed: every leg the snapshot names must still be working. Legs being cancelled are kept
+            // whatever their status; the study releases them once neither can fill.
+            bool legsMatch = snapshot.BracketStatus == BRACKET_CANCEL_PENDING ||
+                ((buyID == 0 || OrderHasStatus(sc, buyID, SCT_OSC_OPEN)) && (sellID == 0 || OrderHasStatus(sc, sellID, SCT_OSC_OPEN)));
+            if ((buyID != 0 || sellID != 0) && legsMatch) {
+                parentBuyID = buyID;
+                parentSellID = sellID;
+                bracketStatus = snapshot.BracketStatus;
+                consistent = true;
+            }
+        } else {
+            // A leg filled while the study was not running.
+            int filledID = (liveSide == SIDE_LONG) ? buyID : sellID;
+            if (OrderHasFill(sc, filledID)) {
+                tradeSide = liveSide;
+                activeParentID = filledID;
+                consistent = true;
+            }
+        }
+    } else {
+        consistent = (liveSide == SIDE_FLAT);
+    }
+
+    DailyRiskState& risk = runtimeState.Risk;
+    risk = snapshot.Risk;
+    if (!consistent || tradeSide == SIDE_FLAT) {
+        risk.OpenSide = SIDE_FLAT;
+        risk.LossTriggerPrice = 0.0f;
+    }
+    if (!consistent) {
+        result.Format("BOOTSTRAP: State snapshot (side %d, bracket %d, buy %d, sell %d, parent %d) does not match the live position %.0f. "
+            "Daily risk counters restored; inferring state from orders.",
+            snapshot.TradeSide, snapshot.BracketStatus, snapshot.ParentBuyLimitOrderID, snapshot.ParentSellLimitOrderID,
+            snapshot.ActiveFilledParentOrderID, position.PositionQuantity);
+        return false;
+    }
+
+    if (tradeSide != SIDE_FLAT) {
+        // Re-arm the loss trigger against the current limit. A leg that filled while the study was not
+        // running starts risk tracking at the parent's fill price.
+        float entryPrice = risk.OpenEntryPrice;
+        float quantity = risk.OpenQuantity;
+        if (risk.OpenSide == SIDE_FLAT) {
+            s_SCTradeOrder filledParent;
+            sc.GetOrderByOrderID(activeParentID, filledParent);
+            entryPrice = static_cast<float>(filledParent.AvgFillPrice);
+            quantity = static_cast<float>(filledParent.FilledQuantity);
+        }
+        float currencyPerPoint = (sc.CurrencyValuePerTick > 0.0f && sc.TickSize > 0.0f) ? sc.CurrencyValuePerTick / sc.TickSize : 1.0f;
+        OpenRiskTrade(risk, static_cast<TradeSide>(tradeSide), entryPrice, quantity, dailyLossLimit, currencyPerPoint);
+    }
+
+    sc.GetPersistentInt(PID_PARENT_BUY_LIMIT_ORDER_ID) = parentBuyID;
+    sc.GetPersistentInt(PID_PARENT_SELL_LIMIT_ORDER_ID) = parentSellID;
+    sc.GetPersistentInt(PID_CURRENT_TRADE_SIDE) = tradeSide;
+    sc.GetPersistentInt(PID_IS_BRACKET_ARMED) = bracketStatus;
+    sc.GetPersistentInt(PID_ACTIVE_FILLED_PARENT_ORDER_ID) = activeParentID;
+    runtimeState.ArmedBracket = snapshot.ArmedBracket;
+    if (tradeSide != SIDE_FLAT)
+        runtimeState.TradeEntryTime = sc.CurrentSystemDateTimeMS; // A time stop restarts on resume.
+    if (bracketStatus == BRACKET_ARMED_AND_WORKING)
+        runtimeState.Quality.ArmedSince = sc.CurrentSystemDateTimeMS;
+
+    result.Format("BOOTSTRAP: Resumed from state snapshot. Side %d, bracket %d, BuyLimitID %d, SellLimitID %d, ActiveParentID %d. "
+        "Ladder net position %.0f, %d ladder levels no longer matched their orders.",
+        tradeSide, bracketStatus, parentBuyID, parentSellID, activeParentID, LadderNetPosition(ladder), droppedLevels);
+    return true;
+}
+
+// Folds every closed bar not yet seen (all bars before 'barIndex') into the EMA of the high-low range
+// and returns it. A full recalculation or a length change starts over from the first bar, so the cost
+// per update is the number of newly closed bars, normally zero or one. Returns 0 until a bar has closed.
+double UpdateRangeEstimator(SCStudyInterfaceRef& sc, RangeEstimatorState& estimator, int lengthBars, int barIndex) {
+    if (lengthBars < 1) lengthBars = 1;
+    if (estimator.Length != lengthBars || estimator.LastBar >= barIndex) {
+        estimator.Value = 0.0;
+        estimator.LastBar = -1;
+        estimator.Length = lengthBars;
+    }
+    double alpha = 2.0 / (lengthBars + 1);
+    for (int bar = estimator.LastBar + 1; bar < barIndex; bar++) {
+        double range = sc.High[bar] - sc.Low[bar];
+        estimator.Value = (bar == 0) ? range : estimator.Value + alpha * (range - estimator.Value);
+    }
+    if (barIndex - 1 > estimator.LastBar)
+        estimator.LastBar = barIndex - 1;
+    return estimator.Value;
+}
+
+// Signed position held by the ladder levels that are in a trade.
+float LadderNetPosition(const LadderState& ladder) {
+    float position = 0.0f;
+    for (int i = 0; i < MAX_LADDER_LEVELS; i++) {
+        const LadderLevel& level = ladder.Levels[i];
+        if (level.State == LADDER_IN_TRADE)
+            position += (level.Side == SIDE_LONG) ? level.Quantity : -level.Quantity;
+    }
+    return position;
+}
+
+// True if 'orderID' is the buy or sell entry order of a ladder level.
+bool IsLadderParentOrder(const LadderState& ladder, int orderID) {
+    for (int i = 0; i < MAX_LADDER_LEVELS; i++) {
+        const LadderLevel& level = ladder.Levels[i];
+        if (level.State != LADDER_IDLE && (level.BuyOrderID == orderID || level.SellOrderID == orderID))
+            return true;
+    }
+    return false;
+}
+
+// Books a closed ladder trade into the daily risk counters, the same way CloseRiskTrade does for the
+// main bracket's trade.
+static double RecordLadderTrade(DailyRiskState& risk, const LadderLevel& level, float exitPrice, float currencyPerPoint) {
+    double pointsPerContract = (level.Side == SIDE_LONG) ? exitPrice - level.EntryPrice : level.EntryPrice - exitPrice;
+    double tradePnL = pointsPerContract * level.Quantity * currencyPerPoint;
+    risk.RealizedPnL += tradePnL;
+    risk.TradesToday++;
+    risk.ConsecutiveLosses = (tradePnL < 0.0) ? risk.ConsecutiveLosses + 1 : 0;
+    return tradePnL;
+}
+
+// True while an order can still fill: any status before a final one.
+bool IsWorkingOrderStatus(int status) {
+    return status != SCT_OSC_UNSPECIFIED && status != SCT_OSC_FILLED && status != SCT_OSC_CANCELED && status != SCT_OSC_ERROR;
+}
+
+// Order status of 'orderID', or SCT_OSC_UNSPECIFIED (with 'order' left empty) if it cannot be found.
+int GetOrderStatusByID(SCStudyInterfaceRef& sc, int orderID, s_SCTradeOrder& order) {
+    if (orderID == 0 || sc.GetOrderByOrderID(orderID, order) == SCTRADING_ORDER_ERROR) {
+        order = s_SCTradeOrder();
+        return SCT_OSC_UNSPECIFIED;
+    }
+    return order.OrderStatusCode;
+}
+
+// Folds the latest trade into the feed latency estimate (once per new trade time or bar) and updates
+// the stale flag: stale as soon as the estimate exceeds 'thresholdMs', healthy again once it has stayed
+// below for 'recoverySeconds'. Returns true if the stale flag changed.
+bool UpdateFeedLatency(FeedLatencyState& feed, const SCDateTime& tradeTime, int tradeBar, const SCDateTime& now,
+    int smoothingTrades, float thresholdMs, int recoverySeconds) {
+    if (feed.LastTradeTime.IsUnset()) {
+        // The trade seen on the first call was loaded, not just received: it is not a sample.
+        feed.LastTradeTime = tradeTime;
+        feed.LastTradeBar = tradeBar;
+    } else if (tradeTime != feed.LastTradeTime || tradeBar != feed.LastTradeBar) {
+        feed.LastTradeTime = tradeTime;
+        feed.LastTradeBar = tradeBar;
+        double sampleMs = (now - tradeTime).GetAsDouble() * SECONDS_PER_DAY * 1000.0;
+        if (sampleMs < FEED_LATENCY_HISTORY_DAYS * SECONDS_PER_DAY * 1000.0) {
+            double alpha = 2.0 / (smoothingTrades + 1.0);
+            feed.EstimateMs = feed.HasEstimate ? feed.EstimateMs + alpha * (sampleMs - feed.EstimateMs) : sampleMs;
+            feed.LastSampleMs = sampleMs;
+            feed.HasEstimate = true;
+        }
+    }
+    if (!feed.HasEstimate)
+        return false;
+
+    bool aboveThreshold = feed.EstimateMs > thresholdMs;
+    if (!feed.Stale) {
+        if (!aboveThreshold)
+            return false;
+        feed.Stale = true;
+        feed.HealthySince = SCDateTime();
+        feed.StaleEpisodes++;
+        return true;
+    }
+    if (aboveThreshold) {
+        feed.HealthySince = SCDateTime();
+        return false;
+    }
+    if (feed.HealthySince.IsUnset())
+        feed.HealthySince = now;
+    if ((now - feed.HealthySince).GetAsDouble() * SECONDS_PER_DAY < recoverySeconds)
+        return false;
+    feed.Stale = false;
+    feed.HealthySince = SCDateTime();
+    return true;
+}
+
+//── Shared-Memory Bus ─────────────────────────────────────────────────
+
+// Maps the bus segment at 'path' and starts a new epoch: both rings are reset, and the strategy
+// process drops its state when it sees the epoch change.
+bool OpenBusBridge(BusBridgeState& bus, const char* path) {
+    strncpy(bus.Path, path, BUS_PATH_LENGTH - 1);
+    bus.Path[BUS_PATH_LENGTH - 1] = '\0';
+    if (OpenBusSegment(path, true, bus.Mapping) == NULL) {
+        bus.NextOpenTime = SteadyClockSeconds() + BUS_REOPEN_SECONDS;
+        return false;
+    }
+    bus.NextSequence = 0;
+    bus.LastTick = BusTick();
+    bus.LastDepth = BusDepth();
+    bus.LastPosition = BusPosition();
+    bus.NumOrders = 0;
+    return true;
+}
+
+void CloseBusBridge(BusBridgeState& bus) {
+    CloseBusSegment(bus.Mapping);
+}
+
+// Assigns the next sequence number and pushes the event. A full ring drops the event and counts it
+// in the segment; the strategy process sees the gap in the sequence numbers.
+static void PublishBusEvent(BusBridgeState& bus, BusEvent& event, double exchangeTime) {
+    event.Sequence = ++bus.NextSequence;
+    event.ExchangeTime = exchangeTime;
+    bus.PublishedNs[event.Sequence & (BUS_PUBLISH_WINDOW - 1)] = SteadyClockNanoseconds();
+    if (!BusRingPush(bus.Mapping.Segment->Events, event))
+        bus.Mapping.Segment->EventsDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+static BusOrderStatus BusOrderStatusFor(int status) {
+    switch (status) {
+    case SCT_OSC_OPEN: return BUS_ORDER_WORKING;
+    case SCT_OSC_FILLED: return BUS_ORDER_FILLED;
+    case SCT_OSC_CANCELED: return BUS_ORDER_CANCELED;
+    case SCT_OSC_ERROR:
+    case SCT_OSC_UNSPECIFIED: return BUS_ORDER_ERROR;
+    default: return BUS_ORDER_PENDING;
+    }
+}
+
+static void WatchBusOrder(BusBridgeState& bus, int orderID) {
+    if (orderID <= 0 || bus.NumOrders >= MAX_BUS_ORDERS)
+        return;
+    BusWatchedOrder& watched = bus.Orders[bus.NumOrders++];
+    watched.OrderID = orderID;
+    watched.Status = -1;
+    watched.FilledQuantity = 0.0;
+}
+
+// One order lookup per followed order. A status or fill change is published; an order in a final
+// state is published once and then no longer followed.
+static void PollBusOrders(SCStudyInterfaceRef& sc, BusBridgeState& bus, double exchangeTime) {
+    s_SCTradeOrder order;
+    BusEvent event = BusEvent();
+    event.Type = BUS_EVENT_ORDER;
+    for (int i = 0; i < bus.NumOrders; ) {
+        BusWatchedOrder& watched = bus.Orders[i];
+        BusOrderStatus status = BusOrderStatusFor(GetOrderStatusByID(sc, watched.OrderID, order));
+        if (status != watched.Status || order.FilledQuantity != watched.FilledQuantity) {
+            watched.Status = status;
+            watched.FilledQuantity = order.FilledQuantity;
+            event.Order.OrderID = watched.OrderID;
+            event.Order.Status = status;
+            event.Order.FilledQuantity = static_cast<float>(order.FilledQuantity);
+            event.Order.Quantity = static_cast<float>(order.OrderQuantity);
+            event.Order.AvgFillPrice = order.AvgFillPrice;
+            PublishBusEvent(bus, event, exchangeTime);
+        }
+        if (status == BUS_ORDER_FILLED || status == BUS_ORDER_CANCELED || status == BUS_ORDER_ERROR)
+            bus.Orders[i] = bus.Orders[--bus.NumOrders];
+        else
+            i++;
+    }
+}
+
+static void RejectBusCommand(BusBridgeState& bus, const BusCommand& command, BusRejectReason reason, double exchangeTime) {
+    BusEvent event = BusEvent();
+    event.Type = BUS_EVENT_COMMAND_REJECTED;
+    event.Rejected.CommandID = command.CommandID;
+    event.Rejected.Reason = reason;
+    PublishBusEvent(bus, event, exchangeTime);
+    bus.CommandsRejected++;
+}
+
+// Submits an OCO bracket with one attached stop and target per leg from the ladder template, with
+// the prices and offsets of the command rounded to the tick size, and replies with the order IDs.
+static void ExecuteBusBracket(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, const BusCommand& command,
+    int stopOrderType, double exchangeTime, int logLevel) {
+    BusBridgeState& bus = runtimeState.Bus;
+    if (command.Quantity <= 0 || command.BuyPrice <= 0.0 || command.BuyPrice >= command.SellPrice ||
+        command.StopOffset <= 0.0 || command.TargetOffset <= 0.0) {
+        RejectBusCommand(bus, command, BUS_REJECT_INVALID, exchangeTime);
+        return;
+    }
+    if (!AcquireOrderTokens(runtimeState.RateLimiter, ORDER_COST_OCO_SUBMIT)) {
+        RejectBusCommand(bus, command, BUS_REJECT_RATE_LIMITED, exchangeTime);
+        return;
+    }
+    OrderTemplateState& templates = runtimeState.OrderTemplates;
+    if (templates.BuiltForQuantity != command.Quantity || templates.BuiltForTargets < 1)
+        BuildBracketOrderTemplates(templates, command.Quantity, stopOrderType, 1);
+    s_SCNewOrder order = templates.LadderTemplate;
+    float stopOffset = sc.RoundToIncrement(static_cast<float>(command.StopOffset), sc.TickSize);
+    float targetOffset = sc.RoundToIncrement(static_cast<float>(command.TargetOffset), sc.TickSize);
+    if (stopOffset < sc.TickSize) stopOffset = sc.TickSize;
+    if (targetOffset < sc.TickSize) targetOffset = sc.TickSize;
+    PatchBracketOrder(order, sc.RoundToTickSize(static_cast<float>(command.BuyPrice), sc.TickSize),
+        sc.RoundToTickSize(static_cast<float>(command.SellPrice), sc.TickSize), stopOffset, &targetOffset, 1);
+    long long submitStartTime = SteadyClockNanoseconds();
+    if (sc.SubmitOCOOrder(order) <= 0) {
+        LogBuffer message;
+        message.Format("Bus command %d: SubmitOCOOrder failed.", command.CommandID);
+        LogSCSMessage(sc, logLevel, LOG_LEVEL_ERROR, message, true);
+        RejectBusCommand(bus, command, BUS_REJECT_SUBMIT_FAILED, exchangeTime);
+        return;
+    }
+
+    BusEvent event = BusEvent();
+    event.Type = BUS_EVENT_BRACKET_SUBMITTED;
+    event.Bracket.CommandID = command.CommandID;
+    event.Bracket.BuyOrderID = order.InternalOrderID;
+    event.Bracket.SellOrderID = order.InternalOrderID2;
+    event.Bracket.BuyStopID = order.Stop1InternalOrderID;
+    event.Bracket.BuyTargetID = order.Target1InternalOrderID;
+    event.Bracket.SellStopID = order.Stop1InternalOrderID_2;
+    event.Bracket.SellTargetID = order.Target1InternalOrderID_2;
+    PublishBusEvent(bus, event, exchangeTime);
+    bus.CommandsExecuted++;
+
+    const int orderIDs[6] = { event.Bracket.BuyOrderID, event.Bracket.SellOrderID, event.Bracket.BuyStopID,
+        event.Bracket.BuyTargetID, event.Bracket.SellStopID, event.Bracket.SellTargetID };
+    static const OrderTraceRole Roles[6] = { TRACE_ROLE_BUY_ENTRY, TRACE_ROLE_SELL_ENTRY, TRACE_ROLE_STOP,
+        TRACE_ROLE_TARGET, TRACE_ROLE_STOP, TRACE_ROLE_TARGET };
+    for (int i = 0; i < 6; i++) {
+        WatchBusOrder(bus, orderIDs[i]);
+        if (runtimeState.Trace.Running)
+            TraceOrderSubmitted(&runtimeState.Trace, orderIDs[i], Roles[i]);
+    }
+    ExpectAcknowledgement(runtimeState.RateLimiter, ACK_SUBMIT, event.Bracket.BuyOrderID, submitStartTime);
+    ExpectAcknowledgement(runtimeState.RateLimiter, ACK_SUBMIT, event.Bracket.SellOrderID, submitStartTime);
+}
+
+// Cancels the entry legs submitted for the external process that are still working. Their attached
+// orders are cancelled with them; legs already filled and their stops and targets are left alone.
+void CancelBusEntryOrders(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState) {
+    BusBridgeState& bus = runtimeState.Bus;
+    s_SCTradeOrder order;
+    for (int i = 0; i < bus.NumOrders; i++) {
+        if (IsWorkingOrderStatus(GetOrderStatusByID(sc, bus.Orders[i].OrderID, order)) && order.ParentInternalOrderID == 0)
+            LimitedCancelOrder(sc, runtimeState.RateLimiter, order.InternalOrderID);
+    }
+}
+
+// One update of the bus: publishes the last trade and quote, the top of the book and the position
+// when they changed, and the status changes of the followed orders; then executes up to
+// MAX_BUS_COMMANDS_PER_CALL commands. A non-zero 'bracketBlockReason' (a BusRejectReason) rejects
+// bracket submissions; cancels and flattens are still executed. Nothing is allocated and no call blocks on the other process.
+void RunBusBridge(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, float rValue, int depthLevels, int stopOrderType,
+    int bracketBlockReason, int logLevel) {
+    BusBridgeState& bus = runtimeState.Bus;
+    BusSegment& segment = *bus.Mapping.Segment;
+    const int lastBarIndex = sc.ArraySize - 1;
+    double exchangeTime = sc.LatestDateTimeForLastBar.GetAsDouble();
+    BusEvent event = BusEvent();
+
+    BusTick tick = BusTick();
+    tick.Price = sc.Close[lastBarIndex];
+    tick.Bid = sc.Bid;
+    tick.Ask = sc.Ask;
+    tick.RangeR = rValue;
+    tick.Volume = sc.Volume[lastBarIndex];
+    tick.BarIndex = lastBarIndex;
+    if (memcmp(&tick, &bus.LastTick, sizeof(tick)) != 0) {
+        bus.LastTick = tick;
+        event.Type = BUS_EVENT_TICK;
+        event.Tick = tick;
+        PublishBusEvent(bus, event, exchangeTime);
+    }
+
+    if (depthLevels > BUS_DEPTH_LEVELS) depthLevels = BUS_DEPTH_LEVELS;
+    MarketDepthSnapshot& book = runtimeState.Depth;
+    if (ReadMarketDepth(sc, depthLevels, book)) {
+        BusDepth depth = BusDepth();
+        depth.NumBidLevels = book.NumBidLevels < depthLevels ? book.NumBidLevels : depthLevels;
+        depth.NumAskLevels = book.NumAskLevels < depthLevels ? book.NumAskLevels : depthLevels;
+        for (int level = 0; level < depth.NumBidLevels; level++) {
+            depth.BidPrice[level] = book.BidPrice[level];
+            depth.BidQuantity[level] = book.BidQuantity[level];
+        }
+        for (int level = 0; level < depth.NumAskLevels; level++) {
+            depth.AskPrice[level] = book.AskPrice[level];
+            depth.AskQuantity[level] = book.AskQuantity[level];
+        }
+        if (memcmp(&depth, &bus.LastDepth, sizeof(depth)) != 0) {
+            bus.LastDepth = depth;
+            event.Type = BUS_EVENT_DEPTH;
+            event.Depth = depth;
+            PublishBusEvent(bus, event, exchangeTime);
+        }
+    }
+
+    s_SCPositionData position;
+    sc.GetTradePosition(position);
+    if (position.PositionQuantity != bus.LastPosition.Quantity || position.AveragePrice != bus.LastPosition.AveragePrice) {
+        bus.LastPosition.Quantity = position.PositionQuantity;
+        bus.LastPosition.AveragePrice = position.AveragePrice;
+        event.Type = BUS_EVENT_POSITION;
+        event.Position = bus.LastPosition;
+        PublishBusEvent(bus, event, exchangeTime);
+    }
+
+    if (bus.NumOrders > 0)
+        PollBusOrders(sc, bus, exchangeTime);
+
+    // Commands. The round trip of a command is measured from the publication of the event it names.
+    BusCommand command;
+    bool sampled = false;
+    for (int i = 0; i < MAX_BUS_COMMANDS_PER_CALL && BusRingPop(segment.Commands, command); i++) {
+        if (command.TriggerSequence != 0 && command.TriggerSequence <= bus.NextSequence &&
+            bus.NextSequence - command.TriggerSequence < BUS_PUBLISH_WINDOW) {
+            long long roundTripNs = SteadyClockNanoseconds() - bus.PublishedNs[command.TriggerSequence & (BUS_PUBLISH_WINDOW - 1)];
+            RecordLatencySample(bus.RoundTrip, roundTripNs);
+            if (roundTripNs > bus.RoundTripMaxNs)
+                bus.RoundTripMaxNs = roundTripNs;
+            sampled = true;
+        }
+        switch (command.Type) {
+        case BUS_COMMAND_SUBMIT_BRACKET:
+            if (bracketBlockReason != 0)
+                RejectBusCommand(bus, command, static_cast<BusRejectReason>(bracketBlockReason), exchangeTime);
+            else
+                ExecuteBusBracket(sc, runtimeState, command, stopOrderType, exchangeTime, logLevel);
+            break;
+        case BUS_COMMAND_CANCEL:
+            LimitedCancelOrder(sc, runtimeState.RateLimiter, command.OrderID);
+            bus.CommandsExecuted++;
+            break;
+        case BUS_COMMAND_FLATTEN:
+            LimitedFlatten(sc, runtimeState, true);
+            bus.CommandsExecuted++;
+            break;
+        case BUS_COMMAND_NOOP:
+            break;
+        default:
+            RejectBusCommand(bus, command, BUS_REJECT_INVALID, exchangeTime);
+            break;
+        }
+    }
+    if (sampled) {
+        long long p50 = LatencyHistogramPercentile(bus.RoundTrip, 50.0);
+        long long p99 = LatencyHistogramPercentile(bus.RoundTrip, 99.0);
+        bus.RoundTripP50Ns = p50 < bus.RoundTripMaxNs ? p50 : bus.RoundTripMaxNs;
+        bus.RoundTripP99Ns = p99 < bus.RoundTripMaxNs ? p99 : bus.RoundTripMaxNs;
+    }
+}
+
+// Advances every ladder level by one step: arms idle levels (while 'allowArming' and within 'numLevels'),
+// detects entry fills of armed levels and exits of levels in a trade. Each level costs at most two
+// order lookups. Returns true if a level in a trade lost its stop or target, in which case the caller
+// flattens everything.
+bool ManageLadder(SCStudyInterfaceRef& sc, BotRuntimeState& runtimeState, int numLevels, bool allowArming, float centerPrice,
+    float rValue, float bracketFraction, float stepFraction, float stopOffset, float targetOffset, int quantity, int stopOrderType,
+    float currencyPerPoint, int logLevel) {
+    LadderState& ladder = runtimeState.Ladder;
+    OrderRateLimiter& limiter = runtimeState.RateLimiter;
+    LogBuffer message;
+    s_SCTradeOrder order;
+
+    for (int i = 0; i < MAX_LADDER_LEVELS; i++) {
+        LadderLevel& level = ladder.Levels[i];
+
+        if (level.State == LADDER_IDLE) {
+            if (!allowArming || i >= numLevels)
+                continue;
+            if (!AcquireOrderTokens(limiter, ORDER_COST_OCO_SUBMIT))
+                break; // The remaining levels are armed on a later update.
+
+            float entryOffset = sc.RoundToIncrement(rValue * (bracketFraction + (i + 1) * stepFraction), sc.TickSize);
+            if (entryOffset < sc.TickSize) entryOffset = sc.TickSize;
+            OrderTemplateState& templates = runtimeState.OrderTemplates;
+            if (templates.BuiltForQuantity != quantity || templates.BuiltForTargets < 1)
+                BuildBracketOrderTemplates(templates, quantity, stopOrderType, 1);
+            s_SCNewOrder ladderOrder = templates.LadderTemplate; // Ladder levels always use a single target.
+            PatchBracketOrder(ladderOrder, sc.RoundToTickSize(centerPrice - entryOffset, sc.TickSize),
+                sc.RoundToTickSize(centerPrice + entryOffset, sc.TickSize), stopOffset, &targetOffset, 1);
+            long long submitStartTime = SteadyClockNanoseconds();
+            if (sc.SubmitOCOOrder(ladderOrder) <= 0) {
+                message.Format("Ladder level %d: SubmitOCOOrder failed.", i + 1);
+                LogSCSMessage(sc, logLevel, LOG_LEVEL_ERROR, message, true);
+                continue;
+            }
+            level.State = LADDER_ARMED;
+            level.BuyOrderID = ladderOrder.InternalOrderID;
+            level.SellOrderID = ladderOrder.InternalOrderID2;
+            level.BuyStopID = ladderOrder.Stop1InternalOrderID;
+            level.BuyTargetID = ladderOrder.Target1InternalOrderID;
+            level.SellStopID = ladderOrder.Stop1InternalOrderID_2;
+            level.SellTargetID = ladderOrder.Target1InternalOrderID_2;
+            level.Quantity = static_cast<float>(quantity);
+            ladder.StateVersion++;
+            ExpectAcknowledgement(limiter, ACK_SUBMIT, level.BuyOrderID, submitStartTime);
+            ExpectAcknowledgement(limiter, ACK_SUBMIT, level.SellOrderID, submitStartTime);
+            if (runtimeState.Trace.Running) {
+                TraceOrderSubmitted(&runtimeState.Trace, level.BuyOrderID, TRACE_ROLE_LADDER_ENTRY);
+                TraceOrderSubmitted(&runtimeState.Trace, level.SellOrderID, TRACE_ROLE_LADDER_ENTRY);
+                TraceOrderSubmitted(&runtimeState.Trace, level.BuyStopID, TRACE_ROLE_LADDER_STOP);
+                TraceOrderSubmitted(&runtimeState.Trace, level.BuyTargetID, TRACE_ROLE_LADDER_TARGET);
+                TraceOrderSubmitted(&runtimeState.Trace, level.SellStopID, TRACE_ROLE_LADDER_STOP);
+                TraceOrderSubmitted(&runtimeState.Trace, level.SellTargetID, TRACE_ROLE_LADDER_TARGET);
+            }
+            message.Format("Ladder level %d armed: BuyLimitID %d @%.5f, SellLimitID %d @%.5f.",
+                i + 1, level.BuyOrderID, ladderOrder.Price1, level.SellOrderID, ladderOrder.Price2);
+            LogSCSMessage(sc, logLevel, LOG_LEVEL_INFO, message, true);
+        } else if (level.State == LADDER_ARMED) {
+            int buyStatus = GetOrderStatusByID(sc, level.BuyOrderID, order);
+            if (buyStatus != SCT_OSC_FILLED) {
+                int sellStatus = GetOrderStatusByID(sc, level.SellOrderID, order);
+                if (sellStatus == SCT_OSC_FILLED) {
+                    level.Side = SIDE_SHORT;
+                } else {
+                    bool buyDone = buyStatus == SCT_OSC_CANCELED || buyStatus == SCT_OSC_ERROR || buyStatus == SCT_OSC_UNSPECIFIED;
+                    bool sellDone = sellStatus == SCT_OSC_CANCELED || sellStatus == SCT_OSC_ERROR || sellStatus == SCT_OSC_UNSPECIFIED;
+                    if (buyDone && sellDone) {
+                        message.Format("Ladder level %d: both legs inactive without a fill. Level reset.", i + 1);
+                        LogSCSMessage(sc, logLevel, LOG_LEVEL_WARN, message);
+                        level = LadderLevel();
+                        ladder.StateVersion++;
+                    }
+                    continue;
+                }
+            } else {
+                level.Side = SIDE_LONG;
+            }
+            level.State = LADDER_IN_TRADE;
+            level.EntryPrice = static_cast<float>(order.AvgFillPrice);
+            if (order.FilledQuantity > 0)
+                level.Quantity = static_cast<float>(order.FilledQuantity);
+            ladder.StateVersion++;
+            message.Format("Ladder level %d entry filled: %s %.0f @%.5f.", i + 1, level.Side == SIDE_LONG ? "BUY" : "SELL", level.Quantity, level.EntryPrice);
+            LogSCSMessage(sc, logLevel, LOG_LEVEL_INFO, message, true);
+        } else { // LADDER_IN_TRADE
+            int stopID = (level.Side == SIDE_LONG) ? level.BuyStopID : level.SellStopID;
+            int targetID = (level.Side == SIDE_LONG) ? level.BuyTargetID : level.SellTargetID;
+            int stopStatus = GetOrderStatusByID(sc, stopID, order);
+            if (stopStatus != SCT_OSC_FILLED) {
+                int targetStatus = GetOrderStatusByID(sc, targetID, order);
+                if (targetStatus != SCT_OSC_FILLED) {
+                    bool lostProtection = stopStatus == SCT_OSC_CANCELED || stopStatus == SCT_OSC_ERROR ||
+                        targetStatus == SCT_OSC_CANCELED || targetStatus == SCT_OSC_ERROR;
+                    if (lostProtection) {
+                        message.Format("CRITICAL SAFETY: Ladder level %d stop (status %d) or target (status %d) is no longer working.", i + 1, stopStatus, targetStatus);
+                        LogSCSMessage(sc, logLevel, LOG_LEVEL_ERROR, message, true);
+                        return true;
+                    }
+                    continue;
+                }
+            }
+            double pnl = RecordLadderTrade(runtimeState.Risk, level, static_cast<float>(order.AvgFillPrice), currencyPerPoint);
+            message.Format("Ladder level %d exit: %s filled @%.5f. Trade P&L %.2f.", i + 1,
+                stopStatus == SCT_OSC_FILLED ? "STOP" : "TARGET", order.AvgFillPrice, pnl);
+            LogSCSMessage(sc, logLevel, LOG_LEVEL_INFO, message, true);
+            level = LadderLevel();
+            ladder.StateVersion++;
+        }
+    }
+    return false;
+}
+
+// Cancels the entry legs of every armed ladder level and resets those levels.
+void CancelLadderBrackets(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, LadderState& ladder) {
+    for (int i = 0; i < MAX_LADDER_LEVELS; i++) {
+        LadderLevel& level = ladder.Levels[i];
+        if (level.State != LADDER_ARMED)
+            continue;
+        LimitedCancelOrder(sc, limiter, level.BuyOrderID);
+        LimitedCancelOrder(sc, limiter, level.SellOrderID);
+        level = LadderLevel();
+        ladder.StateVersion++;
+    }
+}
+
+// Books every ladder level in a trade as closed at 'exitPrice' (the caller flattens the position) and
+// resets it. With 'cancelAttachedOrders', its stop and target are cancelled too.
+void CloseLadderTrades(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, LadderState& ladder, DailyRiskState& risk,
+    float exitPrice, float currencyPerPoint, bool cancelAttachedOrders) {
+    for (int i = 0; i < MAX_LADDER_LEVELS; i++) {
+        LadderLevel& level = ladder.Levels[i];
+        if (level.State != LADDER_IN_TRADE)
+            continue;
+        if (cancelAttachedOrders) {
+            LimitedCancelOrder(sc, limiter, level.Side == SIDE_LONG ? level.BuyStopID : level.SellStopID);
+            LimitedCancelOrder(sc, limiter, level.Side == SIDE_LONG ? level.BuyTargetID : level.SellTargetID);
+        }
+        RecordLadderTrade(risk, level, exitPrice, currencyPerPoint);
+        level = LadderLevel();
+        ladder.StateVersion++;
+    }
+}
+
+// Starts tracking the fills of a trade entered through 'parentOrderID'. The attached stop and target
+// IDs of each group come from the submission; if they are unknown (state inferred by the bootstrap),
+// they are looked up in the order list (FindAttachedOrders).
+void BeginFillTracking(SCStudyInterfaceRef& sc, TradeFillTracker& fills, int parentOrderID, TradeSide side, const ArmedBracketInfo& bracket, float filledQuantity) {
+    fills = TradeFillTracker();
+    fills.EntryOrderID = parentOrderID;
+    fills.EntryWorking = true; // Settled by the first lookup of the entry order.
+    fills.EntryFilledQuantity = filledQuantity;
+    fills.NumGroups = bracket.NumTargets;
+    for (int group = 0; group < bracket.NumTargets && group < MAX_SCALE_OUT_TARGETS; group++) {
+        fills.StopOrderIDs[group] = (side == SIDE_LONG) ? bracket.BuyStopIDs[group] : bracket.SellStopIDs[group];
+        fills.TargetOrderIDs[group] = (side == SIDE_LONG) ? bracket.BuyTargetIDs[group] : bracket.SellTargetIDs[group];
+    }
+
+    s_SCTradeOrder order;
+    if (fills.NumGroups > 0 && fills.StopOrderIDs[0] != 0 && fills.TargetOrderIDs[0] != 0 &&
+        GetOrderStatusByID(sc, fills.StopOrderIDs[0], order) != SCT_OSC_UNSPECIFIED && order.ParentInternalOrderID == parentOrderID)
+        return;
+    FindAttachedOrders(sc, fills);
+}
+
+// Walks the order list for the attached orders of the tracked entry and pairs each target with its
+// OCO sibling stop. Leaves NumGroups at 0 if none is listed yet, or if a target is listed before its
+// stop is linked to it; the caller looks again on a later update.
+void FindAttachedOrders(SCStudyInterfaceRef& sc, TradeFillTracker& fills) {
+    s_SCTradeOrder order;
+    fills.NumGroups = 0;
+    int orderIndex = 0;
+    while (fills.NumGroups < MAX_SCALE_OUT_TARGETS && sc.GetOrderByIndex(orderIndex++, order) != SCTRADING_ORDER_ERROR) {
+        if (order.ParentInternalOrderID != fills.EntryOrderID)
+            continue;
+        bool isStop = order.OrderTypeAsInt == SCT_ORDERTYPE_STOP || order.OrderTypeAsInt == SCT_ORDERTYPE_STOP_LIMIT ||
+            order.OrderTypeAsInt == SCT_ORDERTYPE_TRAILING_STOP;
+        if (isStop)
+            continue;
+        if (order.OCOSiblingInternalOrderID == 0) {
+            fills.NumGroups = 0;
+            return;
+        }
+        fills.TargetOrderIDs[fills.NumGroups] = order.InternalOrderID;
+        fills.StopOrderIDs[fills.NumGroups] = order.OCOSiblingInternalOrderID;
+        fills.NumGroups++;
+    }
+}
+
+// Resizes the working part of an attached order to 'openQuantity'. Returns true if a modify was sent;
+// false if the order already matches or no tokens are available (the caller retries next update).
+bool LimitedResizeOrder(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, const s_SCTradeOrder& order, float openQuantity) {
+    double workingQuantity = order.OrderQuantity - order.FilledQuantity;
+    if (workingQuantity == openQuantity || !AcquireOrderTokens(limiter, ORDER_COST_SINGLE))
+        return false;
+    s_SCNewOrder modifyOrder;
+    modifyOrder.InternalOrderID = order.InternalOrderID;
+    modifyOrder.OrderQuantity = order.FilledQuantity + openQuantity;
+    sc.ModifyOrder(modifyOrder);
+    return true;
+}
+
+// Moves a working stop to 'price'. Returns true if a modify was sent; false if it is already there or
+// no tokens are available (the caller retries next update).
+bool LimitedMoveStopOrder(SCStudyInterfaceRef& sc, OrderRateLimiter& limiter, const s_SCTradeOrder& order, float price) {
+    if (static_cast<float>(order.Price1) == price || !AcquireOrderTokens(limiter, ORDER_COST_SINGLE))
+        return false;
+    s_SCNewOrder modifyOrder;
+    modifyOrder.InternalOrderID = order.InternalOrderID;
+    modifyOrder.Price1 = price;
+    sc.ModifyOrder(modifyOrder);
+    return true;
+}
+
+// Reads the stamp of the file at 'path'. Returns false (and a stamp of -1) if it does not exist.
+bool ReadFileStamp(const char* path, FileStamp& stamp) {
+    stamp.ModificationTime = -1;
+    stamp.Size = -1;
+    if (path == NULL || path[0] == '\0')
+        return false;
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info))
+        return false;
+    stamp.ModificationTime = (static_cast<long long>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+    stamp.Size = (static_cast<long long>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+#else
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return false;
+#if defined(__APPLE__)
+    stamp.ModificationTime = static_cast<long long>(info.st_mtimespec.tv_sec) * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+    stamp.ModificationTime = static_cast<long long>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+    stamp.Size = static_cast<long long>(info.st_size);
+#endif
+    return true;
+}
+
+bool SameFileStamp(const FileStamp& a, const FileStamp& b) {
+    return a.ModificationTime == b.ModificationTime && a.Size == b.Size;
+}
+
+// Reads the parameter file at 'path' into 'parameters'. File format, one parameter per line, '#'
+// starts a comment, times in the chart time zone:
+//   BRACKET_FRAC <fraction>         e.g. BRACKET_FRAC 0.4
+//   STOP_FRAC    <fraction>         e.g. STOP_FRAC 0.5
+//   TP_FRAC      <fraction>         e.g. TP_FRAC 1.0
+//   START_TIME   <time>             e.g. START_TIME 08:30:00
+//   STOP_TIME    <time>             e.g. STOP_TIME 15:00:00
+// Values are checked against the limits of the corresponding inputs. Returns false without a usable
+// result if any line is invalid.
+bool LoadParameterFile(const char* path, StrategyParameterSet& parameters, SCString& errorMessage) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        errorMessage = "file not found or not readable";
+        return false;
+    }
+
+    bool hasStartTime = false, hasStopTime = false;
+    char line[256];
+    int lineNumber = 0;
+    bool parseError = false;
+    while (!parseError && fgets(line, sizeof(line), file) != NULL) {
+        ++lineNumber;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+
+        char keyword[16] = "", value[32] = "";
+        int numFields = sscanf(line, "%15s %31s", keyword, value);
+        if (numFields <= 0)
+            continue; // Blank or comment-only line.
+        if (numFields != 2) {
+            parseError = true;
+            break;
+        }
+
+        // A fraction must be a number and nothing else ("0.5x" or "abc" is rejected, not read as 0.5 or 0).
+        // The range checks are written so that a NaN fails them too.
+        char* valueEnd = NULL;
+        float fraction = strtof(value, &valueEnd);
+        bool fractionValid = valueEnd != value && *valueEnd == '\0';
+        if (strcmp(keyword, "BRACKET_FRAC") == 0) {
+            parameters.BracketFraction = fraction;
+            parameters.HasBracketFraction = true;
+            parseError = !fractionValid || !(fraction >= 0.001f && fraction <= 5.0f);
+        } else if (strcmp(keyword, "STOP_FRAC") == 0) {
+            parameters.StopFraction = fraction;
+            parameters.HasStopFraction = true;
+            parseError = !fractionValid || !(fraction >= 0.001f && fraction <= 10.0f);
+        } else if (strcmp(keyword, "TP_FRAC") == 0) {
+            parameters.TakeProfitFraction = fraction;
+            parameters.HasTakeProfitFraction = true;
+            parseError = !fractionValid || !(fraction >= 0.001f && fraction <= 20.0f);
+        } else if (strcmp(keyword, "START_TIME") == 0) {
+            parameters.StartTime = ParseCalendarTime(value);
+            hasStartTime = true;
+            parseError = parameters.StartTime < 0;
+        } else if (strcmp(keyword, "STOP_TIME") == 0) {
+            parameters.StopTime = ParseCalendarTime(value);
+            hasStopTime = true;
+            parseError = parameters.StopTime < 0;
+        } else {
+            parseError = true;
+        }
+    }
+    fclose(file);
+
+    if (parseError) {
+        errorMessage.Format("invalid parameter or value on line %d", lineNumber);
+        return false;
+    }
+    if (hasStartTime != hasStopTime || (hasStartTime && parameters.StopTime <= parameters.StartTime)) {
+        errorMessage = "START_TIME and STOP_TIME must both be set, with STOP_TIME after START_TIME";
+        return false;
+    }
+    parameters.HasWindow = hasStartTime;
+    return true;
+}
+
+// True if both sets override the same parameters with the same values.
+bool SameParameterSet(const StrategyParameterSet& a, const StrategyParameterSet& b) {
+    return a.HasBracketFraction == b.HasBracketFraction && (!a.HasBracketFraction || a.BracketFraction == b.BracketFraction) &&
+        a.HasStopFraction == b.HasStopFraction && (!a.HasStopFraction || a.StopFraction == b.StopFraction) &&
+        a.HasTakeProfitFraction == b.HasTakeProfitFraction && (!a.HasTakeProfitFraction || a.TakeProfitFraction == b.TakeProfitFraction) &&
+        a.HasWindow == b.HasWindow && (!a.HasWindow || (a.StartTime == b.StartTime && a.StopTime == b.StopTime));
+}
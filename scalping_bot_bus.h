@@ -0,0 +1,288 @@
+/*
+* ===================================================================
+*   Scalping Bot - Shared-Memory Bus
+* ===================================================================
+*
+*   Layout of the shared-memory segment between the study (publisher of
+*   market data and order events, executor of order commands) and an
+*   external strategy process (tools/bus_strategy.cpp). Included by both,
+*   so every structure here is plain data with fixed-width fields.
+*
+*   The segment holds two single-producer, single-consumer rings:
+*   - Events:   study -> strategy. Ticks, market depth, order status, position.
+*   - Commands: strategy -> study. Bracket submissions, cancels, flattens.
+*
+*   The segment is a file mapping. On Windows the study maps a file with
+*   CreateFileMapping; under Wine, a path on Z:\dev\shm is the same memory
+*   as /dev/shm for a native Linux process mapping it with mmap.
+*
+* ===================================================================
+*/
+
+#ifndef SCALPING_BOT_BUS_H
+#define SCALPING_BOT_BUS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define BUS_MAGIC 0x53554253u               // "SBUS"
+#define BUS_VERSION 1
+#define BUS_CACHE_LINE 64
+#define BUS_EVENT_RING_LOG2 14              // 16384 events.
+#define BUS_COMMAND_RING_LOG2 10            // 1024 commands.
+#define BUS_DEPTH_LEVELS 5
+
+// Single-producer, single-consumer ring of fixed-size slots. Head and Tail are free-running counters
+// on separate cache lines; each side also keeps its last view of the other's counter on its own line,
+// so the shared counter is only read when the ring looks full (producer) or empty (consumer).
+template <typename T, int CapacityLog2>
+struct BusRing {
+    static const uint64_t Capacity = 1ull << CapacityLog2;
+
+    alignas(BUS_CACHE_LINE) std::atomic<uint64_t> Head;    // Written by the producer only.
+    uint64_t CachedTail;
+    alignas(BUS_CACHE_LINE) std::atomic<uint64_t> Tail;    // Written by the consumer only.
+    uint64_t CachedHead;
+    alignas(BUS_CACHE_LINE) T Slots[Capacity];
+};
+
+// Producer side. Returns false (and leaves the ring unchanged) if it is full.
+template <typename T, int CapacityLog2>
+inline bool BusRingPush(BusRing<T, CapacityLog2>& ring, const T& item) {
+    uint64_t head = ring.Head.load(std::memory_order_relaxed);
+    if (head - ring.CachedTail >= ring.Capacity) {
+        ring.CachedTail = ring.Tail.load(std::memory_order_acquire);
+        if (head - ring.CachedTail >= ring.Capacity)
+            return false;
+    }
+    ring.Slots[head & (ring.Capacity - 1)] = item;
+    ring.Head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+// Consumer side. Returns false if the ring is empty.
+template <typename T, int CapacityLog2>
+inline bool BusRingPop(BusRing<T, CapacityLog2>& ring, T& item) {
+    uint64_t tail = ring.Tail.load(std::memory_order_relaxed);
+    if (tail == ring.CachedHead) {
+        ring.CachedHead = ring.Head.load(std::memory_order_acquire);
+        if (tail == ring.CachedHead)
+            return false;
+    }
+    item = ring.Slots[tail & (ring.Capacity - 1)];
+    ring.Tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+//── Events (study -> strategy) ──────────────────────────────────────────
+
+enum BusEventType {
+    BUS_EVENT_TICK = 1,
+    BUS_EVENT_DEPTH = 2,
+    BUS_EVENT_ORDER = 3,                // Status or fill change of an order submitted for the bus.
+    BUS_EVENT_BRACKET_SUBMITTED = 4,    // Reply to BUS_COMMAND_SUBMIT_BRACKET with the order IDs.
+    BUS_EVENT_COMMAND_REJECTED = 5,     // Command not executed (rate limited, submission failed).
+    BUS_EVENT_POSITION = 6
+};
+
+// Order status as seen by the strategy. The study maps the ACSIL status codes onto these.
+enum BusOrderStatus {
+    BUS_ORDER_PENDING = 0,              // Sent, pending open, or attached order waiting for its parent.
+    BUS_ORDER_WORKING = 1,
+    BUS_ORDER_FILLED = 2,
+    BUS_ORDER_CANCELED = 3,
+    BUS_ORDER_ERROR = 4                 // Rejected, or no longer found.
+};
+
+struct BusTick {
+    double Price;                       // Last trade.
+    double Bid;
+    double Ask;
+    double RangeR;                      // The study's current 'R', 0 if invalid.
+    float Volume;                       // Volume of the last bar so far.
+    int32_t BarIndex;
+};
+
+struct BusDepth {
+    double BidPrice[BUS_DEPTH_LEVELS];
+    double AskPrice[BUS_DEPTH_LEVELS];
+    float BidQuantity[BUS_DEPTH_LEVELS];
+    float AskQuantity[BUS_DEPTH_LEVELS];
+    int32_t NumBidLevels;
+    int32_t NumAskLevels;
+};
+
+struct BusOrderUpdate {
+    int32_t OrderID;
+    int32_t Status;                     // BusOrderStatus.
+    float FilledQuantity;
+    float Quantity;
+    double AvgFillPrice;
+};
+
+struct BusBracketSubmitted {
+    int32_t CommandID;
+    int32_t BuyOrderID;
+    int32_t SellOrderID;
+    int32_t BuyStopID;
+    int32_t BuyTargetID;
+    int32_t SellStopID;
+    int32_t SellTargetID;
+};
+
+struct BusCommandRejected {
+    int32_t CommandID;
+    int32_t Reason;                     // BusRejectReason.
+};
+
+enum BusRejectReason {
+    BUS_REJECT_RATE_LIMITED = 1,
+    BUS_REJECT_SUBMIT_FAILED = 2,
+    BUS_REJECT_INVALID = 3,
+    BUS_REJECT_KILL_SWITCH = 4,         // The study's daily risk kill switch has tripped.
+    BUS_REJECT_STALE_FEED = 5           // The study's stale-feed guard holds.
+};
+
+struct BusPosition {
+    double Quantity;                    // Signed.
+    double AveragePrice;
+};
+
+struct BusEvent {
+    uint32_t Type;                      // BusEventType.
+    uint32_t Reserved;
+    uint64_t Sequence;                  // Per published event, from 1. Commands echo it.
+    double ExchangeTime;                // SCDateTime of the latest trade (days since 1899-12-30, chart time zone).
+    union {
+        BusTick Tick;
+        BusDepth Depth;
+        BusOrderUpdate Order;
+        BusBracketSubmitted Bracket;
+        BusCommandRejected Rejected;
+        BusPosition Position;
+    };
+};
+
+//── Commands (strategy -> study) ────────────────────────────────────────
+
+enum BusCommandType {
+    BUS_COMMAND_SUBMIT_BRACKET = 1,     // OCO buy limit / sell limit, each with one attached stop and target.
+    BUS_COMMAND_CANCEL = 2,
+    BUS_COMMAND_FLATTEN = 3,            // Flatten and cancel all orders.
+    BUS_COMMAND_NOOP = 4                // Only measures the round trip.
+};
+
+struct BusCommand {
+    uint32_t Type;                      // BusCommandType.
+    int32_t CommandID;
+    uint64_t TriggerSequence;           // Sequence of the event the decision was made on, 0 if none.
+    double BuyPrice;
+    double SellPrice;
+    double StopOffset;
+    double TargetOffset;
+    int32_t Quantity;
+    int32_t OrderID;                    // For BUS_COMMAND_CANCEL.
+};
+
+//── Segment ─────────────────────────────────────────────────────────────
+
+struct BusSegment {
+    uint32_t Magic;
+    uint32_t Version;
+    std::atomic<uint32_t> Epoch;        // Incremented each time the study initializes the segment.
+    std::atomic<uint64_t> EventsDropped;    // Events the study could not publish because the ring was full.
+    alignas(BUS_CACHE_LINE) BusRing<BusEvent, BUS_EVENT_RING_LOG2> Events;
+    BusRing<BusCommand, BUS_COMMAND_RING_LOG2> Commands;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The bus needs address-free 64-bit atomics.");
+
+// An open mapping of the segment.
+struct BusMapping {
+#if defined(_WIN32)
+    HANDLE File;
+    HANDLE Mapping;
+#else
+    int File;
+#endif
+    BusSegment* Segment;
+};
+
+// Maps the segment file at 'path', creating and sizing it if needed. With 'initialize' (the study),
+// the rings are reset and the epoch advanced; otherwise the segment must already carry the magic and
+// version. Returns NULL on failure.
+inline BusSegment* OpenBusSegment(const char* path, bool initialize, BusMapping& mapping) {
+    mapping = BusMapping();
+    void* view = NULL;
+#if defined(_WIN32)
+    mapping.File = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapping.File == INVALID_HANDLE_VALUE)
+        return NULL;
+    unsigned long long size = sizeof(BusSegment);
+    mapping.Mapping = CreateFileMappingA(mapping.File, NULL, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), NULL);
+    if (mapping.Mapping != NULL)
+        view = MapViewOfFile(mapping.Mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(BusSegment));
+    if (view == NULL) {
+        if (mapping.Mapping != NULL) CloseHandle(mapping.Mapping);
+        CloseHandle(mapping.File);
+        mapping = BusMapping();
+        return NULL;
+    }
+#else
+    mapping.File = open(path, O_RDWR | O_CREAT, 0600);
+    if (mapping.File < 0)
+        return NULL;
+    if (ftruncate(mapping.File, sizeof(BusSegment)) != 0 ||
+        (view = mmap(NULL, sizeof(BusSegment), PROT_READ | PROT_WRITE, MAP_SHARED, mapping.File, 0)) == MAP_FAILED) {
+        close(mapping.File);
+        mapping = BusMapping();
+        return NULL;
+    }
+#endif
+    BusSegment* segment = static_cast<BusSegment*>(view);
+    if (initialize) {
+        segment->Magic = 0;
+        segment->Events.Head.store(0, std::memory_order_relaxed);
+        segment->Events.Tail.store(0, std::memory_order_relaxed);
+        segment->Events.CachedHead = segment->Events.CachedTail = 0;
+        segment->Commands.Head.store(0, std::memory_order_relaxed);
+        segment->Commands.Tail.store(0, std::memory_order_relaxed);
+        segment->Commands.CachedHead = segment->Commands.CachedTail = 0;
+        segment->EventsDropped.store(0, std::memory_order_relaxed);
+        segment->Version = BUS_VERSION;
+        segment->Epoch.fetch_add(1, std::memory_order_release);
+        segment->Magic = BUS_MAGIC;
+    }
+    mapping.Segment = segment;
+    return segment;
+}
+
+inline void CloseBusSegment(BusMapping& mapping) {
+    if (mapping.Segment == NULL)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(mapping.Segment);
+    CloseHandle(mapping.Mapping);
+    CloseHandle(mapping.File);
+#else
+    munmap(mapping.Segment, sizeof(BusSegment));
+    close(mapping.File);
+#endif
+    mapping = BusMapping();
+}
+
+// Whether the segment has been initialized by a study of this bus version.
+inline bool IsBusSegmentReady(const BusSegment& segment) {
+    return segment.Magic == BUS_MAGIC && segment.Version == BUS_VERSION;
+}
+
+#endif // SCALPING_BOT_BUS_H
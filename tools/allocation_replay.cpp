@@ -0,0 +1,304 @@
+/*
+* ===================================================================
+*   Scalping Bot - Allocation Replay Harness
+* ===================================================================
+*
+*   Builds the study (scalping_bot.cpp) against the Sierra Chart stub
+*   (sierra_stub/sierrachart.h) and replays a one-tick random walk of
+*   the mid price through it, one study call per trade, with trades
+*   alternating between the bid and the ask of a two-tick book and the
+*   stub's simulated trade service filling the bracket legs and their
+*   attached orders.
+*
+*   Every operator new and every malloc, calloc and realloc in the
+*   process is counted while a study call runs. A steady-state call
+*   is one that starts and ends with the bracket armed, or in the
+*   same trade, without a state transition: the polling path the
+*   README promises is allocation free. The harness prints the counts
+*   per study and exits with 1 if any steady-state call allocated, or
+*   if the replay never reached the armed or the in-trade state.
+*
+*   The allocator hooks forward to glibc's __libc_* functions, so the
+*   harness builds on Linux with glibc only.
+*
+*   Build:  g++ -std=c++17 -O2 -pthread -Isierra_stub -I.. allocation_replay.cpp -o allocation_replay
+*   Run:    ./allocation_replay [--ticks N] [--seed N] [--verbose]
+*
+* ===================================================================
+*/
+
+#include "scalping_bot.cpp"
+
+#include <cstdint>
+#include <new>
+#include <random>
+
+//── Allocation Counting ───────────────────────────────────────────────
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* memory, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* memory);
+}
+
+static bool CountingAllocations = false;
+static long long NewCount = 0;
+static long long MallocCount = 0;
+
+extern "C" void* malloc(size_t size) {
+    if (CountingAllocations) MallocCount++;
+    return __libc_malloc(size);
+}
+extern "C" void* calloc(size_t count, size_t size) {
+    if (CountingAllocations) MallocCount++;
+    return __libc_calloc(count, size);
+}
+extern "C" void* realloc(void* memory, size_t size) {
+    if (CountingAllocations) MallocCount++;
+    return __libc_realloc(memory, size);
+}
+extern "C" void free(void* memory) {
+    __libc_free(memory);
+}
+
+static void* CountedNew(size_t size, size_t alignment) {
+    if (CountingAllocations) NewCount++;
+    if (size == 0) size = 1;
+    void* memory = alignment > alignof(std::max_align_t) ? __libc_memalign(alignment, size) : __libc_malloc(size);
+    if (memory == NULL)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(size_t size) { return CountedNew(size, 0); }
+void* operator new[](size_t size) { return CountedNew(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return CountedNew(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return CountedNew(size, static_cast<size_t>(alignment)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    if (CountingAllocations) NewCount++;
+    return __libc_malloc(size != 0 ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    if (CountingAllocations) NewCount++;
+    return __libc_malloc(size != 0 ? size : 1);
+}
+void operator delete(void* memory) noexcept { __libc_free(memory); }
+void operator delete[](void* memory) noexcept { __libc_free(memory); }
+void operator delete(void* memory, size_t) noexcept { __libc_free(memory); }
+void operator delete[](void* memory, size_t) noexcept { __libc_free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { __libc_free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { __libc_free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { __libc_free(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { __libc_free(memory); }
+
+//── Replay ────────────────────────────────────────────────────────────
+
+static const int MAX_BARS = 4096;
+static const int TICKS_PER_BAR = 600;       // One-minute bars at one trade per 100 ms.
+static const double TICK_SECONDS = 0.1;
+static const float TICK_SIZE = 0.25f;
+static const float RANGE_R = 4.0f;          // 16 ticks: entries 8 ticks out, stop 8 and target 16 ticks from entry.
+
+typedef void (*StudyFunction)(SCStudyInterfaceRef);
+
+struct StudyCase {
+    const char* Name;
+    StudyFunction Function;
+};
+
+struct ReplayResult {
+    long long Calls;
+    long long ArmedCalls;               // Steady-state calls with the bracket armed.
+    long long InTradeCalls;             // Steady-state calls in a trade.
+    long long Entries;
+    long long AllocatingCalls;
+    long long NewCount;
+    long long MallocCount;
+};
+
+static bool Verbose = false;
+
+static void PrintLog(const char* message) {
+    if (Verbose)
+        printf("    %s\n", message);
+}
+
+// Bar arrays shared by the replays; each study gets its own interface and persistent state.
+static float Closes[MAX_BARS], Highs[MAX_BARS], Lows[MAX_BARS], Volumes[MAX_BARS], RangeValues[MAX_BARS];
+static SCDateTime BarTimes[MAX_BARS];
+static float SubgraphData[STUB_MAX_SUBGRAPHS][MAX_BARS];
+
+static void AttachBars(s_sc& sc, int numBars) {
+    sc.ArraySize = numBars;
+    sc.Close.Attach(Closes, numBars);
+    sc.High.Attach(Highs, numBars);
+    sc.Low.Attach(Lows, numBars);
+    sc.Volume.Attach(Volumes, numBars);
+    sc.BaseDateTimeIn.Attach(BarTimes, numBars);
+    sc.StubStudyArray.Attach(RangeValues, numBars);
+    for (int i = 0; i < STUB_MAX_SUBGRAPHS; i++)
+        sc.Subgraph[i].Data.Attach(SubgraphData[i], numBars);
+}
+
+// The replayed path is the mid price. The book is two ticks wide around it and trades alternate
+// between the bid and the ask, so the last trade and the mid center brackets differently.
+static float TradePrice(const int32_t* path, long long tick) {
+    return (path[tick] + (tick % 2 == 0 ? -1 : 1)) * TICK_SIZE;
+}
+
+// Sets the book around 'mid' and the last trade to 'price': one lot at the best bid and ask, 20 behind them.
+static void SetMarket(s_sc& sc, float mid, float price, SCDateTime now) {
+    int last = sc.ArraySize - 1;
+    Closes[last] = price;
+    if (price > Highs[last]) Highs[last] = price;
+    if (price < Lows[last]) Lows[last] = price;
+    Volumes[last] += 1.0f;
+    sc.Bid = mid - TICK_SIZE;
+    sc.Ask = mid + TICK_SIZE;
+    sc.StubDepthLevels = STUB_MAX_DEPTH_LEVELS;
+    for (int level = 0; level < STUB_MAX_DEPTH_LEVELS; level++) {
+        sc.StubBidDepth[level].Price = sc.Bid - level * TICK_SIZE;
+        sc.StubAskDepth[level].Price = sc.Ask + level * TICK_SIZE;
+        sc.StubBidDepth[level].Quantity = level == 0 ? 1 : 20;
+        sc.StubAskDepth[level].Quantity = level == 0 ? 1 : 20;
+    }
+    sc.CurrentSystemDateTime = now;
+    sc.CurrentSystemDateTimeMS = now;
+    sc.LatestDateTimeForLastBar = now - SCDateTime::MILLISECONDS(20);
+}
+
+static ReplayResult Replay(const StudyCase& study, const int32_t* path, long long numTicks) {
+    ReplayResult result = ReplayResult();
+    s_sc* interface = new s_sc();
+    s_sc& sc = *interface;
+    sc.StubLog = PrintLog;
+    sc.ChartNumber = 1;
+    sc.Symbol = "ESM6";
+    sc.TickSize = TICK_SIZE;
+    sc.CurrencyValuePerTick = 12.5f;
+    sc.StartTime1 = HMS_TIME(8, 30, 0);
+    sc.EndTime1 = HMS_TIME(15, 15, 0);
+
+    sc.SetDefaults = 1;
+    study.Function(sc);
+    sc.SetDefaults = 0;
+    sc.Input[8].SetYesNo(true);         // Enable Trading.
+    sc.Input[48].SetFloat(5000.0f);     // Stale feed guard on, far above the replayed 20 ms feed latency.
+
+    // Trading day 2026-06-01 from 09:00, inside the default 08:30-15:00 window.
+    SCDateTime start(SierraDateFromCivil(2026, 6, 1), HMS_TIME(9, 0, 0));
+    int numBars = 1;
+    BarTimes[0] = start;
+    Closes[0] = Highs[0] = Lows[0] = TradePrice(path, 0);
+    for (int i = 0; i < MAX_BARS; i++) RangeValues[i] = RANGE_R;
+    AttachBars(sc, numBars);
+    SetMarket(sc, path[0] * TICK_SIZE, TradePrice(path, 0), start);
+    sc.IsFullRecalculation = 1;
+    sc.UpdateStartIndex = 0;
+    study.Function(sc);
+    sc.IsFullRecalculation = 0;
+
+    for (long long tick = 1; tick < numTicks; tick++) {
+        SCDateTime now = start + SCDateTime(tick * TICK_SECONDS / SECONDS_PER_DAY);
+        float price = TradePrice(path, tick);
+        if (tick % TICKS_PER_BAR == 0 && numBars < MAX_BARS) {
+            BarTimes[numBars] = now;
+            Closes[numBars] = Highs[numBars] = Lows[numBars] = price;
+            Volumes[numBars] = 0.0f;
+            AttachBars(sc, ++numBars);
+        }
+        sc.UpdateStartIndex = numBars - 1;
+        sc.StubBarClosed = 0;
+        SetMarket(sc, path[tick] * TICK_SIZE, price, now);
+        sc.StubTrade(price);
+
+        int sideBefore = sc.GetPersistentInt(PID_CURRENT_TRADE_SIDE);
+        int bracketBefore = sc.GetPersistentInt(PID_IS_BRACKET_ARMED);
+        long long newBefore = NewCount, mallocBefore = MallocCount;
+        CountingAllocations = true;
+        study.Function(sc);
+        CountingAllocations = false;
+        long long newCalls = NewCount - newBefore, mallocCalls = MallocCount - mallocBefore;
+        int sideAfter = sc.GetPersistentInt(PID_CURRENT_TRADE_SIDE);
+        int bracketAfter = sc.GetPersistentInt(PID_IS_BRACKET_ARMED);
+
+        result.Calls++;
+        if (sideBefore == SIDE_FLAT && sideAfter != SIDE_FLAT)
+            result.Entries++;
+        bool steadyState = (sideBefore != SIDE_FLAT || bracketBefore == BRACKET_ARMED_AND_WORKING) &&
+            sideBefore == sideAfter && bracketBefore == bracketAfter;
+        if (!steadyState)
+            continue;
+        if (sideBefore != SIDE_FLAT) result.InTradeCalls++;
+        else result.ArmedCalls++;
+        if (newCalls + mallocCalls > 0) {
+            result.AllocatingCalls++;
+            result.NewCount += newCalls;
+            result.MallocCount += mallocCalls;
+            if (Verbose)
+                printf("    tick %lld: %lld operator new, %lld malloc (side %d, bracket %d)\n", tick, newCalls, mallocCalls, sideBefore, bracketBefore);
+        }
+    }
+
+    sc.LastCallToFunction = 1;
+    study.Function(sc);
+    delete interface;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    long long numTicks = 100000;
+    unsigned int seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) numTicks = strtoll(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+        else if (strcmp(argv[i], "--verbose") == 0) Verbose = true;
+        else {
+            fprintf(stderr, "Usage: allocation_replay [--ticks N] [--seed N] [--verbose]\n");
+            return 2;
+        }
+    }
+    long long maxTicks = static_cast<long long>(MAX_BARS) * TICKS_PER_BAR;
+    if (numTicks < 2 || numTicks > maxTicks) {
+        fprintf(stderr, "--ticks must be between 2 and %lld.\n", maxTicks);
+        return 2;
+    }
+
+    int32_t* path = new int32_t[numTicks];
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> move(-1, 1);
+    int32_t price = 20000; // 5000.00 in ticks.
+    for (long long i = 0; i < numTicks; i++) {
+        price += move(random);
+        path[i] = price;
+    }
+
+    // The calendar-gated studies never arm without a calendar file, so only the window-gated ones are replayed.
+    const StudyCase studies[] = {
+        { "Scalping Bot", scsf_Scalping_Bot },
+        { "Close, Static Exit, Window", scsf_Scalping_Bot_Close_Static_Window },
+        { "Mid, Trailing Stop, Window", scsf_Scalping_Bot_Mid_Trailing_Window },
+        { "Built-in R, Close, Time Stop, Window", scsf_Scalping_Bot_BuiltInR_Close_TimeStop_Window },
+    };
+
+    printf("Allocation replay, %lld ticks, seed %u\n\n", numTicks, seed);
+    printf("  %-38s %10s %10s %8s %11s %12s %8s\n", "Study", "Armed", "In trade", "Entries", "Allocating", "operator new", "malloc");
+    bool failed = false;
+    for (const StudyCase& study : studies) {
+        ReplayResult result = Replay(study, path, numTicks);
+        printf("  %-38s %10lld %10lld %8lld %11lld %12lld %8lld\n", study.Name, result.ArmedCalls, result.InTradeCalls,
+            result.Entries, result.AllocatingCalls, result.NewCount, result.MallocCount);
+        if (result.AllocatingCalls > 0)
+            failed = true;
+        if (result.ArmedCalls == 0 || result.InTradeCalls == 0) {
+            printf("    The replay did not reach both the armed and the in-trade state.\n");
+            failed = true;
+        }
+    }
+    delete[] path;
+
+    printf("\n%s\n", failed ? "FAILED: steady-state calls allocated, or a state was not reached." : "OK: no steady-state call allocated.");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,300 @@
+/*
+* ===================================================================
+*   Scalping Bot - Bracket Core
+* ===================================================================
+*
+*   The bracket strategy without Sierra Chart: offsets from 'R', the
+*   OCO entry prices around a center price, and the FLAT / ARMED /
+*   IN TRADE state machine with its safety flatten. Shared by the tools
+*   that run the strategy outside the study (external process on the
+*   shared-memory bus, standalone DTC engine).
+*
+*   It is a reduced model of the study's single-bracket path, not a
+*   copy of it: one stop and one target, no ladder, scale-out,
+*   imbalance gate, requotes, parameter file or kill switch. Prices
+*   and offsets are rounded like the study does with
+*   sc.RoundToIncrement and sc.RoundToTickSize, so the same inputs
+*   give the same order prices. bracket_parity.cpp runs it next to
+*   the study and fails if the brackets, states or trades diverge;
+*   run it after changing either side.
+*
+*   The state machine does no I/O: it consumes market data and order
+*   events and leaves the order commands to send in Commands[].
+*
+* ===================================================================
+*/
+
+#ifndef SCALPING_BOT_BRACKET_CORE_H
+#define SCALPING_BOT_BRACKET_CORE_H
+
+#include <cmath>
+
+// Strategy parameters, as the study's inputs of the same names.
+struct BracketParameters {
+    double TickSize;
+    double BracketFraction;         // Fraction of R: distance from the center to the OCO entry limits.
+    double StopFraction;            // Fraction of R: stop-loss distance from the entry price.
+    double TakeProfitFraction;      // Fraction of R: take-profit distance from the entry price.
+    int Quantity;
+    int StartTimeSeconds;           // Trading window, seconds since midnight. -1 = no window.
+    int StopTimeSeconds;            // Open trades are flattened at this time.
+};
+
+// Order prices of one bracket.
+struct BracketLevels {
+    double BuyPrice;
+    double SellPrice;
+    double StopOffset;
+    double TargetOffset;
+};
+
+// Nearest multiple of 'increment', as sc.RoundToIncrement and sc.RoundToTickSize.
+inline double RoundToIncrement(double value, double increment) {
+    return std::floor(value / increment + 0.5) * increment;
+}
+
+// Offsets are fractions of R rounded to the tick size and at least one tick; the entry limits sit
+// one entry offset either side of the center, and never cross.
+inline BracketLevels ComputeBracketLevels(const BracketParameters& parameters, double center, double rValue) {
+    double tick = parameters.TickSize;
+    double entryOffset = RoundToIncrement(rValue * parameters.BracketFraction, tick);
+    BracketLevels levels;
+    levels.StopOffset = RoundToIncrement(rValue * parameters.StopFraction, tick);
+    levels.TargetOffset = RoundToIncrement(rValue * parameters.TakeProfitFraction, tick);
+    if (entryOffset < tick) entryOffset = tick;
+    if (levels.StopOffset < tick) levels.StopOffset = tick;
+    if (levels.TargetOffset < tick) levels.TargetOffset = tick;
+    levels.BuyPrice = RoundToIncrement(center - entryOffset, tick);
+    levels.SellPrice = RoundToIncrement(center + entryOffset, tick);
+    if (levels.BuyPrice >= levels.SellPrice)
+        levels.BuyPrice = RoundToIncrement(levels.SellPrice - tick, tick);
+    return levels;
+}
+
+// Built-in 'R' from a trade stream: time bars of BarSeconds (a bar per interval that has trades) and an
+// exponential moving average of the closed bars' high-low range over Length bars, the first closed bar
+// seeding it, as the study's built-in 'R' estimator.
+struct TradeRangeEstimator {
+    int BarSeconds;
+    int Length;
+    long long BarStart;             // Start of the open bar, seconds. -1 before the first trade.
+    double High;
+    double Low;
+    int ClosedBars;
+    double Value;                   // 0 until a bar has closed.
+};
+
+inline void ResetTradeRangeEstimator(TradeRangeEstimator& estimator, int barSeconds, int length) {
+    estimator = TradeRangeEstimator();
+    estimator.BarSeconds = barSeconds > 0 ? barSeconds : 1;
+    estimator.Length = length > 0 ? length : 1;
+    estimator.BarStart = -1;
+}
+
+inline double UpdateTradeRange(TradeRangeEstimator& estimator, double timeSeconds, double price) {
+    long long barStart = static_cast<long long>(std::floor(timeSeconds / estimator.BarSeconds)) * estimator.BarSeconds;
+    if (barStart != estimator.BarStart) {
+        if (estimator.BarStart >= 0) {
+            double range = estimator.High - estimator.Low;
+            double alpha = 2.0 / (estimator.Length + 1);
+            estimator.Value = estimator.ClosedBars == 0 ? range : estimator.Value + alpha * (range - estimator.Value);
+            estimator.ClosedBars++;
+        }
+        estimator.BarStart = barStart;
+        estimator.High = estimator.Low = price;
+    } else {
+        if (price > estimator.High) estimator.High = price;
+        if (price < estimator.Low) estimator.Low = price;
+    }
+    return estimator.Value;
+}
+
+enum BracketCoreState {
+    CORE_FLAT = 0,
+    CORE_SUBMITTING = 1,            // Bracket command sent, order IDs not known yet.
+    CORE_ARMED = 2,
+    CORE_IN_TRADE = 3,
+    CORE_FLATTENING = 4             // Flatten sent; waiting for the position to be flat.
+};
+
+enum CoreOrderStatus {
+    CORE_ORDER_PENDING = 0,
+    CORE_ORDER_WORKING = 1,
+    CORE_ORDER_FILLED = 2,
+    CORE_ORDER_CANCELED = 3,
+    CORE_ORDER_ERROR = 4
+};
+
+enum BracketCommandType {
+    CORE_COMMAND_SUBMIT_BRACKET = 1,
+    CORE_COMMAND_CANCEL = 2,
+    CORE_COMMAND_FLATTEN = 3        // Flatten and cancel all orders.
+};
+
+struct BracketCommand {
+    BracketCommandType Type;
+    BracketLevels Levels;           // For CORE_COMMAND_SUBMIT_BRACKET.
+    int Quantity;
+    int OrderID;                    // For CORE_COMMAND_CANCEL.
+};
+
+// IDs of the two entry legs and their attached orders, as returned for a submitted bracket.
+struct BracketOrderIDs {
+    int BuyOrderID;
+    int SellOrderID;
+    int BuyStopID;
+    int BuyTargetID;
+    int SellStopID;
+    int SellTargetID;
+};
+
+struct BracketCoreStats {
+    int BracketsSubmitted;
+    int Trades;
+    int Wins;
+    double RealizedPoints;          // Per contract.
+    int SafetyFlattens;
+};
+
+#define MAX_BRACKET_COMMANDS 4
+
+struct BracketStateMachine {
+    BracketParameters Parameters;
+    BracketCoreState State;
+    BracketOrderIDs Orders;
+    int Side;                       // +1 long, -1 short, 0 flat.
+    double EntryPrice;
+    int LostExitOrderID;            // Stop or target cancelled in the trade; flattened on the next market update.
+    BracketCoreStats Stats;
+    BracketCommand Commands[MAX_BRACKET_COMMANDS]; // Produced by the last call; the caller sends and clears them.
+    int NumCommands;
+};
+
+inline void ResetBracketStateMachine(BracketStateMachine& machine, const BracketParameters& parameters) {
+    machine = BracketStateMachine();
+    machine.Parameters = parameters;
+}
+
+inline void PushBracketCommand(BracketStateMachine& machine, BracketCommandType type, int orderID) {
+    if (machine.NumCommands >= MAX_BRACKET_COMMANDS)
+        return;
+    BracketCommand& command = machine.Commands[machine.NumCommands++];
+    command = BracketCommand();
+    command.Type = type;
+    command.OrderID = orderID;
+}
+
+// Market update. Flat and inside the window with a valid R: submit a bracket around 'center'.
+// Before the window start: cancel an armed bracket. At or after the stop time: also flatten.
+// In a trade that lost its stop or target since the last update: flatten.
+inline void OnBracketMarket(BracketStateMachine& machine, int timeOfDaySeconds, double center, double rValue) {
+    if (machine.State == CORE_IN_TRADE && machine.LostExitOrderID != 0) {
+        PushBracketCommand(machine, CORE_COMMAND_FLATTEN, 0);
+        machine.Stats.SafetyFlattens++;
+        machine.LostExitOrderID = 0;
+        machine.State = CORE_FLATTENING;
+        return;
+    }
+    const BracketParameters& parameters = machine.Parameters;
+    bool useWindow = parameters.StartTimeSeconds >= 0;
+    bool beforeStart = useWindow && timeOfDaySeconds < parameters.StartTimeSeconds;
+    bool closed = useWindow && timeOfDaySeconds >= parameters.StopTimeSeconds;
+    if (beforeStart || closed) {
+        if (machine.State == CORE_ARMED) {
+            PushBracketCommand(machine, CORE_COMMAND_CANCEL, machine.Orders.BuyOrderID);
+            PushBracketCommand(machine, CORE_COMMAND_CANCEL, machine.Orders.SellOrderID);
+            machine.State = CORE_FLAT;
+        } else if (machine.State == CORE_IN_TRADE && closed) {
+            PushBracketCommand(machine, CORE_COMMAND_FLATTEN, 0);
+            machine.State = CORE_FLATTENING;
+        }
+        return;
+    }
+    if (machine.State != CORE_FLAT || rValue <= 0.0 || center <= 0.0)
+        return;
+    PushBracketCommand(machine, CORE_COMMAND_SUBMIT_BRACKET, 0);
+    BracketCommand& command = machine.Commands[machine.NumCommands - 1];
+    command.Levels = ComputeBracketLevels(parameters, center, rValue);
+    command.Quantity = parameters.Quantity;
+    machine.State = CORE_SUBMITTING;
+    machine.Stats.BracketsSubmitted++;
+}
+
+inline void OnBracketSubmitted(BracketStateMachine& machine, const BracketOrderIDs& orders) {
+    if (machine.State != CORE_SUBMITTING)
+        return;
+    machine.Orders = orders;
+    machine.State = CORE_ARMED;
+}
+
+// The bracket command was not executed (rate limited, rejected). The next market update retries.
+inline void OnBracketSubmitRejected(BracketStateMachine& machine) {
+    if (machine.State == CORE_SUBMITTING)
+        machine.State = CORE_FLAT;
+}
+
+inline bool IsFinalOrderStatus(CoreOrderStatus status) {
+    return status == CORE_ORDER_FILLED || status == CORE_ORDER_CANCELED || status == CORE_ORDER_ERROR;
+}
+
+// Order status or fill change. An entry fill starts the trade (a partial fill cancels the opposite
+// leg, which OCO only does on a full fill); a stop or target fill ends it. A stop or target cancelled
+// in the trade is flattened by the next market update unless its sibling's fill arrives first: the
+// OCO cancel of the sibling can be reported before the fill, which the study sees in the same update.
+inline void OnBracketOrderUpdate(BracketStateMachine& machine, int orderID, CoreOrderStatus status,
+    double filledQuantity, double avgFillPrice) {
+    BracketOrderIDs& orders = machine.Orders;
+    if (machine.State == CORE_ARMED) {
+        bool isBuy = orderID == orders.BuyOrderID;
+        if (!isBuy && orderID != orders.SellOrderID)
+            return;
+        if (filledQuantity > 0.0) {
+            machine.Side = isBuy ? 1 : -1;
+            machine.EntryPrice = avgFillPrice;
+            machine.LostExitOrderID = 0;
+            machine.State = CORE_IN_TRADE;
+            if (status != CORE_ORDER_FILLED)
+                PushBracketCommand(machine, CORE_COMMAND_CANCEL, isBuy ? orders.SellOrderID : orders.BuyOrderID);
+        } else if (IsFinalOrderStatus(status)) {
+            // Both legs gone without a fill: flat again.
+            if (isBuy) orders.BuyOrderID = 0;
+            else orders.SellOrderID = 0;
+            if (orders.BuyOrderID == 0 && orders.SellOrderID == 0)
+                machine.State = CORE_FLAT;
+        }
+        return;
+    }
+    if (machine.State != CORE_IN_TRADE)
+        return;
+    int stopID = machine.Side > 0 ? orders.BuyStopID : orders.SellStopID;
+    int targetID = machine.Side > 0 ? orders.BuyTargetID : orders.SellTargetID;
+    if (orderID != stopID && orderID != targetID)
+        return;
+    if (status == CORE_ORDER_FILLED) {
+        double points = (avgFillPrice - machine.EntryPrice) * machine.Side;
+        machine.Stats.Trades++;
+        if (points > 0.0)
+            machine.Stats.Wins++;
+        machine.Stats.RealizedPoints += points;
+        machine.Side = 0;
+        machine.LostExitOrderID = 0;
+        machine.State = CORE_FLAT;
+    } else if (status == CORE_ORDER_CANCELED || status == CORE_ORDER_ERROR) {
+        machine.LostExitOrderID = orderID;
+    }
+}
+
+// Position update. Ends a flatten once the position is flat. A position appearing while flat (a leg
+// filled after its cancel was sent) is not tracked by any bracket, so it is flattened.
+inline void OnBracketPosition(BracketStateMachine& machine, double positionQuantity) {
+    if (machine.State == CORE_FLATTENING && positionQuantity == 0.0) {
+        machine.Side = 0;
+        machine.State = CORE_FLAT;
+    } else if (machine.State == CORE_FLAT && positionQuantity != 0.0) {
+        PushBracketCommand(machine, CORE_COMMAND_FLATTEN, 0);
+        machine.Stats.SafetyFlattens++;
+        machine.State = CORE_FLATTENING;
+    }
+}
+
+#endif // SCALPING_BOT_BRACKET_CORE_H
@@ -0,0 +1,297 @@
+/*
+* ===================================================================
+*   Scalping Bot - Bracket Core Parity Check
+* ===================================================================
+*
+*   bracket_core.h is a reduced model of the study's single-bracket
+*   path, kept for the tools that trade without Sierra Chart. This
+*   check builds the study (scalping_bot.cpp) against the Sierra
+*   Chart stub, replays the same random walk as allocation_replay.cpp
+*   through the "Close, Static Exit, Window" study, and drives a
+*   BracketStateMachine alongside it from the same order updates:
+*
+*   - Every bracket the study submits must be the one the core
+*     computes from the same center and 'R', submitted from CORE_FLAT.
+*   - After each study call the core's state must match the study's
+*     (flat, armed or in a trade).
+*   - At the end, the trades and realized points must agree.
+*
+*   Everything else the study does (ladder, scale-out, imbalance gate,
+*   parameter file, requotes, kill switch) is outside the core and
+*   left at its defaults, which keep it out of the way.
+*
+*   Build:  g++ -std=c++17 -O2 -pthread -Isierra_stub -I.. bracket_parity.cpp -o bracket_parity
+*   Run:    ./bracket_parity [--ticks N] [--seed N] [--verbose]
+*
+* ===================================================================
+*/
+
+#include "scalping_bot.cpp"
+#include "bracket_core.h"
+
+#include <cstdint>
+#include <random>
+
+static const int MAX_BARS = 4096;
+static const int TICKS_PER_BAR = 600;       // One-minute bars at one trade per 100 ms.
+static const double TICK_SECONDS = 0.1;
+static const float TICK_SIZE = 0.25f;
+static const float RANGE_R = 4.0f;
+static const int MAX_REPORTED = 10;         // Mismatches printed in full.
+
+static bool Verbose = false;
+
+static void PrintLog(const char* message) {
+    if (Verbose)
+        printf("    %s\n", message);
+}
+
+static float Closes[MAX_BARS], Highs[MAX_BARS], Lows[MAX_BARS], Volumes[MAX_BARS], RangeValues[MAX_BARS];
+static SCDateTime BarTimes[MAX_BARS];
+static float SubgraphData[STUB_MAX_SUBGRAPHS][MAX_BARS];
+
+static void AttachBars(s_sc& sc, int numBars) {
+    sc.ArraySize = numBars;
+    sc.Close.Attach(Closes, numBars);
+    sc.High.Attach(Highs, numBars);
+    sc.Low.Attach(Lows, numBars);
+    sc.Volume.Attach(Volumes, numBars);
+    sc.BaseDateTimeIn.Attach(BarTimes, numBars);
+    sc.StubStudyArray.Attach(RangeValues, numBars);
+    for (int i = 0; i < STUB_MAX_SUBGRAPHS; i++)
+        sc.Subgraph[i].Data.Attach(SubgraphData[i], numBars);
+}
+
+// The same market as allocation_replay.cpp: a two-tick book around the walked mid price, trades
+// alternating between its bid and ask.
+static float TradePrice(const int32_t* path, long long tick) {
+    return (path[tick] + (tick % 2 == 0 ? -1 : 1)) * TICK_SIZE;
+}
+
+static void SetMarket(s_sc& sc, float mid, float price, SCDateTime now) {
+    int last = sc.ArraySize - 1;
+    Closes[last] = price;
+    if (price > Highs[last]) Highs[last] = price;
+    if (price < Lows[last]) Lows[last] = price;
+    Volumes[last] += 1.0f;
+    sc.Bid = mid - TICK_SIZE;
+    sc.Ask = mid + TICK_SIZE;
+    sc.StubDepthLevels = STUB_MAX_DEPTH_LEVELS;
+    for (int level = 0; level < STUB_MAX_DEPTH_LEVELS; level++) {
+        sc.StubBidDepth[level].Price = sc.Bid - level * TICK_SIZE;
+        sc.StubAskDepth[level].Price = sc.Ask + level * TICK_SIZE;
+        sc.StubBidDepth[level].Quantity = level == 0 ? 1 : 20;
+        sc.StubAskDepth[level].Quantity = level == 0 ? 1 : 20;
+    }
+    sc.CurrentSystemDateTime = now;
+    sc.CurrentSystemDateTimeMS = now;
+    sc.LatestDateTimeForLastBar = now - SCDateTime::MILLISECONDS(20);
+}
+
+static CoreOrderStatus CoreStatusFor(int status) {
+    switch (status) {
+    case SCT_OSC_OPEN: return CORE_ORDER_WORKING;
+    case SCT_OSC_FILLED: return CORE_ORDER_FILLED;
+    case SCT_OSC_CANCELED: return CORE_ORDER_CANCELED;
+    case SCT_OSC_ERROR: return CORE_ORDER_ERROR;
+    default: return CORE_ORDER_PENDING;
+    }
+}
+
+// Last status and fill of an order fed to the core, so only changes are fed, as on the bus.
+struct FedOrder {
+    int OrderID;
+    int Status;
+    double FilledQuantity;
+};
+
+static const char* CoreStateText(int state) {
+    switch (state) {
+    case CORE_FLAT: return "FLAT";
+    case CORE_SUBMITTING: return "SUBMITTING";
+    case CORE_ARMED: return "ARMED";
+    case CORE_IN_TRADE: return "IN TRADE";
+    default: return "FLATTENING";
+    }
+}
+
+// The core state the study's persistent state corresponds to. A core that is flattening is flat to the study.
+static int ExpectedCoreState(int studySide, int studyBracket) {
+    if (studySide != SIDE_FLAT) return CORE_IN_TRADE;
+    if (studyBracket == BRACKET_ARMED_AND_WORKING) return CORE_ARMED;
+    return CORE_FLAT;
+}
+
+static bool SamePrice(double a, double b) {
+    return std::fabs(a - b) < 1e-6;
+}
+
+int main(int argc, char** argv) {
+    long long numTicks = 30000;
+    unsigned int seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) numTicks = strtoll(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+        else if (strcmp(argv[i], "--verbose") == 0) Verbose = true;
+        else {
+            fprintf(stderr, "Usage: bracket_parity [--ticks N] [--seed N] [--verbose]\n");
+            return 2;
+        }
+    }
+    long long maxTicks = static_cast<long long>(MAX_BARS) * TICKS_PER_BAR;
+    if (numTicks < 2 || numTicks > maxTicks) {
+        fprintf(stderr, "--ticks must be between 2 and %lld.\n", maxTicks);
+        return 2;
+    }
+
+    int32_t* path = new int32_t[numTicks];
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> move(-1, 1);
+    int32_t walk = 20000; // 5000.00 in ticks.
+    for (long long i = 0; i < numTicks; i++) {
+        walk += move(random);
+        path[i] = walk;
+    }
+
+    s_sc* interface = new s_sc();
+    s_sc& sc = *interface;
+    sc.StubLog = PrintLog;
+    sc.ChartNumber = 1;
+    sc.Symbol = "ESM6";
+    sc.TickSize = TICK_SIZE;
+    sc.CurrencyValuePerTick = 12.5f;
+    sc.StartTime1 = HMS_TIME(8, 30, 0);
+    sc.EndTime1 = HMS_TIME(15, 15, 0);
+    sc.SetDefaults = 1;
+    scsf_Scalping_Bot_Close_Static_Window(sc);
+    sc.SetDefaults = 0;
+    sc.Input[8].SetYesNo(true);         // Enable Trading.
+
+    // The core's parameters are the study's inputs of the same names.
+    BracketParameters parameters = BracketParameters();
+    parameters.TickSize = TICK_SIZE;
+    parameters.BracketFraction = sc.Input[2].GetFloat();
+    parameters.StopFraction = sc.Input[3].GetFloat();
+    parameters.TakeProfitFraction = sc.Input[4].GetFloat();
+    parameters.Quantity = sc.Input[0].GetInt();
+    parameters.StartTimeSeconds = sc.Input[6].GetTime();
+    parameters.StopTimeSeconds = sc.Input[7].GetTime();
+    BracketStateMachine machine;
+    ResetBracketStateMachine(machine, parameters);
+    FedOrder fed[6] = {};
+
+    // Trading day 2026-06-01 from 09:00, inside the default 08:30-15:00 window.
+    SCDateTime start(SierraDateFromCivil(2026, 6, 1), HMS_TIME(9, 0, 0));
+    int numBars = 1;
+    BarTimes[0] = start;
+    Closes[0] = Highs[0] = Lows[0] = TradePrice(path, 0);
+    for (int i = 0; i < MAX_BARS; i++) RangeValues[i] = RANGE_R;
+    AttachBars(sc, numBars);
+    sc.IsFullRecalculation = 1;
+    sc.UpdateStartIndex = 0;
+
+    long long brackets = 0, levelMismatches = 0, stateMismatches = 0;
+    int lastBuyID = 0, lastSellID = 0;
+    for (long long tick = 0; tick < numTicks; tick++) {
+        SCDateTime now = start + SCDateTime(tick * TICK_SECONDS / SECONDS_PER_DAY);
+        int timeOfDay = HMS_TIME(9, 0, 0) + static_cast<int>(tick * TICK_SECONDS);
+        float price = TradePrice(path, tick);
+        if (tick > 0 && tick % TICKS_PER_BAR == 0 && numBars < MAX_BARS) {
+            BarTimes[numBars] = now;
+            Closes[numBars] = Highs[numBars] = Lows[numBars] = price;
+            Volumes[numBars] = 0.0f;
+            AttachBars(sc, ++numBars);
+        }
+        if (tick > 0)
+            sc.UpdateStartIndex = numBars - 1;
+        sc.StubBarClosed = 0;
+        SetMarket(sc, path[tick] * TICK_SIZE, price, now);
+        sc.StubTrade(price);
+
+        // The core sees the order updates of this trade before the study call, as the study does in it.
+        for (int i = 0; i < 6; i++) {
+            s_SCTradeOrder order;
+            if (fed[i].OrderID == 0 || sc.GetOrderByOrderID(fed[i].OrderID, order) == SCTRADING_ORDER_ERROR)
+                continue;
+            if (order.OrderStatusCode == fed[i].Status && order.FilledQuantity == fed[i].FilledQuantity)
+                continue;
+            fed[i].Status = order.OrderStatusCode;
+            fed[i].FilledQuantity = order.FilledQuantity;
+            OnBracketOrderUpdate(machine, fed[i].OrderID, CoreStatusFor(order.OrderStatusCode), order.FilledQuantity, order.AvgFillPrice);
+        }
+        s_SCPositionData position;
+        sc.GetTradePosition(position);
+        OnBracketPosition(machine, position.PositionQuantity);
+        // Market updates that cannot submit (armed or in a trade); a flat core is given the study's center
+        // when the study arms, so both arm on the same update.
+        if (machine.State == CORE_ARMED || machine.State == CORE_IN_TRADE)
+            OnBracketMarket(machine, timeOfDay, price, RANGE_R);
+        machine.NumCommands = 0; // The study executes; the core's commands are not sent.
+
+        scsf_Scalping_Bot_Close_Static_Window(sc);
+        sc.IsFullRecalculation = 0;
+        BotRuntimeState* runtimeState = static_cast<BotRuntimeState*>(sc.GetPersistentPointer(PID_RUNTIME_STATE_POINTER));
+        int lastBar = sc.ArraySize - 1;
+        int studySide = sc.GetPersistentInt(PID_CURRENT_TRADE_SIDE);
+        int studyBracket = sc.GetPersistentInt(PID_IS_BRACKET_ARMED);
+        int buyID = sc.GetPersistentInt(PID_PARENT_BUY_LIMIT_ORDER_ID);
+        int sellID = sc.GetPersistentInt(PID_PARENT_SELL_LIMIT_ORDER_ID);
+
+        if (studyBracket == BRACKET_ARMED_AND_WORKING && (buyID != lastBuyID || sellID != lastSellID)) {
+            // A new bracket: the core must be flat and compute the same one from the same center and 'R'.
+            brackets++;
+            int stateBefore = machine.State;
+            OnBracketMarket(machine, timeOfDay, sc.Close[lastBar], RANGE_R);
+            const ArmedBracketInfo& armed = runtimeState->ArmedBracket;
+            bool submitted = machine.NumCommands == 1 && machine.Commands[0].Type == CORE_COMMAND_SUBMIT_BRACKET;
+            const BracketLevels& levels = machine.Commands[0].Levels;
+            if (!submitted || !SamePrice(levels.BuyPrice, armed.BuyPrice) || !SamePrice(levels.SellPrice, armed.SellPrice) ||
+                !SamePrice(levels.StopOffset, armed.StopOffset) || !SamePrice(levels.TargetOffset, armed.TargetOffsets[0])) {
+                if (++levelMismatches <= MAX_REPORTED)
+                    printf("  tick %lld: study bracket %.2f/%.2f stop %.2f target %.2f, core (%s) %s %.2f/%.2f stop %.2f target %.2f\n",
+                        tick, armed.BuyPrice, armed.SellPrice, armed.StopOffset, armed.TargetOffsets[0], CoreStateText(stateBefore),
+                        submitted ? "submits" : "does not submit", submitted ? levels.BuyPrice : 0.0, submitted ? levels.SellPrice : 0.0,
+                        submitted ? levels.StopOffset : 0.0, submitted ? levels.TargetOffset : 0.0);
+            }
+            machine.NumCommands = 0;
+            BracketOrderIDs orders = { buyID, sellID, armed.BuyStopIDs[0], armed.BuyTargetIDs[0], armed.SellStopIDs[0], armed.SellTargetIDs[0] };
+            if (machine.State != CORE_SUBMITTING) machine.State = CORE_SUBMITTING; // Follow the study after a mismatch.
+            OnBracketSubmitted(machine, orders);
+            const int orderIDs[6] = { orders.BuyOrderID, orders.SellOrderID, orders.BuyStopID, orders.BuyTargetID, orders.SellStopID, orders.SellTargetID };
+            for (int i = 0; i < 6; i++)
+                fed[i] = FedOrder{ orderIDs[i], -1, 0.0 };
+        }
+        lastBuyID = buyID;
+        lastSellID = sellID;
+
+        int expected = ExpectedCoreState(studySide, studyBracket);
+        int actual = machine.State == CORE_FLATTENING ? CORE_FLAT : machine.State;
+        if (studyBracket != BRACKET_CANCEL_PENDING && expected != actual) {
+            if (++stateMismatches <= MAX_REPORTED)
+                printf("  tick %lld: study %s, core %s\n", tick, CoreStateText(expected), CoreStateText(machine.State));
+        }
+    }
+
+    BotRuntimeState* runtimeState = static_cast<BotRuntimeState*>(sc.GetPersistentPointer(PID_RUNTIME_STATE_POINTER));
+    const DailyRiskState& risk = runtimeState->Risk;
+    double currencyPerPoint = sc.CurrencyValuePerTick / sc.TickSize;
+    double studyPoints = risk.RealizedPnL / (currencyPerPoint * parameters.Quantity);
+    bool tradesMatch = risk.TradesToday == machine.Stats.Trades && std::fabs(studyPoints - machine.Stats.RealizedPoints) < 1e-3;
+
+    printf("Bracket core parity, %lld ticks, seed %u\n\n", numTicks, seed);
+    printf("  Brackets submitted by the study   %lld\n", brackets);
+    printf("  Bracket level mismatches          %lld\n", levelMismatches);
+    printf("  State mismatches                  %lld\n", stateMismatches);
+    printf("  Trades            study %d, core %d\n", risk.TradesToday, machine.Stats.Trades);
+    printf("  Realized points   study %.2f, core %.2f\n", studyPoints, machine.Stats.RealizedPoints);
+    printf("  Safety flattens   core %d\n", machine.Stats.SafetyFlattens);
+
+    sc.LastCallToFunction = 1;
+    scsf_Scalping_Bot_Close_Static_Window(sc);
+    delete interface;
+    delete[] path;
+
+    bool failed = brackets == 0 || levelMismatches > 0 || stateMismatches > 0 || !tradesMatch;
+    printf("\n%s\n", failed ? "FAILED: the bracket core and the study diverged." : "OK: the bracket core matches the study.");
+    return failed ? 1 : 0;
+}
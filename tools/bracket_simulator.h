@@ -0,0 +1,620 @@
+/*
+* ===================================================================
+*   Scalping Bot - Offline Bracket Simulator
+* ===================================================================
+*
+*   Replays decoded trades (tick_data.h) through the bracket strategy
+*   for many parameter sets at once. The rules are the state machine's
+*   (bracket_core.h), in whole ticks:
+*   - FLAT inside the window with a valid 'R': arm at the trade price,
+*     entry limits one entry offset either side. The stop and target
+*     offsets are fixed here too, from the same 'R'.
+*   - ARMED: a later trade at or through a limit fills it at the limit.
+*   - IN TRADE: a later trade at or through the stop or the target
+*     exits there; the stop wins if both are crossed.
+*   - Window: an armed bracket is cancelled outside it, a trade is
+*     flattened at the first trade at or after the stop time.
+*   On each trade, exits are checked first, then entries, then arming,
+*   so a bracket armed or filled on a trade acts from the next one.
+*
+*   Parameter sets are grouped into lanes (16 with AVX-512, 8
+*   otherwise) held as struct-of-arrays, and all lanes of a group are
+*   advanced together per trade with compare-and-blend kernels. Trades
+*   that reach no lane's entry limit, stop or target are skipped with
+*   FindFirstTouch on the group's innermost levels. Without AVX2 the
+*   same kernel runs lane by lane. Prices and offsets are
+*   integers, so every kernel gives exactly the results of the one-set
+*   reference, SimulateBracketReference, which jumps from one entry or
+*   exit to the next with FindFirstTouch (first_touch.h).
+*
+*   Build with -march=native (or -mavx2, -mavx512f) to get the SIMD kernels.
+*
+* ===================================================================
+*/
+
+#ifndef SCALPING_BOT_BRACKET_SIMULATOR_H
+#define SCALPING_BOT_BRACKET_SIMULATOR_H
+
+#include "first_touch.h"
+#include "tick_data.h"
+
+#include <cmath>
+#include <cstdint>
+#include <climits>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512F__)
+#define SIM_LANES 16
+#define SIM_KERNEL_NAME "AVX-512"
+#elif defined(__AVX2__)
+#define SIM_LANES 8
+#define SIM_KERNEL_NAME "AVX2"
+#else
+#define SIM_LANES 8
+#define SIM_KERNEL_NAME "scalar"
+#endif
+
+// One parameter set, as the study's inputs of the same names.
+struct BracketFractions {
+    double BracketFraction;
+    double StopFraction;
+    double TakeProfitFraction;
+};
+
+// A grid axis: From, From + Step, ... up to To.
+struct FractionRange {
+    double From;
+    double To;
+    double Step;
+};
+
+// Every combination of the three axes, bracket fraction outermost.
+inline void BuildBracketGrid(const FractionRange& bracket, const FractionRange& stop, const FractionRange& target,
+    std::vector<BracketFractions>& sets) {
+    std::vector<double> axes[3];
+    const FractionRange* ranges[3] = { &bracket, &stop, &target };
+    for (int axis = 0; axis < 3; axis++)
+        for (int i = 0; ranges[axis]->From + i * ranges[axis]->Step <= ranges[axis]->To + ranges[axis]->Step * 1e-9; i++)
+            axes[axis].push_back(ranges[axis]->From + i * ranges[axis]->Step);
+    for (size_t b = 0; b < axes[0].size(); b++)
+        for (size_t s = 0; s < axes[1].size(); s++)
+            for (size_t t = 0; t < axes[2].size(); t++)
+                sets.push_back({ axes[0][b], axes[1][s], axes[2][t] });
+}
+
+// Per contract, in ticks. A trade still open at the end of the range is not counted.
+struct BracketSimResult {
+    int32_t Trades;
+    int32_t Wins;
+    int32_t PnLTicks;
+    int32_t PeakTicks;              // Highest closed P&L so far.
+    int32_t MaxDrawdownTicks;       // Largest fall of the closed P&L from its peak.
+};
+
+inline bool operator==(const BracketSimResult& a, const BracketSimResult& b) {
+    return a.Trades == b.Trades && a.Wins == b.Wins && a.PnLTicks == b.PnLTicks && a.PeakTicks == b.PeakTicks &&
+        a.MaxDrawdownTicks == b.MaxDrawdownTicks;
+}
+
+enum SimLaneState { SIM_FLAT = 0, SIM_ARMED = 1, SIM_LONG = 2, SIM_SHORT = 3 };
+
+// An offset as ComputeBracketLevels rounds it, in ticks: the fraction of R to the nearest tick, at least one.
+inline int32_t OffsetTicks(double rValue, double fraction, double tickSize) {
+    int32_t ticks = static_cast<int32_t>(std::floor(rValue * fraction / tickSize + 0.5));
+    return ticks < 1 ? 1 : ticks;
+}
+
+inline void RecordExit(BracketSimResult& result, int32_t points) {
+    result.Trades++;
+    if (points > 0)
+        result.Wins++;
+    result.PnLTicks += points;
+    if (result.PnLTicks > result.PeakTicks)
+        result.PeakTicks = result.PnLTicks;
+    if (result.PeakTicks - result.PnLTicks > result.MaxDrawdownTicks)
+        result.MaxDrawdownTicks = result.PeakTicks - result.PnLTicks;
+}
+
+//── Reference: one parameter set, from touch to touch ──────────────────
+
+// Whether an armed bracket or a trade outlives a segment with this window state: a bracket is
+// cancelled outside the window, a trade is only flattened at the stop time.
+inline bool SurvivesSegment(int state, int32_t window) {
+    return state == SIM_ARMED ? window == SEGMENT_OPEN : window != SEGMENT_CLOSED;
+}
+
+// Simulates segments [firstSegment, lastSegment) for one set. 'result' is accumulated into, so ranges
+// simulated one after the other continue the same P&L and drawdown.
+//
+// Armed, the next event is the first trade reaching the buy or sell limit; in a trade, the first
+// reaching the stop or target (Stop1Offset / Target1Offset from the fill). Both are found with
+// FindFirstTouch, over all the following segments the bracket or trade outlives, so a trade lasting
+// tens of thousands of ticks is one scan. Flat, the bracket is armed on the next trade.
+inline void SimulateBracketReference(const TickData& data, size_t firstSegment, size_t lastSegment,
+    const BracketFractions& fractions, BracketSimResult& result) {
+    if (firstSegment >= lastSegment)
+        return;
+    const double tick = data.Settings.TickSize;
+    const int32_t* prices = data.Prices.data();
+    const TickSegment* segments = data.Segments.data();
+    int state = SIM_FLAT;
+    int32_t buy = 0, sell = 0, stop = 0, target = 0, entry = 0;
+    int32_t armedStopOffset = 0, armedTargetOffset = 0;
+    bool armAllowed = false;
+    int32_t entryOffset = 0, stopOffset = 0, targetOffset = 0;
+    // Segment start: window cancel and flatten, and the offsets for the segment's R.
+    auto enterSegment = [&](size_t index) {
+        const TickSegment& segment = segments[index];
+        if (segment.Window != SEGMENT_OPEN && state == SIM_ARMED)
+            state = SIM_FLAT;
+        if (segment.Window == SEGMENT_CLOSED && (state == SIM_LONG || state == SIM_SHORT)) {
+            int32_t price = prices[segment.Begin];
+            RecordExit(result, state == SIM_LONG ? price - entry : entry - price);
+            state = SIM_FLAT;
+        }
+        armAllowed = segment.Window == SEGMENT_OPEN && segment.RangeR > 0.0;
+        entryOffset = OffsetTicks(segment.RangeR, fractions.BracketFraction, tick);
+        stopOffset = OffsetTicks(segment.RangeR, fractions.StopFraction, tick);
+        targetOffset = OffsetTicks(segment.RangeR, fractions.TakeProfitFraction, tick);
+    };
+    auto arm = [&](int32_t price) {
+        state = SIM_ARMED;
+        buy = price - entryOffset;
+        sell = price + entryOffset;
+        armedStopOffset = stopOffset;
+        armedTargetOffset = targetOffset;
+    };
+
+    size_t s = firstSegment;
+    size_t nextNotOpen = s, nextClosed = s;
+    enterSegment(s);
+    uint32_t i = segments[s].Begin;
+    for (;;) {
+        if (i >= segments[s].End) {
+            if (++s >= lastSegment)
+                break;
+            enterSegment(s);
+            continue;
+        }
+        if (state == SIM_FLAT) {
+            if (armAllowed)
+                arm(prices[i++]);
+            else
+                i = segments[s].End;
+            continue;
+        }
+        // The first later segment that cancels the bracket or flattens the trade, found once per run.
+        size_t& runEnd = state == SIM_ARMED ? nextNotOpen : nextClosed;
+        if (runEnd <= s) {
+            runEnd = s + 1;
+            while (runEnd < lastSegment && SurvivesSegment(state, segments[runEnd].Window))
+                runEnd++;
+        }
+        size_t runLast = runEnd - 1;
+        uint32_t end = segments[runLast].End;
+        int32_t low = state == SIM_ARMED ? buy : state == SIM_LONG ? stop : target;
+        int32_t high = state == SIM_ARMED ? sell : state == SIM_LONG ? target : stop;
+        uint32_t touch = i + static_cast<uint32_t>(FindFirstTouch(prices + i, end - i, low, high));
+        // The segments passed over leave the bracket or trade as it is; only their offsets are needed.
+        while (s < runLast && segments[s].End <= touch)
+            enterSegment(++s);
+        if (touch >= end) {
+            i = end;
+            continue;
+        }
+        int32_t price = prices[touch];
+        if (state == SIM_ARMED) {
+            if (price <= buy) {
+                state = SIM_LONG;
+                entry = buy;
+                stop = buy - armedStopOffset;
+                target = buy + armedTargetOffset;
+            } else {
+                state = SIM_SHORT;
+                entry = sell;
+                stop = sell + armedStopOffset;
+                target = sell - armedTargetOffset;
+            }
+        } else {
+            int32_t exitPrice = price <= low ? low : high;
+            RecordExit(result, state == SIM_LONG ? exitPrice - entry : entry - exitPrice);
+            state = SIM_FLAT;
+            if (armAllowed)
+                arm(price);
+        }
+        i = touch + 1;
+    }
+}
+
+//── Lanes: SIM_LANES parameter sets per group ───────────────────────────
+
+// State of one group of parameter sets, one array element per lane.
+struct alignas(64) BracketLaneGroup {
+    double BracketFraction[SIM_LANES];
+    double StopFraction[SIM_LANES];
+    double TakeProfitFraction[SIM_LANES];
+    int32_t EntryOffset[SIM_LANES];     // Offsets for the current segment's R, in ticks.
+    int32_t StopOffset[SIM_LANES];
+    int32_t TargetOffset[SIM_LANES];
+    int32_t State[SIM_LANES];           // SimLaneState.
+    int32_t Buy[SIM_LANES];
+    int32_t Sell[SIM_LANES];
+    int32_t ArmedStopOffset[SIM_LANES]; // Offsets of the armed bracket, from R when it was armed.
+    int32_t ArmedTargetOffset[SIM_LANES];
+    int32_t Stop[SIM_LANES];
+    int32_t Target[SIM_LANES];
+    int32_t Entry[SIM_LANES];
+    int32_t Trades[SIM_LANES];
+    int32_t Wins[SIM_LANES];
+    int32_t PnL[SIM_LANES];
+    int32_t Peak[SIM_LANES];
+    int32_t MaxDrawdown[SIM_LANES];
+};
+
+// Fills the groups from 'sets'. The last group's unused lanes repeat the last set.
+inline void InitLaneGroups(const std::vector<BracketFractions>& sets, std::vector<BracketLaneGroup>& groups) {
+    size_t count = (sets.size() + SIM_LANES - 1) / SIM_LANES;
+    groups.assign(count, BracketLaneGroup());
+    for (size_t g = 0; g < count; g++) {
+        for (int lane = 0; lane < SIM_LANES; lane++) {
+            size_t index = g * SIM_LANES + lane;
+            const BracketFractions& set = sets[index < sets.size() ? index : sets.size() - 1];
+            groups[g].BracketFraction[lane] = set.BracketFraction;
+            groups[g].StopFraction[lane] = set.StopFraction;
+            groups[g].TakeProfitFraction[lane] = set.TakeProfitFraction;
+        }
+    }
+}
+
+inline void ReadLaneResults(const std::vector<BracketLaneGroup>& groups, size_t setCount, std::vector<BracketSimResult>& results) {
+    results.resize(setCount);
+    for (size_t index = 0; index < setCount; index++) {
+        const BracketLaneGroup& group = groups[index / SIM_LANES];
+        int lane = static_cast<int>(index % SIM_LANES);
+        BracketSimResult& result = results[index];
+        result.Trades = group.Trades[lane];
+        result.Wins = group.Wins[lane];
+        result.PnLTicks = group.PnL[lane];
+        result.PeakTicks = group.Peak[lane];
+        result.MaxDrawdownTicks = group.MaxDrawdown[lane];
+    }
+}
+
+// Segment start: offsets for the segment's R, window cancel and flatten. Returns whether the
+// segment's trades can change anything (a lane is not flat, or brackets may be armed).
+inline bool BeginLaneSegment(BracketLaneGroup& group, const TickSegment& segment, int32_t firstPrice, double tickSize) {
+    bool active = segment.Window == SEGMENT_OPEN && segment.RangeR > 0.0;
+    for (int lane = 0; lane < SIM_LANES; lane++) {
+        group.EntryOffset[lane] = OffsetTicks(segment.RangeR, group.BracketFraction[lane], tickSize);
+        group.StopOffset[lane] = OffsetTicks(segment.RangeR, group.StopFraction[lane], tickSize);
+        group.TargetOffset[lane] = OffsetTicks(segment.RangeR, group.TakeProfitFraction[lane], tickSize);
+        int32_t& state = group.State[lane];
+        if (segment.Window != SEGMENT_OPEN && state == SIM_ARMED)
+            state = SIM_FLAT;
+        if (segment.Window == SEGMENT_CLOSED && (state == SIM_LONG || state == SIM_SHORT)) {
+            int32_t points = state == SIM_LONG ? firstPrice - group.Entry[lane] : group.Entry[lane] - firstPrice;
+            group.Trades[lane]++;
+            group.Wins[lane] += points > 0 ? 1 : 0;
+            group.PnL[lane] += points;
+            if (group.PnL[lane] > group.Peak[lane]) group.Peak[lane] = group.PnL[lane];
+            if (group.Peak[lane] - group.PnL[lane] > group.MaxDrawdown[lane]) group.MaxDrawdown[lane] = group.Peak[lane] - group.PnL[lane];
+            state = SIM_FLAT;
+        }
+        active = active || state != SIM_FLAT;
+    }
+    return active;
+}
+
+// A lane only changes state on a trade at or below its low level or at or above its high level: the
+// entry limits when armed, the stop and target in a trade. A flat lane has no levels, except that
+// Low = INT_MAX while brackets may be armed, so the next trade arms it. A trade reaches some lane's
+// level exactly when it is at or below the highest low or at or above the lowest high, so the kernels
+// find the next such trade with FindFirstTouch and run the full step only there.
+#define SIM_NO_LOW INT_MIN
+#define SIM_NO_HIGH INT_MAX
+
+#if defined(__AVX512F__)
+
+// Horizontal max / min by halving: lane k meets lane k ^ 8, k ^ 4, k ^ 2, k ^ 1. The masked forms
+// avoid GCC 12's -Wmaybe-uninitialized on the unmasked intrinsics and the _mm512_reduce_* sequences.
+inline __m512i SwapLanes(__m512i values, int distance) {
+    const __m512i index = _mm512_xor_si512(_mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0),
+        _mm512_set1_epi32(distance));
+    return _mm512_maskz_permutexvar_epi32(0xFFFF, index, values);
+}
+
+inline int32_t ReduceMaxEpi32(__m512i values) {
+    for (int distance = 8; distance > 0; distance >>= 1)
+        values = _mm512_mask_max_epi32(values, 0xFFFF, values, SwapLanes(values, distance));
+    return _mm512_cvtsi512_si32(values);
+}
+
+inline int32_t ReduceMinEpi32(__m512i values) {
+    for (int distance = 8; distance > 0; distance >>= 1)
+        values = _mm512_mask_min_epi32(values, 0xFFFF, values, SwapLanes(values, distance));
+    return _mm512_cvtsi512_si32(values);
+}
+
+// 16 lanes per __m512i; comparisons give __mmask16 and every update is a masked move or add.
+inline void AdvanceLanes(BracketLaneGroup& group, const int32_t* prices, uint32_t begin, uint32_t end, bool armAllowed) {
+    const __m512i flat = _mm512_setzero_si512();
+    const __m512i armed = _mm512_set1_epi32(SIM_ARMED);
+    const __m512i longState = _mm512_set1_epi32(SIM_LONG);
+    const __m512i shortState = _mm512_set1_epi32(SIM_SHORT);
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i flatLow = _mm512_set1_epi32(armAllowed ? SIM_NO_HIGH : SIM_NO_LOW);
+    const __m512i noHigh = _mm512_set1_epi32(SIM_NO_HIGH);
+    const __m512i entryOffset = _mm512_load_si512(group.EntryOffset);
+    const __m512i stopOffset = _mm512_load_si512(group.StopOffset);
+    const __m512i targetOffset = _mm512_load_si512(group.TargetOffset);
+    const __mmask16 armMask = armAllowed ? 0xFFFF : 0;
+    __m512i state = _mm512_load_si512(group.State);
+    __m512i buy = _mm512_load_si512(group.Buy);
+    __m512i sell = _mm512_load_si512(group.Sell);
+    __m512i armedStopOffset = _mm512_load_si512(group.ArmedStopOffset);
+    __m512i armedTargetOffset = _mm512_load_si512(group.ArmedTargetOffset);
+    __m512i stop = _mm512_load_si512(group.Stop);
+    __m512i target = _mm512_load_si512(group.Target);
+    __m512i entry = _mm512_load_si512(group.Entry);
+    __m512i trades = _mm512_load_si512(group.Trades);
+    __m512i wins = _mm512_load_si512(group.Wins);
+    __m512i pnl = _mm512_load_si512(group.PnL);
+    __m512i peak = _mm512_load_si512(group.Peak);
+    __m512i maxDrawdown = _mm512_load_si512(group.MaxDrawdown);
+    __m512i low, high;
+    for (uint32_t i = begin; ; i++) {
+        {
+            __mmask16 isArmed = _mm512_cmpeq_epi32_mask(state, armed);
+            __mmask16 isLong = _mm512_cmpeq_epi32_mask(state, longState);
+            __mmask16 isShort = _mm512_cmpeq_epi32_mask(state, shortState);
+            low = _mm512_mask_mov_epi32(_mm512_mask_mov_epi32(_mm512_mask_mov_epi32(flatLow, isArmed, buy), isLong, stop), isShort, target);
+            high = _mm512_mask_mov_epi32(_mm512_mask_mov_epi32(_mm512_mask_mov_epi32(noHigh, isArmed, sell), isLong, target), isShort, stop);
+        }
+        i += static_cast<uint32_t>(FindFirstTouch(prices + i, end - i, ReduceMaxEpi32(low), ReduceMinEpi32(high)));
+        if (i >= end)
+            break;
+        const __m512i price = _mm512_set1_epi32(prices[i]);
+        // Exits.
+        __mmask16 isLong = _mm512_cmpeq_epi32_mask(state, longState);
+        __mmask16 isShort = _mm512_cmpeq_epi32_mask(state, shortState);
+        __mmask16 stopHit = _mm512_mask_cmple_epi32_mask(isLong, price, stop) | _mm512_mask_cmpge_epi32_mask(isShort, price, stop);
+        __mmask16 targetHit = _mm512_mask_cmpge_epi32_mask(isLong, price, target) | _mm512_mask_cmple_epi32_mask(isShort, price, target);
+        __mmask16 exit = stopHit | targetHit;
+        if (exit) {
+            __m512i exitPrice = _mm512_mask_blend_epi32(stopHit, target, stop);
+            __m512i points = _mm512_mask_sub_epi32(_mm512_sub_epi32(exitPrice, entry), isShort, entry, exitPrice);
+            pnl = _mm512_mask_add_epi32(pnl, exit, pnl, points);
+            trades = _mm512_mask_add_epi32(trades, exit, trades, one);
+            wins = _mm512_mask_add_epi32(wins, exit & _mm512_cmpgt_epi32_mask(points, flat), wins, one);
+            peak = _mm512_mask_max_epi32(peak, exit, peak, pnl);
+            maxDrawdown = _mm512_mask_max_epi32(maxDrawdown, exit, maxDrawdown, _mm512_sub_epi32(peak, pnl));
+            state = _mm512_mask_mov_epi32(state, exit, flat);
+        }
+        // Entries.
+        __mmask16 isArmed = _mm512_cmpeq_epi32_mask(state, armed);
+        __mmask16 goLong = _mm512_mask_cmple_epi32_mask(isArmed, price, buy);
+        __mmask16 goShort = _mm512_mask_cmpge_epi32_mask(isArmed, price, sell);
+        if (goLong | goShort) {
+            entry = _mm512_mask_mov_epi32(_mm512_mask_mov_epi32(entry, goLong, buy), goShort, sell);
+            stop = _mm512_mask_add_epi32(_mm512_mask_sub_epi32(stop, goLong, buy, armedStopOffset), goShort, sell, armedStopOffset);
+            target = _mm512_mask_sub_epi32(_mm512_mask_add_epi32(target, goLong, buy, armedTargetOffset), goShort, sell, armedTargetOffset);
+            state = _mm512_mask_mov_epi32(_mm512_mask_mov_epi32(state, goLong, longState), goShort, shortState);
+        }
+        // Arming.
+        __mmask16 arm = _mm512_mask_cmpeq_epi32_mask(armMask, state, flat);
+        buy = _mm512_mask_sub_epi32(buy, arm, price, entryOffset);
+        sell = _mm512_mask_add_epi32(sell, arm, price, entryOffset);
+        armedStopOffset = _mm512_mask_mov_epi32(armedStopOffset, arm, stopOffset);
+        armedTargetOffset = _mm512_mask_mov_epi32(armedTargetOffset, arm, targetOffset);
+        state = _mm512_mask_mov_epi32(state, arm, armed);
+    }
+    _mm512_store_si512(group.State, state);
+    _mm512_store_si512(group.Buy, buy);
+    _mm512_store_si512(group.Sell, sell);
+    _mm512_store_si512(group.ArmedStopOffset, armedStopOffset);
+    _mm512_store_si512(group.ArmedTargetOffset, armedTargetOffset);
+    _mm512_store_si512(group.Stop, stop);
+    _mm512_store_si512(group.Target, target);
+    _mm512_store_si512(group.Entry, entry);
+    _mm512_store_si512(group.Trades, trades);
+    _mm512_store_si512(group.Wins, wins);
+    _mm512_store_si512(group.PnL, pnl);
+    _mm512_store_si512(group.Peak, peak);
+    _mm512_store_si512(group.MaxDrawdown, maxDrawdown);
+}
+
+#elif defined(__AVX2__)
+
+inline int32_t ReduceMaxEpi32(__m256i values) {
+    __m128i half = _mm_max_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+    half = _mm_max_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtsi128_si32(_mm_max_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1))));
+}
+
+inline int32_t ReduceMinEpi32(__m256i values) {
+    __m128i half = _mm_min_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtsi128_si32(_mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1))));
+}
+
+// 8 lanes per __m256i. Comparisons give all-ones lanes; updates are blendv selects, and a true
+// lane (-1) is counted by subtracting it. a <= b is computed as not (a > b).
+inline void AdvanceLanes(BracketLaneGroup& group, const int32_t* prices, uint32_t begin, uint32_t end, bool armAllowed) {
+    const __m256i flat = _mm256_setzero_si256();
+    const __m256i armed = _mm256_set1_epi32(SIM_ARMED);
+    const __m256i longState = _mm256_set1_epi32(SIM_LONG);
+    const __m256i shortState = _mm256_set1_epi32(SIM_SHORT);
+    const __m256i flatLow = _mm256_set1_epi32(armAllowed ? SIM_NO_HIGH : SIM_NO_LOW);
+    const __m256i noHigh = _mm256_set1_epi32(SIM_NO_HIGH);
+    const __m256i entryOffset = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.EntryOffset));
+    const __m256i stopOffset = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.StopOffset));
+    const __m256i targetOffset = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.TargetOffset));
+    const __m256i armMask = _mm256_set1_epi32(armAllowed ? -1 : 0);
+    __m256i state = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.State));
+    __m256i buy = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.Buy));
+    __m256i sell = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.Sell));
+    __m256i armedStopOffset = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.ArmedStopOffset));
+    __m256i armedTargetOffset = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.ArmedTargetOffset));
+    __m256i stop = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.Stop));
+    __m256i target = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.Target));
+    __m256i entry = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.Entry));
+    __m256i trades = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.Trades));
+    __m256i wins = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.Wins));
+    __m256i pnl = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.PnL));
+    __m256i peak = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.Peak));
+    __m256i maxDrawdown = _mm256_load_si256(reinterpret_cast<const __m256i*>(group.MaxDrawdown));
+    __m256i low, high;
+    for (uint32_t i = begin; ; i++) {
+        {
+            __m256i isArmed = _mm256_cmpeq_epi32(state, armed);
+            __m256i isLong = _mm256_cmpeq_epi32(state, longState);
+            __m256i isShort = _mm256_cmpeq_epi32(state, shortState);
+            low = _mm256_blendv_epi8(_mm256_blendv_epi8(_mm256_blendv_epi8(flatLow, buy, isArmed), stop, isLong), target, isShort);
+            high = _mm256_blendv_epi8(_mm256_blendv_epi8(_mm256_blendv_epi8(noHigh, sell, isArmed), target, isLong), stop, isShort);
+        }
+        i += static_cast<uint32_t>(FindFirstTouch(prices + i, end - i, ReduceMaxEpi32(low), ReduceMinEpi32(high)));
+        if (i >= end)
+            break;
+        const __m256i price = _mm256_set1_epi32(prices[i]);
+        // Exits.
+        __m256i isLong = _mm256_cmpeq_epi32(state, longState);
+        __m256i isShort = _mm256_cmpeq_epi32(state, shortState);
+        __m256i stopHit = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpgt_epi32(price, stop), isLong),
+            _mm256_andnot_si256(_mm256_cmpgt_epi32(stop, price), isShort));
+        __m256i targetHit = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpgt_epi32(target, price), isLong),
+            _mm256_andnot_si256(_mm256_cmpgt_epi32(price, target), isShort));
+        __m256i exit = _mm256_or_si256(stopHit, targetHit);
+        if (!_mm256_testz_si256(exit, exit)) {
+            __m256i exitPrice = _mm256_blendv_epi8(target, stop, stopHit);
+            __m256i points = _mm256_blendv_epi8(_mm256_sub_epi32(exitPrice, entry), _mm256_sub_epi32(entry, exitPrice), isShort);
+            pnl = _mm256_add_epi32(pnl, _mm256_and_si256(points, exit));
+            trades = _mm256_sub_epi32(trades, exit);
+            wins = _mm256_sub_epi32(wins, _mm256_and_si256(exit, _mm256_cmpgt_epi32(points, flat)));
+            peak = _mm256_max_epi32(peak, pnl);
+            maxDrawdown = _mm256_max_epi32(maxDrawdown, _mm256_sub_epi32(peak, pnl));
+            state = _mm256_andnot_si256(exit, state);
+        }
+        // Entries.
+        __m256i isArmed = _mm256_cmpeq_epi32(state, armed);
+        __m256i goLong = _mm256_andnot_si256(_mm256_cmpgt_epi32(price, buy), isArmed);
+        __m256i goShort = _mm256_andnot_si256(_mm256_cmpgt_epi32(sell, price), isArmed);
+        __m256i go = _mm256_or_si256(goLong, goShort);
+        if (!_mm256_testz_si256(go, go)) {
+            entry = _mm256_blendv_epi8(_mm256_blendv_epi8(entry, buy, goLong), sell, goShort);
+            stop = _mm256_blendv_epi8(_mm256_blendv_epi8(stop, _mm256_sub_epi32(buy, armedStopOffset), goLong),
+                _mm256_add_epi32(sell, armedStopOffset), goShort);
+            target = _mm256_blendv_epi8(_mm256_blendv_epi8(target, _mm256_add_epi32(buy, armedTargetOffset), goLong),
+                _mm256_sub_epi32(sell, armedTargetOffset), goShort);
+            state = _mm256_blendv_epi8(_mm256_blendv_epi8(state, longState, goLong), shortState, goShort);
+        }
+        // Arming.
+        __m256i arm = _mm256_and_si256(_mm256_cmpeq_epi32(state, flat), armMask);
+        buy = _mm256_blendv_epi8(buy, _mm256_sub_epi32(price, entryOffset), arm);
+        sell = _mm256_blendv_epi8(sell, _mm256_add_epi32(price, entryOffset), arm);
+        armedStopOffset = _mm256_blendv_epi8(armedStopOffset, stopOffset, arm);
+        armedTargetOffset = _mm256_blendv_epi8(armedTargetOffset, targetOffset, arm);
+        state = _mm256_blendv_epi8(state, armed, arm);
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.State), state);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.Buy), buy);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.Sell), sell);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.ArmedStopOffset), armedStopOffset);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.ArmedTargetOffset), armedTargetOffset);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.Stop), stop);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.Target), target);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.Entry), entry);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.Trades), trades);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.Wins), wins);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.PnL), pnl);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.Peak), peak);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(group.MaxDrawdown), maxDrawdown);
+}
+
+#else
+
+// Scalar fallback: the same levels and the same step, lane by lane.
+inline void AdvanceLanes(BracketLaneGroup& group, const int32_t* prices, uint32_t begin, uint32_t end, bool armAllowed) {
+    int32_t low[SIM_LANES], high[SIM_LANES];
+    for (uint32_t i = begin; ; i++) {
+        for (int lane = 0; lane < SIM_LANES; lane++) {
+            int32_t state = group.State[lane];
+            low[lane] = state == SIM_ARMED ? group.Buy[lane] : state == SIM_LONG ? group.Stop[lane] :
+                state == SIM_SHORT ? group.Target[lane] : armAllowed ? SIM_NO_HIGH : SIM_NO_LOW;
+            high[lane] = state == SIM_ARMED ? group.Sell[lane] : state == SIM_LONG ? group.Target[lane] :
+                state == SIM_SHORT ? group.Stop[lane] : SIM_NO_HIGH;
+        }
+        int32_t highestLow = low[0], lowestHigh = high[0];
+        for (int lane = 1; lane < SIM_LANES; lane++) {
+            if (low[lane] > highestLow) highestLow = low[lane];
+            if (high[lane] < lowestHigh) lowestHigh = high[lane];
+        }
+        i += static_cast<uint32_t>(FindFirstTouch(prices + i, end - i, highestLow, lowestHigh));
+        if (i >= end)
+            break;
+        const int32_t price = prices[i];
+        for (int lane = 0; lane < SIM_LANES; lane++) {
+            int32_t state = group.State[lane];
+            bool isLong = state == SIM_LONG, isShort = state == SIM_SHORT;
+            bool stopHit = (isLong && price <= group.Stop[lane]) || (isShort && price >= group.Stop[lane]);
+            bool targetHit = (isLong && price >= group.Target[lane]) || (isShort && price <= group.Target[lane]);
+            if (stopHit || targetHit) {
+                int32_t exitPrice = stopHit ? group.Stop[lane] : group.Target[lane];
+                int32_t points = isShort ? group.Entry[lane] - exitPrice : exitPrice - group.Entry[lane];
+                group.PnL[lane] += points;
+                group.Trades[lane]++;
+                group.Wins[lane] += points > 0 ? 1 : 0;
+                if (group.PnL[lane] > group.Peak[lane]) group.Peak[lane] = group.PnL[lane];
+                if (group.Peak[lane] - group.PnL[lane] > group.MaxDrawdown[lane]) group.MaxDrawdown[lane] = group.Peak[lane] - group.PnL[lane];
+                state = SIM_FLAT;
+            }
+            if (state == SIM_ARMED) {
+                if (price <= group.Buy[lane]) {
+                    state = SIM_LONG;
+                    group.Entry[lane] = group.Buy[lane];
+                    group.Stop[lane] = group.Buy[lane] - group.ArmedStopOffset[lane];
+                    group.Target[lane] = group.Buy[lane] + group.ArmedTargetOffset[lane];
+                } else if (price >= group.Sell[lane]) {
+                    state = SIM_SHORT;
+                    group.Entry[lane] = group.Sell[lane];
+                    group.Stop[lane] = group.Sell[lane] + group.ArmedStopOffset[lane];
+                    group.Target[lane] = group.Sell[lane] - group.ArmedTargetOffset[lane];
+                }
+            }
+            if (state == SIM_FLAT && armAllowed) {
+                state = SIM_ARMED;
+                group.Buy[lane] = price - group.EntryOffset[lane];
+                group.Sell[lane] = price + group.EntryOffset[lane];
+                group.ArmedStopOffset[lane] = group.StopOffset[lane];
+                group.ArmedTargetOffset[lane] = group.TargetOffset[lane];
+            }
+            group.State[lane] = state;
+        }
+    }
+}
+
+#endif
+
+// Simulates segments [firstSegment, lastSegment) for every set of 'groups'. Segment by segment, all
+// groups run over the same trades while they are in cache. Like the reference, the groups' results
+// are accumulated into; the groups start flat for each call.
+inline void SimulateBracketLanes(const TickData& data, size_t firstSegment, size_t lastSegment, std::vector<BracketLaneGroup>& groups) {
+    const double tick = data.Settings.TickSize;
+    const int32_t* prices = data.Prices.data();
+    for (size_t g = 0; g < groups.size(); g++)
+        for (int lane = 0; lane < SIM_LANES; lane++)
+            groups[g].State[lane] = SIM_FLAT;
+    for (size_t s = firstSegment; s < lastSegment; s++) {
+        const TickSegment& segment = data.Segments[s];
+        bool armAllowed = segment.Window == SEGMENT_OPEN && segment.RangeR > 0.0;
+        for (size_t g = 0; g < groups.size(); g++) {
+            if (BeginLaneSegment(groups[g], segment, prices[segment.Begin], tick))
+                AdvanceLanes(groups[g], prices, segment.Begin, segment.End, armAllowed);
+        }
+    }
+}
+
+#endif // SCALPING_BOT_BRACKET_SIMULATOR_H
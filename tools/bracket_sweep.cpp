@@ -0,0 +1,180 @@
+/*
+* ===================================================================
+*   Scalping Bot - Parameter Sweep
+* ===================================================================
+*
+*   Runs a grid of BracketFrac / StopFrac / TPFrac combinations over
+*   decoded trades with the lane simulator (bracket_simulator.h), and
+*   prints the best sets by P&L. With --verify, every set is also run
+*   through the one-set reference and the results compared; with
+*   --reference, the reference is timed over the whole grid.
+*
+*   Build:  g++ -std=c++17 -O3 -march=native -I.. bracket_sweep.cpp -o bracket_sweep
+*   Run:    ./bracket_sweep --scid ESZ6.scid --tick 0.25 --bracket 0.25:1.5:0.25 --stop 0.25:2:0.25 --target 0.25:3:0.25
+*           ./bracket_sweep --synthetic 20000000 --verify
+*
+* ===================================================================
+*/
+
+#include "bracket_simulator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static double NowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct SweepOptions {
+    const char* ScidPath;
+    size_t SyntheticTrades;         // Random-walk trades when no file is given.
+    TickDataSettings Settings;
+    FractionRange Bracket;
+    FractionRange Stop;
+    FractionRange Target;
+    bool Verify;
+    bool Reference;
+    int Top;
+};
+
+static int ParseTimeOfDay(const char* text) {
+    int hour = 0, minute = 0, second = 0;
+    if (sscanf(text, "%d:%d:%d", &hour, &minute, &second) < 2)
+        return -1;
+    return hour * 3600 + minute * 60 + second;
+}
+
+static bool ParseRange(const char* text, FractionRange& range) {
+    int fields = sscanf(text, "%lf:%lf:%lf", &range.From, &range.To, &range.Step);
+    if (fields == 1) {
+        range.To = range.From;
+        range.Step = 1.0;
+    }
+    return fields == 1 || (fields == 3 && range.Step > 0.0 && range.To >= range.From);
+}
+
+static bool ParseOptions(int argc, char** argv, SweepOptions& options) {
+    options.ScidPath = NULL;
+    options.SyntheticTrades = 10000000;
+    options.Settings.TickSize = 0.25;
+    options.Settings.StartTimeSeconds = 8 * 3600 + 30 * 60;
+    options.Settings.StopTimeSeconds = 15 * 3600;
+    options.Settings.UtcOffsetHours = 0.0;
+    options.Settings.BarSeconds = 60;
+    options.Settings.RangeLength = 14;
+    options.Bracket = { 0.25, 1.5, 0.25 };
+    options.Stop = { 0.25, 2.0, 0.25 };
+    options.Target = { 0.25, 3.0, 0.25 };
+    options.Verify = false;
+    options.Reference = false;
+    options.Top = 10;
+    for (int i = 1; i < argc; i++) {
+        const char* name = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(name, "--verify") == 0) { options.Verify = true; continue; }
+        if (strcmp(name, "--reference") == 0) { options.Reference = true; continue; }
+        if (strcmp(name, "--no-window") == 0) { options.Settings.StartTimeSeconds = -1; continue; }
+        if (value == NULL) {
+            fprintf(stderr, "Missing value for %s\n", name);
+            return false;
+        }
+        i++;
+        bool valid = true;
+        if (strcmp(name, "--scid") == 0) options.ScidPath = value;
+        else if (strcmp(name, "--synthetic") == 0) options.SyntheticTrades = strtoull(value, NULL, 10);
+        else if (strcmp(name, "--tick") == 0) options.Settings.TickSize = atof(value);
+        else if (strcmp(name, "--start") == 0) options.Settings.StartTimeSeconds = ParseTimeOfDay(value);
+        else if (strcmp(name, "--stop-time") == 0) options.Settings.StopTimeSeconds = ParseTimeOfDay(value);
+        else if (strcmp(name, "--utc-offset-hours") == 0) options.Settings.UtcOffsetHours = atof(value);
+        else if (strcmp(name, "--bar-seconds") == 0) options.Settings.BarSeconds = atoi(value);
+        else if (strcmp(name, "--r-length") == 0) options.Settings.RangeLength = atoi(value);
+        else if (strcmp(name, "--bracket") == 0) valid = ParseRange(value, options.Bracket);
+        else if (strcmp(name, "--stop") == 0) valid = ParseRange(value, options.Stop);
+        else if (strcmp(name, "--target") == 0) valid = ParseRange(value, options.Target);
+        else if (strcmp(name, "--top") == 0) options.Top = atoi(value);
+        else valid = false;
+        if (!valid) {
+            fprintf(stderr, "Invalid option %s %s\n", name, value);
+            return false;
+        }
+    }
+    return options.Settings.TickSize > 0.0;
+}
+
+int main(int argc, char** argv) {
+    SweepOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: bracket_sweep [--scid FILE | --synthetic TRADES] [--tick T] [--start HH:MM:SS] [--stop-time HH:MM:SS]\n"
+            "                     [--no-window] [--utc-offset-hours H] [--bar-seconds N] [--r-length N]\n"
+            "                     [--bracket FROM:TO:STEP] [--stop FROM:TO:STEP] [--target FROM:TO:STEP] [--top N] [--verify] [--reference]\n");
+        return 2;
+    }
+
+    TickData data;
+    double started = NowSeconds();
+    if (options.ScidPath != NULL) {
+        if (!LoadScidTicks(options.ScidPath, options.Settings, data)) {
+            fprintf(stderr, "Cannot read %s\n", options.ScidPath);
+            return 1;
+        }
+    } else {
+        GenerateRandomWalkTicks(options.SyntheticTrades, 1776328200.0, 0.25, 5000.0, 1, options.Settings, data);
+    }
+    printf("Decoded %zu trades, %zu segments, %zu days in %.2f s\n", data.Prices.size(), data.Segments.size(),
+        data.Days.size(), NowSeconds() - started);
+
+    std::vector<BracketFractions> sets;
+    BuildBracketGrid(options.Bracket, options.Stop, options.Target, sets);
+    if (sets.empty() || data.Prices.empty()) {
+        fprintf(stderr, "Nothing to simulate.\n");
+        return 1;
+    }
+
+    std::vector<BracketLaneGroup> groups;
+    InitLaneGroups(sets, groups);
+    started = NowSeconds();
+    SimulateBracketLanes(data, 0, data.Segments.size(), groups);
+    double laneSeconds = NowSeconds() - started;
+    std::vector<BracketSimResult> results;
+    ReadLaneResults(groups, sets.size(), results);
+    double setTrades = static_cast<double>(sets.size()) * data.Prices.size();
+    printf("%s lanes (%d per group): %zu sets in %.3f s, %.3f ns per trade per set\n", SIM_KERNEL_NAME, SIM_LANES,
+        sets.size(), laneSeconds, laneSeconds * 1e9 / setTrades);
+
+    if (options.Verify || options.Reference) {
+        size_t mismatches = 0;
+        started = NowSeconds();
+        for (size_t i = 0; i < sets.size(); i++) {
+            BracketSimResult reference = BracketSimResult();
+            SimulateBracketReference(data, 0, data.Segments.size(), sets[i], reference);
+            if (!(reference == results[i])) {
+                if (mismatches++ < 5)
+                    printf("Mismatch for %.3f/%.3f/%.3f: reference %d trades %d ticks, lanes %d trades %d ticks\n",
+                        sets[i].BracketFraction, sets[i].StopFraction, sets[i].TakeProfitFraction, reference.Trades,
+                        reference.PnLTicks, results[i].Trades, results[i].PnLTicks);
+            }
+        }
+        double referenceSeconds = NowSeconds() - started;
+        printf("Reference: %.3f s, %.3f ns per trade per set, lanes %.1fx faster, %zu mismatches\n", referenceSeconds,
+            referenceSeconds * 1e9 / setTrades, referenceSeconds / laneSeconds, mismatches);
+        if (mismatches > 0)
+            return 1;
+    }
+
+    std::vector<size_t> order(sets.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&results](size_t a, size_t b) { return results[a].PnLTicks > results[b].PnLTicks; });
+    printf("\n Bracket   Stop  Target   Trades   Win %%   P&L (ticks)   Max DD (ticks)\n");
+    for (int rank = 0; rank < options.Top && rank < static_cast<int>(order.size()); rank++) {
+        const BracketFractions& set = sets[order[rank]];
+        const BracketSimResult& result = results[order[rank]];
+        printf("%8.3f %6.3f %7.3f %8d %7.1f %13d %16d\n", set.BracketFraction, set.StopFraction, set.TakeProfitFraction,
+            result.Trades, result.Trades > 0 ? 100.0 * result.Wins / result.Trades : 0.0, result.PnLTicks, result.MaxDrawdownTicks);
+    }
+    return 0;
+}
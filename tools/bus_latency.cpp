@@ -0,0 +1,290 @@
+/*
+* ===================================================================
+*   Scalping Bot - Shared-Memory Bus Round-Trip Harness
+* ===================================================================
+*
+*   Drives both rings of the bus (scalping_bot_bus.h) locally, without
+*   Sierra Chart, and measures the decision round trip: a tick event
+*   published on the study side until the command answering it is read
+*   back on the study side.
+*
+*   Two threads share one mapped segment, as the study and the external
+*   process would:
+*   - The study side publishes a random-walk tick, stands in for the
+*     exchange (bracket submissions are acknowledged with order IDs,
+*     legs and exits fill when the price crosses them), and waits for
+*     the reply before publishing the next tick.
+*   - The strategy side runs the bracket state machine (bracket_core.h)
+*     on each event and answers every tick, with the state machine's
+*     commands or with a NOOP.
+*
+*   Build:  g++ -std=c++17 -O2 -pthread -I.. bus_latency.cpp -o bus_latency
+*   Run:    ./bus_latency [--ticks N] [--bus PATH] [--cpus A,B]
+*
+* ===================================================================
+*/
+
+#include "scalping_bot_bus.h"
+#include "bracket_core.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static long long NowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void PinToCpu(int cpu) {
+#if defined(__linux__)
+    if (cpu < 0)
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+// Busy wait, yielding after a while so the harness still progresses with both threads on one CPU.
+static inline void Backoff(int& spins) {
+    if (++spins < 4096) {
+#if defined(__x86_64__) || defined(_M_X64)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+struct HarnessResult {
+    std::vector<long long> RoundTripNs;     // One per tick.
+    std::vector<long long> DecisionNs;      // Ticks answered with a state machine command.
+    long long Fills;
+    long long Mismatches;                   // Commands naming a sequence other than the last tick.
+};
+
+// Fake exchange state on the study side: one bracket of the single-target form the study submits.
+struct SimulatedBracket {
+    bool Working;
+    bool InTrade;
+    int Side;
+    double BuyPrice;
+    double SellPrice;
+    double StopPrice;
+    double TargetPrice;
+    double StopOffset;
+    double TargetOffset;
+    BusBracketSubmitted IDs;
+};
+
+static void Publish(BusSegment& segment, BusEvent& event, uint64_t& sequence) {
+    event.Sequence = ++sequence;
+    int spins = 0;
+    while (!BusRingPush(segment.Events, event))
+        Backoff(spins);
+}
+
+static void PublishOrder(BusSegment& segment, uint64_t& sequence, int orderID, BusOrderStatus status, double price) {
+    BusEvent event = BusEvent();
+    event.Type = BUS_EVENT_ORDER;
+    event.Order.OrderID = orderID;
+    event.Order.Status = status;
+    event.Order.Quantity = 1.0f;
+    event.Order.FilledQuantity = status == BUS_ORDER_FILLED ? 1.0f : 0.0f;
+    event.Order.AvgFillPrice = status == BUS_ORDER_FILLED ? price : 0.0;
+    Publish(segment, event, sequence);
+}
+
+static void RunStudySide(BusSegment& segment, int ticks, int cpu, HarnessResult& result) {
+    PinToCpu(cpu);
+    uint64_t sequence = 0;
+    int nextOrderID = 1;
+    double price = 5000.0;
+    unsigned int random = 12345;
+    SimulatedBracket bracket = SimulatedBracket();
+    result.RoundTripNs.reserve(ticks);
+
+    for (int i = 0; i < ticks; i++) {
+        random = random * 1103515245u + 12345u;
+        price += ((random >> 16) % 3 - 1) * 0.25;
+
+        // Exchange: fills for crossed prices, published before the tick that crossed them.
+        if (bracket.Working && (price <= bracket.BuyPrice || price >= bracket.SellPrice)) {
+            bracket.Side = price <= bracket.BuyPrice ? 1 : -1;
+            double fill = bracket.Side > 0 ? bracket.BuyPrice : bracket.SellPrice;
+            bracket.StopPrice = fill - bracket.Side * bracket.StopOffset;
+            bracket.TargetPrice = fill + bracket.Side * bracket.TargetOffset;
+            PublishOrder(segment, sequence, bracket.Side > 0 ? bracket.IDs.BuyOrderID : bracket.IDs.SellOrderID, BUS_ORDER_FILLED, fill);
+            PublishOrder(segment, sequence, bracket.Side > 0 ? bracket.IDs.SellOrderID : bracket.IDs.BuyOrderID, BUS_ORDER_CANCELED, 0.0);
+            bracket.Working = false;
+            bracket.InTrade = true;
+            result.Fills++;
+        } else if (bracket.InTrade) {
+            bool stopped = bracket.Side > 0 ? price <= bracket.StopPrice : price >= bracket.StopPrice;
+            bool targeted = bracket.Side > 0 ? price >= bracket.TargetPrice : price <= bracket.TargetPrice;
+            if (stopped || targeted) {
+                int stopID = bracket.Side > 0 ? bracket.IDs.BuyStopID : bracket.IDs.SellStopID;
+                int targetID = bracket.Side > 0 ? bracket.IDs.BuyTargetID : bracket.IDs.SellTargetID;
+                PublishOrder(segment, sequence, stopped ? stopID : targetID, BUS_ORDER_FILLED, stopped ? bracket.StopPrice : bracket.TargetPrice);
+                PublishOrder(segment, sequence, stopped ? targetID : stopID, BUS_ORDER_CANCELED, 0.0);
+                bracket.InTrade = false;
+            }
+        }
+
+        BusEvent event = BusEvent();
+        event.Type = BUS_EVENT_TICK;
+        event.ExchangeTime = 45000.5;       // Noon, inside the default window.
+        event.Tick.Price = price;
+        event.Tick.Bid = price - 0.25;
+        event.Tick.Ask = price;
+        event.Tick.RangeR = 4.0;
+        event.Tick.Volume = static_cast<float>(i);
+        event.Tick.BarIndex = i / 1000;
+        long long publishedNs = NowNanoseconds();
+        Publish(segment, event, sequence);
+        uint64_t tickSequence = sequence;
+
+        // Wait for the answer to this tick. Every tick is answered in order, so a command naming
+        // another event is a mismatch.
+        BusCommand command;
+        int spins = 0;
+        for (;;) {
+            if (!BusRingPop(segment.Commands, command)) {
+                Backoff(spins);
+                continue;
+            }
+            if (command.TriggerSequence != tickSequence) {
+                result.Mismatches++;
+                continue;
+            }
+            long long roundTripNs = NowNanoseconds() - publishedNs;
+            result.RoundTripNs.push_back(roundTripNs);
+            if (command.Type != BUS_COMMAND_NOOP)
+                result.DecisionNs.push_back(roundTripNs);
+            if (command.Type == BUS_COMMAND_SUBMIT_BRACKET) {
+                bracket = SimulatedBracket();
+                bracket.Working = true;
+                bracket.BuyPrice = command.BuyPrice;
+                bracket.SellPrice = command.SellPrice;
+                bracket.StopOffset = command.StopOffset;
+                bracket.TargetOffset = command.TargetOffset;
+                BusEvent reply = BusEvent();
+                reply.Type = BUS_EVENT_BRACKET_SUBMITTED;
+                reply.Bracket.CommandID = command.CommandID;
+                reply.Bracket.BuyOrderID = nextOrderID++;
+                reply.Bracket.SellOrderID = nextOrderID++;
+                reply.Bracket.BuyStopID = nextOrderID++;
+                reply.Bracket.BuyTargetID = nextOrderID++;
+                reply.Bracket.SellStopID = nextOrderID++;
+                reply.Bracket.SellTargetID = nextOrderID++;
+                bracket.IDs = reply.Bracket;
+                Publish(segment, reply, sequence);
+            }
+            break;
+        }
+    }
+    BusEvent stop = BusEvent();     // Type 0 ends the strategy side.
+    Publish(segment, stop, sequence);
+}
+
+static void RunStrategySide(BusSegment& segment, int cpu) {
+    PinToCpu(cpu);
+    BracketParameters parameters = { 0.25, 0.5, 0.5, 1.0, 1, -1, 0 };
+    BracketStateMachine machine;
+    ResetBracketStateMachine(machine, parameters);
+    int nextCommandID = 0;
+    BusEvent event;
+    int spins = 0;
+    for (;;) {
+        if (!BusRingPop(segment.Events, event)) {
+            Backoff(spins);
+            continue;
+        }
+        spins = 0;
+        if (event.Type == 0)
+            return;
+        if (event.Type == BUS_EVENT_BRACKET_SUBMITTED) {
+            BracketOrderIDs orders = { event.Bracket.BuyOrderID, event.Bracket.SellOrderID, event.Bracket.BuyStopID,
+                event.Bracket.BuyTargetID, event.Bracket.SellStopID, event.Bracket.SellTargetID };
+            OnBracketSubmitted(machine, orders);
+            continue;
+        }
+        if (event.Type == BUS_EVENT_ORDER) {
+            OnBracketOrderUpdate(machine, event.Order.OrderID, static_cast<CoreOrderStatus>(event.Order.Status),
+                event.Order.FilledQuantity, event.Order.AvgFillPrice);
+            machine.NumCommands = 0;    // The simulated exchange cancels the other OCO leg itself.
+            continue;
+        }
+        OnBracketMarket(machine, 43200, event.Tick.Price, event.Tick.RangeR);
+        BusCommand command = BusCommand();
+        command.Type = BUS_COMMAND_NOOP;
+        if (machine.NumCommands > 0 && machine.Commands[0].Type == CORE_COMMAND_SUBMIT_BRACKET) {
+            const BracketLevels& levels = machine.Commands[0].Levels;
+            command.Type = BUS_COMMAND_SUBMIT_BRACKET;
+            command.BuyPrice = levels.BuyPrice;
+            command.SellPrice = levels.SellPrice;
+            command.StopOffset = levels.StopOffset;
+            command.TargetOffset = levels.TargetOffset;
+            command.Quantity = machine.Commands[0].Quantity;
+        }
+        machine.NumCommands = 0;
+        command.CommandID = ++nextCommandID;
+        command.TriggerSequence = event.Sequence;
+        while (!BusRingPush(segment.Commands, command))
+            Backoff(spins);
+    }
+}
+
+static long long Percentile(const std::vector<long long>& sorted, double percentile) {
+    if (sorted.empty())
+        return 0;
+    size_t rank = static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+}
+
+static void Report(const char* name, std::vector<long long>& samples) {
+    std::sort(samples.begin(), samples.end());
+    printf("%-10s n=%zu  p50 %lld ns  p99 %lld ns  p99.9 %lld ns  max %lld ns\n", name, samples.size(),
+        Percentile(samples, 50.0), Percentile(samples, 99.0), Percentile(samples, 99.9), samples.empty() ? 0 : samples.back());
+}
+
+int main(int argc, char** argv) {
+    int ticks = 1000000;
+    const char* busPath = "/dev/shm/scalping_bot_bus_latency";
+    int studyCpu = -1, strategyCpu = -1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--ticks") == 0) ticks = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--bus") == 0) busPath = argv[i + 1];
+        else if (strcmp(argv[i], "--cpus") == 0) sscanf(argv[i + 1], "%d,%d", &studyCpu, &strategyCpu);
+    }
+
+    BusMapping mapping;
+    BusSegment* segment = OpenBusSegment(busPath, true, mapping);
+    if (segment == NULL) {
+        fprintf(stderr, "Cannot map %s\n", busPath);
+        return 1;
+    }
+    HarnessResult result = HarnessResult();
+    std::thread strategy(RunStrategySide, std::ref(*segment), strategyCpu);
+    RunStudySide(*segment, ticks, studyCpu, result);
+    strategy.join();
+    CloseBusSegment(mapping);
+    remove(busPath);
+
+    printf("%d ticks, %lld entry fills, %lld mismatched commands\n", ticks, result.Fills, result.Mismatches);
+    Report("round trip", result.RoundTripNs);
+    Report("decision", result.DecisionNs);
+    return result.Mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+/*
+* ===================================================================
+*   Scalping Bot - External Strategy Process
+* ===================================================================
+*
+*   Runs the bracket state machine (bracket_core.h) in a separate Linux
+*   process. The study, with "Strategy Host" set to EXTERNAL PROCESS,
+*   publishes ticks, depth, order status and position on the
+*   shared-memory bus (scalping_bot_bus.h); this process consumes them
+*   and sends the bracket submissions, cancels and flattens back.
+*
+*   Build:  g++ -std=c++17 -O2 -pthread -I.. bus_strategy.cpp -o bus_strategy
+*   Run:    ./bus_strategy --bus /dev/shm/scalping_bot_bus --tick 0.25 [--verbose]
+*
+*   The study owns the segment: it resets the rings each time it maps
+*   it, and this process starts over when it sees the epoch change.
+*
+* ===================================================================
+*/
+
+#include "scalping_bot_bus.h"
+#include "bracket_core.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+static volatile std::sig_atomic_t StopRequested = 0;
+
+static void OnSignal(int) { StopRequested = 1; }
+
+struct StrategyOptions {
+    const char* BusPath;
+    BracketParameters Parameters;
+    bool CenterOnMid;               // Center on the bid/ask midpoint instead of the last trade.
+    int IdleSleepMicroseconds;      // Sleep when both rings are empty. 0 = busy poll.
+    bool Verbose;                   // Print every command sent. Off by default: a printf is slower than the round trip.
+};
+
+static int ParseTimeOfDay(const char* text) {
+    int hour = 0, minute = 0, second = 0;
+    if (sscanf(text, "%d:%d:%d", &hour, &minute, &second) < 2)
+        return -1;
+    return hour * 3600 + minute * 60 + second;
+}
+
+static bool ParseOptions(int argc, char** argv, StrategyOptions& options) {
+    options.BusPath = "/dev/shm/scalping_bot_bus";
+    options.Parameters.TickSize = 0.25;
+    options.Parameters.BracketFraction = 0.5;
+    options.Parameters.StopFraction = 0.5;
+    options.Parameters.TakeProfitFraction = 1.0;
+    options.Parameters.Quantity = 1;
+    options.Parameters.StartTimeSeconds = 8 * 3600 + 30 * 60;
+    options.Parameters.StopTimeSeconds = 15 * 3600;
+    options.CenterOnMid = false;
+    options.IdleSleepMicroseconds = 0;
+    options.Verbose = false;
+    for (int i = 1; i < argc; i++) {
+        const char* name = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(name, "--center-mid") == 0) { options.CenterOnMid = true; continue; }
+        if (strcmp(name, "--no-window") == 0) { options.Parameters.StartTimeSeconds = -1; continue; }
+        if (strcmp(name, "--verbose") == 0) { options.Verbose = true; continue; }
+        if (value == NULL) {
+            fprintf(stderr, "Missing value for %s\n", name);
+            return false;
+        }
+        i++;
+        if (strcmp(name, "--bus") == 0) options.BusPath = value;
+        else if (strcmp(name, "--tick") == 0) options.Parameters.TickSize = atof(value);
+        else if (strcmp(name, "--bracket") == 0) options.Parameters.BracketFraction = atof(value);
+        else if (strcmp(name, "--stop") == 0) options.Parameters.StopFraction = atof(value);
+        else if (strcmp(name, "--target") == 0) options.Parameters.TakeProfitFraction = atof(value);
+        else if (strcmp(name, "--quantity") == 0) options.Parameters.Quantity = atoi(value);
+        else if (strcmp(name, "--start") == 0) options.Parameters.StartTimeSeconds = ParseTimeOfDay(value);
+        else if (strcmp(name, "--stop-time") == 0) options.Parameters.StopTimeSeconds = ParseTimeOfDay(value);
+        else if (strcmp(name, "--idle-sleep-us") == 0) options.IdleSleepMicroseconds = atoi(value);
+        else {
+            fprintf(stderr, "Unknown option %s\n", name);
+            return false;
+        }
+    }
+    return options.Parameters.TickSize > 0.0 && options.Parameters.Quantity > 0;
+}
+
+// Seconds since midnight of an SCDateTime value (days since 1899-12-30).
+static int TimeOfDaySeconds(double dateTime) {
+    double seconds = (dateTime - static_cast<long long>(dateTime)) * 86400.0;
+    return static_cast<int>(seconds + 0.5) % 86400;
+}
+
+// Sends the commands the state machine produced. A full command ring is retried on the next event.
+static void SendCommands(BusSegment& segment, BracketStateMachine& machine, uint64_t triggerSequence,
+    int& nextCommandID, int& pendingSubmitID, bool verbose) {
+    int sent = 0;
+    for (; sent < machine.NumCommands; sent++) {
+        const BracketCommand& core = machine.Commands[sent];
+        BusCommand command = BusCommand();
+        command.CommandID = ++nextCommandID;
+        command.TriggerSequence = triggerSequence;
+        command.Quantity = core.Quantity;
+        command.OrderID = core.OrderID;
+        if (core.Type == CORE_COMMAND_SUBMIT_BRACKET) {
+            command.Type = BUS_COMMAND_SUBMIT_BRACKET;
+            command.BuyPrice = core.Levels.BuyPrice;
+            command.SellPrice = core.Levels.SellPrice;
+            command.StopOffset = core.Levels.StopOffset;
+            command.TargetOffset = core.Levels.TargetOffset;
+            pendingSubmitID = command.CommandID;
+        } else {
+            command.Type = core.Type == CORE_COMMAND_CANCEL ? BUS_COMMAND_CANCEL : BUS_COMMAND_FLATTEN;
+        }
+        if (!BusRingPush(segment.Commands, command))
+            break;
+        if (verbose)
+            printf("command %d: type %u buy %.5f sell %.5f stop %.5f target %.5f order %d\n", command.CommandID, command.Type,
+                command.BuyPrice, command.SellPrice, command.StopOffset, command.TargetOffset, command.OrderID);
+    }
+    for (int i = sent; i < machine.NumCommands; i++)
+        machine.Commands[i - sent] = machine.Commands[i];
+    machine.NumCommands -= sent;
+}
+
+int main(int argc, char** argv) {
+    StrategyOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: bus_strategy [--bus PATH] [--tick T] [--bracket F] [--stop F] [--target F] [--quantity N]\n"
+            "                    [--start HH:MM:SS] [--stop-time HH:MM:SS] [--no-window] [--center-mid] [--idle-sleep-us N] [--verbose]\n");
+        return 2;
+    }
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    BusMapping mapping;
+    BusSegment* segment = OpenBusSegment(options.BusPath, false, mapping);
+    if (segment == NULL) {
+        fprintf(stderr, "Cannot map %s\n", options.BusPath);
+        return 1;
+    }
+    printf("Waiting for the study on %s\n", options.BusPath);
+    while (!StopRequested && !IsBusSegmentReady(*segment))
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    BracketStateMachine machine;
+    ResetBracketStateMachine(machine, options.Parameters);
+    uint32_t epoch = segment->Epoch.load(std::memory_order_acquire);
+    uint64_t lastSequence = 0;
+    uint64_t gaps = 0;
+    int nextCommandID = 0;
+    int pendingSubmitID = 0;
+    double bid = 0.0, ask = 0.0;
+    BusEvent event;
+
+    while (!StopRequested) {
+        uint32_t currentEpoch = segment->Epoch.load(std::memory_order_acquire);
+        if (currentEpoch != epoch) {
+            // The study mapped the segment again (chart reload, new bus file): its rings and order IDs
+            // start over, and so does the strategy.
+            epoch = currentEpoch;
+            ResetBracketStateMachine(machine, options.Parameters);
+            lastSequence = 0;
+            pendingSubmitID = 0;
+            printf("Study restarted (epoch %u). State reset.\n", epoch);
+        }
+        if (!BusRingPop(segment->Events, event)) {
+            if (machine.NumCommands > 0)
+                SendCommands(*segment, machine, lastSequence, nextCommandID, pendingSubmitID, options.Verbose);
+            if (options.IdleSleepMicroseconds > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(options.IdleSleepMicroseconds));
+            continue;
+        }
+        if (lastSequence != 0 && event.Sequence != lastSequence + 1)
+            gaps += event.Sequence - lastSequence - 1;
+        lastSequence = event.Sequence;
+
+        switch (event.Type) {
+        case BUS_EVENT_TICK:
+            bid = event.Tick.Bid;
+            ask = event.Tick.Ask;
+            OnBracketMarket(machine, TimeOfDaySeconds(event.ExchangeTime),
+                options.CenterOnMid && bid > 0.0 && ask > 0.0 ? (bid + ask) / 2.0 : event.Tick.Price, event.Tick.RangeR);
+            break;
+        case BUS_EVENT_ORDER:
+            OnBracketOrderUpdate(machine, event.Order.OrderID, static_cast<CoreOrderStatus>(event.Order.Status),
+                event.Order.FilledQuantity, event.Order.AvgFillPrice);
+            break;
+        case BUS_EVENT_BRACKET_SUBMITTED:
+            if (event.Bracket.CommandID == pendingSubmitID) {
+                BracketOrderIDs orders = { event.Bracket.BuyOrderID, event.Bracket.SellOrderID, event.Bracket.BuyStopID,
+                    event.Bracket.BuyTargetID, event.Bracket.SellStopID, event.Bracket.SellTargetID };
+                OnBracketSubmitted(machine, orders);
+            }
+            break;
+        case BUS_EVENT_COMMAND_REJECTED:
+            if (event.Rejected.CommandID == pendingSubmitID)
+                OnBracketSubmitRejected(machine);
+            break;
+        case BUS_EVENT_POSITION:
+            OnBracketPosition(machine, event.Position.Quantity);
+            break;
+        default:
+            break;
+        }
+        if (machine.NumCommands > 0)
+            SendCommands(*segment, machine, event.Sequence, nextCommandID, pendingSubmitID, options.Verbose);
+    }
+
+    printf("Brackets %d, trades %d, wins %d, realized %.5f points, safety flattens %d, events missed %llu (dropped by the study %llu)\n",
+        machine.Stats.BracketsSubmitted, machine.Stats.Trades, machine.Stats.Wins, machine.Stats.RealizedPoints,
+        machine.Stats.SafetyFlattens, static_cast<unsigned long long>(gaps),
+        static_cast<unsigned long long>(segment->EventsDropped.load(std::memory_order_relaxed)));
+    CloseBusSegment(mapping);
+    return 0;
+}
@@ -0,0 +1,590 @@
+/*
+* ===================================================================
+*   Scalping Bot - Standalone DTC Engine
+* ===================================================================
+*
+*   Runs the bracket strategy (bracket_core.h) directly against a DTC
+*   server over TCP, without Sierra Chart in the decision path: no
+*   chart update interval, no study call per update, no bus hop. Each
+*   trade is acted on as soon as its bytes arrive.
+*
+*   - Market data (trades, best bid/ask) and order and position updates
+*     are read from a non-blocking TCP_NODELAY socket by one dedicated
+*     thread, optionally pinned to a CPU, that busy-polls the socket.
+*   - Frames are parsed in place in the receive buffer (dtc_protocol.h).
+*   - 'R' is the EMA of time-bar ranges built from the trade stream,
+*     as the study's built-in estimator.
+*   - A bracket is three OCO messages in one send: the entry limits, and
+*     one stop/target pair per entry triggered by that entry's fill.
+*
+*   Build:  g++ -std=c++17 -O2 -pthread -I.. dtc_engine.cpp -o dtc_engine
+*   Run:    ./dtc_engine --host 127.0.0.1 --port 11099 --symbol ESZ6 --tick 0.25 --cpu 2
+*
+*   Test against the stand-in server (dtc_stand_in_server.cpp), or any
+*   DTC server that uses the binary encoding. Add -I<ACS_Source> to
+*   check dtc_protocol.h against Sierra Chart's DTCProtocol.h.
+*
+* ===================================================================
+*/
+
+#include "dtc_protocol.h"
+#include "bracket_core.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define MAX_LATENCY_SAMPLES (1 << 20)
+#define HEARTBEAT_SECONDS 10
+
+static std::atomic<bool> StopRequested(false);
+
+static void OnSignal(int) { StopRequested.store(true); }
+
+static long long NowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void PinToCpu(int cpu) {
+#if defined(__linux__)
+    if (cpu < 0)
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+// Busy wait, yielding after a while so the engine still progresses when its CPU is shared.
+static inline void Backoff(int& spins) {
+    if (++spins < 4096) {
+#if defined(__x86_64__) || defined(_M_X64)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+struct EngineOptions {
+    const char* Host;
+    int Port;
+    const char* Symbol;
+    const char* Exchange;
+    const char* Account;
+    BracketParameters Parameters;
+    int BarSeconds;                 // 'R' estimator bar length.
+    int RangeLength;                // 'R' estimator EMA length, in bars.
+    double UtcOffsetHours;          // Added to the DTC times (UTC) for the trading window.
+    bool CenterOnMid;
+    int Cpu;                        // CPU for the engine thread. -1 = not pinned.
+    int DurationSeconds;            // 0 = until interrupted.
+};
+
+static int ParseTimeOfDay(const char* text) {
+    int hour = 0, minute = 0, second = 0;
+    if (sscanf(text, "%d:%d:%d", &hour, &minute, &second) < 2)
+        return -1;
+    return hour * 3600 + minute * 60 + second;
+}
+
+static bool ParseOptions(int argc, char** argv, EngineOptions& options) {
+    options.Host = "127.0.0.1";
+    options.Port = 11099;
+    options.Symbol = "ESZ6";
+    options.Exchange = "CME";
+    options.Account = "Sim1";
+    options.Parameters.TickSize = 0.25;
+    options.Parameters.BracketFraction = 0.5;
+    options.Parameters.StopFraction = 0.5;
+    options.Parameters.TakeProfitFraction = 1.0;
+    options.Parameters.Quantity = 1;
+    options.Parameters.StartTimeSeconds = 8 * 3600 + 30 * 60;
+    options.Parameters.StopTimeSeconds = 15 * 3600;
+    options.BarSeconds = 60;
+    options.RangeLength = 14;
+    options.UtcOffsetHours = 0.0;
+    options.CenterOnMid = false;
+    options.Cpu = -1;
+    options.DurationSeconds = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* name = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(name, "--center-mid") == 0) { options.CenterOnMid = true; continue; }
+        if (strcmp(name, "--no-window") == 0) { options.Parameters.StartTimeSeconds = -1; continue; }
+        if (value == NULL) {
+            fprintf(stderr, "Missing value for %s\n", name);
+            return false;
+        }
+        i++;
+        if (strcmp(name, "--host") == 0) options.Host = value;
+        else if (strcmp(name, "--port") == 0) options.Port = atoi(value);
+        else if (strcmp(name, "--symbol") == 0) options.Symbol = value;
+        else if (strcmp(name, "--exchange") == 0) options.Exchange = value;
+        else if (strcmp(name, "--account") == 0) options.Account = value;
+        else if (strcmp(name, "--tick") == 0) options.Parameters.TickSize = atof(value);
+        else if (strcmp(name, "--bracket") == 0) options.Parameters.BracketFraction = atof(value);
+        else if (strcmp(name, "--stop") == 0) options.Parameters.StopFraction = atof(value);
+        else if (strcmp(name, "--target") == 0) options.Parameters.TakeProfitFraction = atof(value);
+        else if (strcmp(name, "--quantity") == 0) options.Parameters.Quantity = atoi(value);
+        else if (strcmp(name, "--start") == 0) options.Parameters.StartTimeSeconds = ParseTimeOfDay(value);
+        else if (strcmp(name, "--stop-time") == 0) options.Parameters.StopTimeSeconds = ParseTimeOfDay(value);
+        else if (strcmp(name, "--bar-seconds") == 0) options.BarSeconds = atoi(value);
+        else if (strcmp(name, "--r-length") == 0) options.RangeLength = atoi(value);
+        else if (strcmp(name, "--utc-offset-hours") == 0) options.UtcOffsetHours = atof(value);
+        else if (strcmp(name, "--cpu") == 0) options.Cpu = atoi(value);
+        else if (strcmp(name, "--duration") == 0) options.DurationSeconds = atoi(value);
+        else {
+            fprintf(stderr, "Unknown option %s\n", name);
+            return false;
+        }
+    }
+    return options.Parameters.TickSize > 0.0 && options.Parameters.Quantity > 0 && options.Port > 0;
+}
+
+// Seconds since midnight, in the trading window's time zone, of a DTC time (Unix seconds, UTC).
+static int TimeOfDaySeconds(double unixSeconds, double utcOffsetHours) {
+    double local = std::floor(unixSeconds + utcOffsetHours * 3600.0);
+    double seconds = std::fmod(local, 86400.0);
+    return static_cast<int>(seconds < 0.0 ? seconds + 86400.0 : seconds);
+}
+
+static CoreOrderStatus CoreStatusFor(int32_t dtcStatus) {
+    switch (dtcStatus) {
+    case DTC_ORDER_STATUS_OPEN:
+    case DTC_ORDER_STATUS_PARTIALLY_FILLED:
+    case DTC_ORDER_STATUS_PENDING_CANCEL:
+    case DTC_ORDER_STATUS_PENDING_CANCEL_REPLACE:
+        return CORE_ORDER_WORKING;
+    case DTC_ORDER_STATUS_FILLED:
+        return CORE_ORDER_FILLED;
+    case DTC_ORDER_STATUS_CANCELED:
+        return CORE_ORDER_CANCELED;
+    case DTC_ORDER_STATUS_REJECTED:
+        return CORE_ORDER_ERROR;
+    default:
+        return CORE_ORDER_PENDING;
+    }
+}
+
+struct EngineStats {
+    long long Trades;
+    long long Frames;
+    long long BytesReceived;
+    long long MessagesSent;
+    long long EarlyFlushes;             // Sends forced by a full send buffer before the batch was complete.
+    std::vector<long long> ReactNs;     // Trade bytes received until the orders answering it were sent.
+    std::vector<long long> DecideNs;    // Trade bytes received until the state machine returned, every trade.
+};
+
+struct Engine {
+    const EngineOptions* Options;
+    int Socket;
+    BracketStateMachine Machine;
+    TradeRangeEstimator Range;
+    int NextClientOrderID;
+    double Bid;
+    double Ask;
+    uint8_t SendBuffer[4096];
+    size_t SendSize;
+    bool SendFailed;                    // A send made while queueing failed; FlushEngine reports it.
+    EngineStats Stats;
+};
+
+// Appends a message to the send buffer, sent in one write by FlushEngine. A message that does not fit
+// sends what is queued first. If that send fails, nothing more is queued and the next FlushEngine
+// returns false, so the caller closes the connection as for any failed send.
+template <typename T>
+static void QueueMessage(Engine& engine, const T& message) {
+    if (engine.SendFailed)
+        return;
+    if (engine.SendSize + sizeof(T) > sizeof(engine.SendBuffer)) {
+        engine.Stats.EarlyFlushes++;
+        bool sent = SendAllDTC(engine.Socket, engine.SendBuffer, engine.SendSize);
+        engine.SendSize = 0;
+        if (!sent) {
+            fprintf(stderr, "Send failed while flushing a full send buffer.\n");
+            engine.SendFailed = true;
+            return;
+        }
+    }
+    memcpy(engine.SendBuffer + engine.SendSize, &message, sizeof(T));
+    engine.SendSize += sizeof(T);
+    engine.Stats.MessagesSent++;
+}
+
+static bool FlushEngine(Engine& engine) {
+    bool sent = !engine.SendFailed && SendAllDTC(engine.Socket, engine.SendBuffer, engine.SendSize);
+    engine.SendSize = 0;
+    return sent;
+}
+
+static void QueueOCO(Engine& engine, int firstID, DTCOrderType firstType, DTCBuySell firstSide, double firstPrice,
+    int secondID, DTCOrderType secondType, DTCBuySell secondSide, double secondPrice, int quantity, int parentID) {
+    const EngineOptions& options = *engine.Options;
+    DTCSubmitNewOCOOrder order;
+    InitDTCMessage(order, DTC_SUBMIT_NEW_OCO_ORDER);
+    SetDTCText(order.Symbol, options.Symbol);
+    SetDTCText(order.Exchange, options.Exchange);
+    SetDTCText(order.TradeAccount, options.Account);
+    FormatClientOrderID(order.ClientOrderID_1, firstID);
+    order.OrderType_1 = firstType;
+    order.BuySell_1 = firstSide;
+    order.Price1_1 = firstPrice;
+    order.Quantity_1 = quantity;
+    FormatClientOrderID(order.ClientOrderID_2, secondID);
+    order.OrderType_2 = secondType;
+    order.BuySell_2 = secondSide;
+    order.Price1_2 = secondPrice;
+    order.Quantity_2 = quantity;
+    order.TimeInForce = DTC_TIF_DAY;
+    order.IsAutomatedOrder = 1;
+    if (parentID != 0)
+        FormatClientOrderID(order.ParentTriggerClientOrderID, parentID);
+    order.PartialFillHandling = DTC_PARTIAL_FILL_HANDLING_REDUCE_QUANTITY;
+    QueueMessage(engine, order);
+}
+
+static void QueueCancel(Engine& engine, int orderID) {
+    if (orderID == 0)
+        return;
+    DTCCancelOrder cancel;
+    InitDTCMessage(cancel, DTC_CANCEL_ORDER);
+    FormatClientOrderID(cancel.ClientOrderID, orderID);
+    SetDTCText(cancel.TradeAccount, engine.Options->Account);
+    QueueMessage(engine, cancel);
+}
+
+// Turns the state machine's commands into DTC messages. Client order IDs are allocated here, so a
+// submitted bracket is known to the state machine at once, without waiting for the server.
+static void QueueCommands(Engine& engine) {
+    BracketStateMachine& machine = engine.Machine;
+    for (int i = 0; i < machine.NumCommands; i++) {
+        const BracketCommand& command = machine.Commands[i];
+        if (command.Type == CORE_COMMAND_SUBMIT_BRACKET) {
+            const BracketLevels& levels = command.Levels;
+            BracketOrderIDs orders;
+            orders.BuyOrderID = ++engine.NextClientOrderID;
+            orders.SellOrderID = ++engine.NextClientOrderID;
+            orders.BuyStopID = ++engine.NextClientOrderID;
+            orders.BuyTargetID = ++engine.NextClientOrderID;
+            orders.SellStopID = ++engine.NextClientOrderID;
+            orders.SellTargetID = ++engine.NextClientOrderID;
+            QueueOCO(engine, orders.BuyOrderID, DTC_ORDER_TYPE_LIMIT, DTC_BUY, levels.BuyPrice,
+                orders.SellOrderID, DTC_ORDER_TYPE_LIMIT, DTC_SELL, levels.SellPrice, command.Quantity, 0);
+            QueueOCO(engine, orders.BuyStopID, DTC_ORDER_TYPE_STOP, DTC_SELL, levels.BuyPrice - levels.StopOffset,
+                orders.BuyTargetID, DTC_ORDER_TYPE_LIMIT, DTC_SELL, levels.BuyPrice + levels.TargetOffset, command.Quantity,
+                orders.BuyOrderID);
+            QueueOCO(engine, orders.SellStopID, DTC_ORDER_TYPE_STOP, DTC_BUY, levels.SellPrice + levels.StopOffset,
+                orders.SellTargetID, DTC_ORDER_TYPE_LIMIT, DTC_BUY, levels.SellPrice - levels.TargetOffset, command.Quantity,
+                orders.SellOrderID);
+            OnBracketSubmitted(machine, orders);
+        } else if (command.Type == CORE_COMMAND_CANCEL) {
+            QueueCancel(engine, command.OrderID);
+        } else {
+            const BracketOrderIDs& orders = machine.Orders;
+            QueueCancel(engine, orders.BuyOrderID);
+            QueueCancel(engine, orders.SellOrderID);
+            QueueCancel(engine, orders.BuyStopID);
+            QueueCancel(engine, orders.BuyTargetID);
+            QueueCancel(engine, orders.SellStopID);
+            QueueCancel(engine, orders.SellTargetID);
+            DTCSubmitFlattenPositionOrder flatten;
+            InitDTCMessage(flatten, DTC_SUBMIT_FLATTEN_POSITION_ORDER);
+            SetDTCText(flatten.Symbol, engine.Options->Symbol);
+            SetDTCText(flatten.Exchange, engine.Options->Exchange);
+            SetDTCText(flatten.TradeAccount, engine.Options->Account);
+            FormatClientOrderID(flatten.ClientOrderID, ++engine.NextClientOrderID);
+            flatten.IsAutomatedOrder = 1;
+            QueueMessage(engine, flatten);
+        }
+    }
+    machine.NumCommands = 0;
+}
+
+// Handles one frame, read in place. Returns false if the connection must be closed.
+static bool HandleFrame(Engine& engine, const DTCFrame& frame, long long receivedNs) {
+    const EngineOptions& options = *engine.Options;
+    BracketStateMachine& machine = engine.Machine;
+    engine.Stats.Frames++;
+    switch (frame.Type) {
+    case DTC_MARKET_DATA_UPDATE_TRADE: {
+        DTCMarketDataUpdateTrade copy;
+        const DTCMarketDataUpdateTrade* trade = DTCMessageAs(frame, copy);
+        engine.Stats.Trades++;
+        double rValue = UpdateTradeRange(engine.Range, trade->DateTime, trade->Price);
+        double center = options.CenterOnMid && engine.Bid > 0.0 && engine.Ask > 0.0 ? (engine.Bid + engine.Ask) / 2.0 : trade->Price;
+        OnBracketMarket(machine, TimeOfDaySeconds(trade->DateTime, options.UtcOffsetHours), center, rValue);
+        if (engine.Stats.DecideNs.size() < MAX_LATENCY_SAMPLES)
+            engine.Stats.DecideNs.push_back(NowNanoseconds() - receivedNs);
+        if (machine.NumCommands > 0) {
+            QueueCommands(engine);
+            if (!FlushEngine(engine))
+                return false;
+            if (engine.Stats.ReactNs.size() < MAX_LATENCY_SAMPLES)
+                engine.Stats.ReactNs.push_back(NowNanoseconds() - receivedNs);
+        }
+        return true;
+    }
+    case DTC_MARKET_DATA_UPDATE_BID_ASK: {
+        DTCMarketDataUpdateBidAsk copy;
+        const DTCMarketDataUpdateBidAsk* quote = DTCMessageAs(frame, copy);
+        engine.Bid = quote->BidPrice;
+        engine.Ask = quote->AskPrice;
+        return true;
+    }
+    case DTC_ORDER_UPDATE: {
+        DTCOrderUpdate copy;
+        const DTCOrderUpdate* update = DTCMessageAs(frame, copy);
+        int orderID = ParseClientOrderID(update->ClientOrderID);
+        if (orderID != 0)
+            OnBracketOrderUpdate(machine, orderID, CoreStatusFor(update->OrderStatus), update->FilledQuantity, update->AverageFillPrice);
+        break;
+    }
+    case DTC_POSITION_UPDATE: {
+        DTCPositionUpdate copy;
+        const DTCPositionUpdate* position = DTCMessageAs(frame, copy);
+        OnBracketPosition(machine, position->Quantity);
+        break;
+    }
+    case DTC_MARKET_DATA_REJECT: {
+        DTCMarketDataReject copy;
+        const DTCMarketDataReject* reject = DTCMessageAs(frame, copy);
+        fprintf(stderr, "Market data rejected: %.*s\n", DTC_TEXT_DESCRIPTION_LENGTH, reject->RejectText);
+        return false;
+    }
+    case DTC_LOGOFF:
+        fprintf(stderr, "Logged off by the server.\n");
+        return false;
+    default:
+        break;
+    }
+    if (machine.NumCommands > 0) {
+        QueueCommands(engine);
+        return FlushEngine(engine);
+    }
+    return true;
+}
+
+// The engine thread: busy-polls the socket and handles each frame where it landed in the buffer.
+static void RunEngine(Engine& engine, DTCReceiveBuffer& buffer) {
+    PinToCpu(engine.Options->Cpu);
+    long long nextHeartbeatNs = NowNanoseconds() + HEARTBEAT_SECONDS * 1000000000LL;
+    int spins = 0;
+    while (!StopRequested.load(std::memory_order_relaxed)) {
+        size_t space;
+        uint8_t* end = DTCReceiveSpace(buffer, space);
+        ssize_t received = recv(engine.Socket, end, space, MSG_DONTWAIT);
+        if (received <= 0) {
+            if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                fprintf(stderr, "Connection closed.\n");
+                break;
+            }
+            if ((spins & 1023) == 0 && NowNanoseconds() >= nextHeartbeatNs) {
+                DTCHeartbeat heartbeat;
+                InitDTCMessage(heartbeat, DTC_HEARTBEAT);
+                heartbeat.CurrentDateTime = static_cast<int64_t>(time(NULL));
+                QueueMessage(engine, heartbeat);
+                if (!FlushEngine(engine))
+                    break;
+                nextHeartbeatNs = NowNanoseconds() + HEARTBEAT_SECONDS * 1000000000LL;
+            }
+            Backoff(spins);
+            continue;
+        }
+        long long receivedNs = NowNanoseconds();
+        spins = 0;
+        buffer.End += static_cast<size_t>(received);
+        engine.Stats.BytesReceived += received;
+        DTCFrame frame;
+        int status;
+        bool open = true;
+        while (open && (status = NextDTCFrame(buffer.Data + buffer.Begin, buffer.End - buffer.Begin, frame)) != 0) {
+            if (status < 0) {
+                fprintf(stderr, "Malformed frame. Closing.\n");
+                open = false;
+                break;
+            }
+            buffer.Begin += frame.Size;
+            open = HandleFrame(engine, frame, receivedNs);
+        }
+        if (!open)
+            break;
+    }
+    StopRequested.store(true);
+}
+
+// Reads one whole message with a blocking socket, for the logon exchange.
+static bool ReadMessageBlocking(int socket, DTCReceiveBuffer& buffer, DTCFrame& frame) {
+    for (;;) {
+        int status = NextDTCFrame(buffer.Data + buffer.Begin, buffer.End - buffer.Begin, frame);
+        if (status < 0)
+            return false;
+        if (status > 0) {
+            buffer.Begin += frame.Size;
+            return true;
+        }
+        size_t space;
+        uint8_t* end = DTCReceiveSpace(buffer, space);
+        ssize_t received = recv(socket, end, space, 0);
+        if (received <= 0)
+            return false;
+        buffer.End += static_cast<size_t>(received);
+    }
+}
+
+static int Connect(const char* host, int port) {
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    addrinfo hints = addrinfo();
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = NULL;
+    if (getaddrinfo(host, service, &hints, &addresses) != 0)
+        return -1;
+    int result = -1;
+    for (addrinfo* address = addresses; address != NULL && result < 0; address = address->ai_next) {
+        int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0)
+            continue;
+        if (connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+            result = fd;
+        else
+            close(fd);
+    }
+    freeaddrinfo(addresses);
+    if (result >= 0) {
+        int noDelay = 1;
+        setsockopt(result, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+    return result;
+}
+
+// Logon and market data subscription, before the socket goes non-blocking.
+static bool LogOn(Engine& engine, DTCReceiveBuffer& buffer) {
+    const EngineOptions& options = *engine.Options;
+    DTCLogonRequest logon;
+    InitDTCMessage(logon, DTC_LOGON_REQUEST);
+    logon.ProtocolVersion = DTC_PROTOCOL_VERSION;
+    logon.HeartbeatIntervalInSeconds = HEARTBEAT_SECONDS;
+    SetDTCText(logon.TradeAccount, options.Account);
+    SetDTCText(logon.ClientName, "Scalping Bot DTC Engine");
+    if (!SendAllDTC(engine.Socket, &logon, sizeof(logon)))
+        return false;
+    DTCFrame frame;
+    do {
+        if (!ReadMessageBlocking(engine.Socket, buffer, frame))
+            return false;
+    } while (frame.Type != DTC_LOGON_RESPONSE);
+    DTCLogonResponse copy;
+    const DTCLogonResponse* response = DTCMessageAs(frame, copy);
+    if (response->Result != DTC_LOGON_SUCCESS) {
+        fprintf(stderr, "Logon failed: %.*s\n", DTC_TEXT_DESCRIPTION_LENGTH, response->ResultText);
+        return false;
+    }
+    if (!response->TradingIsSupported || !response->OCOOrdersSupported) {
+        fprintf(stderr, "The server does not support OCO order entry.\n");
+        return false;
+    }
+    printf("Logged on to %.*s\n", 60, response->ServerName);
+
+    DTCMarketDataRequest request;
+    InitDTCMessage(request, DTC_MARKET_DATA_REQUEST);
+    request.RequestAction = DTC_SUBSCRIBE;
+    request.SymbolID = 1;
+    SetDTCText(request.Symbol, options.Symbol);
+    SetDTCText(request.Exchange, options.Exchange);
+    return SendAllDTC(engine.Socket, &request, sizeof(request));
+}
+
+static long long Percentile(const std::vector<long long>& sorted, double percentile) {
+    if (sorted.empty())
+        return 0;
+    size_t rank = static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+}
+
+static void Report(const char* name, std::vector<long long>& samples) {
+    std::sort(samples.begin(), samples.end());
+    printf("%-8s n=%zu  p50 %lld ns  p99 %lld ns  p99.9 %lld ns  max %lld ns\n", name, samples.size(),
+        Percentile(samples, 50.0), Percentile(samples, 99.0), Percentile(samples, 99.9), samples.empty() ? 0 : samples.back());
+}
+
+int main(int argc, char** argv) {
+    EngineOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: dtc_engine [--host H] [--port P] [--symbol S] [--exchange E] [--account A] [--tick T]\n"
+            "                  [--bracket F] [--stop F] [--target F] [--quantity N] [--start HH:MM:SS] [--stop-time HH:MM:SS]\n"
+            "                  [--no-window] [--center-mid] [--bar-seconds N] [--r-length N] [--utc-offset-hours H]\n"
+            "                  [--cpu N] [--duration SECONDS]\n");
+        return 2;
+    }
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    static Engine engine;
+    static DTCReceiveBuffer buffer;
+    engine.Options = &options;
+    ResetBracketStateMachine(engine.Machine, options.Parameters);
+    ResetTradeRangeEstimator(engine.Range, options.BarSeconds, options.RangeLength);
+    engine.Stats.ReactNs.reserve(MAX_LATENCY_SAMPLES);
+    engine.Stats.DecideNs.reserve(MAX_LATENCY_SAMPLES);
+
+    engine.Socket = Connect(options.Host, options.Port);
+    if (engine.Socket < 0) {
+        fprintf(stderr, "Cannot connect to %s:%d\n", options.Host, options.Port);
+        return 1;
+    }
+    if (!LogOn(engine, buffer)) {
+        close(engine.Socket);
+        return 1;
+    }
+    fcntl(engine.Socket, F_SETFL, fcntl(engine.Socket, F_GETFL) | O_NONBLOCK);
+
+    std::thread engineThread(RunEngine, std::ref(engine), std::ref(buffer));
+    long long stopNs = options.DurationSeconds > 0 ? NowNanoseconds() + options.DurationSeconds * 1000000000LL : 0;
+    while (!StopRequested.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (stopNs != 0 && NowNanoseconds() >= stopNs)
+            StopRequested.store(true);
+    }
+    engineThread.join();
+
+    DTCLogoff logoff;
+    InitDTCMessage(logoff, DTC_LOGOFF);
+    SetDTCText(logoff.Reason, "Engine stopped");
+    SendAllDTC(engine.Socket, &logoff, sizeof(logoff));
+    close(engine.Socket);
+
+    const BracketCoreStats& stats = engine.Machine.Stats;
+    printf("%lld trades, %lld frames, %lld bytes in, %lld messages out, %lld early flushes\n", engine.Stats.Trades,
+        engine.Stats.Frames, engine.Stats.BytesReceived, engine.Stats.MessagesSent, engine.Stats.EarlyFlushes);
+    printf("Brackets %d, trades %d, wins %d, realized %.5f points, safety flattens %d\n", stats.BracketsSubmitted,
+        stats.Trades, stats.Wins, stats.RealizedPoints, stats.SafetyFlattens);
+    Report("decide", engine.Stats.DecideNs);
+    Report("react", engine.Stats.ReactNs);
+    return 0;
+}
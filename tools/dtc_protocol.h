@@ -0,0 +1,537 @@
+/*
+* ===================================================================
+*   Scalping Bot - DTC Protocol (Binary Encoding)
+* ===================================================================
+*
+*   The messages of the Data and Trading Communications protocol
+*   (https://dtcprotocol.org) that the standalone engine and the
+*   stand-in server exchange: logon, heartbeat, market data (trades,
+*   best bid/ask), OCO order entry with parent-triggered OCO children,
+*   cancel, flatten, order and position updates.
+*
+*   Message type numbers, enumerations, field names, record layouts
+*   and sizes follow DTCProtocol.h (protocol version 8), so the tools
+*   talk to any DTC server that uses the binary encoding. Every message
+*   is a little-endian fixed-size record that starts with uint16 Size
+*   and uint16 Type. The record sizes are checked at compile time, and
+*   against DTCProtocol.h itself when Sierra Chart's ACS_Source is on
+*   the include path.
+*
+*   Parsing is zero-copy: a frame is located in the receive buffer and
+*   read through a pointer to its record; text fields are read in place.
+*   A frame that is misaligned or shorter than its record is copied.
+*
+* ===================================================================
+*/
+
+#ifndef SCALPING_BOT_DTC_PROTOCOL_H
+#define SCALPING_BOT_DTC_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <sys/socket.h>
+#include <thread>
+#endif
+
+#define DTC_PROTOCOL_VERSION 8
+
+// Message types.
+enum DTCMessageType {
+    DTC_LOGON_REQUEST = 1,
+    DTC_LOGON_RESPONSE = 2,
+    DTC_HEARTBEAT = 3,
+    DTC_LOGOFF = 5,
+    DTC_MARKET_DATA_REQUEST = 101,
+    DTC_MARKET_DATA_REJECT = 103,
+    DTC_MARKET_DATA_UPDATE_TRADE = 107,
+    DTC_MARKET_DATA_UPDATE_BID_ASK = 108,
+    DTC_SUBMIT_NEW_OCO_ORDER = 201,
+    DTC_CANCEL_ORDER = 203,
+    DTC_SUBMIT_FLATTEN_POSITION_ORDER = 209,
+    DTC_ORDER_UPDATE = 301,
+    DTC_POSITION_UPDATE = 306
+};
+
+enum DTCLogonStatus { DTC_LOGON_SUCCESS = 1, DTC_LOGON_ERROR = 2 };
+enum DTCRequestAction { DTC_SUBSCRIBE = 1, DTC_UNSUBSCRIBE = 2 };
+enum DTCBuySell { DTC_BUY = 1, DTC_SELL = 2 };
+enum DTCOrderType { DTC_ORDER_TYPE_MARKET = 1, DTC_ORDER_TYPE_LIMIT = 2, DTC_ORDER_TYPE_STOP = 3 };
+enum DTCTimeInForce { DTC_TIF_DAY = 1, DTC_TIF_GOOD_TILL_CANCELED = 2 };
+
+enum DTCOrderStatus {
+    DTC_ORDER_STATUS_UNSPECIFIED = 0,
+    DTC_ORDER_STATUS_ORDER_SENT = 1,
+    DTC_ORDER_STATUS_PENDING_OPEN = 2,
+    DTC_ORDER_STATUS_PENDING_CHILD = 3,     // OCO child held until its parent fills.
+    DTC_ORDER_STATUS_OPEN = 4,
+    DTC_ORDER_STATUS_PENDING_CANCEL_REPLACE = 5,
+    DTC_ORDER_STATUS_PENDING_CANCEL = 6,
+    DTC_ORDER_STATUS_FILLED = 7,
+    DTC_ORDER_STATUS_CANCELED = 8,
+    DTC_ORDER_STATUS_REJECTED = 9,
+    DTC_ORDER_STATUS_PARTIALLY_FILLED = 10
+};
+
+enum DTCPartialFillHandling {
+    DTC_PARTIAL_FILL_UNSET = 0,
+    DTC_PARTIAL_FILL_HANDLING_REDUCE_QUANTITY = 1,      // The other OCO order is reduced by the filled quantity.
+    DTC_PARTIAL_FILL_HANDLING_IMMEDIATE_CANCEL = 2      // The other OCO order is cancelled on the first fill.
+};
+
+// Field lengths, as named in DTCProtocol.h.
+#define DTC_USERNAME_PASSWORD_LENGTH 32
+#define DTC_SYMBOL_EXCHANGE_DELIMITER_LENGTH 4
+#define DTC_SYMBOL_LENGTH 64
+#define DTC_EXCHANGE_LENGTH 16
+#define DTC_ORDER_ID_LENGTH 32
+#define DTC_TRADE_ACCOUNT_LENGTH 32
+#define DTC_TEXT_DESCRIPTION_LENGTH 96
+#define DTC_ORDER_FREE_FORM_TEXT_LENGTH 48
+#define DTC_GENERAL_IDENTIFIER_LENGTH 64
+#define DTC_ORDER_FILL_EXECUTION_LENGTH 64
+
+// DTC time types: Unix seconds, UTC.
+typedef int64_t DTCDateTime;
+typedef uint32_t DTCDateTime4Byte;
+typedef double DTCDateTimeWithMilliseconds;
+
+// The records below are DTCProtocol.h's, field for field and in its packing (8, so natural alignment
+// on the x86-64 targets these tools build for). Fields these tools do not use are kept so that every
+// record has the size a DTC peer sends and expects.
+#pragma pack(push, 8)
+
+struct DTCHeader {
+    uint16_t Size;
+    uint16_t Type;
+};
+
+struct DTCLogonRequest {
+    uint16_t Size;
+    uint16_t Type;
+    int32_t ProtocolVersion;
+    char Username[DTC_USERNAME_PASSWORD_LENGTH];
+    char Password[DTC_USERNAME_PASSWORD_LENGTH];
+    char GeneralTextData[DTC_GENERAL_IDENTIFIER_LENGTH];
+    int32_t Integer_1;
+    int32_t Integer_2;
+    int32_t HeartbeatIntervalInSeconds;
+    int32_t Unused1;
+    char TradeAccount[DTC_TRADE_ACCOUNT_LENGTH];
+    char HardwareIdentifier[DTC_GENERAL_IDENTIFIER_LENGTH];
+    char ClientName[32];
+    int32_t MarketDataTransmissionInterval;
+};
+
+struct DTCLogonResponse {
+    uint16_t Size;
+    uint16_t Type;
+    int32_t ProtocolVersion;
+    int32_t Result;                 // DTCLogonStatus.
+    char ResultText[DTC_TEXT_DESCRIPTION_LENGTH];
+    char ReconnectAddress[64];
+    int32_t Integer_1;
+    char ServerName[60];
+    uint8_t MarketDepthUpdatesBestBidAndAsk;
+    uint8_t TradingIsSupported;
+    uint8_t OCOOrdersSupported;
+    uint8_t OrderCancelReplaceSupported;
+    char SymbolExchangeDelimiter[DTC_SYMBOL_EXCHANGE_DELIMITER_LENGTH];
+    uint8_t SecurityDefinitionsSupported;
+    uint8_t HistoricalPriceDataSupported;
+    uint8_t ResubscribeWhenMarketDataFeedAvailable;
+    uint8_t MarketDepthIsSupported;
+    uint8_t OneHistoricalPriceDataRequestPerConnection;
+    uint8_t BracketOrdersSupported;
+    uint8_t UseIntegerPriceOrderMessages;
+    uint8_t UsesMultiplePositionsPerSymbolAndTradeAccount;
+    uint8_t MarketDataSupported;
+};
+
+struct DTCHeartbeat {
+    uint16_t Size;
+    uint16_t Type;
+    uint32_t NumDroppedMessages;
+    DTCDateTime CurrentDateTime;
+};
+
+struct DTCLogoff {
+    uint16_t Size;
+    uint16_t Type;
+    char Reason[DTC_TEXT_DESCRIPTION_LENGTH];
+    uint8_t DoNotReconnect;
+};
+
+struct DTCMarketDataRequest {
+    uint16_t Size;
+    uint16_t Type;
+    int32_t RequestAction;          // DTCRequestAction.
+    uint32_t SymbolID;              // Chosen by the client; market data messages carry it instead of the symbol.
+    char Symbol[DTC_SYMBOL_LENGTH];
+    char Exchange[DTC_EXCHANGE_LENGTH];
+    uint32_t IntervalForSnapshotUpdatesInMilliseconds;
+};
+
+struct DTCMarketDataReject {
+    uint16_t Size;
+    uint16_t Type;
+    uint32_t SymbolID;
+    char RejectText[DTC_TEXT_DESCRIPTION_LENGTH];
+};
+
+struct DTCMarketDataUpdateTrade {
+    uint16_t Size;
+    uint16_t Type;
+    uint32_t SymbolID;
+    uint16_t AtBidOrAsk;            // 1 = at bid, 2 = at ask.
+    double Price;
+    double Volume;
+    DTCDateTimeWithMilliseconds DateTime;
+};
+
+struct DTCMarketDataUpdateBidAsk {
+    uint16_t Size;
+    uint16_t Type;
+    uint32_t SymbolID;
+    double BidPrice;
+    float BidQuantity;
+    double AskPrice;
+    float AskQuantity;
+    DTCDateTime4Byte DateTime;
+};
+
+// Two orders where a fill of one cancels the other. With ParentTriggerClientOrderID set, the pair is
+// held until that order fills and is then sized to its filled quantity: the attached stop and target.
+struct DTCSubmitNewOCOOrder {
+    uint16_t Size;
+    uint16_t Type;
+    char Symbol[DTC_SYMBOL_LENGTH];
+    char Exchange[DTC_EXCHANGE_LENGTH];
+    char ClientOrderID_1[DTC_ORDER_ID_LENGTH];
+    int32_t OrderType_1;
+    int32_t BuySell_1;
+    double Price1_1;
+    double Price2_1;
+    double Quantity_1;
+    char ClientOrderID_2[DTC_ORDER_ID_LENGTH];
+    int32_t OrderType_2;
+    int32_t BuySell_2;
+    double Price1_2;
+    double Price2_2;
+    double Quantity_2;
+    int32_t TimeInForce;
+    DTCDateTime GoodTillDateTime;
+    char TradeAccount[DTC_TRADE_ACCOUNT_LENGTH];
+    uint8_t IsAutomatedOrder;
+    char ParentTriggerClientOrderID[DTC_ORDER_ID_LENGTH];
+    char FreeFormText[DTC_ORDER_FREE_FORM_TEXT_LENGTH];
+    int32_t OpenOrClose;
+    int32_t PartialFillHandling;    // DTCPartialFillHandling.
+    uint8_t UseOffsets;
+    double OffsetFromParent1;
+    double OffsetFromParent2;
+    uint8_t MaintainSamePricesOnParentFill;
+};
+
+struct DTCCancelOrder {
+    uint16_t Size;
+    uint16_t Type;
+    char ServerOrderID[DTC_ORDER_ID_LENGTH];
+    char ClientOrderID[DTC_ORDER_ID_LENGTH];
+    char TradeAccount[DTC_TRADE_ACCOUNT_LENGTH];
+};
+
+struct DTCSubmitFlattenPositionOrder {
+    uint16_t Size;
+    uint16_t Type;
+    char Symbol[DTC_SYMBOL_LENGTH];
+    char Exchange[DTC_EXCHANGE_LENGTH];
+    char TradeAccount[DTC_TRADE_ACCOUNT_LENGTH];
+    char ClientOrderID[DTC_ORDER_ID_LENGTH];
+    char FreeFormText[DTC_ORDER_FREE_FORM_TEXT_LENGTH];
+    uint8_t IsAutomatedOrder;
+};
+
+struct DTCOrderUpdate {
+    uint16_t Size;
+    uint16_t Type;
+    int32_t RequestID;
+    int32_t TotalNumMessages;
+    int32_t MessageNumber;
+    char Symbol[DTC_SYMBOL_LENGTH];
+    char Exchange[DTC_EXCHANGE_LENGTH];
+    char PreviousServerOrderID[DTC_ORDER_ID_LENGTH];
+    char ServerOrderID[DTC_ORDER_ID_LENGTH];
+    char ClientOrderID[DTC_ORDER_ID_LENGTH];
+    char ExchangeOrderID[DTC_ORDER_ID_LENGTH];
+    int32_t OrderStatus;            // DTCOrderStatus.
+    int32_t OrderUpdateReason;
+    int32_t OrderType;
+    int32_t BuySell;
+    double Price1;
+    double Price2;
+    int32_t TimeInForce;
+    DTCDateTime GoodTillDateTime;
+    double OrderQuantity;
+    double FilledQuantity;
+    double RemainingQuantity;
+    double AverageFillPrice;
+    double LastFillPrice;
+    DTCDateTimeWithMilliseconds LastFillDateTime;
+    double LastFillQuantity;
+    char LastFillExecutionID[DTC_ORDER_FILL_EXECUTION_LENGTH];
+    char TradeAccount[DTC_TRADE_ACCOUNT_LENGTH];
+    char InfoText[DTC_TEXT_DESCRIPTION_LENGTH];
+    uint8_t NoOrders;
+    char ParentServerOrderID[DTC_ORDER_ID_LENGTH];
+    char OCOLinkedOrderServerOrderID[DTC_ORDER_ID_LENGTH];
+    int32_t OpenOrClose;
+    char PreviousClientOrderID[DTC_ORDER_ID_LENGTH];
+    char FreeFormText[DTC_ORDER_FREE_FORM_TEXT_LENGTH];
+    DTCDateTime OrderReceivedDateTime;
+    DTCDateTimeWithMilliseconds LatestTransactionDateTime;
+    char Username[DTC_USERNAME_PASSWORD_LENGTH];
+};
+
+struct DTCPositionUpdate {
+    uint16_t Size;
+    uint16_t Type;
+    int32_t RequestID;
+    int32_t TotalNumberMessages;
+    int32_t MessageNumber;
+    char Symbol[DTC_SYMBOL_LENGTH];
+    char Exchange[DTC_EXCHANGE_LENGTH];
+    double Quantity;                // Signed.
+    double AveragePrice;
+    char PositionIdentifier[DTC_ORDER_ID_LENGTH];
+    char TradeAccount[DTC_TRADE_ACCOUNT_LENGTH];
+    uint8_t NoPositions;
+    uint8_t Unsolicited;
+    double MarginRequirement;
+    DTCDateTime4Byte EntryDateTime;
+    double OpenProfitLoss;
+    double HighPriceDuringPosition;
+    double LowPriceDuringPosition;
+    double QuantityLimit;
+    double MaxPotentialPostionQuantity;
+};
+
+#pragma pack(pop)
+
+// Message sizes of DTCProtocol.h version 8. A record that drifts from its DTC size fails the build.
+static_assert(sizeof(DTCHeader) == 4, "DTC header size");
+static_assert(sizeof(DTCLogonRequest) == 284, "LOGON_REQUEST size");
+static_assert(sizeof(DTCLogonResponse) == 256, "LOGON_RESPONSE size");
+static_assert(sizeof(DTCHeartbeat) == 16, "HEARTBEAT size");
+static_assert(sizeof(DTCLogoff) == 102, "LOGOFF size");
+static_assert(sizeof(DTCMarketDataRequest) == 96, "MARKET_DATA_REQUEST size");
+static_assert(sizeof(DTCMarketDataReject) == 104, "MARKET_DATA_REJECT size");
+static_assert(sizeof(DTCMarketDataUpdateTrade) == 40, "MARKET_DATA_UPDATE_TRADE size");
+static_assert(sizeof(DTCMarketDataUpdateBidAsk) == 40, "MARKET_DATA_UPDATE_BID_ASK size");
+static_assert(sizeof(DTCSubmitNewOCOOrder) == 384, "SUBMIT_NEW_OCO_ORDER size");
+static_assert(sizeof(DTCCancelOrder) == 100, "CANCEL_ORDER size");
+static_assert(sizeof(DTCSubmitFlattenPositionOrder) == 198, "SUBMIT_FLATTEN_POSITION_ORDER size");
+static_assert(sizeof(DTCOrderUpdate) == 720, "ORDER_UPDATE size");
+static_assert(sizeof(DTCPositionUpdate) == 240, "POSITION_UPDATE size");
+
+// With Sierra Chart's ACS_Source on the include path, every record is also checked against the
+// header itself: the same size, and each field these tools read or write at the same offset.
+#if defined(__has_include)
+#if __has_include(<DTCProtocol.h>)
+#include <DTCProtocol.h>
+
+#define DTC_CHECK_SIZE(Record, Reference) \
+    static_assert(sizeof(Record) == sizeof(DTC::Reference), #Reference " size")
+#define DTC_CHECK_FIELD(Record, Reference, Field) \
+    static_assert(offsetof(Record, Field) == offsetof(DTC::Reference, Field), #Reference "::" #Field " offset")
+
+DTC_CHECK_SIZE(DTCLogonRequest, s_LogonRequest);
+DTC_CHECK_FIELD(DTCLogonRequest, s_LogonRequest, ProtocolVersion);
+DTC_CHECK_FIELD(DTCLogonRequest, s_LogonRequest, HeartbeatIntervalInSeconds);
+DTC_CHECK_FIELD(DTCLogonRequest, s_LogonRequest, TradeAccount);
+DTC_CHECK_FIELD(DTCLogonRequest, s_LogonRequest, ClientName);
+DTC_CHECK_SIZE(DTCLogonResponse, s_LogonResponse);
+DTC_CHECK_FIELD(DTCLogonResponse, s_LogonResponse, Result);
+DTC_CHECK_FIELD(DTCLogonResponse, s_LogonResponse, ResultText);
+DTC_CHECK_FIELD(DTCLogonResponse, s_LogonResponse, ServerName);
+DTC_CHECK_FIELD(DTCLogonResponse, s_LogonResponse, TradingIsSupported);
+DTC_CHECK_FIELD(DTCLogonResponse, s_LogonResponse, OCOOrdersSupported);
+DTC_CHECK_SIZE(DTCHeartbeat, s_Heartbeat);
+DTC_CHECK_FIELD(DTCHeartbeat, s_Heartbeat, CurrentDateTime);
+DTC_CHECK_SIZE(DTCLogoff, s_Logoff);
+DTC_CHECK_FIELD(DTCLogoff, s_Logoff, Reason);
+DTC_CHECK_SIZE(DTCMarketDataRequest, s_MarketDataRequest);
+DTC_CHECK_FIELD(DTCMarketDataRequest, s_MarketDataRequest, RequestAction);
+DTC_CHECK_FIELD(DTCMarketDataRequest, s_MarketDataRequest, SymbolID);
+DTC_CHECK_FIELD(DTCMarketDataRequest, s_MarketDataRequest, Symbol);
+DTC_CHECK_FIELD(DTCMarketDataRequest, s_MarketDataRequest, Exchange);
+DTC_CHECK_SIZE(DTCMarketDataReject, s_MarketDataReject);
+DTC_CHECK_FIELD(DTCMarketDataReject, s_MarketDataReject, RejectText);
+DTC_CHECK_SIZE(DTCMarketDataUpdateTrade, s_MarketDataUpdateTrade);
+DTC_CHECK_FIELD(DTCMarketDataUpdateTrade, s_MarketDataUpdateTrade, AtBidOrAsk);
+DTC_CHECK_FIELD(DTCMarketDataUpdateTrade, s_MarketDataUpdateTrade, Price);
+DTC_CHECK_FIELD(DTCMarketDataUpdateTrade, s_MarketDataUpdateTrade, DateTime);
+DTC_CHECK_SIZE(DTCMarketDataUpdateBidAsk, s_MarketDataUpdateBidAsk);
+DTC_CHECK_FIELD(DTCMarketDataUpdateBidAsk, s_MarketDataUpdateBidAsk, BidPrice);
+DTC_CHECK_FIELD(DTCMarketDataUpdateBidAsk, s_MarketDataUpdateBidAsk, AskPrice);
+DTC_CHECK_FIELD(DTCMarketDataUpdateBidAsk, s_MarketDataUpdateBidAsk, DateTime);
+DTC_CHECK_SIZE(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder);
+DTC_CHECK_FIELD(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder, ClientOrderID_1);
+DTC_CHECK_FIELD(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder, Price1_1);
+DTC_CHECK_FIELD(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder, Quantity_1);
+DTC_CHECK_FIELD(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder, ClientOrderID_2);
+DTC_CHECK_FIELD(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder, Price1_2);
+DTC_CHECK_FIELD(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder, Quantity_2);
+DTC_CHECK_FIELD(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder, TimeInForce);
+DTC_CHECK_FIELD(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder, TradeAccount);
+DTC_CHECK_FIELD(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder, ParentTriggerClientOrderID);
+DTC_CHECK_FIELD(DTCSubmitNewOCOOrder, s_SubmitNewOCOOrder, PartialFillHandling);
+DTC_CHECK_SIZE(DTCCancelOrder, s_CancelOrder);
+DTC_CHECK_FIELD(DTCCancelOrder, s_CancelOrder, ClientOrderID);
+DTC_CHECK_FIELD(DTCCancelOrder, s_CancelOrder, TradeAccount);
+DTC_CHECK_SIZE(DTCSubmitFlattenPositionOrder, s_SubmitFlattenPositionOrder);
+DTC_CHECK_FIELD(DTCSubmitFlattenPositionOrder, s_SubmitFlattenPositionOrder, ClientOrderID);
+DTC_CHECK_FIELD(DTCSubmitFlattenPositionOrder, s_SubmitFlattenPositionOrder, IsAutomatedOrder);
+DTC_CHECK_SIZE(DTCOrderUpdate, s_OrderUpdate);
+DTC_CHECK_FIELD(DTCOrderUpdate, s_OrderUpdate, ServerOrderID);
+DTC_CHECK_FIELD(DTCOrderUpdate, s_OrderUpdate, ClientOrderID);
+DTC_CHECK_FIELD(DTCOrderUpdate, s_OrderUpdate, OrderStatus);
+DTC_CHECK_FIELD(DTCOrderUpdate, s_OrderUpdate, Price1);
+DTC_CHECK_FIELD(DTCOrderUpdate, s_OrderUpdate, OrderQuantity);
+DTC_CHECK_FIELD(DTCOrderUpdate, s_OrderUpdate, FilledQuantity);
+DTC_CHECK_FIELD(DTCOrderUpdate, s_OrderUpdate, AverageFillPrice);
+DTC_CHECK_FIELD(DTCOrderUpdate, s_OrderUpdate, LastFillDateTime);
+DTC_CHECK_FIELD(DTCOrderUpdate, s_OrderUpdate, InfoText);
+DTC_CHECK_FIELD(DTCOrderUpdate, s_OrderUpdate, ParentServerOrderID);
+DTC_CHECK_SIZE(DTCPositionUpdate, s_PositionUpdate);
+DTC_CHECK_FIELD(DTCPositionUpdate, s_PositionUpdate, Quantity);
+DTC_CHECK_FIELD(DTCPositionUpdate, s_PositionUpdate, AveragePrice);
+
+#undef DTC_CHECK_SIZE
+#undef DTC_CHECK_FIELD
+#endif
+#endif
+
+// Zeroes the message and sets its header.
+template <typename T>
+inline void InitDTCMessage(T& message, DTCMessageType type) {
+    memset(&message, 0, sizeof(message));
+    message.Size = static_cast<uint16_t>(sizeof(T));
+    message.Type = static_cast<uint16_t>(type);
+}
+
+// Copies 'text' into a fixed-size text field, truncated and always terminated.
+template <size_t Length>
+inline void SetDTCText(char (&field)[Length], const char* text) {
+    strncpy(field, text, Length - 1);
+    field[Length - 1] = '\0';
+}
+
+// A message located in a receive buffer. Nothing is copied; Data points at its header.
+struct DTCFrame {
+    const uint8_t* Data;
+    uint16_t Size;
+    uint16_t Type;
+};
+
+// Locates the message at the start of 'data'. Returns 1 and the frame if it is complete, 0 if more
+// bytes are needed, -1 if the header is invalid (the stream cannot be resynchronized).
+inline int NextDTCFrame(const uint8_t* data, size_t available, DTCFrame& frame) {
+    if (available < sizeof(DTCHeader))
+        return 0;
+    uint16_t size;
+    memcpy(&size, data, sizeof(size));
+    if (size < sizeof(DTCHeader))
+        return -1;
+    if (available < size)
+        return 0;
+    frame.Data = data;
+    frame.Size = size;
+    memcpy(&frame.Type, data + 2, sizeof(frame.Type));
+    return 1;
+}
+
+// The frame as a message record. It is read in place when the frame holds the whole record and starts
+// aligned for it, which every frame of a stream of DTC records does. Otherwise it is copied into 'copy':
+// the fields a shorter frame (an older sender) lacks are zero, the extra bytes of a longer one ignored.
+template <typename T>
+inline const T* DTCMessageAs(const DTCFrame& frame, T& copy) {
+    if (frame.Size >= sizeof(T) && reinterpret_cast<uintptr_t>(frame.Data) % alignof(T) == 0)
+        return reinterpret_cast<const T*>(frame.Data);
+    memset(&copy, 0, sizeof(T));
+    memcpy(&copy, frame.Data, frame.Size < sizeof(T) ? frame.Size : sizeof(T));
+    return &copy;
+}
+
+// Receive buffer parsed in place. Bytes are appended at End and consumed from Begin; only a partial
+// frame left at the end of the buffer is ever moved, to the front, to make room. The buffer is aligned
+// for the records, so frames land aligned as long as the sender's frames have their records' sizes.
+#define DTC_RECEIVE_BUFFER_SIZE 65536
+
+struct DTCReceiveBuffer {
+    alignas(8) uint8_t Data[DTC_RECEIVE_BUFFER_SIZE];
+    size_t Begin;
+    size_t End;
+};
+
+inline uint8_t* DTCReceiveSpace(DTCReceiveBuffer& buffer, size_t& space) {
+    if (buffer.Begin == buffer.End) {
+        buffer.Begin = buffer.End = 0;
+    } else if (buffer.End == DTC_RECEIVE_BUFFER_SIZE) {
+        memmove(buffer.Data, buffer.Data + buffer.Begin, buffer.End - buffer.Begin);
+        buffer.End -= buffer.Begin;
+        buffer.Begin = 0;
+    }
+    space = DTC_RECEIVE_BUFFER_SIZE - buffer.End;
+    return buffer.Data + buffer.End;
+}
+
+// Integer client order ID from its "SB<n>" text form, read in place. 0 if it is not one of ours.
+inline int ParseClientOrderID(const char* text) {
+    if (text[0] != 'S' || text[1] != 'B')
+        return 0;
+    int value = 0;
+    for (const char* c = text + 2; *c >= '0' && *c <= '9'; c++)
+        value = value * 10 + (*c - '0');
+    return value;
+}
+
+template <size_t Length>
+inline void FormatClientOrderID(char (&field)[Length], int orderID) {
+    char digits[16];
+    int count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + orderID % 10);
+        orderID /= 10;
+    } while (orderID > 0 && count < 16);
+    size_t position = 0;
+    field[position++] = 'S';
+    field[position++] = 'B';
+    while (count > 0 && position < Length - 1)
+        field[position++] = digits[--count];
+    field[position] = '\0';
+}
+
+#if !defined(_WIN32)
+// Writes all of 'size' bytes to a socket, blocking or not. False if the connection failed.
+inline bool SendAllDTC(int socket, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t sent = send(socket, bytes, size, MSG_NOSIGNAL);
+        if (sent > 0) {
+            bytes += sent;
+            size -= static_cast<size_t>(sent);
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            std::this_thread::yield();
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+#endif // SCALPING_BOT_DTC_PROTOCOL_H
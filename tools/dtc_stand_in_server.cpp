@@ -0,0 +1,488 @@
+/*
+* ===================================================================
+*   Scalping Bot - Stand-In DTC Server
+* ===================================================================
+*
+*   A local DTC server for running and measuring the standalone engine
+*   (dtc_engine.cpp) without a broker or Sierra Chart. It speaks the
+*   DTC messages in dtc_protocol.h and serves one client at a time.
+*
+*   - Streams a random-walk trade and best bid/ask per step, with a
+*     simulated clock advancing --step-ms per trade from --start.
+*   - Works limit and stop orders against the trades, cancels the other
+*     order of an OCO pair on a fill, and holds parent-triggered pairs
+*     until their parent fills, re-basing their prices on its fill.
+*   - Sends order and position updates, and flattens at the last trade.
+*   - Measures the wire reaction: last trade written until the engine's
+*     bracket submission is read.
+*
+*   Build:  g++ -std=c++17 -O2 -pthread -I.. dtc_stand_in_server.cpp -o dtc_stand_in_server
+*   Run:    ./dtc_stand_in_server [--port 11099] [--rate TRADES_PER_SECOND] [--step-ms 250]
+*                                 [--start YYYY-MM-DDTHH:MM:SS] [--price 5000] [--tick 0.25] [--seed N]
+*
+* ===================================================================
+*/
+
+#include "dtc_protocol.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static volatile std::sig_atomic_t StopRequested = 0;
+
+static void OnSignal(int) { StopRequested = 1; }
+
+static long long NowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct ServerOptions {
+    int Port;
+    double TradesPerSecond;         // 0 = as fast as the client keeps up.
+    double StepSeconds;             // Simulated time between trades.
+    double StartTime;               // Unix seconds of the first trade.
+    double StartPrice;
+    double TickSize;
+    unsigned Seed;
+};
+
+// An order on the simulated exchange.
+enum SimulatedOrderState { SIM_PENDING_CHILD, SIM_OPEN, SIM_FILLED, SIM_CANCELED };
+
+struct SimulatedOrder {
+    int ClientOrderID;
+    int PeerID;                     // Other order of its OCO pair.
+    int ParentID;                   // Parent-triggered pair: the order whose fill activates it. 0 = none.
+    int Side;                       // +1 buy, -1 sell.
+    int32_t OrderType;
+    double Price;
+    double Quantity;
+    double FillPrice;
+    SimulatedOrderState State;
+    long long ActiveFromStep;       // Not matched before this step, so a child never fills on its parent's trade.
+};
+
+struct Session {
+    const ServerOptions* Options;
+    int Socket;
+    std::mt19937 Random;
+    double Price;
+    double Time;
+    long long Step;
+    uint32_t SymbolID;
+    bool Subscribed;
+    double Position;
+    double PositionPrice;
+    std::vector<SimulatedOrder> Orders;
+    long long LastTradeSentNs;
+    std::vector<long long> SubmitReactNs;
+    long long Fills;
+    long long Submissions;
+    uint8_t SendBuffer[16384];
+    size_t SendSize;
+};
+
+template <typename T>
+static void Queue(Session& session, const T& message) {
+    if (session.SendSize + sizeof(T) > sizeof(session.SendBuffer)) {
+        SendAllDTC(session.Socket, session.SendBuffer, session.SendSize);
+        session.SendSize = 0;
+    }
+    memcpy(session.SendBuffer + session.SendSize, &message, sizeof(T));
+    session.SendSize += sizeof(T);
+}
+
+static bool Flush(Session& session) {
+    bool sent = SendAllDTC(session.Socket, session.SendBuffer, session.SendSize);
+    session.SendSize = 0;
+    return sent;
+}
+
+static SimulatedOrder* FindOrder(Session& session, int clientOrderID) {
+    for (size_t i = 0; i < session.Orders.size(); i++)
+        if (session.Orders[i].ClientOrderID == clientOrderID)
+            return &session.Orders[i];
+    return NULL;
+}
+
+static void QueueOrderUpdate(Session& session, const SimulatedOrder& order, DTCOrderStatus status, const char* info) {
+    DTCOrderUpdate update;
+    InitDTCMessage(update, DTC_ORDER_UPDATE);
+    FormatClientOrderID(update.ClientOrderID, order.ClientOrderID);
+    snprintf(update.ServerOrderID, sizeof(update.ServerOrderID), "S%d", order.ClientOrderID);
+    update.OrderStatus = status;
+    update.OrderType = order.OrderType;
+    update.BuySell = order.Side > 0 ? DTC_BUY : DTC_SELL;
+    update.Price1 = order.Price;
+    update.OrderQuantity = order.Quantity;
+    if (status == DTC_ORDER_STATUS_FILLED) {
+        update.FilledQuantity = order.Quantity;
+        update.AverageFillPrice = order.FillPrice;
+        update.LastFillDateTime = session.Time;
+    }
+    if (order.ParentID != 0)
+        snprintf(update.ParentServerOrderID, sizeof(update.ParentServerOrderID), "S%d", order.ParentID);
+    SetDTCText(update.InfoText, info);
+    Queue(session, update);
+}
+
+static void QueuePosition(Session& session) {
+    DTCPositionUpdate position;
+    InitDTCMessage(position, DTC_POSITION_UPDATE);
+    position.Quantity = session.Position;
+    position.AveragePrice = session.Position != 0.0 ? session.PositionPrice : 0.0;
+    Queue(session, position);
+}
+
+// Cancels an order that is still working or waiting for its parent, and the pairs waiting on it.
+static void CancelOrder(Session& session, int clientOrderID, const char* info) {
+    SimulatedOrder* order = FindOrder(session, clientOrderID);
+    if (order == NULL || (order->State != SIM_OPEN && order->State != SIM_PENDING_CHILD))
+        return;
+    order->State = SIM_CANCELED;
+    QueueOrderUpdate(session, *order, DTC_ORDER_STATUS_CANCELED, info);
+    for (size_t i = 0; i < session.Orders.size(); i++)
+        if (session.Orders[i].ParentID == clientOrderID)
+            CancelOrder(session, session.Orders[i].ClientOrderID, "Parent canceled");
+}
+
+static void ApplyFill(Session& session, int side, double quantity, double price) {
+    double previous = session.Position;
+    session.Position += side * quantity;
+    if (session.Position == 0.0)
+        session.PositionPrice = 0.0;
+    else if (previous == 0.0 || (previous > 0.0) != (session.Position > 0.0))
+        session.PositionPrice = price;
+    else if ((previous > 0.0) == (side > 0))
+        session.PositionPrice = (session.PositionPrice * std::abs(previous) + price * quantity) / std::abs(session.Position);
+    session.Fills++;
+}
+
+static void FillOrder(Session& session, SimulatedOrder& filled, double price) {
+    filled.State = SIM_FILLED;
+    filled.FillPrice = price;
+    int clientOrderID = filled.ClientOrderID;
+    int peerID = filled.PeerID;
+    double shift = price - filled.Price;
+    QueueOrderUpdate(session, filled, DTC_ORDER_STATUS_FILLED, "");
+    ApplyFill(session, filled.Side, filled.Quantity, price);
+    CancelOrder(session, peerID, "OCO");
+    // Activate the pairs this fill triggers, their prices moved with the fill as attached orders are.
+    for (size_t i = 0; i < session.Orders.size(); i++) {
+        SimulatedOrder& child = session.Orders[i];
+        if (child.ParentID != clientOrderID || child.State != SIM_PENDING_CHILD)
+            continue;
+        child.State = SIM_OPEN;
+        child.Price += shift;
+        child.ActiveFromStep = session.Step + 1;
+        QueueOrderUpdate(session, child, DTC_ORDER_STATUS_OPEN, "Parent filled");
+    }
+    QueuePosition(session);
+}
+
+static bool Crosses(const SimulatedOrder& order, double trade) {
+    if (order.OrderType == DTC_ORDER_TYPE_LIMIT)
+        return order.Side > 0 ? trade <= order.Price : trade >= order.Price;
+    if (order.OrderType == DTC_ORDER_TYPE_STOP)
+        return order.Side > 0 ? trade >= order.Price : trade <= order.Price;
+    return true;
+}
+
+// Works the open orders against a trade. Limits fill at their price, stops at the trade.
+static void MatchOrders(Session& session, double trade) {
+    for (size_t i = 0; i < session.Orders.size(); i++) {
+        SimulatedOrder& order = session.Orders[i];
+        if (order.State != SIM_OPEN || order.ActiveFromStep > session.Step || !Crosses(order, trade))
+            continue;
+        FillOrder(session, order, order.OrderType == DTC_ORDER_TYPE_LIMIT ? order.Price : trade);
+    }
+    // Forget orders that ended a while ago; recent ones stay so late cancels and parents resolve.
+    int newest = session.Orders.empty() ? 0 : session.Orders.back().ClientOrderID;
+    session.Orders.erase(std::remove_if(session.Orders.begin(), session.Orders.end(), [newest](const SimulatedOrder& order) {
+        return (order.State == SIM_FILLED || order.State == SIM_CANCELED) && order.ClientOrderID < newest - 64;
+    }), session.Orders.end());
+}
+
+static void SubmitOCO(Session& session, const DTCSubmitNewOCOOrder& message, long long receivedNs) {
+    int firstID = ParseClientOrderID(message.ClientOrderID_1);
+    int secondID = ParseClientOrderID(message.ClientOrderID_2);
+    int parentID = message.ParentTriggerClientOrderID[0] != '\0' ? ParseClientOrderID(message.ParentTriggerClientOrderID) : 0;
+    const SimulatedOrder* parent = parentID != 0 ? FindOrder(session, parentID) : NULL;
+    bool parentFilled = parent != NULL && parent->State == SIM_FILLED;
+    double parentShift = parentFilled ? parent->FillPrice - parent->Price : 0.0;
+    SimulatedOrder orders[2];
+    for (int leg = 0; leg < 2; leg++) {
+        SimulatedOrder& order = orders[leg];
+        order = SimulatedOrder();
+        order.ClientOrderID = leg == 0 ? firstID : secondID;
+        order.PeerID = leg == 0 ? secondID : firstID;
+        order.ParentID = parentID;
+        order.Side = (leg == 0 ? message.BuySell_1 : message.BuySell_2) == DTC_BUY ? 1 : -1;
+        order.OrderType = leg == 0 ? message.OrderType_1 : message.OrderType_2;
+        order.Price = leg == 0 ? message.Price1_1 : message.Price1_2;
+        order.Quantity = leg == 0 ? message.Quantity_1 : message.Quantity_2;
+        order.ActiveFromStep = session.Step + 1;
+        order.State = parentID != 0 ? SIM_PENDING_CHILD : SIM_OPEN;
+    }
+    bool rejected = firstID == 0 || secondID == 0 || orders[0].Quantity <= 0.0 || FindOrder(session, firstID) != NULL ||
+        FindOrder(session, secondID) != NULL || (parentID != 0 && (parent == NULL || parent->State == SIM_CANCELED));
+    for (int leg = 0; leg < 2; leg++) {
+        if (rejected) {
+            QueueOrderUpdate(session, orders[leg], DTC_ORDER_STATUS_REJECTED, "Rejected");
+            continue;
+        }
+        if (parentFilled) {
+            orders[leg].State = SIM_OPEN;
+            orders[leg].Price += parentShift;
+        }
+        session.Orders.push_back(orders[leg]);
+        QueueOrderUpdate(session, orders[leg], orders[leg].State == SIM_OPEN ? DTC_ORDER_STATUS_OPEN : DTC_ORDER_STATUS_PENDING_CHILD, "");
+    }
+    if (parentID == 0 && !rejected) {
+        session.Submissions++;
+        if (session.LastTradeSentNs != 0)
+            session.SubmitReactNs.push_back(receivedNs - session.LastTradeSentNs);
+    }
+}
+
+static void Flatten(Session& session, const DTCSubmitFlattenPositionOrder& message) {
+    for (size_t i = 0; i < session.Orders.size(); i++)
+        CancelOrder(session, session.Orders[i].ClientOrderID, "Flatten");
+    if (session.Position == 0.0)
+        return;
+    SimulatedOrder order = SimulatedOrder();
+    order.ClientOrderID = ParseClientOrderID(message.ClientOrderID);
+    order.Side = session.Position > 0.0 ? -1 : 1;
+    order.OrderType = DTC_ORDER_TYPE_MARKET;
+    order.Quantity = std::abs(session.Position);
+    order.FillPrice = session.Price;
+    QueueOrderUpdate(session, order, DTC_ORDER_STATUS_FILLED, "Flatten");
+    ApplyFill(session, order.Side, order.Quantity, session.Price);
+    QueuePosition(session);
+}
+
+// Handles one client message. Returns false when the session ends.
+static bool HandleMessage(Session& session, const DTCFrame& frame, long long receivedNs) {
+    switch (frame.Type) {
+    case DTC_LOGON_REQUEST: {
+        DTCLogonResponse response;
+        InitDTCMessage(response, DTC_LOGON_RESPONSE);
+        response.ProtocolVersion = DTC_PROTOCOL_VERSION;
+        response.Result = DTC_LOGON_SUCCESS;
+        SetDTCText(response.ResultText, "Logged on");
+        SetDTCText(response.ServerName, "Scalping Bot stand-in DTC server");
+        response.TradingIsSupported = 1;
+        response.OCOOrdersSupported = 1;
+        Queue(session, response);
+        break;
+    }
+    case DTC_MARKET_DATA_REQUEST: {
+        DTCMarketDataRequest copy;
+        const DTCMarketDataRequest* request = DTCMessageAs(frame, copy);
+        session.SymbolID = request->SymbolID;
+        session.Subscribed = request->RequestAction == DTC_SUBSCRIBE;
+        break;
+    }
+    case DTC_SUBMIT_NEW_OCO_ORDER: {
+        DTCSubmitNewOCOOrder copy;
+        const DTCSubmitNewOCOOrder* order = DTCMessageAs(frame, copy);
+        SubmitOCO(session, *order, receivedNs);
+        break;
+    }
+    case DTC_CANCEL_ORDER: {
+        DTCCancelOrder copy;
+        const DTCCancelOrder* cancel = DTCMessageAs(frame, copy);
+        CancelOrder(session, ParseClientOrderID(cancel->ClientOrderID), "Canceled");
+        break;
+    }
+    case DTC_SUBMIT_FLATTEN_POSITION_ORDER: {
+        DTCSubmitFlattenPositionOrder copy;
+        const DTCSubmitFlattenPositionOrder* flatten = DTCMessageAs(frame, copy);
+        Flatten(session, *flatten);
+        break;
+    }
+    case DTC_LOGOFF:
+        return false;
+    default:
+        break;
+    }
+    return true;
+}
+
+// Reads and handles what the client sent. Returns false when the session ends.
+static bool PollClient(Session& session, DTCReceiveBuffer& buffer) {
+    for (;;) {
+        size_t space;
+        uint8_t* end = DTCReceiveSpace(buffer, space);
+        ssize_t received = recv(session.Socket, end, space, MSG_DONTWAIT);
+        if (received == 0)
+            return false;
+        if (received < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        long long receivedNs = NowNanoseconds();
+        buffer.End += static_cast<size_t>(received);
+        DTCFrame frame;
+        int status;
+        while ((status = NextDTCFrame(buffer.Data + buffer.Begin, buffer.End - buffer.Begin, frame)) > 0) {
+            buffer.Begin += frame.Size;
+            if (!HandleMessage(session, frame, receivedNs))
+                return false;
+        }
+        if (status < 0)
+            return false;
+        if (session.SendSize > 0 && !Flush(session))
+            return false;
+    }
+}
+
+static void SendMarketData(Session& session) {
+    std::uniform_int_distribution<int> move(-1, 1);
+    session.Price += move(session.Random) * session.Options->TickSize;
+    session.Time += session.Options->StepSeconds;
+    session.Step++;
+
+    DTCMarketDataUpdateBidAsk quote;
+    InitDTCMessage(quote, DTC_MARKET_DATA_UPDATE_BID_ASK);
+    quote.SymbolID = session.SymbolID;
+    quote.BidPrice = session.Price;
+    quote.AskPrice = session.Price + session.Options->TickSize;
+    quote.BidQuantity = quote.AskQuantity = 10.0f;
+    quote.DateTime = static_cast<DTCDateTime4Byte>(session.Time);
+    Queue(session, quote);
+
+    DTCMarketDataUpdateTrade trade;
+    InitDTCMessage(trade, DTC_MARKET_DATA_UPDATE_TRADE);
+    trade.SymbolID = session.SymbolID;
+    trade.AtBidOrAsk = move(session.Random) >= 0 ? 2 : 1;
+    trade.Price = session.Price;
+    trade.Volume = 1.0;
+    trade.DateTime = session.Time;
+    Queue(session, trade);
+}
+
+static long long Percentile(const std::vector<long long>& sorted, double percentile) {
+    if (sorted.empty())
+        return 0;
+    size_t rank = static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+}
+
+static void RunSession(const ServerOptions& options, int socket) {
+    Session session = Session();
+    DTCReceiveBuffer buffer;
+    buffer.Begin = buffer.End = 0;
+    session.Options = &options;
+    session.Socket = socket;
+    session.Random.seed(options.Seed);
+    session.Price = options.StartPrice;
+    session.Time = options.StartTime;
+    session.Orders.reserve(1024);
+    session.SubmitReactNs.reserve(1 << 20);
+
+    long long intervalNs = options.TradesPerSecond > 0.0 ? static_cast<long long>(1e9 / options.TradesPerSecond) : 0;
+    long long nextTradeNs = NowNanoseconds();
+    bool open = true;
+    while (open && !StopRequested) {
+        open = PollClient(session, buffer);
+        if (!open || !session.Subscribed)
+            continue;
+        long long now = NowNanoseconds();
+        if (now < nextTradeNs) {
+            if (nextTradeNs - now > 200000)
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            else
+                std::this_thread::yield();
+            continue;
+        }
+        nextTradeNs = intervalNs > 0 ? nextTradeNs + intervalNs : now;
+        SendMarketData(session);
+        MatchOrders(session, session.Price);
+        open = Flush(session);
+        session.LastTradeSentNs = NowNanoseconds();
+    }
+    close(socket);
+
+    std::vector<long long>& samples = session.SubmitReactNs;
+    std::sort(samples.begin(), samples.end());
+    printf("Session: %lld trades, %lld brackets, %lld fills, position %.0f\n", session.Step, session.Submissions,
+        session.Fills, session.Position);
+    printf("Trade sent to bracket received: n=%zu  p50 %lld ns  p99 %lld ns  max %lld ns\n", samples.size(),
+        Percentile(samples, 50.0), Percentile(samples, 99.0), samples.empty() ? 0 : samples.back());
+    fflush(stdout);
+}
+
+static double ParseDateTime(const char* text) {
+    tm parts = tm();
+    if (sscanf(text, "%d-%d-%dT%d:%d:%d", &parts.tm_year, &parts.tm_mon, &parts.tm_mday, &parts.tm_hour, &parts.tm_min, &parts.tm_sec) < 5)
+        return -1.0;
+    parts.tm_year -= 1900;
+    parts.tm_mon -= 1;
+    return static_cast<double>(timegm(&parts));
+}
+
+int main(int argc, char** argv) {
+    ServerOptions options;
+    options.Port = 11099;
+    options.TradesPerSecond = 1000.0;
+    options.StepSeconds = 0.25;
+    options.StartTime = ParseDateTime("2026-10-16T08:30:00");
+    options.StartPrice = 5000.0;
+    options.TickSize = 0.25;
+    options.Seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--port") == 0) options.Port = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--rate") == 0) options.TradesPerSecond = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--step-ms") == 0) options.StepSeconds = atof(argv[i + 1]) / 1000.0;
+        else if (strcmp(argv[i], "--start") == 0) options.StartTime = ParseDateTime(argv[i + 1]);
+        else if (strcmp(argv[i], "--price") == 0) options.StartPrice = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--tick") == 0) options.TickSize = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0) options.Seed = static_cast<unsigned>(atoi(argv[i + 1]));
+    }
+    if (options.StartTime < 0.0 || options.TickSize <= 0.0) {
+        fprintf(stderr, "Invalid --start or --tick\n");
+        return 2;
+    }
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(options.Port));
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0) {
+        fprintf(stderr, "Cannot listen on port %d\n", options.Port);
+        return 1;
+    }
+    printf("Listening on 127.0.0.1:%d\n", options.Port);
+    fflush(stdout);
+    while (!StopRequested) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0)
+            continue;
+        int noDelay = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+        RunSession(options, client);
+    }
+    close(listener);
+    return 0;
+}
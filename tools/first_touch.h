@@ -0,0 +1,122 @@
+/*
+* ===================================================================
+*   Scalping Bot - First-Touch Search
+* ===================================================================
+*
+*   Whether a filled entry reaches its stop or its target first, and
+*   whether an armed bracket fills on the buy or the sell limit, is the
+*   same question: the first trade at or below a low level or at or
+*   above a high level. FindFirstTouch answers it over a contiguous
+*   array of prices in ticks, 64 prices per iteration with AVX-512 and
+*   32 with AVX2, so a trade lasting tens of thousands of ticks costs
+*   a few hundred loop iterations instead of one branch per tick.
+*
+*   Build with -march=native (or -mavx2, -mavx512f) to get the SIMD
+*   kernels; otherwise FindFirstTouch is the scalar loop.
+*
+* ===================================================================
+*/
+
+#ifndef SCALPING_BOT_FIRST_TOUCH_H
+#define SCALPING_BOT_FIRST_TOUCH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX512F__)
+#define FIRST_TOUCH_KERNEL_NAME "AVX-512"
+#elif defined(__AVX2__)
+#define FIRST_TOUCH_KERNEL_NAME "AVX2"
+#else
+#define FIRST_TOUCH_KERNEL_NAME "scalar"
+#endif
+
+// Index of the first price at or below 'low' or at or above 'high', 'count' if there is none.
+inline size_t FindFirstTouchScalar(const int32_t* prices, size_t count, int32_t low, int32_t high) {
+    for (size_t i = 0; i < count; i++)
+        if (prices[i] <= low || prices[i] >= high)
+            return i;
+    return count;
+}
+
+#if defined(__AVX512F__)
+
+inline size_t FindFirstTouch(const int32_t* prices, size_t count, int32_t low, int32_t high) {
+    const __m512i lowLevel = _mm512_set1_epi32(low);
+    const __m512i highLevel = _mm512_set1_epi32(high);
+    size_t i = 0;
+    for (; i + 64 <= count; i += 64) {
+        __m512i a = _mm512_loadu_si512(prices + i);
+        __m512i b = _mm512_loadu_si512(prices + i + 16);
+        __m512i c = _mm512_loadu_si512(prices + i + 32);
+        __m512i d = _mm512_loadu_si512(prices + i + 48);
+        __mmask16 touchA = _mm512_cmple_epi32_mask(a, lowLevel) | _mm512_cmpge_epi32_mask(a, highLevel);
+        __mmask16 touchB = _mm512_cmple_epi32_mask(b, lowLevel) | _mm512_cmpge_epi32_mask(b, highLevel);
+        __mmask16 touchC = _mm512_cmple_epi32_mask(c, lowLevel) | _mm512_cmpge_epi32_mask(c, highLevel);
+        __mmask16 touchD = _mm512_cmple_epi32_mask(d, lowLevel) | _mm512_cmpge_epi32_mask(d, highLevel);
+        if (touchA | touchB | touchC | touchD) {
+            uint64_t touched = static_cast<uint64_t>(touchA) | static_cast<uint64_t>(touchB) << 16 |
+                static_cast<uint64_t>(touchC) << 32 | static_cast<uint64_t>(touchD) << 48;
+            return i + __builtin_ctzll(touched);
+        }
+    }
+    // The last 0 to 63 prices, 16 at a time; the final block is a masked load.
+    for (; i < count; i += 16) {
+        __mmask16 valid = count - i >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - i)) - 1);
+        __m512i a = _mm512_maskz_loadu_epi32(valid, prices + i);
+        __mmask16 touched = _mm512_mask_cmple_epi32_mask(valid, a, lowLevel) | _mm512_mask_cmpge_epi32_mask(valid, a, highLevel);
+        if (touched)
+            return i + __builtin_ctz(touched);
+    }
+    return count;
+}
+
+#elif defined(__AVX2__)
+
+// A price is inside when price > low and high > price; a block is skipped when all its prices are.
+inline size_t FindFirstTouch(const int32_t* prices, size_t count, int32_t low, int32_t high) {
+    const __m256i lowLevel = _mm256_set1_epi32(low);
+    const __m256i highLevel = _mm256_set1_epi32(high);
+    const __m256i allOnes = _mm256_set1_epi32(-1);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i + 8));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i + 16));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i + 24));
+        __m256i insideA = _mm256_and_si256(_mm256_cmpgt_epi32(a, lowLevel), _mm256_cmpgt_epi32(highLevel, a));
+        __m256i insideB = _mm256_and_si256(_mm256_cmpgt_epi32(b, lowLevel), _mm256_cmpgt_epi32(highLevel, b));
+        __m256i insideC = _mm256_and_si256(_mm256_cmpgt_epi32(c, lowLevel), _mm256_cmpgt_epi32(highLevel, c));
+        __m256i insideD = _mm256_and_si256(_mm256_cmpgt_epi32(d, lowLevel), _mm256_cmpgt_epi32(highLevel, d));
+        __m256i inside = _mm256_and_si256(_mm256_and_si256(insideA, insideB), _mm256_and_si256(insideC, insideD));
+        if (!_mm256_testc_si256(inside, allOnes)) {
+            uint32_t touched = ~(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(insideA))) |
+                static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(insideB))) << 8 |
+                static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(insideC))) << 16 |
+                static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(insideD))) << 24);
+            return i + __builtin_ctz(touched);
+        }
+    }
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i));
+        __m256i insideA = _mm256_and_si256(_mm256_cmpgt_epi32(a, lowLevel), _mm256_cmpgt_epi32(highLevel, a));
+        uint32_t touched = ~static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(insideA))) & 0xFFu;
+        if (touched)
+            return i + __builtin_ctz(touched);
+    }
+    return i + FindFirstTouchScalar(prices + i, count - i, low, high);
+}
+
+#else
+
+inline size_t FindFirstTouch(const int32_t* prices, size_t count, int32_t low, int32_t high) {
+    return FindFirstTouchScalar(prices, count, low, high);
+}
+
+#endif
+
+#endif // SCALPING_BOT_FIRST_TOUCH_H
@@ -0,0 +1,104 @@
+/*
+* ===================================================================
+*   Scalping Bot - First-Touch Benchmark
+* ===================================================================
+*
+*   Times FindFirstTouch (first_touch.h) against the scalar loop on a
+*   one-tick random walk. Each simulated trade starts at a random
+*   trade and sets its stop and target one tick outside the range of
+*   the next LENGTH - 1 trades, so the touch is at least LENGTH trades
+*   away. Both searches must return the same index for every trade.
+*
+*   Build:  g++ -std=c++17 -O3 -march=native -I.. first_touch_bench.cpp -o first_touch_bench
+*   Run:    ./first_touch_bench [--ticks N] [--trades N]
+*
+* ===================================================================
+*/
+
+#include "first_touch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static double NowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct TouchCase {
+    size_t Begin;
+    int32_t Low;
+    int32_t High;
+};
+
+typedef size_t (*TouchSearch)(const int32_t*, size_t, int32_t, int32_t);
+
+// Runs every case and returns the elapsed seconds; the touch indices go to 'touches'.
+static double TimeSearch(TouchSearch search, const std::vector<int32_t>& prices, const std::vector<TouchCase>& cases,
+    std::vector<size_t>& touches) {
+    touches.resize(cases.size());
+    double started = NowSeconds();
+    for (size_t i = 0; i < cases.size(); i++) {
+        const TouchCase& c = cases[i];
+        touches[i] = search(prices.data() + c.Begin, prices.size() - c.Begin, c.Low, c.High);
+    }
+    return NowSeconds() - started;
+}
+
+int main(int argc, char** argv) {
+    size_t tickCount = 50000000;
+    size_t tradeCount = 20000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--ticks") == 0) tickCount = strtoull(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--trades") == 0) tradeCount = strtoull(argv[i + 1], NULL, 10);
+        else {
+            fprintf(stderr, "Usage: first_touch_bench [--ticks N] [--trades N]\n");
+            return 2;
+        }
+    }
+
+    std::vector<int32_t> prices(tickCount);
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> move(-1, 1);
+    int32_t price = 20000;
+    for (size_t i = 0; i < tickCount; i++) {
+        price += move(random);
+        prices[i] = price;
+    }
+
+    printf("%s first-touch search, %zu ticks, %zu trades per length\n\n", FIRST_TOUCH_KERNEL_NAME, tickCount, tradeCount);
+    printf("  Length   Mean ticks   Scalar ns/trade   %s ns/trade   Speedup   Ticks/ns\n", FIRST_TOUCH_KERNEL_NAME);
+    const size_t lengths[] = { 16, 256, 4096, 32768, 65536 };
+    std::vector<TouchCase> cases(tradeCount);
+    std::vector<size_t> scalarTouches, touches;
+    for (size_t length : lengths) {
+        if (length + 1 >= tickCount)
+            break;
+        std::uniform_int_distribution<size_t> start(0, tickCount - length - 1);
+        for (TouchCase& c : cases) {
+            c.Begin = start(random);
+            const int32_t* range = prices.data() + c.Begin;
+            c.Low = *std::min_element(range, range + length - 1) - 1;
+            c.High = *std::max_element(range, range + length - 1) + 1;
+        }
+        double scalarSeconds = TimeSearch(FindFirstTouchScalar, prices, cases, scalarTouches);
+        double seconds = TimeSearch(FindFirstTouch, prices, cases, touches);
+        size_t scanned = 0;
+        for (size_t i = 0; i < cases.size(); i++) {
+            if (touches[i] != scalarTouches[i]) {
+                printf("Mismatch at trade %zu: scalar %zu, %s %zu\n", i, scalarTouches[i], FIRST_TOUCH_KERNEL_NAME, touches[i]);
+                return 1;
+            }
+            scanned += touches[i] + 1;
+        }
+        printf("%8zu %12.0f %17.1f %*.1f %9.1fx %10.2f\n", length, static_cast<double>(scanned) / cases.size(),
+            scalarSeconds * 1e9 / cases.size(),
+            static_cast<int>(strlen(FIRST_TOUCH_KERNEL_NAME)) + 10, seconds * 1e9 / cases.size(),
+            scalarSeconds / seconds, scanned / (seconds * 1e9));
+    }
+    return 0;
+}
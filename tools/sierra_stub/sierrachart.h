@@ -0,0 +1,552 @@
+/*
+* ===================================================================
+*   Scalping Bot - Sierra Chart Stub Header
+* ===================================================================
+*
+*   The subset of the ACSIL interface that scalping_bot.cpp uses, so
+*   the study compiles and runs outside Sierra Chart. Put this
+*   directory first on the include path (-Isierra_stub) to build the
+*   study into a tool; see allocation_replay.cpp.
+*
+*   The trade service is simulated in memory: limit and stop orders
+*   fill when StubTrade() prints through their price, trailing stops
+*   follow favorable trades at their offset, OCO siblings cancel each
+*   other, and attached stops and targets become working orders when
+*   their parent fills. Orders are kept in a fixed table and never
+*   removed. SCString is heap-backed like the real one, so
+*   a hot path that builds one still shows up as an allocation.
+*
+* ===================================================================
+*/
+
+#ifndef SCALPING_BOT_SIERRA_STUB_H
+#define SCALPING_BOT_SIERRA_STUB_H
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define SCDLLName(name)
+#define SCSFExport extern "C" void
+#define RGB(r, g, b) (static_cast<unsigned int>(r) | (static_cast<unsigned int>(g) << 8) | (static_cast<unsigned int>(b) << 16))
+
+inline int HMS_TIME(int hour, int minute, int second) { return hour * 3600 + minute * 60 + second; }
+
+//── Strings and Dates ─────────────────────────────────────────────────
+
+static const int SECONDS_PER_DAY = 86400;
+
+class SCString {
+public:
+    SCString() : m_Text(NULL) {}
+    SCString(const char* text) : m_Text(NULL) { Assign(text); }
+    SCString(const SCString& other) : m_Text(NULL) { Assign(other.m_Text); }
+    ~SCString() { free(m_Text); }
+    SCString& operator=(const SCString& other) { if (this != &other) Assign(other.m_Text); return *this; }
+    SCString& operator=(const char* text) { Assign(text); return *this; }
+
+    SCString& Format(const char* format, ...) {
+        char buffer[4096];
+        va_list arguments;
+        va_start(arguments, format);
+        vsnprintf(buffer, sizeof(buffer), format, arguments);
+        va_end(arguments);
+        Assign(buffer);
+        return *this;
+    }
+    const char* GetChars() const { return m_Text != NULL ? m_Text : ""; }
+    int GetLength() const { return static_cast<int>(strlen(GetChars())); }
+    operator const char*() const { return GetChars(); }
+
+private:
+    void Assign(const char* text) {
+        if (text == NULL) text = "";
+        size_t length = strlen(text);
+        char* copy = static_cast<char*>(malloc(length + 1));
+        memcpy(copy, text, length + 1);
+        free(m_Text);
+        m_Text = copy;
+    }
+
+    char* m_Text;
+};
+
+// Days since 1899-12-30 with the time of day as the fraction, like the real SCDateTime.
+class SCDateTime {
+public:
+    SCDateTime() : m_Days(0.0) {}
+    explicit SCDateTime(double days) : m_Days(days) {}
+    SCDateTime(int date, int timeInSeconds) : m_Days(date + timeInSeconds / 86400.0) {}
+
+    static SCDateTime SECONDS(int seconds) { return SCDateTime(seconds / 86400.0); }
+    static SCDateTime MILLISECONDS(int milliseconds) { return SCDateTime(milliseconds / 86400000.0); }
+
+    double GetAsDouble() const { return m_Days; }
+    bool IsUnset() const { return m_Days == 0.0; }
+    int GetDate() const { return static_cast<int>(std::floor(m_Days + 0.5 / 86400000.0)); }
+    int GetTime() const {
+        int seconds = static_cast<int>(std::floor((m_Days - GetDate()) * 86400.0 + 0.0005));
+        return seconds < 86400 ? seconds : 86399;
+    }
+    int GetHour() const { return GetTime() / 3600; }
+    int GetMinute() const { return GetTime() / 60 % 60; }
+    int GetSecond() const { return GetTime() % 60; }
+    int GetYear() const { int year, month, day; Civil(year, month, day); return year; }
+    int GetMonth() const { int year, month, day; Civil(year, month, day); return month; }
+    int GetDay() const { int year, month, day; Civil(year, month, day); return day; }
+
+    SCDateTime operator+(const SCDateTime& other) const { return SCDateTime(m_Days + other.m_Days); }
+    SCDateTime operator-(const SCDateTime& other) const { return SCDateTime(m_Days - other.m_Days); }
+    SCDateTime& operator+=(const SCDateTime& other) { m_Days += other.m_Days; return *this; }
+    SCDateTime& operator-=(const SCDateTime& other) { m_Days -= other.m_Days; return *this; }
+    bool operator<(const SCDateTime& other) const { return m_Days < other.m_Days; }
+    bool operator>(const SCDateTime& other) const { return m_Days > other.m_Days; }
+    bool operator<=(const SCDateTime& other) const { return m_Days <= other.m_Days; }
+    bool operator>=(const SCDateTime& other) const { return m_Days >= other.m_Days; }
+    bool operator==(const SCDateTime& other) const { return m_Days == other.m_Days; }
+    bool operator!=(const SCDateTime& other) const { return m_Days != other.m_Days; }
+
+private:
+    // Gregorian year, month and day of the date part.
+    void Civil(int& year, int& month, int& day) const {
+        long long days = GetDate() - 25569 + 719468; // 1899-12-30 to 1970-01-01, then to 0000-03-01.
+        long long era = (days >= 0 ? days : days - 146096) / 146097;
+        long long dayOfEra = days - era * 146097;
+        long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        long long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        long long monthIndex = (5 * dayOfYear + 2) / 153;
+        day = static_cast<int>(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+        month = static_cast<int>(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+        year = static_cast<int>(yearOfEra + era * 400 + (month <= 2 ? 1 : 0));
+    }
+
+    double m_Days;
+};
+
+typedef SCDateTime SCDateTimeMS;
+
+//── Arrays, Inputs and Subgraphs ──────────────────────────────────────
+
+template <typename T>
+class SCArray {
+public:
+    SCArray() : m_Data(NULL), m_Size(0) {}
+    void Attach(T* data, int size) { m_Data = data; m_Size = size; }
+    int GetArraySize() const { return m_Size; }
+    T& operator[](int index) {
+        static T outOfRange;
+        return (m_Data != NULL && index >= 0 && index < m_Size) ? m_Data[index] : outOfRange;
+    }
+    const T& operator[](int index) const { return const_cast<SCArray*>(this)->operator[](index); }
+
+private:
+    T* m_Data;
+    int m_Size;
+};
+
+typedef SCArray<float> SCFloatArray;
+typedef SCArray<float>& SCFloatArrayRef;
+typedef SCArray<SCDateTime> SCDateTimeArray;
+
+class SCInput {
+public:
+    SCInput() : m_Int(0), m_Float(0.0f), m_StudyID(0), m_SubgraphIndex(0) { m_Path[0] = '\0'; }
+
+    SCString Name;
+
+    void SetInt(int value) { m_Int = value; m_Float = static_cast<float>(value); }
+    void SetFloat(float value) { m_Float = value; m_Int = static_cast<int>(value); }
+    void SetYesNo(int value) { SetInt(value != 0 ? 1 : 0); }
+    void SetTime(int timeInSeconds) { SetInt(timeInSeconds); }
+    void SetCustomInputIndex(int index) { SetInt(index); }
+    void SetCustomInputStrings(const char*) {}
+    void SetIntLimits(int, int) {}
+    void SetFloatLimits(float, float) {}
+    void SetDescription(const char*) {}
+    void SetPathAndFileName(const char* path) { snprintf(m_Path, sizeof(m_Path), "%s", path); }
+    void SetStudySubgraphValues(int studyID, int subgraphIndex) { m_StudyID = studyID; m_SubgraphIndex = subgraphIndex; }
+
+    int GetInt() const { return m_Int; }
+    float GetFloat() const { return m_Float; }
+    int GetYesNo() const { return m_Int != 0 ? 1 : 0; }
+    int GetTime() const { return m_Int; }
+    int GetIndex() const { return m_Int; }
+    const char* GetPathAndFileName() const { return m_Path; }
+    int GetStudyID() const { return m_StudyID; }
+    int GetSubgraphIndex() const { return m_SubgraphIndex; }
+
+private:
+    int m_Int;
+    float m_Float;
+    int m_StudyID;
+    int m_SubgraphIndex;
+    char m_Path[260];
+};
+
+typedef SCInput& SCInputRef;
+
+class SCSubgraph {
+public:
+    SCSubgraph() : DrawStyle(0), PrimaryColor(0) {}
+
+    SCString Name;
+    int DrawStyle;
+    unsigned int PrimaryColor;
+    SCFloatArray Data;
+
+    float& operator[](int index) { return Data[index]; }
+};
+
+typedef SCSubgraph& SCSubgraphRef;
+
+enum DrawStyleEnum { DRAWSTYLE_IGNORE = 0, DRAWSTYLE_LINE = 1 };
+enum BarHasClosedEnum { BHCS_BAR_HAS_NOT_CLOSED = 0, BHCS_BAR_HAS_CLOSED = 1 };
+
+//── Trading ───────────────────────────────────────────────────────────
+
+enum SCOrderStatusCodeEnum {
+    SCT_OSC_UNSPECIFIED = 0,
+    SCT_OSC_ORDERSENT = 1,
+    SCT_OSC_PENDINGOPEN = 2,
+    SCT_OSC_PENDINGCHILD = 3,
+    SCT_OSC_OPEN = 4,
+    SCT_OSC_PENDINGCANCELREPLACE = 5,
+    SCT_OSC_PENDINGCANCEL = 6,
+    SCT_OSC_FILLED = 7,
+    SCT_OSC_CANCELED = 8,
+    SCT_OSC_ERROR = 9
+};
+
+enum SCOrderTypeEnum {
+    SCT_ORDERTYPE_MARKET = 0,
+    SCT_ORDERTYPE_LIMIT = 1,
+    SCT_ORDERTYPE_STOP = 2,
+    SCT_ORDERTYPE_STOP_LIMIT = 3,
+    SCT_ORDERTYPE_TRAILING_STOP = 7,
+    SCT_ORDERTYPE_OCO_BUY_LIMIT_SELL_LIMIT = 21
+};
+
+enum BuySellEnum { BSE_UNDEFINED = 0, BSE_BUY = 1, BSE_SELL = 2 };
+
+static const int SCTRADING_ORDER_ERROR = -1;
+
+struct s_SCNewOrder {
+    int OrderType;
+    int OrderQuantity;
+    double Price1;
+    double Price2;
+
+    int AttachedOrderTarget1Type, AttachedOrderTarget2Type, AttachedOrderTarget3Type, AttachedOrderTarget4Type;
+    int AttachedOrderStop1Type, AttachedOrderStop2Type, AttachedOrderStop3Type, AttachedOrderStop4Type;
+    double OCOGroup1Quantity, OCOGroup2Quantity, OCOGroup3Quantity, OCOGroup4Quantity;
+    double Target1Offset, Target2Offset, Target3Offset, Target4Offset;
+    double Stop1Offset, Stop2Offset, Stop3Offset, Stop4Offset;
+    double Target1Offset_2, Target2Offset_2, Target3Offset_2, Target4Offset_2;
+    double Stop1Offset_2, Stop2Offset_2, Stop3Offset_2, Stop4Offset_2;
+
+    // Written back by the trade service.
+    int InternalOrderID;
+    int InternalOrderID2;
+    int Target1InternalOrderID, Target2InternalOrderID, Target3InternalOrderID, Target4InternalOrderID;
+    int Stop1InternalOrderID, Stop2InternalOrderID, Stop3InternalOrderID, Stop4InternalOrderID;
+    int Target1InternalOrderID_2, Target2InternalOrderID_2, Target3InternalOrderID_2, Target4InternalOrderID_2;
+    int Stop1InternalOrderID_2, Stop2InternalOrderID_2, Stop3InternalOrderID_2, Stop4InternalOrderID_2;
+
+    s_SCNewOrder() { memset(this, 0, sizeof(*this)); }
+};
+
+struct s_SCTradeOrder {
+    int InternalOrderID;
+    int ParentInternalOrderID;
+    int OCOSiblingInternalOrderID;
+    int OrderTypeAsInt;
+    SCOrderStatusCodeEnum OrderStatusCode;
+    BuySellEnum BuySell;
+    double Price1;
+    double OrderQuantity;
+    double FilledQuantity;
+    double AvgFillPrice;
+
+    s_SCTradeOrder() { memset(this, 0, sizeof(*this)); }
+};
+
+struct s_SCPositionData {
+    double PositionQuantity;
+    double AveragePrice;
+
+    s_SCPositionData() : PositionQuantity(0.0), AveragePrice(0.0) {}
+};
+
+struct s_MarketDepthEntry {
+    float Price;
+    unsigned int Quantity;
+
+    s_MarketDepthEntry() : Price(0.0f), Quantity(0) {}
+};
+
+//── Study Interface ───────────────────────────────────────────────────
+
+static const int STUB_MAX_INPUTS = 128;
+static const int STUB_MAX_SUBGRAPHS = 64;
+static const int STUB_MAX_PERSISTENT = 1024;
+static const int STUB_MAX_ORDERS = 1 << 16;
+static const int STUB_MAX_DEPTH_LEVELS = 10;
+
+// A simulated order: the public record plus what the trade service needs to activate it.
+struct StubOrder {
+    s_SCTradeOrder Order;
+    double Offset;        // Attached orders: distance from the parent's fill price.
+};
+
+struct s_sc {
+    // Study settings.
+    int SetDefaults, LastCallToFunction, IsFullRecalculation, UpdateStartIndex, ArraySize, Index;
+    int AutoLoop, UpdateAlways, UsesMarketDepthData, MaintainTradeStatisticsAndTradesData;
+    int SendOrdersToTradeService, SupportAttachedOrdersForTrading, MaximumPositionAllowed;
+    int AllowMultipleEntriesInSameDirection, AllowOppositeEntryWithOpposingPositionOrOrders, AllowEntryWithWorkingOrders;
+    int CancelAllOrdersOnEntriesAndReversals, CancelAllOrdersOnEntries, CancelAllOrdersOnReversals, CancelAllWorkingOrdersOnExit;
+    int ChartNumber;
+    int StartTime1, EndTime1;                                // Session times, seconds since midnight.
+    SCString GraphName;
+    SCString Symbol;
+    float TickSize;
+    float CurrencyValuePerTick;
+    float Bid, Ask;
+    SCDateTime CurrentSystemDateTime, CurrentSystemDateTimeMS, LatestDateTimeForLastBar;
+
+    SCInput Input[STUB_MAX_INPUTS];
+    SCSubgraph Subgraph[STUB_MAX_SUBGRAPHS];
+    SCFloatArray Close, High, Low, Volume;
+    SCDateTimeArray BaseDateTimeIn;
+
+    // Stub-only state, set up by the tool driving the study.
+    SCFloatArray StubStudyArray;                             // Returned by GetStudyArrayUsingID.
+    int StubBarClosed;                                       // Returned by GetBarHasClosedStatus for the last bar.
+    s_MarketDepthEntry StubBidDepth[STUB_MAX_DEPTH_LEVELS];
+    s_MarketDepthEntry StubAskDepth[STUB_MAX_DEPTH_LEVELS];
+    int StubDepthLevels;
+    void (*StubLog)(const char* message);
+    StubOrder StubOrders[STUB_MAX_ORDERS];
+    int StubNumOrders;
+    s_SCPositionData StubPosition;
+    long long StubOrderActions;
+
+    int StubPersistentInts[STUB_MAX_PERSISTENT];
+    void* StubPersistentPointers[STUB_MAX_PERSISTENT];
+
+    int& GetPersistentInt(int key) { return StubPersistentInts[key & (STUB_MAX_PERSISTENT - 1)]; }
+    void*& GetPersistentPointer(int key) { return StubPersistentPointers[key & (STUB_MAX_PERSISTENT - 1)]; }
+
+    // Date of the trading day 'dateTime' belongs to: a session that starts in the evening counts as the next day.
+    int GetTradingDayDate(const SCDateTime& dateTime) {
+        int date = dateTime.GetDate();
+        return (StartTime1 > EndTime1 && dateTime.GetTime() >= StartTime1) ? date + 1 : date;
+    }
+    int GetBarHasClosedStatus(int index) { return index < ArraySize - 1 || StubBarClosed ? BHCS_BAR_HAS_CLOSED : BHCS_BAR_HAS_NOT_CLOSED; }
+    float RoundToTickSize(float value, float tickSize) { return RoundToIncrement(value, tickSize); }
+    float RoundToIncrement(float value, float increment) {
+        return increment > 0.0f ? static_cast<float>(std::floor(value / increment + 0.5) * increment) : value;
+    }
+    void GetStudyArrayUsingID(int, int, SCFloatArray& array) { array = StubStudyArray; }
+    int GetBidMarketDepthEntryAt(s_MarketDepthEntry& entry, int level) {
+        if (level < 0 || level >= StubDepthLevels) return 0;
+        entry = StubBidDepth[level];
+        return 1;
+    }
+    int GetAskMarketDepthEntryAt(s_MarketDepthEntry& entry, int level) {
+        if (level < 0 || level >= StubDepthLevels) return 0;
+        entry = StubAskDepth[level];
+        return 1;
+    }
+    SCString FormatDateTime(const SCDateTime& dateTime) {
+        SCString text;
+        text.Format("%04d-%02d-%02d %02d:%02d:%02d", dateTime.GetYear(), dateTime.GetMonth(), dateTime.GetDay(),
+            dateTime.GetHour(), dateTime.GetMinute(), dateTime.GetSecond());
+        return text;
+    }
+    void AddMessageToLog(const char* message, int) { if (StubLog != NULL) StubLog(message); }
+
+    //── Simulated trade service ──
+
+    int GetTradePosition(s_SCPositionData& position) { position = StubPosition; return 1; }
+
+    int GetOrderByOrderID(int orderID, s_SCTradeOrder& order) {
+        if (orderID <= 0 || orderID > StubNumOrders) return SCTRADING_ORDER_ERROR;
+        order = StubOrders[orderID - 1].Order;
+        return 1;
+    }
+    int GetOrderByIndex(int index, s_SCTradeOrder& order) {
+        if (index < 0 || index >= StubNumOrders) return SCTRADING_ORDER_ERROR;
+        order = StubOrders[index].Order;
+        return 1;
+    }
+
+    int SubmitOCOOrder(s_SCNewOrder& order) {
+        if (StubNumOrders + 2 * 9 > STUB_MAX_ORDERS) return -1;
+        StubOrderActions++;
+        order.InternalOrderID = StubSubmitParent(order, BSE_BUY, order.Price1, false);
+        order.InternalOrderID2 = StubSubmitParent(order, BSE_SELL, order.Price2, true);
+        StubOrders[order.InternalOrderID - 1].Order.OCOSiblingInternalOrderID = order.InternalOrderID2;
+        StubOrders[order.InternalOrderID2 - 1].Order.OCOSiblingInternalOrderID = order.InternalOrderID;
+        return 1;
+    }
+    int BuyOrder(s_SCNewOrder& order) { return StubSubmitSingle(order, BSE_BUY); }
+    int SellOrder(s_SCNewOrder& order) { return StubSubmitSingle(order, BSE_SELL); }
+
+    int ModifyOrder(s_SCNewOrder& order) {
+        StubOrderActions++;
+        StubOrder* modified = StubFind(order.InternalOrderID);
+        if (modified == NULL || !StubIsWorking(modified->Order)) return -1;
+        if (order.Price1 != 0.0) modified->Order.Price1 = order.Price1;
+        if (order.OrderQuantity > 0) modified->Order.OrderQuantity = order.OrderQuantity;
+        return 1;
+    }
+
+    int CancelOrder(int orderID) {
+        StubOrderActions++;
+        StubOrder* canceled = StubFind(orderID);
+        if (canceled == NULL || !StubIsWorking(canceled->Order)) return 0;
+        StubCancelWithChildren(orderID);
+        return 1;
+    }
+
+    int FlattenPosition() {
+        StubOrderActions++;
+        StubPosition = s_SCPositionData();
+        for (int i = 0; i < StubNumOrders; i++) {
+            if (StubOrders[i].Order.ParentInternalOrderID != 0 && StubIsWorking(StubOrders[i].Order))
+                StubOrders[i].Order.OrderStatusCode = SCT_OSC_CANCELED;
+        }
+        return 1;
+    }
+    int FlattenAndCancelAllOrders() {
+        StubOrderActions++;
+        StubPosition = s_SCPositionData();
+        for (int i = 0; i < StubNumOrders; i++) {
+            if (StubIsWorking(StubOrders[i].Order))
+                StubOrders[i].Order.OrderStatusCode = SCT_OSC_CANCELED;
+        }
+        return 1;
+    }
+
+    // One trade at 'price': trails the trailing stops, fills every working order it reaches, then
+    // activates their attached orders.
+    void StubTrade(float price) {
+        for (int i = 0; i < StubNumOrders; i++) {
+            s_SCTradeOrder& order = StubOrders[i].Order;
+            if (order.OrderStatusCode != SCT_OSC_OPEN) continue;
+            if (order.OrderTypeAsInt == SCT_ORDERTYPE_TRAILING_STOP) {
+                // Keeps its offset from the best price since activation: a sell stop only moves up, a buy stop down.
+                double trailed = order.BuySell == BSE_SELL ? price - StubOrders[i].Offset : price + StubOrders[i].Offset;
+                if (order.BuySell == BSE_SELL ? trailed > order.Price1 : trailed < order.Price1)
+                    order.Price1 = trailed;
+            }
+            bool isStop = order.OrderTypeAsInt != SCT_ORDERTYPE_LIMIT;
+            bool reached = (order.BuySell == BSE_BUY) == isStop ? price >= order.Price1 : price <= order.Price1;
+            if (reached)
+                StubFill(order.InternalOrderID, isStop ? price : static_cast<float>(order.Price1));
+        }
+    }
+
+    // Internal helpers of the simulated trade service.
+    StubOrder* StubFind(int orderID) { return (orderID > 0 && orderID <= StubNumOrders) ? &StubOrders[orderID - 1] : NULL; }
+    static bool StubIsWorking(const s_SCTradeOrder& order) {
+        return order.OrderStatusCode == SCT_OSC_OPEN || order.OrderStatusCode == SCT_OSC_PENDINGCHILD;
+    }
+    int StubAdd(int parentID, BuySellEnum side, int type, double price, double quantity, double offset, SCOrderStatusCodeEnum status) {
+        StubOrder& added = StubOrders[StubNumOrders++];
+        added = StubOrder();
+        added.Order.InternalOrderID = StubNumOrders;
+        added.Order.ParentInternalOrderID = parentID;
+        added.Order.OrderTypeAsInt = type;
+        added.Order.OrderStatusCode = status;
+        added.Order.BuySell = side;
+        added.Order.Price1 = price;
+        added.Order.OrderQuantity = quantity;
+        added.Offset = offset;
+        return added.Order.InternalOrderID;
+    }
+    // Adds a parent limit order and its attached groups; 'sellLeg' picks the _2 fields of an OCO.
+    int StubSubmitParent(s_SCNewOrder& order, BuySellEnum side, double price, bool sellLeg) {
+        int parentID = StubAdd(0, side, SCT_ORDERTYPE_LIMIT, price, order.OrderQuantity, 0.0, SCT_OSC_OPEN);
+        const int targetTypes[4] = { order.AttachedOrderTarget1Type, order.AttachedOrderTarget2Type, order.AttachedOrderTarget3Type, order.AttachedOrderTarget4Type };
+        const int stopTypes[4] = { order.AttachedOrderStop1Type, order.AttachedOrderStop2Type, order.AttachedOrderStop3Type, order.AttachedOrderStop4Type };
+        const double quantities[4] = { order.OCOGroup1Quantity, order.OCOGroup2Quantity, order.OCOGroup3Quantity, order.OCOGroup4Quantity };
+        const double targetOffsets[2][4] = {
+            { order.Target1Offset, order.Target2Offset, order.Target3Offset, order.Target4Offset },
+            { order.Target1Offset_2, order.Target2Offset_2, order.Target3Offset_2, order.Target4Offset_2 } };
+        const double stopOffsets[2][4] = {
+            { order.Stop1Offset, order.Stop2Offset, order.Stop3Offset, order.Stop4Offset },
+            { order.Stop1Offset_2, order.Stop2Offset_2, order.Stop3Offset_2, order.Stop4Offset_2 } };
+        int* const targetIDs[2][4] = {
+            { &order.Target1InternalOrderID, &order.Target2InternalOrderID, &order.Target3InternalOrderID, &order.Target4InternalOrderID },
+            { &order.Target1InternalOrderID_2, &order.Target2InternalOrderID_2, &order.Target3InternalOrderID_2, &order.Target4InternalOrderID_2 } };
+        int* const stopIDs[2][4] = {
+            { &order.Stop1InternalOrderID, &order.Stop2InternalOrderID, &order.Stop3InternalOrderID, &order.Stop4InternalOrderID },
+            { &order.Stop1InternalOrderID_2, &order.Stop2InternalOrderID_2, &order.Stop3InternalOrderID_2, &order.Stop4InternalOrderID_2 } };
+        int leg = sellLeg ? 1 : 0;
+        // A single OCO group uses the Target2/Stop2 types for the sell leg; scale-out groups share them.
+        BuySellEnum exitSide = side == BSE_BUY ? BSE_SELL : BSE_BUY;
+        for (int group = 0; group < 4; group++) {
+            int targetType = (sellLeg && quantities[0] == 0.0 && group == 0) ? targetTypes[1] : targetTypes[group];
+            int stopType = (sellLeg && quantities[0] == 0.0 && group == 0) ? stopTypes[1] : stopTypes[group];
+            if (targetType == 0 || (group > 0 && quantities[group] == 0.0)) break;
+            double quantity = quantities[0] == 0.0 ? order.OrderQuantity : quantities[group];
+            int targetID = StubAdd(parentID, exitSide, targetType, 0.0, quantity, targetOffsets[leg][group], SCT_OSC_PENDINGCHILD);
+            int stopID = StubAdd(parentID, exitSide, stopType, 0.0, quantity, stopOffsets[leg][group], SCT_OSC_PENDINGCHILD);
+            StubOrders[targetID - 1].Order.OCOSiblingInternalOrderID = stopID;
+            StubOrders[stopID - 1].Order.OCOSiblingInternalOrderID = targetID;
+            *targetIDs[leg][group] = targetID;
+            *stopIDs[leg][group] = stopID;
+            if (quantities[0] == 0.0) break;
+        }
+        return parentID;
+    }
+    int StubSubmitSingle(s_SCNewOrder& order, BuySellEnum side) {
+        if (StubNumOrders + 9 > STUB_MAX_ORDERS) return -1;
+        StubOrderActions++;
+        order.InternalOrderID = StubSubmitParent(order, side, order.Price1, false);
+        return 1;
+    }
+    void StubCancelWithChildren(int orderID) {
+        StubOrders[orderID - 1].Order.OrderStatusCode = SCT_OSC_CANCELED;
+        for (int i = orderID; i < StubNumOrders; i++) {
+            if (StubOrders[i].Order.ParentInternalOrderID == orderID && StubIsWorking(StubOrders[i].Order))
+                StubOrders[i].Order.OrderStatusCode = SCT_OSC_CANCELED;
+        }
+    }
+    void StubFill(int orderID, float price) {
+        s_SCTradeOrder& order = StubOrders[orderID - 1].Order;
+        order.OrderStatusCode = SCT_OSC_FILLED;
+        order.FilledQuantity = order.OrderQuantity;
+        order.AvgFillPrice = price;
+
+        double signedQuantity = order.BuySell == BSE_BUY ? order.OrderQuantity : -order.OrderQuantity;
+        double newQuantity = StubPosition.PositionQuantity + signedQuantity;
+        if (newQuantity == 0.0) StubPosition.AveragePrice = 0.0;
+        else if (StubPosition.PositionQuantity == 0.0) StubPosition.AveragePrice = price;
+        StubPosition.PositionQuantity = newQuantity;
+
+        if (order.OCOSiblingInternalOrderID != 0) {
+            StubOrder* sibling = StubFind(order.OCOSiblingInternalOrderID);
+            if (sibling != NULL && StubIsWorking(sibling->Order))
+                StubCancelWithChildren(sibling->Order.InternalOrderID);
+        }
+        if (order.ParentInternalOrderID != 0)
+            return;
+        double direction = order.BuySell == BSE_BUY ? 1.0 : -1.0;
+        for (int i = orderID; i < StubNumOrders; i++) {
+            StubOrder& child = StubOrders[i];
+            if (child.Order.ParentInternalOrderID != orderID || child.Order.OrderStatusCode != SCT_OSC_PENDINGCHILD) continue;
+            bool isTarget = child.Order.OrderTypeAsInt == SCT_ORDERTYPE_LIMIT;
+            child.Order.Price1 = price + direction * (isTarget ? child.Offset : -child.Offset);
+            child.Order.OrderStatusCode = SCT_OSC_OPEN;
+        }
+    }
+};
+
+typedef s_sc& SCStudyInterfaceRef;
+
+#endif // SCALPING_BOT_SIERRA_STUB_H
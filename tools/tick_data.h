@@ -0,0 +1,217 @@
+/*
+* ===================================================================
+*   Scalping Bot - Decoded Tick Data
+* ===================================================================
+*
+*   Trades decoded once for the offline simulators: prices as integer
+*   ticks in one contiguous array, cut into segments over which 'R'
+*   and the trading window are constant, and indexed by trading day.
+*   Every simulation reads this form, so a file is decoded once however
+*   many parameter sets and windows are run over it.
+*
+*   Sources:
+*   - Sierra Chart intraday files (.scid). Tick-by-tick files give one
+*     record per trade; bar files are read one record per bar close.
+*   - A random walk, for benchmarks without data.
+*
+*   'R' is built from the trades as the study's built-in estimator
+*   (TradeRangeEstimator in bracket_core.h), and the trading window
+*   follows the state machine's rules, so a segment says whether a
+*   bracket may be armed, must be cancelled, or the trade flattened.
+*
+* ===================================================================
+*/
+
+#ifndef SCALPING_BOT_TICK_DATA_H
+#define SCALPING_BOT_TICK_DATA_H
+
+#include "bracket_core.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Decoding parameters. They are fixed for the decoded data; only the bracket fractions vary per run.
+struct TickDataSettings {
+    double TickSize;
+    int StartTimeSeconds;           // Trading window, seconds since midnight local. -1 = no window.
+    int StopTimeSeconds;
+    double UtcOffsetHours;          // Local time = UTC + offset.
+    int BarSeconds;                 // 'R' estimator bar length.
+    int RangeLength;                // 'R' estimator EMA length, in bars.
+};
+
+// Window state of a segment, as OnBracketMarket sees it.
+enum SegmentWindow {
+    SEGMENT_OPEN = 0,               // Brackets may be armed.
+    SEGMENT_BEFORE_START = 1,       // An armed bracket is cancelled; a trade runs on.
+    SEGMENT_CLOSED = 2              // An armed bracket is cancelled and a trade flattened at the first trade.
+};
+
+// Trades [Begin, End) with the same 'R', window state and day.
+struct TickSegment {
+    uint32_t Begin;
+    uint32_t End;
+    double RangeR;                  // Price units. 0 until the estimator has a closed bar.
+    int32_t Window;                 // SegmentWindow.
+    int32_t Day;                    // Index into TickData::Days.
+};
+
+struct TickDay {
+    int32_t Date;                   // Local date, YYYYMMDD.
+    uint32_t FirstSegment;
+};
+
+struct TickData {
+    TickDataSettings Settings;
+    std::vector<int32_t> Prices;    // Trade prices in ticks.
+    std::vector<TickSegment> Segments;
+    std::vector<TickDay> Days;
+};
+
+// YYYYMMDD of a day count since 1970-01-01 (proleptic Gregorian).
+inline int32_t CivilDateFromDays(long long days) {
+    days += 719468;
+    long long era = (days >= 0 ? days : days - 146096) / 146097;
+    long long dayOfEra = days - era * 146097;
+    long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    long long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    long long monthIndex = (5 * dayOfYear + 2) / 153;
+    long long day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    long long month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    long long year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+    return static_cast<int32_t>(year * 10000 + month * 100 + day);
+}
+
+// Appends trades in time order and cuts the segments as it goes.
+struct TickDataBuilder {
+    TickData* Data;
+    TradeRangeEstimator Range;
+    long long CurrentLocalDay;
+};
+
+inline void BeginTickData(TickDataBuilder& builder, TickData& data, const TickDataSettings& settings) {
+    data = TickData();
+    data.Settings = settings;
+    builder.Data = &data;
+    ResetTradeRangeEstimator(builder.Range, settings.BarSeconds, settings.RangeLength);
+    builder.CurrentLocalDay = -1;
+}
+
+inline void AddTrade(TickDataBuilder& builder, double unixSeconds, double price) {
+    TickData& data = *builder.Data;
+    const TickDataSettings& settings = data.Settings;
+    double rValue = UpdateTradeRange(builder.Range, unixSeconds, price);
+    double localSeconds = std::floor(unixSeconds + settings.UtcOffsetHours * 3600.0);
+    long long localDay = static_cast<long long>(std::floor(localSeconds / 86400.0));
+    int timeOfDay = static_cast<int>(localSeconds - localDay * 86400.0);
+    int32_t window = SEGMENT_OPEN;
+    if (settings.StartTimeSeconds >= 0) {
+        if (timeOfDay < settings.StartTimeSeconds) window = SEGMENT_BEFORE_START;
+        else if (timeOfDay >= settings.StopTimeSeconds) window = SEGMENT_CLOSED;
+    }
+    uint32_t index = static_cast<uint32_t>(data.Prices.size());
+    data.Prices.push_back(static_cast<int32_t>(std::floor(price / settings.TickSize + 0.5)));
+
+    if (localDay != builder.CurrentLocalDay) {
+        TickDay day;
+        day.Date = CivilDateFromDays(localDay);
+        day.FirstSegment = static_cast<uint32_t>(data.Segments.size());
+        data.Days.push_back(day);
+        builder.CurrentLocalDay = localDay;
+    } else if (data.Segments.back().RangeR == rValue && data.Segments.back().Window == window) {
+        data.Segments.back().End = index + 1;
+        return;
+    }
+    TickSegment segment;
+    segment.Begin = index;
+    segment.End = index + 1;
+    segment.RangeR = rValue;
+    segment.Window = window;
+    segment.Day = static_cast<int32_t>(data.Days.size()) - 1;
+    data.Segments.push_back(segment);
+}
+
+// Sierra Chart intraday file (.scid): a 56-byte header, then 40-byte records. DateTime is in
+// microseconds since 1899-12-30 UTC; a tick record carries the trade in Close.
+#pragma pack(push, 1)
+struct ScidFileHeader {
+    char FileTypeUniqueHeaderID[4]; // "SCID"
+    uint32_t HeaderSize;
+    uint32_t RecordSize;
+    uint16_t Version;
+    uint16_t Unused1;
+    uint32_t UTCStartIndex;
+    char Reserve[36];
+};
+
+struct ScidRecord {
+    int64_t DateTime;
+    float Open;
+    float High;
+    float Low;
+    float Close;
+    uint32_t NumTrades;
+    uint32_t TotalVolume;
+    uint32_t BidVolume;
+    uint32_t AskVolume;
+};
+#pragma pack(pop)
+
+#define SCID_UNIX_EPOCH_DAYS 25569  // 1970-01-01 in days since 1899-12-30.
+
+// Decodes a .scid file, optionally only records with local dates in [fromDate, toDate] (YYYYMMDD, 0 =
+// unbounded). Returns false if the file cannot be read or is not an intraday file.
+inline bool LoadScidTicks(const char* path, const TickDataSettings& settings, TickData& data,
+    int32_t fromDate = 0, int32_t toDate = 0) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    ScidFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.FileTypeUniqueHeaderID, "SCID", 4) != 0 ||
+        header.RecordSize != sizeof(ScidRecord) || header.HeaderSize < sizeof(header)) {
+        fclose(file);
+        return false;
+    }
+    fseek(file, header.HeaderSize, SEEK_SET);
+    TickDataBuilder builder;
+    BeginTickData(builder, data, settings);
+    std::vector<ScidRecord> records(65536);
+    size_t count;
+    while ((count = fread(records.data(), sizeof(ScidRecord), records.size(), file)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            const ScidRecord& record = records[i];
+            if (record.Close <= 0.0f)
+                continue;
+            double unixSeconds = static_cast<double>(record.DateTime) / 1e6 - SCID_UNIX_EPOCH_DAYS * 86400.0;
+            if (fromDate != 0 || toDate != 0) {
+                int32_t date = CivilDateFromDays(static_cast<long long>(std::floor((unixSeconds + settings.UtcOffsetHours * 3600.0) / 86400.0)));
+                if ((fromDate != 0 && date < fromDate) || (toDate != 0 && date > toDate))
+                    continue;
+            }
+            AddTrade(builder, unixSeconds, record.Close);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+// A random walk of one-tick steps: 'count' trades, 'stepSeconds' apart, from 'startUnixSeconds'.
+inline void GenerateRandomWalkTicks(size_t count, double startUnixSeconds, double stepSeconds, double startPrice,
+    unsigned seed, const TickDataSettings& settings, TickData& data) {
+    TickDataBuilder builder;
+    BeginTickData(builder, data, settings);
+    data.Prices.reserve(count);
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> move(-1, 1);
+    double price = startPrice;
+    for (size_t i = 0; i < count; i++) {
+        price += move(random) * settings.TickSize;
+        AddTrade(builder, startUnixSeconds + i * stepSeconds, price);
+    }
+}
+
+#endif // SCALPING_BOT_TICK_DATA_H
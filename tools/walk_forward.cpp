@@ -0,0 +1,312 @@
+/*
+* ===================================================================
+*   Scalping Bot - Walk-Forward Optimization
+* ===================================================================
+*
+*   Rolls an in-sample window of trading days over the decoded trades.
+*   In each window the grid of BracketFrac / StopFrac / TPFrac sets is
+*   run with the lane simulator and the best set by the objective is
+*   chosen. That set then trades the out-of-sample days that follow,
+*   and the next window starts that many days later, so the
+*   out-of-sample windows tile the history after the first in-sample
+*   window. The out-of-sample results are stitched into one P&L curve,
+*   as if the fractions had been re-tuned at the start of every
+*   out-of-sample window.
+*
+*   The file is decoded once and every window reads the same arrays.
+*   'R' is estimated over the whole history, so it is already warm at
+*   the start of each window. Windows are independent until the
+*   stitching and run on --threads workers. Each window's best set
+*   only depends on that window.
+*
+*   Build:  g++ -std=c++17 -O3 -march=native -pthread -I.. walk_forward.cpp -o walk_forward
+*   Run:    ./walk_forward --scid ESZ6.scid --tick 0.25 --in-sample-days 60 --out-of-sample-days 20
+*           ./walk_forward --synthetic 60000000 --synthetic-step 1 --csv walk_forward.csv
+*
+* ===================================================================
+*/
+
+#include "bracket_simulator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static double NowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum WalkForwardObjective {
+    OBJECTIVE_PNL = 0,              // Closed P&L.
+    OBJECTIVE_PNL_LESS_DRAWDOWN = 1 // Closed P&L minus its maximum drawdown.
+};
+
+struct WalkForwardOptions {
+    const char* ScidPath;
+    int32_t FromDate;               // YYYYMMDD, 0 = from the start of the file.
+    int32_t ToDate;                 // YYYYMMDD, 0 = to the end of the file.
+    size_t SyntheticTrades;         // Random-walk trades when no file is given.
+    double SyntheticStepSeconds;
+    TickDataSettings Settings;
+    FractionRange Bracket;
+    FractionRange Stop;
+    FractionRange Target;
+    int InSampleDays;
+    int OutOfSampleDays;
+    int Objective;                  // WalkForwardObjective.
+    int MinTrades;                  // In-sample trades a set needs to be chosen.
+    int Threads;
+    const char* CsvPath;
+};
+
+// Days [InSampleFirstDay, OutOfSampleFirstDay) choose the set; days [OutOfSampleFirstDay, EndDay) trade it.
+struct WalkForwardWindow {
+    size_t InSampleFirstDay;
+    size_t OutOfSampleFirstDay;
+    size_t EndDay;
+    int Chosen;                     // Index into the grid, -1 if no set had MinTrades.
+    BracketSimResult InSample;
+    BracketSimResult OutOfSample;
+    BracketSimResult Stitched;      // The stitched curve after this window.
+};
+
+static int ParseTimeOfDay(const char* text) {
+    int hour = 0, minute = 0, second = 0;
+    if (sscanf(text, "%d:%d:%d", &hour, &minute, &second) < 2)
+        return -1;
+    return hour * 3600 + minute * 60 + second;
+}
+
+static bool ParseRange(const char* text, FractionRange& range) {
+    int fields = sscanf(text, "%lf:%lf:%lf", &range.From, &range.To, &range.Step);
+    if (fields == 1) {
+        range.To = range.From;
+        range.Step = 1.0;
+    }
+    return fields == 1 || (fields == 3 && range.Step > 0.0 && range.To >= range.From);
+}
+
+static bool ParseOptions(int argc, char** argv, WalkForwardOptions& options) {
+    options.ScidPath = NULL;
+    options.FromDate = 0;
+    options.ToDate = 0;
+    options.SyntheticTrades = 20000000;
+    options.SyntheticStepSeconds = 1.0;
+    options.Settings.TickSize = 0.25;
+    options.Settings.StartTimeSeconds = 8 * 3600 + 30 * 60;
+    options.Settings.StopTimeSeconds = 15 * 3600;
+    options.Settings.UtcOffsetHours = 0.0;
+    options.Settings.BarSeconds = 60;
+    options.Settings.RangeLength = 14;
+    options.Bracket = { 0.25, 1.5, 0.25 };
+    options.Stop = { 0.25, 2.0, 0.25 };
+    options.Target = { 0.25, 3.0, 0.25 };
+    options.InSampleDays = 60;
+    options.OutOfSampleDays = 20;
+    options.Objective = OBJECTIVE_PNL;
+    options.MinTrades = 20;
+    options.Threads = static_cast<int>(std::thread::hardware_concurrency());
+    options.CsvPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char* name = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(name, "--no-window") == 0) { options.Settings.StartTimeSeconds = -1; continue; }
+        if (value == NULL) {
+            fprintf(stderr, "Missing value for %s\n", name);
+            return false;
+        }
+        i++;
+        bool valid = true;
+        if (strcmp(name, "--scid") == 0) options.ScidPath = value;
+        else if (strcmp(name, "--from") == 0) options.FromDate = atoi(value);
+        else if (strcmp(name, "--to") == 0) options.ToDate = atoi(value);
+        else if (strcmp(name, "--synthetic") == 0) options.SyntheticTrades = strtoull(value, NULL, 10);
+        else if (strcmp(name, "--synthetic-step") == 0) options.SyntheticStepSeconds = atof(value);
+        else if (strcmp(name, "--tick") == 0) options.Settings.TickSize = atof(value);
+        else if (strcmp(name, "--start") == 0) options.Settings.StartTimeSeconds = ParseTimeOfDay(value);
+        else if (strcmp(name, "--stop-time") == 0) options.Settings.StopTimeSeconds = ParseTimeOfDay(value);
+        else if (strcmp(name, "--utc-offset-hours") == 0) options.Settings.UtcOffsetHours = atof(value);
+        else if (strcmp(name, "--bar-seconds") == 0) options.Settings.BarSeconds = atoi(value);
+        else if (strcmp(name, "--r-length") == 0) options.Settings.RangeLength = atoi(value);
+        else if (strcmp(name, "--bracket") == 0) valid = ParseRange(value, options.Bracket);
+        else if (strcmp(name, "--stop") == 0) valid = ParseRange(value, options.Stop);
+        else if (strcmp(name, "--target") == 0) valid = ParseRange(value, options.Target);
+        else if (strcmp(name, "--in-sample-days") == 0) valid = (options.InSampleDays = atoi(value)) > 0;
+        else if (strcmp(name, "--out-of-sample-days") == 0) valid = (options.OutOfSampleDays = atoi(value)) > 0;
+        else if (strcmp(name, "--objective") == 0) {
+            if (strcmp(value, "pnl") == 0) options.Objective = OBJECTIVE_PNL;
+            else if (strcmp(value, "pnl-dd") == 0) options.Objective = OBJECTIVE_PNL_LESS_DRAWDOWN;
+            else valid = false;
+        }
+        else if (strcmp(name, "--min-trades") == 0) options.MinTrades = atoi(value);
+        else if (strcmp(name, "--threads") == 0) valid = (options.Threads = atoi(value)) > 0;
+        else if (strcmp(name, "--csv") == 0) options.CsvPath = value;
+        else valid = false;
+        if (!valid) {
+            fprintf(stderr, "Invalid option %s %s\n", name, value);
+            return false;
+        }
+    }
+    if (options.Threads < 1)
+        options.Threads = 1;
+    return options.Settings.TickSize > 0.0 && options.SyntheticStepSeconds > 0.0;
+}
+
+// First segment of a day, or the end of the segments for the day after the last.
+static size_t DaySegment(const TickData& data, size_t day) {
+    return day < data.Days.size() ? data.Days[day].FirstSegment : data.Segments.size();
+}
+
+static long long Score(const BracketSimResult& result, int objective) {
+    return objective == OBJECTIVE_PNL_LESS_DRAWDOWN ? static_cast<long long>(result.PnLTicks) - result.MaxDrawdownTicks :
+        result.PnLTicks;
+}
+
+// Runs the grid over the window's in-sample days, chooses the best set, and runs it alone over the
+// out-of-sample days. 'groups' and 'results' are the worker's own buffers.
+static void RunWindow(const TickData& data, const std::vector<BracketFractions>& sets, const WalkForwardOptions& options,
+    WalkForwardWindow& window, std::vector<BracketLaneGroup>& groups, std::vector<BracketSimResult>& results) {
+    InitLaneGroups(sets, groups);
+    SimulateBracketLanes(data, DaySegment(data, window.InSampleFirstDay), DaySegment(data, window.OutOfSampleFirstDay), groups);
+    ReadLaneResults(groups, sets.size(), results);
+    window.Chosen = -1;
+    for (size_t i = 0; i < sets.size(); i++) {
+        if (results[i].Trades < options.MinTrades)
+            continue;
+        if (window.Chosen < 0 || Score(results[i], options.Objective) > Score(results[window.Chosen], options.Objective))
+            window.Chosen = static_cast<int>(i);
+    }
+    window.InSample = window.Chosen >= 0 ? results[window.Chosen] : BracketSimResult();
+    window.OutOfSample = BracketSimResult();
+    if (window.Chosen >= 0)
+        SimulateBracketReference(data, DaySegment(data, window.OutOfSampleFirstDay), DaySegment(data, window.EndDay),
+            sets[window.Chosen], window.OutOfSample);
+}
+
+static void WriteCsv(const char* path, const TickData& data, const std::vector<BracketFractions>& sets,
+    const std::vector<WalkForwardWindow>& windows) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return;
+    }
+    fprintf(file, "in_sample_from,in_sample_to,out_of_sample_from,out_of_sample_to,bracket_frac,stop_frac,tp_frac,"
+        "in_sample_trades,in_sample_pnl_ticks,in_sample_max_dd_ticks,out_of_sample_trades,out_of_sample_wins,"
+        "out_of_sample_pnl_ticks,out_of_sample_max_dd_ticks,stitched_pnl_ticks,stitched_max_dd_ticks\n");
+    for (const WalkForwardWindow& window : windows) {
+        BracketFractions set = window.Chosen >= 0 ? sets[window.Chosen] : BracketFractions();
+        fprintf(file, "%d,%d,%d,%d,%.4f,%.4f,%.4f,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", data.Days[window.InSampleFirstDay].Date,
+            data.Days[window.OutOfSampleFirstDay - 1].Date, data.Days[window.OutOfSampleFirstDay].Date,
+            data.Days[window.EndDay - 1].Date, set.BracketFraction, set.StopFraction, set.TakeProfitFraction,
+            window.InSample.Trades, window.InSample.PnLTicks, window.InSample.MaxDrawdownTicks, window.OutOfSample.Trades,
+            window.OutOfSample.Wins, window.OutOfSample.PnLTicks, window.OutOfSample.MaxDrawdownTicks,
+            window.Stitched.PnLTicks, window.Stitched.MaxDrawdownTicks);
+    }
+    fclose(file);
+}
+
+int main(int argc, char** argv) {
+    WalkForwardOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: walk_forward [--scid FILE [--from YYYYMMDD] [--to YYYYMMDD] | --synthetic TRADES [--synthetic-step S]]\n"
+            "                    [--tick T] [--start HH:MM:SS] [--stop-time HH:MM:SS] [--no-window] [--utc-offset-hours H]\n"
+            "                    [--bar-seconds N] [--r-length N] [--bracket FROM:TO:STEP] [--stop FROM:TO:STEP] [--target FROM:TO:STEP]\n"
+            "                    [--in-sample-days N] [--out-of-sample-days N] [--objective pnl|pnl-dd] [--min-trades N]\n"
+            "                    [--threads N] [--csv FILE]\n");
+        return 2;
+    }
+
+    TickData data;
+    double started = NowSeconds();
+    if (options.ScidPath != NULL) {
+        if (!LoadScidTicks(options.ScidPath, options.Settings, data, options.FromDate, options.ToDate)) {
+            fprintf(stderr, "Cannot read %s\n", options.ScidPath);
+            return 1;
+        }
+    } else {
+        GenerateRandomWalkTicks(options.SyntheticTrades, 1776328200.0, options.SyntheticStepSeconds, 5000.0, 1,
+            options.Settings, data);
+    }
+    printf("Decoded %zu trades, %zu segments, %zu days in %.2f s\n", data.Prices.size(), data.Segments.size(),
+        data.Days.size(), NowSeconds() - started);
+
+    std::vector<BracketFractions> sets;
+    BuildBracketGrid(options.Bracket, options.Stop, options.Target, sets);
+    std::vector<WalkForwardWindow> windows;
+    for (size_t first = 0; first + options.InSampleDays < data.Days.size(); first += options.OutOfSampleDays) {
+        WalkForwardWindow window = WalkForwardWindow();
+        window.InSampleFirstDay = first;
+        window.OutOfSampleFirstDay = first + options.InSampleDays;
+        window.EndDay = window.OutOfSampleFirstDay + options.OutOfSampleDays;
+        if (window.EndDay > data.Days.size())
+            window.EndDay = data.Days.size();
+        windows.push_back(window);
+    }
+    if (sets.empty() || windows.empty()) {
+        fprintf(stderr, "Nothing to simulate: %zu sets, %zu days for %d in-sample days.\n", sets.size(), data.Days.size(),
+            options.InSampleDays);
+        return 1;
+    }
+
+    int threads = options.Threads < static_cast<int>(windows.size()) ? options.Threads : static_cast<int>(windows.size());
+    std::atomic<size_t> nextWindow(0);
+    auto worker = [&]() {
+        std::vector<BracketLaneGroup> groups;
+        std::vector<BracketSimResult> results;
+        for (size_t w; (w = nextWindow.fetch_add(1)) < windows.size(); )
+            RunWindow(data, sets, options, windows[w], groups, results);
+    };
+    started = NowSeconds();
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& thread : workers)
+        thread.join();
+    double optimizeSeconds = NowSeconds() - started;
+
+    // Stitch the out-of-sample windows in order, one P&L curve through all of them.
+    started = NowSeconds();
+    BracketSimResult stitched = BracketSimResult();
+    for (WalkForwardWindow& window : windows) {
+        if (window.Chosen >= 0)
+            SimulateBracketReference(data, DaySegment(data, window.OutOfSampleFirstDay), DaySegment(data, window.EndDay),
+                sets[window.Chosen], stitched);
+        window.Stitched = stitched;
+    }
+    double stitchSeconds = NowSeconds() - started;
+
+    double setTrades = 0.0;
+    for (const WalkForwardWindow& window : windows)
+        setTrades += static_cast<double>(sets.size()) *
+            (data.Segments[DaySegment(data, window.OutOfSampleFirstDay) - 1].End - data.Segments[DaySegment(data, window.InSampleFirstDay)].Begin);
+    printf("%zu windows of %d + %d days, %zu sets, %s lanes on %d threads: %.2f s, %.3f ns per trade per set overall; stitched in %.3f s\n",
+        windows.size(), options.InSampleDays, options.OutOfSampleDays, sets.size(), SIM_KERNEL_NAME, threads, optimizeSeconds,
+        optimizeSeconds * 1e9 / setTrades, stitchSeconds);
+
+    printf("\n In sample           Out of sample     Bracket   Stop  Target   IS P&L   OOS trades   Win %%   OOS P&L   Stitched   Max DD\n");
+    for (const WalkForwardWindow& window : windows) {
+        printf(" %d-%d   %d-%d", data.Days[window.InSampleFirstDay].Date, data.Days[window.OutOfSampleFirstDay - 1].Date,
+            data.Days[window.OutOfSampleFirstDay].Date, data.Days[window.EndDay - 1].Date);
+        if (window.Chosen < 0) {
+            printf("   no set with %d trades\n", options.MinTrades);
+            continue;
+        }
+        const BracketFractions& set = sets[window.Chosen];
+        printf(" %8.3f %6.3f %7.3f %8d %12d %7.1f %9d %10d %8d\n", set.BracketFraction, set.StopFraction,
+            set.TakeProfitFraction, window.InSample.PnLTicks, window.OutOfSample.Trades,
+            window.OutOfSample.Trades > 0 ? 100.0 * window.OutOfSample.Wins / window.OutOfSample.Trades : 0.0,
+            window.OutOfSample.PnLTicks, window.Stitched.PnLTicks, window.Stitched.MaxDrawdownTicks);
+    }
+    printf("\nOut of sample, %d to %d: %d trades, %.1f%% wins, P&L %d ticks, max drawdown %d ticks\n",
+        data.Days[windows.front().OutOfSampleFirstDay].Date, data.Days[windows.back().EndDay - 1].Date, stitched.Trades,
+        stitched.Trades > 0 ? 100.0 * stitched.Wins / stitched.Trades : 0.0, stitched.PnLTicks, stitched.MaxDrawdownTicks);
+
+    if (options.CsvPath != NULL)
+        WriteCsv(options.CsvPath, data, sets, windows);
+    return 0;
+}